@@ -1,11 +1,103 @@
 #version 330 core
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec2 Velocity;    // motion vectors (taa.h); dropped by targets without them
 
 in vec2 TexCoords;
+in vec3 WorldPos;
+in vec3 Normal;
+in vec4 CurrClip;   // unjittered, this frame and last
+in vec4 PrevClip;
 
 uniform sampler2D texture_diffuse1;
+uniform samplerCube environment;   // reflection probe, or the skybox
+uniform vec3 viewPos;
+uniform float reflectivity;        // at normal incidence
+uniform float environmentLod;      // blurred (and cheaper) mip of the environment
+
+// image-based lighting (ibl.h), when environmentLighting is set
+uniform bool environmentLighting;
+uniform bool environmentIsProbe;   // else the prefiltered skybox gives the specular
+uniform vec3 sh[9];                // irradiance / pi
+uniform samplerCube specularMap;   // GGX-prefiltered skybox, roughness 0..1 over lods 0..specularMaxLod
+uniform sampler2D brdfLut;
+uniform float specularMaxLod;
+uniform float roughness;
+uniform float lodBias;             // coarser texture reads in reflection views
+uniform bool occlusionEnabled;     // screen-space ambient occlusion (ssao.h), half resolution
+uniform sampler2D occlusion;
+uniform sampler2D occlusionDepth;  // the depth it was computed from
+// the level's lights baked into the light probe grid (light_probes.h), sampled at this car
+uniform bool lightProbeEnabled;
+uniform vec4 lightProbe[3];        // per channel: constant, then the x, y, z terms
+
+vec3 irradiance(vec3 n)
+{
+    return sh[0] * 0.282095
+         + (sh[1] * n.y + sh[2] * n.z + sh[3] * n.x) * 0.488603
+         + (sh[4] * n.x * n.y + sh[5] * n.y * n.z + sh[7] * n.x * n.z) * 1.092548
+         + sh[6] * 0.315392 * (3.0 * n.z * n.z - 1.0)
+         + sh[8] * 0.546274 * (n.x * n.x - n.y * n.y);
+}
+
+// the probes' L1 harmonics for a surface facing n: scaled like the floor's diffuse term
+vec3 probeLight(vec3 n)
+{
+    if (!lightProbeEnabled) return vec3(0.0);
+    vec4 d = vec4(1.0, n);
+    return max(vec3(dot(lightProbe[0], d), dot(lightProbe[1], d), dot(lightProbe[2], d)), 0.0);
+}
+
+// this fragment's ambient occlusion from the half-resolution result: the four nearest
+// texels, bilinear, each weighted down by how far its depth is from this fragment's so
+// that nothing bleeds across silhouettes
+float ambientOcclusion()
+{
+    if (!occlusionEnabled) return 1.0;
+    vec2 coord = gl_FragCoord.xy * 0.5 - 0.5;
+    ivec2 base = ivec2(floor(coord));
+    vec2 f = coord - vec2(base);
+    ivec2 last = textureSize(occlusion, 0) - 1;
+    float sum = 0.0, total = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 o = ivec2(i & 1, i >> 1);
+        ivec2 p = clamp(base + o, ivec2(0), last);
+        float bilinear = (o.x == 1 ? f.x : 1.0 - f.x) * (o.y == 1 ? f.y : 1.0 - f.y);
+        // reversed-Z depth is near / distance: relative distance difference
+        float difference = abs(texelFetch(occlusionDepth, p, 0).r - gl_FragCoord.z) / gl_FragCoord.z;
+        float w = (bilinear + 1e-3) / (difference + 1e-3);
+        sum += w * texelFetch(occlusion, p, 0).r;
+        total += w;
+    }
+    return sum / total;
+}
 
 void main()
-{    
-    FragColor = texture(texture_diffuse1, TexCoords);
-}
\ No newline at end of file
+{
+    // screen motion since last frame, in texture coordinates
+    Velocity = (CurrClip.xy / CurrClip.w - PrevClip.xy / PrevClip.w) * 0.5;
+    vec4 base = texture(texture_diffuse1, TexCoords, lodBias);
+
+    vec3 N = normalize(Normal);
+    vec3 V = normalize(viewPos - WorldPos);
+    vec3 R = reflect(-V, N);
+    float NdotV = max(dot(N, V), 0.0);
+    float ao = ambientOcclusion();
+    if (environmentLighting)
+    {
+        // split sum: prefiltered radiance times the BRDF's scale and bias for F0
+        vec2 brdf = texture(brdfLut, vec2(NdotV, roughness)).rg;
+        vec3 radiance = environmentIsProbe ? textureLod(environment, R, environmentLod).rgb
+                                           : textureLod(specularMap, R, roughness * specularMaxLod).rgb;
+        vec3 specular = radiance * (reflectivity * brdf.x + brdf.y);
+        FragColor = vec4(base.rgb * (irradiance(N) * ao + probeLight(N)) * (1.0 - reflectivity) + specular, base.a);
+        return;
+    }
+
+    // clear-coat reflection, stronger at grazing angles (Schlick); with the probes the car
+    // is lit like the floor, its 0.3 ambient plus the baked light, else left unlit
+    float fresnel = reflectivity + (1.0 - reflectivity) * pow(1.0 - NdotV, 5.0);
+    vec3 reflection = textureLod(environment, R, environmentLod).rgb;
+    vec3 diffuse = lightProbeEnabled ? base.rgb * (0.3 * ao + probeLight(N)) : base.rgb * ao;
+    FragColor = vec4(mix(diffuse, reflection, reflectivity > 0.0 ? fresnel : 0.0), base.a);
+}
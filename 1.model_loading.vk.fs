@@ -0,0 +1,126 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec2 Velocity;    // motion vectors (taa.h)
+
+layout (location = 0) in vec2 TexCoords;
+layout (location = 1) in vec3 WorldPos;
+layout (location = 2) in vec3 Normal;
+layout (location = 3) in vec4 CurrClip;
+layout (location = 4) in vec4 PrevClip;
+
+layout (set = 0, binding = 0) uniform sampler2D textures[];
+layout (set = 0, binding = 1) uniform samplerCube skybox;
+layout (set = 0, binding = 2) uniform samplerCube probe;       // dynamic reflection probe
+layout (set = 0, binding = 3) uniform samplerCube specularMap; // GGX-prefiltered skybox (ibl.h)
+layout (set = 0, binding = 4) uniform sampler2D brdfLut;
+layout (set = 0, binding = 6) uniform sampler2D occlusion;         // screen-space ambient occlusion (ssao.h), half resolution
+layout (set = 0, binding = 7) uniform sampler2D occlusionDepth;    // the depth it was computed from
+
+layout (set = 1, binding = 0) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    mat4 skyView;
+    mat4 viewProjection;        // unjittered, for motion vectors (taa.h)
+    mat4 prevViewProjection;    // last frame's
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 environment;   // x: reflectivity at normal incidence, y: mip level read, z: 1 = probe, 0 = skybox
+    vec4 ibl;           // x: 1 = environment lighting, y: last prefiltered mip, z: roughness
+    vec4 sh[9];         // irradiance / pi
+    vec4 planar;        // y: texture lod bias (reflection views)
+    vec4 target;
+    vec4 occlusion;     // x: 1 = sample the ambient occlusion in this view
+} frame;
+
+// the level's lights baked into the light probe grid (light_probes.h), sampled per car:
+// three vec4 per slot, per channel the constant, then the x, y, z terms
+layout (set = 1, binding = 1) readonly buffer LightProbes
+{
+    vec4 lightProbes[];
+};
+
+layout (push_constant) uniform Push
+{
+    mat4 model;
+    uint textureIndex;
+    layout (offset = 76) int lightProbeSlot;    // -1: none
+} push;
+
+vec3 irradiance(vec3 n)
+{
+    return frame.sh[0].rgb * 0.282095
+         + (frame.sh[1].rgb * n.y + frame.sh[2].rgb * n.z + frame.sh[3].rgb * n.x) * 0.488603
+         + (frame.sh[4].rgb * n.x * n.y + frame.sh[5].rgb * n.y * n.z + frame.sh[7].rgb * n.x * n.z) * 1.092548
+         + frame.sh[6].rgb * 0.315392 * (3.0 * n.z * n.z - 1.0)
+         + frame.sh[8].rgb * 0.546274 * (n.x * n.x - n.y * n.y);
+}
+
+// the probes' L1 harmonics for a surface facing n: scaled like the floor's diffuse term
+vec3 probeLight(vec3 n)
+{
+    if (push.lightProbeSlot < 0) return vec3(0.0);
+    int slot = push.lightProbeSlot * 3;
+    vec4 d = vec4(1.0, n);
+    return max(vec3(dot(lightProbes[slot], d), dot(lightProbes[slot + 1], d), dot(lightProbes[slot + 2], d)), 0.0);
+}
+
+// this fragment's ambient occlusion from the half-resolution result: the four nearest
+// texels, bilinear, each weighted down by how far its depth is from this fragment's so
+// that nothing bleeds across silhouettes
+float ambientOcclusion()
+{
+    if (frame.occlusion.x < 0.5) return 1.0;
+    vec2 coord = gl_FragCoord.xy * 0.5 - 0.5;
+    ivec2 base = ivec2(floor(coord));
+    vec2 f = coord - vec2(base);
+    ivec2 last = textureSize(occlusion, 0) - 1;
+    float sum = 0.0, total = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 o = ivec2(i & 1, i >> 1);
+        ivec2 p = clamp(base + o, ivec2(0), last);
+        float bilinear = (o.x == 1 ? f.x : 1.0 - f.x) * (o.y == 1 ? f.y : 1.0 - f.y);
+        // reversed-Z depth is near / distance: relative distance difference
+        float difference = abs(texelFetch(occlusionDepth, p, 0).r - gl_FragCoord.z) / gl_FragCoord.z;
+        float w = (bilinear + 1e-3) / (difference + 1e-3);
+        sum += w * texelFetch(occlusion, p, 0).r;
+        total += w;
+    }
+    return sum / total;
+}
+
+void main()
+{
+    // screen motion since last frame, in texture coordinates
+    Velocity = (CurrClip.xy / CurrClip.w - PrevClip.xy / PrevClip.w) * 0.5;
+    vec4 base = texture(textures[push.textureIndex], TexCoords, frame.planar.y);
+
+    float reflectivity = frame.environment.x;
+    vec3 N = normalize(Normal);
+    vec3 V = normalize(frame.viewPos.xyz - WorldPos);
+    vec3 R = reflect(-V, N);
+    float NdotV = max(dot(N, V), 0.0);
+    float ao = ambientOcclusion();
+    if (frame.ibl.x > 0.5)
+    {
+        // split sum: prefiltered radiance times the BRDF's scale and bias for F0
+        float roughness = frame.ibl.z;
+        vec2 brdf = texture(brdfLut, vec2(NdotV, roughness)).rg;
+        vec3 radiance = frame.environment.z > 0.5 ? textureLod(probe, R, frame.environment.y).rgb
+                                                  : textureLod(specularMap, R, roughness * frame.ibl.y).rgb;
+        vec3 specular = radiance * (reflectivity * brdf.x + brdf.y);
+        FragColor = vec4(base.rgb * (irradiance(N) * ao + probeLight(N)) * (1.0 - reflectivity) + specular, base.a);
+        return;
+    }
+
+    // clear-coat reflection, stronger at grazing angles (Schlick); with the probes the car
+    // is lit like the floor, its 0.3 ambient plus the baked light, else left unlit
+    float fresnel = reflectivity + (1.0 - reflectivity) * pow(1.0 - NdotV, 5.0);
+    // uniform across the draw, so the branch costs nothing
+    vec3 reflection = frame.environment.z > 0.5 ? textureLod(probe, R, frame.environment.y).rgb
+                                                : textureLod(skybox, R, frame.environment.y).rgb;
+    vec3 diffuse = push.lightProbeSlot >= 0 ? base.rgb * (0.3 * ao + probeLight(N)) : base.rgb * ao;
+    FragColor = vec4(mix(diffuse, reflection, reflectivity > 0.0 ? fresnel : 0.0), base.a);
+}
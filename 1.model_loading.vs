@@ -4,13 +4,24 @@ layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
 out vec2 TexCoords;
+out vec3 WorldPos;
+out vec3 Normal;
+out vec4 CurrClip;   // motion vectors (taa.h): this frame's and last frame's clip position, unjittered
+out vec4 PrevClip;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform mat4 prevModel;            // last frame's model
+uniform mat4 viewProjection;       // unjittered projection * view
+uniform mat4 prevViewProjection;   // last frame's
 
 void main()
 {
     TexCoords = aTexCoords;    
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    WorldPos = vec3(model * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(model))) * aNormal;
+    gl_Position = projection * view * vec4(WorldPos, 1.0);
+    CurrClip = viewProjection * vec4(WorldPos, 1.0);
+    PrevClip = prevViewProjection * prevModel * vec4(aPos, 1.0);
+}
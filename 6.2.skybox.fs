@@ -1,11 +1,16 @@
 #version 330 core
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec2 Velocity;    // motion vectors (taa.h); dropped by targets without them
 
 in vec3 TexCoords;
+in vec4 CurrClip;   // unjittered, this frame and last
+in vec4 PrevClip;
 
 uniform samplerCube skybox;
 
 void main()
-{    
+{
+    // screen motion since last frame, in texture coordinates
+    Velocity = (CurrClip.xy / CurrClip.w - PrevClip.xy / PrevClip.w) * 0.5;
     FragColor = texture(skybox, TexCoords);
 }
\ No newline at end of file
@@ -0,0 +1,16 @@
+#version 450
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec2 Velocity;    // motion vectors (taa.h)
+
+layout (location = 0) in vec3 TexCoords;
+layout (location = 1) in vec4 CurrClip;
+layout (location = 2) in vec4 PrevClip;
+
+layout (set = 0, binding = 1) uniform samplerCube skybox;
+
+void main()
+{
+    // screen motion since last frame, in texture coordinates
+    Velocity = (CurrClip.xy / CurrClip.w - PrevClip.xy / PrevClip.w) * 0.5;
+    FragColor = texture(skybox, TexCoords);
+}
@@ -0,0 +1,27 @@
+#version 450
+layout (location = 0) in vec3 aPos;
+
+layout (location = 0) out vec3 TexCoords;
+layout (location = 1) out vec4 CurrClip;   // unjittered, this frame and last
+layout (location = 2) out vec4 PrevClip;
+
+layout (set = 1, binding = 0) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    mat4 skyView;
+    mat4 viewProjection;        // unjittered, for motion vectors (taa.h)
+    mat4 prevViewProjection;    // last frame's
+    vec4 viewPos;
+    vec4 lightPos;
+} frame;
+
+void main()
+{
+    TexCoords = aPos;
+    vec4 pos = frame.projection * frame.skyView * vec4(aPos, 1.0);
+    gl_Position = vec4(pos.xy, 0.0, pos.w);   // reversed-Z: at infinity
+    // directions (w = 0): only the camera's rotation moves the sky
+    CurrClip = frame.viewProjection * vec4(aPos, 0.0);
+    PrevClip = frame.prevViewProjection * vec4(aPos, 0.0);
+}
@@ -2,13 +2,22 @@
 layout (location = 0) in vec3 aPos;
 
 out vec3 TexCoords;
+out vec4 CurrClip;   // motion vectors (taa.h): this frame's and last frame's clip position, unjittered
+out vec4 PrevClip;
 
 uniform mat4 projection;
 uniform mat4 view;
+uniform mat4 viewProjection;       // unjittered projection * view
+uniform mat4 prevViewProjection;   // last frame's
+uniform float farDepth;   // clip z / w of infinity: 0, or -1 without glClipControl
 
 void main()
 {
     TexCoords = aPos;
     vec4 pos = projection * view * vec4(aPos, 1.0);
-    gl_Position = pos.xyww;
-}  
\ No newline at end of file
+    // reversed-Z: pin the sky to the infinitely far depth (was pos.xyww, depth 1, with forward Z)
+    gl_Position = vec4(pos.xy, farDepth * pos.w, pos.w);
+    // directions (w = 0): only the camera's rotation moves the sky
+    CurrClip = viewProjection * vec4(aPos, 0.0);
+    PrevClip = prevViewProjection * vec4(aPos, 0.0);
+}
@@ -0,0 +1,43 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D source;   // the level above (the scene for the first level)
+uniform vec2 texelSize;     // of source
+uniform float threshold;    // first level only: keep what is brighter than this; < 0 for the others
+
+vec3 tap(float x, float y) { return texture(source, TexCoord + vec2(x, y) * texelSize).rgb; }
+
+vec3 bright(vec3 c)
+{
+    float peak = max(c.r, max(c.g, c.b));
+    return c * (max(peak - threshold, 0.0) / max(peak, 1e-4));
+}
+
+// weights a box down by its brightness, so one hot texel cannot flare on its own
+float karis(vec3 c) { return 1.0 / (1.0 + max(c.r, max(c.g, c.b))); }
+
+// 13 taps as five overlapping 2x2 boxes: the inner one weighted 0.5, the corner ones 0.125
+void main()
+{
+    vec3 a = tap(-2.0, 2.0), b = tap(0.0, 2.0), c = tap(2.0, 2.0);
+    vec3 d = tap(-2.0, 0.0), e = tap(0.0, 0.0), f = tap(2.0, 0.0);
+    vec3 g = tap(-2.0, -2.0), h = tap(0.0, -2.0), i = tap(2.0, -2.0);
+    vec3 j = tap(-1.0, 1.0), k = tap(1.0, 1.0), l = tap(-1.0, -1.0), m = tap(1.0, -1.0);
+
+    vec3 inner = (j + k + l + m) * 0.25;
+    vec3 tl = (a + b + d + e) * 0.25, tr = (b + c + e + f) * 0.25;
+    vec3 bl = (d + e + g + h) * 0.25, br = (e + f + h + i) * 0.25;
+    if (threshold < 0.0)
+    {
+        FragColor = vec4(inner * 0.5 + (tl + tr + bl + br) * 0.125, 1.0);
+        return;
+    }
+
+    inner = bright(inner); tl = bright(tl); tr = bright(tr); bl = bright(bl); br = bright(br);
+    float wi = 0.5 * karis(inner);
+    float wtl = 0.125 * karis(tl), wtr = 0.125 * karis(tr), wbl = 0.125 * karis(bl), wbr = 0.125 * karis(br);
+    vec3 sum = inner * wi + tl * wtl + tr * wtr + bl * wbl + br * wbr;
+    FragColor = vec4(sum / (wi + wtl + wtr + wbl + wbr), 1.0);
+}
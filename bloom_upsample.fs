@@ -0,0 +1,18 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D source;   // the level below, added (blended) onto this one
+uniform vec2 texelSize;     // of source
+
+vec3 tap(float x, float y) { return texture(source, TexCoord + vec2(x, y) * texelSize).rgb; }
+
+// 3x3 tent
+void main()
+{
+    vec3 sum = tap(-1.0, 1.0) + tap(0.0, 1.0) * 2.0 + tap(1.0, 1.0)
+             + tap(-1.0, 0.0) * 2.0 + tap(0.0, 0.0) * 4.0 + tap(1.0, 0.0) * 2.0
+             + tap(-1.0, -1.0) + tap(0.0, -1.0) * 2.0 + tap(1.0, -1.0);
+    FragColor = vec4(sum / 16.0, 1.0);
+}
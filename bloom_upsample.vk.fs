@@ -0,0 +1,22 @@
+#version 450
+layout (location = 0) out vec4 FragColor;
+
+layout (location = 0) in vec2 TexCoord;
+
+layout (set = 0, binding = 0) uniform sampler2D source;    // the level below, added (blended) onto this one
+
+layout (push_constant) uniform Push
+{
+    vec4 params;    // xy: source texel size
+} push;
+
+vec3 tap(float x, float y) { return texture(source, TexCoord + vec2(x, y) * push.params.xy).rgb; }
+
+// 3x3 tent
+void main()
+{
+    vec3 sum = tap(-1.0, 1.0) + tap(0.0, 1.0) * 2.0 + tap(1.0, 1.0)
+             + tap(-1.0, 0.0) * 2.0 + tap(0.0, 0.0) * 4.0 + tap(1.0, 0.0) * 2.0
+             + tap(-1.0, -1.0) + tap(0.0, -1.0) * 2.0 + tap(1.0, -1.0);
+    FragColor = vec4(sum / 16.0, 1.0);
+}
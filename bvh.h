@@ -0,0 +1,800 @@
+#ifndef BVH_H
+#define BVH_H
+
+// Bounding volume hierarchy over the static world colliders (walls, barriers, buildings).
+//
+// Built top-down with binned SAH; large subtrees are built as jobs on the job system. The
+// binary tree is then collapsed into a flat 4-wide layout (BVH4): each node holds the
+// bounds of its four children as SoA float[4] rows, so one SSE compare tests all four
+// children at once. Nodes are stored parent-before-child, which lets refit() walk the
+// array backwards when a moving platform changes its box.
+//
+// Coherent rays (the lightmap baker's, see lightmap.h) can go down the tree four at a
+// time: raycastPacket() tests a node's four children against all four rays, 16 slab
+// tests in SSE, and follows a child while any ray of the packet still reaches it.
+//
+// The binary tree is at most MAX_DEPTH levels deep: where an SAH split would leave a child
+// too many primitives for the levels still allowed, the node is split at the median
+// instead. A Node4 spans at least one binary level and a traversal pushes at most three
+// more entries per level, so the fixed STACK_SIZE traversal stacks cannot overflow.
+
+#include <glm/glm.hpp>
+
+#include "jobs.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BVH_SSE 1
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+struct BVHBox
+{
+    glm::vec3 min, max;
+};
+
+struct BVHRayHit
+{
+    unsigned int prim;  // collider index as passed to build()
+    float t;            // distance along the (normalized) ray; for sweep(), fraction of the move
+    glm::vec3 normal;   // face normal of the box that was hit
+};
+
+// four rays cast together, SoA; a lane with maxT <= 0 takes no part
+struct BVHRayPacket
+{
+    alignas(16) float ox[4], oy[4], oz[4];
+    alignas(16) float dx[4], dy[4], dz[4];      // normalized
+    alignas(16) float maxT[4];
+};
+
+class StaticBVH
+{
+public:
+    static const unsigned int MAX_LEAF_SIZE = 4;
+    static const unsigned int BINS = 16;
+    static const unsigned int MAX_DEPTH = 20;               // binary levels below the root
+    static const unsigned int STACK_SIZE = 3 * MAX_DEPTH + 1;
+
+    // threads == 0 uses every job system thread; 1 builds serially
+    void build(const std::vector<BVHBox>& boxes, unsigned int threads = 0)
+    {
+        prims = boxes;
+        nodes.clear();
+        primIndex.resize(prims.size());
+        for (unsigned int i = 0; i < primIndex.size(); i++) primIndex[i] = i;
+        if (prims.empty()) return;
+
+        if (!threads) threads = jobSystem().threadCount();
+        std::vector<glm::vec3> centroids(prims.size());
+        for (size_t i = 0; i < prims.size(); i++) centroids[i] = (prims[i].min + prims[i].max) * 0.5f;
+
+        std::unique_ptr<BuildNode> root = buildRange(centroids, 0, (unsigned int)prims.size(), 0, parallelDepth(threads));
+        if (root->leaf())
+        {
+            // keep the root an inner node so traversal always starts from nodes[0]
+            std::unique_ptr<BuildNode> wrapper(new BuildNode());
+            wrapper->box = root->box;
+            wrapper->child[0] = std::move(root);
+            root = std::move(wrapper);
+        }
+        nodes.reserve(prims.size() / 2 + 1);
+        flatten(root.get());
+    }
+
+    // moving platforms: change a collider's box, then call refit() once per step
+    void updatePrimitive(unsigned int prim, const BVHBox& box) { prims[prim] = box; }
+
+    void refit()
+    {
+        for (size_t n = nodes.size(); n-- > 0;)
+        {
+            Node4& node = nodes[n];
+            for (int c = 0; c < 4; c++)
+            {
+                if (node.child[c] < 0) continue;
+                BVHBox b = emptyBox();
+                if (node.count[c] > 0)
+                {
+                    for (unsigned int i = 0; i < node.count[c]; i++) grow(b, prims[primIndex[node.child[c] + i]]);
+                }
+                else
+                {
+                    const Node4& child = nodes[node.child[c]];
+                    for (int k = 0; k < 4; k++)
+                        if (child.child[k] >= 0) grow(b, child.bounds(k));
+                }
+                node.setBounds(c, b);
+            }
+        }
+    }
+
+    // collects indices of all colliders whose box overlaps [qmin, qmax]
+    void overlap(const glm::vec3& qmin, const glm::vec3& qmax, std::vector<unsigned int>& hits) const
+    {
+        hits.clear();
+        visitOverlap(qmin, qmax, [&](unsigned int p) { hits.push_back(p); return true; });
+    }
+
+    // calls visit(prim) for every collider whose box overlaps [qmin, qmax];
+    // visit returns false to stop the query early
+    template <typename Visit>
+    void visitOverlap(const glm::vec3& qmin, const glm::vec3& qmax, Visit visit) const
+    {
+        if (nodes.empty()) return;
+
+        int stack[STACK_SIZE];
+        int top = 0;
+        stack[top++] = 0;
+#ifdef BVH_SSE
+        __m128 qminX = _mm_set1_ps(qmin.x), qminY = _mm_set1_ps(qmin.y), qminZ = _mm_set1_ps(qmin.z);
+        __m128 qmaxX = _mm_set1_ps(qmax.x), qmaxY = _mm_set1_ps(qmax.y), qmaxZ = _mm_set1_ps(qmax.z);
+#endif
+        while (top > 0)
+        {
+            const Node4& node = nodes[stack[--top]];
+#ifdef BVH_SSE
+            __m128 m = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minX), qmaxX), _mm_cmpge_ps(_mm_load_ps(node.maxX), qminX));
+            m = _mm_and_ps(m, _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minY), qmaxY), _mm_cmpge_ps(_mm_load_ps(node.maxY), qminY)));
+            m = _mm_and_ps(m, _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minZ), qmaxZ), _mm_cmpge_ps(_mm_load_ps(node.maxZ), qminZ)));
+            int mask = _mm_movemask_ps(m);
+#else
+            int mask = 0;
+            for (int c = 0; c < 4; c++)
+                if (node.minX[c] <= qmax.x && node.maxX[c] >= qmin.x &&
+                    node.minY[c] <= qmax.y && node.maxY[c] >= qmin.y &&
+                    node.minZ[c] <= qmax.z && node.maxZ[c] >= qmin.z) mask |= 1 << c;
+#endif
+            for (int c = 0; c < 4; c++)
+            {
+                if (!(mask & (1 << c)) || node.child[c] < 0) continue;
+                if (node.count[c] == 0) { stack[top++] = node.child[c]; continue; }
+                for (unsigned int i = 0; i < node.count[c]; i++)
+                {
+                    unsigned int p = primIndex[node.child[c] + i];
+                    const BVHBox& b = prims[p];
+                    if (b.min.x <= qmax.x && b.max.x >= qmin.x &&
+                        b.min.y <= qmax.y && b.max.y >= qmin.y &&
+                        b.min.z <= qmax.z && b.max.z >= qmin.z && !visit(p)) return;
+                }
+            }
+        }
+    }
+
+    // closest hit along origin + t * dir for t in [0, maxT]; dir must be normalized
+    bool raycast(const glm::vec3& origin, const glm::vec3& dir, float maxT, BVHRayHit& hit) const
+    {
+        return cast(origin, dir, maxT, glm::vec3(0.0f), hit);
+    }
+
+    // closest hit with a caller-supplied leaf test, e.g. exact triangles inside each box:
+    // test(prim, closest, t) returns true and sets t when it hits before `closest`.
+    // hit.normal is left to the caller.
+    template <typename PrimTest>
+    bool raycast(const glm::vec3& origin, const glm::vec3& dir, float maxT, BVHRayHit& hit, PrimTest test) const
+    {
+        return traverse(origin, dir, maxT, glm::vec3(0.0f), hit, test);
+    }
+
+    // closest hits of the four rays of a packet, with a caller-supplied leaf test:
+    // test(prim, lanes, closest, t) tests the rays in the `lanes` bitmask against one
+    // primitive and returns the lanes that hit it before closest[lane], having written
+    // their t[lane]. Returns the lanes that hit anything; hits[lane].prim and .t are set
+    // for those (hit.normal is left to the caller). With anyHit a lane stops at the first
+    // hit it finds (shadow rays) and the walk ends once every lane has.
+    template <typename PacketTest>
+    int raycastPacket(const BVHRayPacket& packet, BVHRayHit hits[4], PacketTest test, bool anyHit = false) const
+    {
+        alignas(16) float closest[4], ix[4], iy[4], iz[4];
+        int active = 0;
+        for (int r = 0; r < 4; r++)
+        {
+            closest[r] = packet.maxT[r];
+            if (packet.maxT[r] > 0.0f) active |= 1 << r;
+            ix[r] = 1.0f / packet.dx[r];
+            iy[r] = 1.0f / packet.dy[r];
+            iz[r] = 1.0f / packet.dz[r];
+        }
+        if (nodes.empty() || !active) return 0;
+        int found = 0;
+
+        int stack[STACK_SIZE];
+        int top = 0;
+        stack[top++] = 0;
+#ifdef BVH_SSE
+        __m128 ox = _mm_load_ps(packet.ox), oy = _mm_load_ps(packet.oy), oz = _mm_load_ps(packet.oz);
+        __m128 vix = _mm_load_ps(ix), viy = _mm_load_ps(iy), viz = _mm_load_ps(iz);
+        __m128 zero = _mm_setzero_ps();
+#endif
+        while (top > 0)
+        {
+            const Node4& node = nodes[stack[--top]];
+            // per child, the lanes that reach it and the nearest entry among them
+            int lanes[4], order[4], n = 0;
+            float entry[4];
+            for (int c = 0; c < 4; c++)
+            {
+                lanes[c] = 0;
+                if (node.child[c] < 0) continue;
+#ifdef BVH_SSE
+                __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.minX[c]), ox), vix);
+                __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.maxX[c]), ox), vix);
+                __m128 tmin = _mm_min_ps(t1, t2), tmax = _mm_max_ps(t1, t2);
+                t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.minY[c]), oy), viy);
+                t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.maxY[c]), oy), viy);
+                tmin = _mm_max_ps(tmin, _mm_min_ps(t1, t2));
+                tmax = _mm_min_ps(tmax, _mm_max_ps(t1, t2));
+                t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.minZ[c]), oz), viz);
+                t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.maxZ[c]), oz), viz);
+                tmin = _mm_max_ps(tmin, _mm_min_ps(t1, t2));
+                tmax = _mm_min_ps(tmax, _mm_max_ps(t1, t2));
+                tmin = _mm_max_ps(tmin, zero);
+                tmax = _mm_min_ps(tmax, _mm_load_ps(closest));
+                lanes[c] = _mm_movemask_ps(_mm_cmple_ps(tmin, tmax)) & active;
+                alignas(16) float tEntry[4];
+                _mm_store_ps(tEntry, tmin);
+#else
+                float tEntry[4];
+                BVHBox b = node.bounds(c);
+                for (int r = 0; r < 4; r++)
+                    if ((active & (1 << r)) && slab(glm::vec3(packet.ox[r], packet.oy[r], packet.oz[r]), glm::vec3(ix[r], iy[r], iz[r]), b, closest[r], tEntry[r]))
+                        lanes[c] |= 1 << r;
+#endif
+                if (!lanes[c]) continue;
+                entry[c] = std::numeric_limits<float>::max();
+                for (int r = 0; r < 4; r++)
+                    if (lanes[c] & (1 << r)) entry[c] = std::min(entry[c], tEntry[r]);
+                order[n++] = c;
+            }
+            // as in traverse(): far children pushed first, leaves tested nearest first
+            for (int i = 1; i < n; i++)
+                for (int j = i; j > 0 && entry[order[j - 1]] < entry[order[j]]; j--) std::swap(order[j - 1], order[j]);
+            for (int k = 0; k < n; k++)
+            {
+                int c = order[k];
+                if (node.count[c] == 0) { stack[top++] = node.child[c]; continue; }
+                int want = lanes[c] & active;
+                for (unsigned int i = 0; i < node.count[c] && want; i++)
+                {
+                    unsigned int p = primIndex[node.child[c] + i];
+                    alignas(16) float t[4];
+                    int hit = test(p, want, (const float*)closest, t) & want;
+                    for (int r = 0; r < 4; r++)
+                        if (hit & (1 << r))
+                        {
+                            closest[r] = t[r];
+                            hits[r].prim = p;
+                            hits[r].t = t[r];
+                        }
+                    found |= hit;
+                    if (anyHit)
+                    {
+                        active &= ~hit;
+                        want &= ~hit;
+                        if (!active) return found;
+                    }
+                }
+            }
+        }
+        return found;
+    }
+
+    // continuous collision: moves a box (centre, half extents) by delta and reports the
+    // first collider it touches. hit.t is the time of impact as a fraction of delta
+    // (0..1) and hit.normal the face normal at the contact. Implemented as a ray cast
+    // against the colliders grown by the half extents (Minkowski sum), so fast movers
+    // cannot tunnel through thin walls however large the step. A collider the box already
+    // touches or overlaps and is moving out of (its contact normal faces along delta) is
+    // skipped, so a farther one along the move is still found.
+    bool sweep(const glm::vec3& center, const glm::vec3& halfExtents, const glm::vec3& delta, BVHRayHit& hit) const
+    {
+        float len = glm::length(delta);
+        if (len < 1e-6f) return false;
+        glm::vec3 dir = delta / len, inv(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+        bool found = traverse(center, dir, len, halfExtents, hit, [&](unsigned int p, float closest, float& t) {
+            BVHBox b = grown(prims[p], halfExtents);
+            return slab(center, inv, b, closest, t) && glm::dot(dir, boxNormal(b, center + dir * t)) < 0.0f;
+        });
+        if (!found) return false;
+        hit.normal = boxNormal(grown(prims[hit.prim], halfExtents), center + dir * hit.t);
+        hit.t /= len;
+        return true;
+    }
+
+    // closest hit of a sphere moved from origin along dir (normalized) by up to maxT:
+    // hit.t is the distance travelled and hit.normal points from the box to the sphere's
+    // centre at contact. Exact against the box rounded by the radius, so corners and
+    // edges are round rather than grown into a bigger box (cameras, line of sight).
+    bool sphereCast(const glm::vec3& origin, const glm::vec3& dir, float maxT, float radius, BVHRayHit& hit) const
+    {
+        glm::vec3 inv(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+        bool found = traverse(origin, dir, maxT, glm::vec3(radius), hit, [&](unsigned int p, float closest, float& t) {
+            return roundedBox(origin, dir, inv, prims[p], radius, closest, t);
+        });
+        if (found)
+        {
+            const BVHBox& b = prims[hit.prim];
+            glm::vec3 c = origin + dir * hit.t;
+            glm::vec3 d = c - glm::clamp(c, b.min, b.max);
+            float len = glm::length(d);
+            hit.normal = len > 1e-6f ? d / len : boxNormal(b, c);
+        }
+        return found;
+    }
+
+    // the same sphere cast against one box, without the tree
+    static bool sphereCastBox(const glm::vec3& origin, const glm::vec3& dir, float maxT, float radius, const BVHBox& box, float& t)
+    {
+        return roundedBox(origin, dir, glm::vec3(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z), box, radius, maxT, t);
+    }
+
+    const BVHBox& primitive(unsigned int prim) const { return prims[prim]; }
+    size_t primitiveCount() const { return prims.size(); }
+    size_t nodeCount() const { return nodes.size(); }
+    size_t memoryBytes() const { return nodes.size() * sizeof(Node4) + prims.size() * (sizeof(BVHBox) + sizeof(unsigned int)); }
+
+private:
+    struct alignas(16) Node4
+    {
+        float minX[4], minY[4], minZ[4];
+        float maxX[4], maxY[4], maxZ[4];
+        int32_t child[4];   // inner: node index; leaf: first entry in primIndex; -1: empty slot
+        uint32_t count[4];  // 0 for inner children, primitive count for leaves
+
+        BVHBox bounds(int c) const
+        {
+            return { glm::vec3(minX[c], minY[c], minZ[c]), glm::vec3(maxX[c], maxY[c], maxZ[c]) };
+        }
+        void setBounds(int c, const BVHBox& b)
+        {
+            minX[c] = b.min.x; minY[c] = b.min.y; minZ[c] = b.min.z;
+            maxX[c] = b.max.x; maxY[c] = b.max.y; maxZ[c] = b.max.z;
+        }
+    };
+
+    struct BuildNode
+    {
+        BVHBox box;
+        unsigned int first = 0, count = 0;
+        std::unique_ptr<BuildNode> child[2];
+        bool leaf() const { return !child[0]; }
+    };
+
+    std::vector<BVHBox> prims;
+    std::vector<unsigned int> primIndex;
+    std::vector<Node4> nodes;
+
+    static BVHBox emptyBox()
+    {
+        float inf = std::numeric_limits<float>::infinity();
+        return { glm::vec3(inf), glm::vec3(-inf) };
+    }
+    static void grow(BVHBox& b, const BVHBox& o) { b.min = glm::min(b.min, o.min); b.max = glm::max(b.max, o.max); }
+    static void grow(BVHBox& b, const glm::vec3& p) { b.min = glm::min(b.min, p); b.max = glm::max(b.max, p); }
+    static float area(const BVHBox& b)
+    {
+        glm::vec3 d = b.max - b.min;
+        if (d.x < 0.0f) return 0.0f;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    static unsigned int parallelDepth(unsigned int threads)
+    {
+        unsigned int depth = 0;
+        while ((1u << depth) < threads) depth++;
+        return depth ? depth + 2 : 0;   // a few spare subtrees per thread for stealing
+    }
+
+    std::unique_ptr<BuildNode> buildRange(const std::vector<glm::vec3>& centroids, unsigned int begin, unsigned int end, unsigned int depth, unsigned int spawnDepth)
+    {
+        std::unique_ptr<BuildNode> node(new BuildNode());
+        node->box = emptyBox();
+        BVHBox cbox = emptyBox();
+        for (unsigned int i = begin; i < end; i++)
+        {
+            grow(node->box, prims[primIndex[i]]);
+            grow(cbox, centroids[primIndex[i]]);
+        }
+        node->first = begin;
+        node->count = end - begin;
+        if (node->count <= MAX_LEAF_SIZE || depth == MAX_DEPTH) return node;   // past MAX_DEPTH the rest is one leaf
+
+        // binned SAH over all three axes
+        int bestAxis = -1;
+        unsigned int bestSplit = 0;
+        float bestCost = std::numeric_limits<float>::max();
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float lo = cbox.min[axis], extent = cbox.max[axis] - lo;
+            if (extent <= 0.0f) continue;
+            float scale = BINS / extent;
+
+            BVHBox binBox[BINS];
+            unsigned int binCount[BINS] = {};
+            for (unsigned int b = 0; b < BINS; b++) binBox[b] = emptyBox();
+            for (unsigned int i = begin; i < end; i++)
+            {
+                unsigned int p = primIndex[i];
+                unsigned int b = std::min(BINS - 1, (unsigned int)((centroids[p][axis] - lo) * scale));
+                binCount[b]++;
+                grow(binBox[b], prims[p]);
+            }
+
+            // sweep from the right, then from the left
+            float rightArea[BINS];
+            unsigned int rightCount[BINS];
+            BVHBox acc = emptyBox();
+            unsigned int cnt = 0;
+            for (unsigned int b = BINS - 1; b > 0; b--)
+            {
+                grow(acc, binBox[b]);
+                cnt += binCount[b];
+                rightArea[b] = area(acc);
+                rightCount[b] = cnt;
+            }
+            acc = emptyBox();
+            cnt = 0;
+            for (unsigned int b = 1; b < BINS; b++)
+            {
+                grow(acc, binBox[b - 1]);
+                cnt += binCount[b - 1];
+                float cost = area(acc) * cnt + rightArea[b] * rightCount[b];
+                if (cnt > 0 && rightCount[b] > 0 && cost < bestCost) { bestCost = cost; bestAxis = axis; bestSplit = b; }
+            }
+        }
+
+        unsigned int mid;
+        if (bestAxis < 0)
+        {
+            // every centroid coincides: split the range in half
+            mid = begin + node->count / 2;
+        }
+        else
+        {
+            if (bestCost >= area(node->box) * node->count && node->count <= 4 * MAX_LEAF_SIZE) return node;
+            float lo = cbox.min[bestAxis], scale = BINS / (cbox.max[bestAxis] - lo);
+            unsigned int* split = std::partition(&primIndex[begin], &primIndex[begin] + node->count, [&](unsigned int p) {
+                return std::min(BINS - 1, (unsigned int)((centroids[p][bestAxis] - lo) * scale)) < bestSplit;
+            });
+            mid = (unsigned int)(split - &primIndex[0]);
+
+            // keep each child small enough that median splits still finish it within MAX_DEPTH
+            // (degenerate input, e.g. centroids bunched at one end, can otherwise peel off
+            // a primitive or two per level)
+            unsigned int budget = MAX_LEAF_SIZE << (MAX_DEPTH - depth - 1);
+            if (std::max(mid - begin, end - mid) > budget && node->count <= 2 * budget)
+            {
+                int axis = 0;
+                glm::vec3 extent = cbox.max - cbox.min;
+                if (extent.y > extent[axis]) axis = 1;
+                if (extent.z > extent[axis]) axis = 2;
+                mid = begin + node->count / 2;
+                std::nth_element(&primIndex[begin], &primIndex[mid], &primIndex[begin] + node->count, [&](unsigned int a, unsigned int b) {
+                    return centroids[a][axis] < centroids[b][axis];
+                });
+            }
+        }
+
+        // the two halves touch disjoint ranges of primIndex, so they can build concurrently
+        if (spawnDepth > 0 && node->count > 4096)
+        {
+            JobCounter left;
+            jobSystem().run([&]() { node->child[0] = buildRange(centroids, begin, mid, depth + 1, spawnDepth - 1); }, &left);
+            node->child[1] = buildRange(centroids, mid, end, depth + 1, spawnDepth - 1);
+            jobSystem().wait(left);
+        }
+        else
+        {
+            node->child[0] = buildRange(centroids, begin, mid, depth + 1, 0);
+            node->child[1] = buildRange(centroids, mid, end, depth + 1, 0);
+        }
+        return node;
+    }
+
+    // collapses a binary inner node into a Node4 by opening its largest children
+    int flatten(const BuildNode* bn)
+    {
+        const BuildNode* kids[4] = { bn->child[0].get(), bn->child[1].get(), nullptr, nullptr };
+        int n = bn->child[1] ? 2 : 1;   // the wrapper root of a single-leaf tree has one child
+        while (n < 4)
+        {
+            int best = -1;
+            float bestArea = -1.0f;
+            for (int i = 0; i < n; i++)
+                if (!kids[i]->leaf() && area(kids[i]->box) > bestArea) { bestArea = area(kids[i]->box); best = i; }
+            if (best < 0) break;
+            const BuildNode* open = kids[best];
+            kids[best] = open->child[0].get();
+            kids[n++] = open->child[1].get();
+        }
+
+        int index = (int)nodes.size();
+        nodes.push_back(Node4());
+        for (int c = 0; c < 4; c++)
+        {
+            Node4& node = nodes[index];
+            if (c >= n)
+            {
+                node.setBounds(c, emptyBox());
+                node.child[c] = -1;
+                node.count[c] = 0;
+                continue;
+            }
+            node.setBounds(c, kids[c]->box);
+            if (kids[c]->leaf())
+            {
+                node.child[c] = (int32_t)kids[c]->first;
+                node.count[c] = kids[c]->count;
+            }
+            else
+            {
+                int child = flatten(kids[c]);  // may reallocate nodes
+                nodes[index].child[c] = child;
+                nodes[index].count[c] = 0;
+            }
+        }
+        return index;
+    }
+
+    // ray cast against every box grown by `inflate` on each side (zero for plain rays)
+    bool cast(const glm::vec3& origin, const glm::vec3& dir, float maxT, const glm::vec3& inflate, BVHRayHit& hit) const
+    {
+        glm::vec3 inv(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+        bool found = traverse(origin, dir, maxT, inflate, hit, [&](unsigned int p, float closest, float& t) {
+            return slab(origin, inv, grown(prims[p], inflate), closest, t);
+        });
+        if (found) hit.normal = boxNormal(grown(prims[hit.prim], inflate), origin + dir * hit.t);
+        return found;
+    }
+
+    // front-to-back traversal shared by ray casts and sweeps; nodes are grown by `inflate`
+    template <typename PrimTest>
+    bool traverse(const glm::vec3& origin, const glm::vec3& dir, float maxT, const glm::vec3& inflate, BVHRayHit& hit, PrimTest test) const
+    {
+        if (nodes.empty()) return false;
+        glm::vec3 inv(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+        float closest = maxT;
+        bool found = false;
+
+        int stack[STACK_SIZE];
+        int top = 0;
+        stack[top++] = 0;
+#ifdef BVH_SSE
+        __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+        __m128 ix = _mm_set1_ps(inv.x), iy = _mm_set1_ps(inv.y), iz = _mm_set1_ps(inv.z);
+        __m128 zero = _mm_setzero_ps();
+        __m128 gx = _mm_set1_ps(inflate.x), gy = _mm_set1_ps(inflate.y), gz = _mm_set1_ps(inflate.z);
+#endif
+        while (top > 0)
+        {
+            const Node4& node = nodes[stack[--top]];
+#ifdef BVH_SSE
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_load_ps(node.minX), gx), ox), ix);
+            __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_load_ps(node.maxX), gx), ox), ix);
+            __m128 tmin = _mm_min_ps(t1, t2), tmax = _mm_max_ps(t1, t2);
+            t1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_load_ps(node.minY), gy), oy), iy);
+            t2 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_load_ps(node.maxY), gy), oy), iy);
+            tmin = _mm_max_ps(tmin, _mm_min_ps(t1, t2));
+            tmax = _mm_min_ps(tmax, _mm_max_ps(t1, t2));
+            t1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_load_ps(node.minZ), gz), oz), iz);
+            t2 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_load_ps(node.maxZ), gz), oz), iz);
+            tmin = _mm_max_ps(tmin, _mm_min_ps(t1, t2));
+            tmax = _mm_min_ps(tmax, _mm_max_ps(t1, t2));
+            tmin = _mm_max_ps(tmin, zero);
+            tmax = _mm_min_ps(tmax, _mm_set1_ps(closest));
+            int mask = _mm_movemask_ps(_mm_cmple_ps(tmin, tmax));
+            alignas(16) float entry[4];
+            _mm_store_ps(entry, tmin);
+#else
+            int mask = 0;
+            float entry[4];
+            for (int c = 0; c < 4; c++)
+                if (slab(origin, inv, grown(node.bounds(c), inflate), closest, entry[c])) mask |= 1 << c;
+#endif
+            // push far children first so the nearest one is popped next
+            int order[4], n = 0;
+            for (int c = 0; c < 4; c++)
+                if ((mask & (1 << c)) && node.child[c] >= 0) order[n++] = c;
+            for (int i = 1; i < n; i++)
+                for (int j = i; j > 0 && entry[order[j - 1]] < entry[order[j]]; j--) std::swap(order[j - 1], order[j]);
+            for (int k = 0; k < n; k++)
+            {
+                int c = order[k];
+                if (node.count[c] == 0) { stack[top++] = node.child[c]; continue; }
+                for (unsigned int i = 0; i < node.count[c]; i++)
+                {
+                    unsigned int p = primIndex[node.child[c] + i];
+                    float t;
+                    if (test(p, closest, t))
+                    {
+                        closest = t;
+                        hit.prim = p;
+                        hit.t = t;
+                        found = true;
+                    }
+                }
+            }
+        }
+        return found;
+    }
+
+    static BVHBox grown(const BVHBox& b, const glm::vec3& g) { return { b.min - g, b.max + g }; }
+
+    static bool slab(const glm::vec3& o, const glm::vec3& inv, const BVHBox& b, float maxT, float& tHit)
+    {
+        float t1 = (b.min.x - o.x) * inv.x, t2 = (b.max.x - o.x) * inv.x;
+        float tmin = std::min(t1, t2), tmax = std::max(t1, t2);
+        t1 = (b.min.y - o.y) * inv.y; t2 = (b.max.y - o.y) * inv.y;
+        tmin = std::max(tmin, std::min(t1, t2)); tmax = std::min(tmax, std::max(t1, t2));
+        t1 = (b.min.z - o.z) * inv.z; t2 = (b.max.z - o.z) * inv.z;
+        tmin = std::max(tmin, std::min(t1, t2)); tmax = std::min(tmax, std::max(t1, t2));
+        tmin = std::max(tmin, 0.0f);
+        tmax = std::min(tmax, maxT);
+        tHit = tmin;
+        return tmin <= tmax;
+    }
+
+    // ray against the box grown by r with rounded edges and corners: the grown box's
+    // entry point is exact on a face; in an edge or corner region the ray is tested
+    // against the capsules along the edges there instead
+    static bool roundedBox(const glm::vec3& o, const glm::vec3& d, const glm::vec3& inv, const BVHBox& b, float r, float maxT, float& tHit)
+    {
+        float t;
+        if (!slab(o, inv, grown(b, glm::vec3(r)), maxT, t)) return false;
+        glm::vec3 p = o + d * t;
+        int below = 0, above = 0;
+        for (int a = 0; a < 3; a++)
+        {
+            if (p[a] < b.min[a]) below |= 1 << a;
+            if (p[a] > b.max[a]) above |= 1 << a;
+        }
+        int outside = below | above;
+        if ((outside & (outside - 1)) == 0) { tHit = t; return true; }   // face (or inside)
+
+        glm::vec3 corner;
+        for (int a = 0; a < 3; a++) corner[a] = (above >> a) & 1 ? b.max[a] : b.min[a];
+        bool found = false;
+        tHit = maxT;
+        for (int a = 0; a < 3; a++)
+        {
+            // the edge along axis a: in the edge region only the free axis' edge, at a corner all three
+            if ((outside & (1 << a)) && outside != 7) continue;
+            float te;
+            if (rayEdge(o, d, corner, a, b.min[a], b.max[a], r, tHit, te)) { tHit = te; found = true; }
+        }
+        return found;
+    }
+
+    // ray against a capsule of radius r along axis a from lo to hi, through point c
+    static bool rayEdge(const glm::vec3& o, const glm::vec3& d, glm::vec3 c, int a, float lo, float hi, float r, float maxT, float& tHit)
+    {
+        int u = (a + 1) % 3, v = (a + 2) % 3;
+        // cylinder: 2D ray against a circle in the plane across the axis
+        float ou = o[u] - c[u], ov = o[v] - c[v];
+        float A = d[u] * d[u] + d[v] * d[v], B = ou * d[u] + ov * d[v], C = ou * ou + ov * ov - r * r;
+        if (A > 1e-12f)
+        {
+            float disc = B * B - A * C;
+            if (disc < 0.0f) return false;
+            float t = std::max(0.0f, (-B - std::sqrt(disc)) / A);
+            float along = o[a] + d[a] * t;
+            if (C > 0.0f && t == 0.0f) return false;   // moving away from a cylinder we are not in
+            if (along >= lo && along <= hi)
+            {
+                if (t > maxT) return false;
+                tHit = t;
+                return true;
+            }
+        }
+        else if (C > 0.0f) return false;   // parallel to the axis, outside the cylinder
+        // past the ends: the end spheres
+        bool found = false;
+        for (float end : { lo, hi })
+        {
+            c[a] = end;
+            glm::vec3 m = o - c;
+            float b2 = glm::dot(m, d), c2 = glm::dot(m, m) - r * r;
+            if (c2 > 0.0f && b2 > 0.0f) continue;
+            float disc = b2 * b2 - c2;
+            if (disc < 0.0f) continue;
+            float t = std::max(0.0f, -b2 - std::sqrt(disc));
+            if (t <= maxT && (!found || t < tHit)) { tHit = t; found = true; }
+        }
+        return found;
+    }
+
+    static glm::vec3 boxNormal(const BVHBox& b, const glm::vec3& p)
+    {
+        glm::vec3 c = (b.min + b.max) * 0.5f, h = (b.max - b.min) * 0.5f;
+        glm::vec3 d = (p - c) / glm::max(h, glm::vec3(1e-6f));
+        glm::vec3 a = glm::abs(d);
+        if (a.x >= a.y && a.x >= a.z) return glm::vec3(d.x > 0 ? 1.0f : -1.0f, 0.0f, 0.0f);
+        if (a.y >= a.z) return glm::vec3(0.0f, d.y > 0 ? 1.0f : -1.0f, 0.0f);
+        return glm::vec3(0.0f, 0.0f, d.z > 0 ? 1.0f : -1.0f);
+    }
+};
+
+// ---- benchmark: build time, box and ray query throughput, refit ----
+inline void runBVHBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    std::cout << "bvh" << std::setw(10) << "colliders" << std::setw(14) << "build 1T ms" << std::setw(14) << "build MT ms"
+              << std::setw(14) << "box Mq/s" << std::setw(14) << "ray Mq/s" << std::setw(12) << "refit ms" << std::setw(10) << "KB" << "\n";
+
+    for (int n : { 1000, 10000, 100000, 1000000 })
+    {
+        std::mt19937 rng(42);
+        float extent = std::sqrt((float)n) * 20.0f;
+        std::uniform_real_distribution<float> pos(-extent * 0.5f, extent * 0.5f);
+        std::uniform_real_distribution<float> len(0.5f, 12.0f);
+        std::vector<BVHBox> walls(n);
+        for (BVHBox& w : walls)
+        {
+            glm::vec3 c(pos(rng), 2.0f, pos(rng));
+            glm::vec3 h(len(rng) * 0.5f, 2.0f, 0.25f);
+            if (rng() & 1) std::swap(h.x, h.z);
+            w = { c - h, c + h };
+        }
+
+        StaticBVH bvh;
+        auto t0 = Clock::now();
+        bvh.build(walls, 1);
+        double build1 = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        t0 = Clock::now();
+        bvh.build(walls);
+        double buildMT = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+        // car-sized box queries
+        const int queries = 200000;
+        std::vector<unsigned int> hits;
+        size_t totalHits = 0;
+        t0 = Clock::now();
+        for (int q = 0; q < queries; q++)
+        {
+            glm::vec3 c(pos(rng), 0.5f, pos(rng));
+            bvh.overlap(c - glm::vec3(0.75f, 0.5f, 1.5f), c + glm::vec3(0.75f, 0.5f, 1.5f), hits);
+            totalHits += hits.size();
+        }
+        double boxRate = queries / std::chrono::duration<double>(Clock::now() - t0).count() / 1e6;
+
+        // horizontal rays of up to 50 units (camera / line-of-sight length)
+        std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+        size_t rayHits = 0;
+        t0 = Clock::now();
+        for (int q = 0; q < queries; q++)
+        {
+            float a = angle(rng);
+            BVHRayHit hit;
+            if (bvh.raycast(glm::vec3(pos(rng), 1.0f, pos(rng)), glm::vec3(std::sin(a), 0.0f, std::cos(a)), 50.0f, hit)) rayHits++;
+        }
+        double rayRate = queries / std::chrono::duration<double>(Clock::now() - t0).count() / 1e6;
+
+        // move 1% of colliders (platforms) and refit
+        for (int i = 0; i < n / 100; i++)
+        {
+            BVHBox b = walls[i];
+            b.min.y += 0.5f; b.max.y += 0.5f;
+            bvh.updatePrimitive(i, b);
+        }
+        t0 = Clock::now();
+        bvh.refit();
+        double refitMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+        std::cout << std::setw(13) << n << std::setw(14) << build1 << std::setw(14) << buildMT << std::setw(14) << boxRate
+                  << std::setw(14) << rayRate << std::setw(12) << refitMs << std::setw(10) << bvh.memoryBytes() / 1024 << "\n";
+        (void)totalHits;
+        (void)rayHits;
+    }
+}
+
+#endif
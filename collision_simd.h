@@ -0,0 +1,479 @@
+#ifndef COLLISION_SIMD_H
+#define COLLISION_SIMD_H
+
+// Batched narrowphase: AABB-vs-AABB and OBB-vs-OBB (separating-axis test) over SoA
+// arrays, many pairs per call. Pair i tests A[i] against B[i] and writes a contact
+// normal (pointing from B to A) and a penetration depth (<= 0: no overlap).
+//
+// The kernels live in collision_simd_kernels.inl and are compiled once per
+// instruction set (scalar, SSE2, AVX2, AVX-512) via target pragmas, so no global
+// compiler flags are needed; the widest variant the CPU supports is picked at
+// runtime. Non-x86 or non-GCC/Clang builds fall back to the scalar kernels.
+
+#include <glm/glm.hpp>
+
+#include "deterministic.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define COLLISION_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+struct BoxBatch
+{
+    const float *cx, *cy, *cz;   // centres
+    const float *hx, *hy, *hz;   // half extents
+};
+
+struct OBBBatch
+{
+    const float *cx, *cy, *cz;
+    const float *hx, *hy, *hz;
+    const float* axis[3][3];     // axis[k][c]: component c of local axis k (unit length)
+};
+
+struct ContactBatch
+{
+    float *nx, *ny, *nz;
+    float *depth;
+};
+
+// ---- scalar reference (also finishes the tail of every wide call) ----
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")   // strict: see deterministic.h
+#endif
+namespace collision_scalar
+{
+    struct Simd
+    {
+        typedef float V;
+        typedef bool M;
+        static const int W = 1;
+        static V set1(float v) { return v; }
+        static V load(const float* p) { return *p; }
+        static void store(float* p, V v) { *p = v; }
+        static V add(V a, V b) { return a + b; }
+        static V sub(V a, V b) { return a - b; }
+        static V mul(V a, V b) { return a * b; }
+        static V div(V a, V b) { return a / b; }
+        static V sqrt(V a) { return std::sqrt(a); }
+        static V abs(V a) { return std::fabs(a); }
+        static M lt(V a, V b) { return a < b; }
+        static M gt(V a, V b) { return a > b; }
+        static V select(M m, V a, V b) { return m ? a : b; }
+        // integer lanes, for table lookups (heightfield.h)
+        typedef int32_t I;
+        static V floor(V a) { return std::floor(a); }
+        static I toInt(V a) { return (I)a; }
+        static I iadd(I a, I b) { return a + b; }
+        static I iand(I a, int32_t mask) { return a & mask; }
+        static I ishl(I a, int bits) { return (I)((uint32_t)a << bits); }
+        static I iset1(int32_t v) { return v; }
+        static V gather(const float* base, I index) { return base[index]; }
+    };
+#include "collision_simd_kernels.inl"
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+#ifdef COLLISION_SIMD_X86
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#pragma GCC optimize("fp-contract=off")   // strict: see deterministic.h
+#endif
+namespace collision_sse2
+{
+    struct Simd
+    {
+        typedef __m128 V;
+        typedef __m128 M;
+        static const int W = 4;
+        static V set1(float v) { return _mm_set1_ps(v); }
+        static V load(const float* p) { return _mm_loadu_ps(p); }
+        static void store(float* p, V v) { _mm_storeu_ps(p, v); }
+        static V add(V a, V b) { return _mm_add_ps(a, b); }
+        static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+        static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+        static V div(V a, V b) { return _mm_div_ps(a, b); }
+        static V sqrt(V a) { return _mm_sqrt_ps(a); }
+        static V abs(V a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+        static M lt(V a, V b) { return _mm_cmplt_ps(a, b); }
+        static M gt(V a, V b) { return _mm_cmpgt_ps(a, b); }
+        static V select(M m, V a, V b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+        typedef __m128i I;
+        static V floor(V a)
+        {
+            V t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));   // truncation rounds negatives up
+            return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.0f)));
+        }
+        static I toInt(V a) { return _mm_cvttps_epi32(a); }
+        static I iadd(I a, I b) { return _mm_add_epi32(a, b); }
+        static I iand(I a, int32_t mask) { return _mm_and_si128(a, _mm_set1_epi32(mask)); }
+        static I ishl(I a, int bits) { return _mm_sll_epi32(a, _mm_cvtsi32_si128(bits)); }
+        static I iset1(int32_t v) { return _mm_set1_epi32(v); }
+        static V gather(const float* base, I index)   // no gather before AVX2
+        {
+            alignas(16) int32_t i[4];
+            _mm_store_si128((__m128i*)i, index);
+            return _mm_setr_ps(base[i[0]], base[i[1]], base[i[2]], base[i[3]]);
+        }
+    };
+#include "collision_simd_kernels.inl"
+}
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+namespace collision_avx2
+{
+    struct Simd
+    {
+        typedef __m256 V;
+        typedef __m256 M;
+        static const int W = 8;
+        static V set1(float v) { return _mm256_set1_ps(v); }
+        static V load(const float* p) { return _mm256_loadu_ps(p); }
+        static void store(float* p, V v) { _mm256_storeu_ps(p, v); }
+        static V add(V a, V b) { return _mm256_add_ps(a, b); }
+        static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+        static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+        static V div(V a, V b) { return _mm256_div_ps(a, b); }
+        static V sqrt(V a) { return _mm256_sqrt_ps(a); }
+        static V abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+        static M lt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static M gt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static V select(M m, V a, V b) { return _mm256_blendv_ps(b, a, m); }
+        typedef __m256i I;
+        static V floor(V a) { return _mm256_floor_ps(a); }
+        static I toInt(V a) { return _mm256_cvttps_epi32(a); }
+        static I iadd(I a, I b) { return _mm256_add_epi32(a, b); }
+        static I iand(I a, int32_t mask) { return _mm256_and_si256(a, _mm256_set1_epi32(mask)); }
+        static I ishl(I a, int bits) { return _mm256_sll_epi32(a, _mm_cvtsi32_si128(bits)); }
+        static I iset1(int32_t v) { return _mm256_set1_epi32(v); }
+        static V gather(const float* base, I index) { return _mm256_i32gather_ps(base, index, 4); }
+    };
+#include "collision_simd_kernels.inl"
+}
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#endif
+namespace collision_avx512
+{
+    struct Simd
+    {
+        typedef __m512 V;
+        typedef __mmask16 M;
+        static const int W = 16;
+        static V set1(float v) { return _mm512_set1_ps(v); }
+        static V load(const float* p) { return _mm512_loadu_ps(p); }
+        static void store(float* p, V v) { _mm512_storeu_ps(p, v); }
+        static V add(V a, V b) { return _mm512_add_ps(a, b); }
+        static V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+        static V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+        static V div(V a, V b) { return _mm512_div_ps(a, b); }
+        static V sqrt(V a) { return _mm512_mask_sqrt_ps(a, 0xFFFF, a); } // avoids a GCC 12 false -Wmaybe-uninitialized
+        static V abs(V a) { return _mm512_abs_ps(a); }
+        static M lt(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+        static M gt(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+        static V select(M m, V a, V b) { return _mm512_mask_blend_ps(m, b, a); }
+        typedef __m512i I;
+        static V floor(V a) { return _mm512_mask_roundscale_ps(a, 0xFFFF, a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); } // masked forms: same GCC 12 warning as sqrt
+        static I toInt(V a) { return _mm512_mask_cvttps_epi32(_mm512_setzero_si512(), 0xFFFF, a); }
+        static I iadd(I a, I b) { return _mm512_add_epi32(a, b); }
+        static I iand(I a, int32_t mask) { return _mm512_and_si512(a, _mm512_set1_epi32(mask)); }
+        static I ishl(I a, int bits) { return _mm512_mask_sll_epi32(a, 0xFFFF, a, _mm_cvtsi32_si128(bits)); }
+        static I iset1(int32_t v) { return _mm512_set1_epi32(v); }
+        static V gather(const float* base, I index) { return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, index, base, 4); }
+    };
+#include "collision_simd_kernels.inl"
+}
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif // COLLISION_SIMD_X86
+
+enum class SimdLevel { Scalar, SSE2, AVX2, AVX512 };
+
+inline const char* simdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::SSE2: return "SSE2";
+    case SimdLevel::AVX2: return "AVX2";
+    case SimdLevel::AVX512: return "AVX-512";
+    default: return "scalar";
+    }
+}
+
+inline SimdLevel detectSimdLevel()
+{
+#ifdef COLLISION_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+#endif
+    return SimdLevel::Scalar;
+}
+
+// level used by the batch functions; can be lowered (benchmarks, debugging) but
+// never raised above what the CPU supports
+inline SimdLevel& simdLevel()
+{
+    static SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+inline void setSimdLevel(SimdLevel level)
+{
+    simdLevel() = std::min(level, detectSimdLevel());
+}
+
+// level for physics kernels: in deterministic mode only the strict (fp-contract off)
+// scalar and SSE2 variants are used, so every x86-64 machine computes the same bits
+inline SimdLevel physicsSimdLevel()
+{
+    return deterministicPhysics() ? std::min(simdLevel(), SimdLevel::SSE2) : simdLevel();
+}
+
+inline void batchOverlapAABB(const BoxBatch& a, const BoxBatch& b, size_t count, const ContactBatch& out)
+{
+    size_t done = 0;
+#ifdef COLLISION_SIMD_X86
+    switch (physicsSimdLevel())
+    {
+    case SimdLevel::AVX512: done = collision_avx512::aabbKernel(a, b, 0, count, out); break;
+    case SimdLevel::AVX2: done = collision_avx2::aabbKernel(a, b, 0, count, out); break;
+    case SimdLevel::SSE2: done = collision_sse2::aabbKernel(a, b, 0, count, out); break;
+    default: break;
+    }
+#endif
+    collision_scalar::aabbKernel(a, b, done, count, out);
+}
+
+inline void batchOverlapOBB(const OBBBatch& a, const OBBBatch& b, size_t count, const ContactBatch& out)
+{
+    size_t done = 0;
+#ifdef COLLISION_SIMD_X86
+    switch (physicsSimdLevel())
+    {
+    case SimdLevel::AVX512: done = collision_avx512::obbKernel(a, b, 0, count, out); break;
+    case SimdLevel::AVX2: done = collision_avx2::obbKernel(a, b, 0, count, out); break;
+    case SimdLevel::SSE2: done = collision_sse2::obbKernel(a, b, 0, count, out); break;
+    default: break;
+    }
+#endif
+    collision_scalar::obbKernel(a, b, done, count, out);
+}
+
+// ---- SoA storage helpers ----
+
+struct OBBArrays
+{
+    std::vector<float> cx, cy, cz, hx, hy, hz;
+    std::vector<float> axis[3][3];
+
+    void clear()
+    {
+        for (std::vector<float>* v : { &cx, &cy, &cz, &hx, &hy, &hz }) v->clear();
+        for (int k = 0; k < 3; k++) for (int c = 0; c < 3; c++) axis[k][c].clear();
+    }
+
+    // axes: columns are the box's local x/y/z directions
+    void push(const glm::vec3& center, const glm::vec3& halfExtents, const glm::mat3& axes)
+    {
+        cx.push_back(center.x); cy.push_back(center.y); cz.push_back(center.z);
+        hx.push_back(halfExtents.x); hy.push_back(halfExtents.y); hz.push_back(halfExtents.z);
+        for (int k = 0; k < 3; k++) for (int c = 0; c < 3; c++) axis[k][c].push_back(axes[k][c]);
+    }
+
+    size_t size() const { return cx.size(); }
+
+    OBBBatch batch() const
+    {
+        OBBBatch b = { cx.data(), cy.data(), cz.data(), hx.data(), hy.data(), hz.data(), {} };
+        for (int k = 0; k < 3; k++) for (int c = 0; c < 3; c++) b.axis[k][c] = axis[k][c].data();
+        return b;
+    }
+
+    BoxBatch boxes() const { return { cx.data(), cy.data(), cz.data(), hx.data(), hy.data(), hz.data() }; }
+};
+
+struct ContactArrays
+{
+    std::vector<float> nx, ny, nz, depth;
+
+    void resize(size_t n) { nx.resize(n); ny.resize(n); nz.resize(n); depth.resize(n); }
+    ContactBatch batch() { return { nx.data(), ny.data(), nz.data(), depth.data() }; }
+    glm::vec3 normal(size_t i) const { return glm::vec3(nx[i], ny[i], nz[i]); }
+};
+
+// world axes of a box yawed about +Y (degrees, same convention as carYaw)
+inline glm::mat3 yawAxes(float yawDegrees)
+{
+    float s = tableSin(glm::radians(yawDegrees)), c = tableCos(glm::radians(yawDegrees));
+    return glm::mat3(glm::vec3(c, 0.0f, -s), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(s, 0.0f, c));
+}
+
+// continuous collision of an oriented box (centre, half extents, axes as columns) moved
+// by delta against an axis-aligned box [boxMin, boxMax]: the separating-axis test with
+// every projection a linear function of time. t is the time of impact as a fraction of
+// delta and normal the separating axis it is found on, pointing from the box to the
+// moving one. A box that already overlaps at the start reports t = 0 and its axis of
+// least penetration, and is skipped (false) when delta leaves along that axis, so a
+// caller sweeping again finds the next box along the move.
+inline bool sweepOBBAgainstBox(const glm::vec3& center, const glm::vec3& halfExtents, const glm::mat3& axes, const glm::vec3& delta,
+                               const glm::vec3& boxMin, const glm::vec3& boxMax, float& t, glm::vec3& normal)
+{
+    glm::vec3 boxCenter = (boxMin + boxMax) * 0.5f, boxHalf = (boxMax - boxMin) * 0.5f;
+    glm::vec3 offset = center - boxCenter;
+    glm::vec3 tests[15];
+    int n = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        glm::vec3 e(0.0f);
+        e[k] = 1.0f;
+        tests[n++] = e;
+        tests[n++] = axes[k];
+    }
+    for (int k = 0; k < 3; k++)
+        for (int j = 0; j < 3; j++)
+        {
+            glm::vec3 e(0.0f);
+            e[j] = 1.0f;
+            glm::vec3 c = glm::cross(axes[k], e);
+            float len = glm::length(c);
+            if (len > 1e-4f) tests[n++] = c / len;   // parallel edges: already covered by the face axes
+        }
+
+    float enter = -std::numeric_limits<float>::max(), leave = std::numeric_limits<float>::max();
+    float leastPenetration = std::numeric_limits<float>::max();
+    glm::vec3 enterAxis(0.0f), leastAxis(0.0f);
+    for (int i = 0; i < n; i++)
+    {
+        const glm::vec3& L = tests[i];
+        float r = std::fabs(glm::dot(axes[0], L)) * halfExtents.x + std::fabs(glm::dot(axes[1], L)) * halfExtents.y +
+                  std::fabs(glm::dot(axes[2], L)) * halfExtents.z + glm::dot(glm::abs(L), boxHalf);
+        float s = glm::dot(offset, L), v = glm::dot(delta, L);
+        if (std::fabs(s) <= r && r - std::fabs(s) < leastPenetration)
+        {
+            leastPenetration = r - std::fabs(s);
+            leastAxis = s < 0.0f ? -L : L;
+        }
+        if (std::fabs(v) < 1e-9f)
+        {
+            if (std::fabs(s) > r) return false;   // separated on this axis for the whole move
+            continue;
+        }
+        // |s + v t| <= r between the two crossings
+        float t0 = (-r - s) / v, t1 = (r - s) / v;
+        if (t0 > t1) std::swap(t0, t1);
+        if (t0 > enter) { enter = t0; enterAxis = v > 0.0f ? -L : L; }
+        leave = std::min(leave, t1);
+        if (enter > leave || enter > 1.0f || leave < 0.0f) return false;
+    }
+    if (enter >= 0.0f)
+    {
+        t = enter;
+        normal = enterAxis;
+        return true;
+    }
+    // overlapping at the start: blocked only when moving further in
+    if (glm::dot(delta, leastAxis) >= 0.0f) return false;
+    t = 0.0f;
+    normal = leastAxis;
+    return true;
+}
+
+// ---- benchmark: pairs per second per instruction set, checked against scalar ----
+inline void runNarrowphaseBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const size_t n = 1 << 20;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> pos(-4.0f, 4.0f), half(0.25f, 2.0f), angle(0.0f, 360.0f);
+
+    OBBArrays a, b;
+    for (size_t i = 0; i < n; i++)
+    {
+        a.push(glm::vec3(pos(rng), pos(rng) * 0.25f, pos(rng)), glm::vec3(half(rng), half(rng), half(rng)), yawAxes(angle(rng)));
+        b.push(glm::vec3(pos(rng), pos(rng) * 0.25f, pos(rng)), glm::vec3(half(rng), half(rng), half(rng)), yawAxes(angle(rng)));
+    }
+    ContactArrays reference, out;
+    reference.resize(n);
+    out.resize(n);
+
+    SimdLevel best = detectSimdLevel();
+    std::cout << "narrowphase: " << n << " pairs, best available " << simdLevelName(best) << "\n";
+    std::cout << std::setw(10) << "kernel" << std::setw(10) << "isa" << std::setw(14) << "Mpairs/s" << std::setw(14) << "max error" << "\n";
+
+    for (int kernel = 0; kernel < 2; kernel++)
+    {
+        for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512 })
+        {
+            if (level > best) continue;
+            setSimdLevel(level);
+            ContactArrays& target = level == SimdLevel::Scalar ? reference : out;
+            ContactBatch c = target.batch();
+
+            const int reps = 5;
+            auto t0 = Clock::now();
+            for (int r = 0; r < reps; r++)
+            {
+                if (kernel == 0) batchOverlapAABB(a.boxes(), b.boxes(), n, c);
+                else batchOverlapOBB(a.batch(), b.batch(), n, c);
+            }
+            double secs = std::chrono::duration<double>(Clock::now() - t0).count() / reps;
+
+            float maxErr = 0.0f;
+            if (level != SimdLevel::Scalar)
+                for (size_t i = 0; i < n; i++)
+                {
+                    maxErr = std::max(maxErr, std::fabs(out.depth[i] - reference.depth[i]));
+                    if (reference.depth[i] > 0.0f) maxErr = std::max(maxErr, glm::length(out.normal(i) - reference.normal(i)));
+                }
+            std::cout << std::setw(10) << (kernel == 0 ? "AABB" : "OBB") << std::setw(10) << simdLevelName(level)
+                      << std::setw(14) << n / secs / 1e6 << std::setw(14) << maxErr << "\n";
+        }
+    }
+    setSimdLevel(best);
+}
+
+#endif
@@ -0,0 +1,140 @@
+// Batched narrowphase kernels, written once against a small SIMD wrapper.
+// collision_simd.h includes this file once per instruction set, inside a namespace
+// that defines `Simd` (V = float lanes, M = lane mask, W = lane count) and under the
+// matching target pragma. Each kernel handles whole W-wide blocks starting at `begin`
+// and returns where it stopped; the caller finishes the tail with the scalar variant.
+//
+// Conventions for every pair i: normal points from B towards A, so moving A by
+// normal * depth separates the boxes. depth <= 0 means the pair does not overlap.
+
+inline size_t aabbKernel(const BoxBatch& a, const BoxBatch& b, size_t begin, size_t end, const ContactBatch& out)
+{
+    typedef Simd::V V;
+    typedef Simd::M M;
+    const V zero = Simd::set1(0.0f), one = Simd::set1(1.0f), minusOne = Simd::set1(-1.0f);
+
+    size_t i = begin;
+    for (; i + Simd::W <= end; i += Simd::W)
+    {
+        V dx = Simd::sub(Simd::load(a.cx + i), Simd::load(b.cx + i));
+        V dy = Simd::sub(Simd::load(a.cy + i), Simd::load(b.cy + i));
+        V dz = Simd::sub(Simd::load(a.cz + i), Simd::load(b.cz + i));
+        V px = Simd::sub(Simd::add(Simd::load(a.hx + i), Simd::load(b.hx + i)), Simd::abs(dx));
+        V py = Simd::sub(Simd::add(Simd::load(a.hy + i), Simd::load(b.hy + i)), Simd::abs(dy));
+        V pz = Simd::sub(Simd::add(Simd::load(a.hz + i), Simd::load(b.hz + i)), Simd::abs(dz));
+
+        // axis of least penetration
+        V depth = px;
+        V nx = Simd::select(Simd::lt(dx, zero), minusOne, one), ny = zero, nz = zero;
+        M useY = Simd::lt(py, depth);
+        depth = Simd::select(useY, py, depth);
+        nx = Simd::select(useY, zero, nx);
+        ny = Simd::select(useY, Simd::select(Simd::lt(dy, zero), minusOne, one), ny);
+        M useZ = Simd::lt(pz, depth);
+        depth = Simd::select(useZ, pz, depth);
+        nx = Simd::select(useZ, zero, nx);
+        ny = Simd::select(useZ, zero, ny);
+        nz = Simd::select(useZ, Simd::select(Simd::lt(dz, zero), minusOne, one), nz);
+
+        Simd::store(out.nx + i, nx);
+        Simd::store(out.ny + i, ny);
+        Simd::store(out.nz + i, nz);
+        Simd::store(out.depth + i, depth);
+    }
+    return i;
+}
+
+// one SAT axis L (in A's frame) for W pairs; keeps the shallowest penetration in best/bn
+inline void obbTestAxis(const Simd::V ea[3], const Simd::V eb[3], const Simd::V R[3][3], const Simd::V t[3],
+                        Simd::V& best, Simd::V bn[3], Simd::V lx, Simd::V ly, Simd::V lz)
+{
+    typedef Simd::V V;
+    typedef Simd::M M;
+    const V zero = Simd::set1(0.0f), one = Simd::set1(1.0f);
+
+    V len = Simd::sqrt(Simd::add(Simd::add(Simd::mul(lx, lx), Simd::mul(ly, ly)), Simd::mul(lz, lz)));
+    V ra = Simd::add(Simd::add(Simd::mul(ea[0], Simd::abs(lx)), Simd::mul(ea[1], Simd::abs(ly))), Simd::mul(ea[2], Simd::abs(lz)));
+    V rb = zero;
+    for (int c = 0; c < 3; c++)
+    {
+        V proj = Simd::add(Simd::add(Simd::mul(lx, R[0][c]), Simd::mul(ly, R[1][c])), Simd::mul(lz, R[2][c]));
+        rb = Simd::add(rb, Simd::mul(eb[c], Simd::abs(proj)));
+    }
+    V tl = Simd::add(Simd::add(Simd::mul(t[0], lx), Simd::mul(t[1], ly)), Simd::mul(t[2], lz));
+    M valid = Simd::gt(len, Simd::set1(1e-6f));
+    V safeLen = Simd::select(valid, len, one);
+    V depth = Simd::div(Simd::sub(Simd::add(ra, rb), Simd::abs(tl)), safeLen);
+    depth = Simd::select(valid, depth, Simd::set1(3.0e38f));
+
+    M better = Simd::lt(depth, best);
+    // B lies along +L when t.L > 0, so the separating direction for A is -L
+    V s = Simd::div(Simd::select(Simd::gt(tl, zero), Simd::set1(-1.0f), one), safeLen);
+    best = Simd::select(better, depth, best);
+    bn[0] = Simd::select(better, Simd::mul(lx, s), bn[0]);
+    bn[1] = Simd::select(better, Simd::mul(ly, s), bn[1]);
+    bn[2] = Simd::select(better, Simd::mul(lz, s), bn[2]);
+}
+
+// Separating-axis test over the 15 candidate axes (3 + 3 face normals, 9 edge
+// crosses), evaluated in A's local frame. Each axis L gives
+//     depth = (rA + rB - |t.L|) / |L|
+// and the pair overlaps when every depth is positive; the smallest one is the
+// contact. Near-parallel edge pairs (|L| ~ 0) are skipped.
+inline size_t obbKernel(const OBBBatch& a, const OBBBatch& b, size_t begin, size_t end, const ContactBatch& out)
+{
+    typedef Simd::V V;
+    const V zero = Simd::set1(0.0f), huge = Simd::set1(3.0e38f);
+
+    size_t i = begin;
+    for (; i + Simd::W <= end; i += Simd::W)
+    {
+        // A's axes (rows) and B's axes in world space
+        V A[3][3], B[3][3];
+        for (int k = 0; k < 3; k++)
+        {
+            A[k][0] = Simd::load(a.axis[k][0] + i); A[k][1] = Simd::load(a.axis[k][1] + i); A[k][2] = Simd::load(a.axis[k][2] + i);
+            B[k][0] = Simd::load(b.axis[k][0] + i); B[k][1] = Simd::load(b.axis[k][1] + i); B[k][2] = Simd::load(b.axis[k][2] + i);
+        }
+        V ea[3] = { Simd::load(a.hx + i), Simd::load(a.hy + i), Simd::load(a.hz + i) };
+        V eb[3] = { Simd::load(b.hx + i), Simd::load(b.hy + i), Simd::load(b.hz + i) };
+        V d[3] = { Simd::sub(Simd::load(b.cx + i), Simd::load(a.cx + i)),
+                   Simd::sub(Simd::load(b.cy + i), Simd::load(a.cy + i)),
+                   Simd::sub(Simd::load(b.cz + i), Simd::load(a.cz + i)) };
+
+        // R[r][c] = A_r . B_c ; t = centre offset in A's frame
+        V R[3][3], t[3];
+        for (int r = 0; r < 3; r++)
+        {
+            for (int c = 0; c < 3; c++)
+                R[r][c] = Simd::add(Simd::add(Simd::mul(A[r][0], B[c][0]), Simd::mul(A[r][1], B[c][1])), Simd::mul(A[r][2], B[c][2]));
+            t[r] = Simd::add(Simd::add(Simd::mul(A[r][0], d[0]), Simd::mul(A[r][1], d[1])), Simd::mul(A[r][2], d[2]));
+        }
+
+        V best = huge;
+        V bn[3] = { zero, zero, zero };   // best axis in A's frame, pointing from B to A
+
+        const V one = Simd::set1(1.0f);
+        // A's face normals
+        obbTestAxis(ea, eb, R, t, best, bn, one, zero, zero);
+        obbTestAxis(ea, eb, R, t, best, bn, zero, one, zero);
+        obbTestAxis(ea, eb, R, t, best, bn, zero, zero, one);
+        // B's face normals, expressed in A's frame
+        for (int c = 0; c < 3; c++) obbTestAxis(ea, eb, R, t, best, bn, R[0][c], R[1][c], R[2][c]);
+        // A_r x B_c in A's frame: e_r x (R[0][c], R[1][c], R[2][c])
+        for (int c = 0; c < 3; c++)
+        {
+            obbTestAxis(ea, eb, R, t, best, bn, zero, Simd::sub(zero, R[2][c]), R[1][c]);      // e_x x b
+            obbTestAxis(ea, eb, R, t, best, bn, R[2][c], zero, Simd::sub(zero, R[0][c]));      // e_y x b
+            obbTestAxis(ea, eb, R, t, best, bn, Simd::sub(zero, R[1][c]), R[0][c], zero);      // e_z x b
+        }
+
+        // back to world space
+        for (int k = 0; k < 3; k++)
+        {
+            V w = Simd::add(Simd::add(Simd::mul(bn[0], A[0][k]), Simd::mul(bn[1], A[1][k])), Simd::mul(bn[2], A[2][k]));
+            Simd::store((k == 0 ? out.nx : k == 1 ? out.ny : out.nz) + i, w);
+        }
+        Simd::store(out.depth + i, best);
+    }
+    return i;
+}
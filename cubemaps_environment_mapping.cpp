@@ -2,6 +2,9 @@
 // Full scene: skybox, textured floor, controllable car, third-person chase camera
 
 #include <glad/glad.h>
+#ifdef USE_VULKAN
+#define GLFW_INCLUDE_VULKAN
+#endif
 #include <GLFW/glfw3.h>
 #include <stb_image.h>
 
@@ -13,7 +16,43 @@
 #include <learnopengl/shader_m.h>
 #include <learnopengl/model.h>
 
+#include "renderer.h"
+#include "renderer_gl.h"
+#ifdef USE_VULKAN
+#include "renderer_vulkan.h"
+#endif
+#include "spatial_hash.h"
+#include "bvh.h"
+#include "collision_simd.h"
+#include "mesh_collider.h"
+#include "traffic.h"
+#include "vehicle_dynamics.h"
+#include "deterministic.h"
+#include "world_stream.h"
+#include "heightfield.h"
+#include "terrain.h"
+#include "roads.h"
+#include "level.h"
+#include "camera.h"
+#include "culling.h"
+#include "probe.h"
+#include "planar_reflection.h"
+#include "post.h"
+#include "ibl.h"
+#include "taa.h"
+#include "ssao.h"
+#include "lightmap.h"
+#include "light_probes.h"
+#include "jobs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 // window
@@ -27,190 +66,302 @@ float lastFrame = 0.0f;
 // camera follow parameters (third-person)
 glm::vec3 cameraUp(0.0f, 1.0f, 0.0f);
 glm::vec3 cameraPos(0.0f, 3.0f, 8.0f); // initial
-float cameraSmoothSpeed = 6.0f; // lerp speed
+SpringArmCamera chaseCamera;            // keeps the camera out of walls (see camera.h)
 
 // car state
 glm::vec3 carPos(0.0f, 0.0f, 0.0f);
 float carYaw = 0.0f;       // degrees, 0 -> +Z in our code (consistent with example)
-float carSpeed = 0.0f;     // units per second
 
-// car bounding box (approximate)
+// player car handling: a batch of one through the same bicycle model as traffic;
+// carPos/carYaw mirror its pose after collision response
+VehicleParams carParams;
+VehicleArrays playerCar;
+
+// car bounding box (approximate until the mesh proxy below is loaded)
 glm::vec3 carSize(1.5f, 1.0f, 3.0f); // width, height, length
+glm::vec3 carCenter(0.0f);           // box centre in the car's frame
+
+// exact car shape for the narrowphase, in the car's frame
+MeshCollider carCollider;
 
-// wall bounding box (match your wall dimensions)
-glm::vec3 wallPos(0.0f, 2.0f, 20.0f); // center
-glm::vec3 wallSize(4.0f, 4.0f, 0.5f); // width, height, depth
+// static world colliders (walls, barriers, buildings) live in a BVH;
+// moving bodies (the car, future traffic) share the grid broadphase
+StaticBVH staticWorld;
+SpatialHash broadphase(4.0f);
+
+// AI cars on ring lanes around the arena, in the same broadphase as the player
+TrafficSystem traffic(broadphase);
 
 // physics params
-const float MAX_SPEED = 12.0f;
-const float ACCELERATION = 20.0f;   // units/s^2
-const float BRAKE = 30.0f;
-const float FRICTION = 6.0f;
-const float TURN_SPEED = 90.0f;     // degrees per second at full input
+const float CONTACT_SKIN = 0.01f;   // gap left between the car and a wall it hits
+const int MAX_SLIDES = 3;           // contacts resolved per physics tick
+
+// fixed physics step, see --physics-hz
+float physicsDt = 1.0f / 60.0f;
 
 // inputs
 bool keys[1024] = {false};
 
+// active rendering backend (GL by default, Vulkan with --vulkan)
+Renderer* renderer = nullptr;
+
 // function declarations
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
-unsigned int loadTexture(const char *path);
-unsigned int loadCubemap(std::vector<std::string> faces);
 
-// Axis-Aligned Bounding Box collision check
-bool checkCollision(const glm::vec3 &posA, const glm::vec3 &sizeA,
-                    const glm::vec3 &posB, const glm::vec3 &sizeB)
+// Shelby.obj space -> car frame (origin at carPos, yawed by carYaw)
+glm::mat4 carModelToBody()
 {
-    return (fabs(posA.x - posB.x) * 2 < (sizeA.x + sizeB.x)) &&
-           (fabs(posA.y - posB.y) * 2 < (sizeA.y + sizeB.y)) &&
-           (fabs(posA.z - posB.z) * 2 < (sizeA.z + sizeB.z));
+    glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.1f, 0.0f)); // small lift
+    m = glm::rotate(m, glm::radians(90.0f), glm::vec3(0, 1, 0));
+    m = glm::scale(m, glm::vec3(0.6f)); // adjust to taste
+    return m;
 }
 
-int main()
+// stands a car upright on ground with this normal
+glm::mat4 groundTilt(const glm::vec3& normal)
 {
-    // ---- GLFW init ----
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glm::vec3 axis = glm::cross(glm::vec3(0.0f, 1.0f, 0.0f), normal);
+    float s = glm::length(axis);
+    if (s < 1e-6f) return glm::mat4(1.0f);
+    return glm::rotate(glm::mat4(1.0f), std::atan2(s, normal.y), axis / s);
+}
+
+int main(int argc, char** argv)
+{
+    jobSystem();   // start the workers; the first caller (this thread) is the main thread
+
+    // ---- command line ----
+    // --vulkan      use the Vulkan backend (requires a -DUSE_VULKAN build)
+    // --headless    no window; Vulkan renders offscreen (e.g. on lavapipe)
+    // --frames N    exit after N frames and print the average CPU submission cost
+    // --physics-hz N  physics tick rate (default 60)
+    // --traffic N   number of AI cars (default 64)
+    // --bench NAME  run a CPU benchmark and exit (broadphase, bvh, narrowphase, mesh, traffic, jobs, vehicle, stream, heightfield, roads, level, camera, views, ibl, lightmap, probes)
+    // --level FILE  level to play (default levels/arena.txt; a .txt level is compiled to .lvl first)
+    // --convert-level IN OUT  compile a text level to the binary format and exit
+    // --views N     split-screen with N views (1-4): the player's camera, then cameras chasing AI cars
+    // --probe-size N   resolution of the cars' dynamic reflection cubemap (default 128, 0 = reflect the skybox)
+    // --probe-faces N  reflection cubemap faces re-rendered per frame (0-6, default 2)
+    // --no-ibl      no lighting from the skybox (constant ambient, plain reflections)
+    // --reflection-scale N  floor reflection at 1/N resolution (2 = half, 4 = quarter, 0 = off; default 2)
+    // --no-hdr      8-bit rendering straight to the window (no tonemap, no bloom)
+    // --exposure X  HDR exposure before the tonemap (default 1)
+    // --bloom-scale N  bloom chain from 1/N resolution (2 = half, 4 = quarter, 0 = off; default 2)
+    // --post-budget MS  GPU budget for bloom + tonemap; bloom steps down to stay inside it (default 1, 0 = fixed)
+    // --no-taa      no temporal anti-aliasing (TAA runs with HDR)
+    // --render-scale X  scene rendered at X times the window's size (0.5-1) and upsampled by TAA (default 1)
+    // --ssao Q      ambient occlusion preset: off, low, medium or high (default medium)
+    // --ssao-sweep N  cycle the ambient occlusion presets every N frames, timing each
+    // --no-lightmap  light the static geometry from lightPos every frame instead of the baked lightmap
+    // --no-probes   no baked light on the cars from the light probe grid (the sky's ambient only)
+    // --flat        level ground streamed in chunks instead of the heightfield terrain
+    // --stream-budget MB  memory for resident world chunks with --flat (default 4)
+    // --deterministic  bit-reproducible physics; prints the final state hash
+    // --record FILE    deterministic, and save inputs + per-tick state hashes on exit
+    // --replay FILE    deterministic, drive the car from a recording and check every tick's hash
+    bool useVulkan = false, headless = false;
+    long maxFrames = -1;
+    unsigned int trafficCars = 64;
+    std::string recordPath, replayPath;
+    long streamBudgetMB = 0;
+    bool flatGround = false;
+    std::string levelPath = "levels/arena.txt";
+    unsigned int viewCount = 1;
+    ReflectionSettings reflections;
+    ReflectionProbeConfig probeConfig;
+    PlanarReflectionSettings planarSettings;
+    PostProcessSettings postSettings;
+    double postBudgetMs = 1.0;
+    TemporalAASettings taaSettings;
+    AmbientOcclusionSettings aoSettings;
+    unsigned int aoSweepFrames = 0;
+    bool environmentLighting = true;
+    bool bakedLighting = true;
+    bool probeLighting = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--vulkan")) useVulkan = true;
+        else if (!strcmp(argv[i], "--headless")) headless = true;
+        else if (!strcmp(argv[i], "--frames") && i + 1 < argc) maxFrames = atol(argv[++i]);
+        else if (!strcmp(argv[i], "--traffic") && i + 1 < argc) trafficCars = (unsigned int)atol(argv[++i]);
+        else if (!strcmp(argv[i], "--physics-hz") && i + 1 < argc) physicsDt = 1.0f / std::max(1.0f, (float)atof(argv[++i]));
+        else if (!strcmp(argv[i], "--stream-budget") && i + 1 < argc) streamBudgetMB = atol(argv[++i]);
+        else if (!strcmp(argv[i], "--flat")) flatGround = true;
+        else if (!strcmp(argv[i], "--views") && i + 1 < argc) viewCount = (unsigned int)std::min<long>(std::max(1L, atol(argv[++i])), MAX_SCREEN_VIEWS);
+        else if (!strcmp(argv[i], "--probe-size") && i + 1 < argc) reflections.probeSize = (int)std::max(0L, atol(argv[++i]));
+        else if (!strcmp(argv[i], "--probe-faces") && i + 1 < argc) probeConfig.facesPerFrame = (int)std::min(std::max(0L, atol(argv[++i])), 6L);
+        else if (!strcmp(argv[i], "--no-ibl")) environmentLighting = false;
+        else if (!strcmp(argv[i], "--no-hdr")) postSettings.hdr = false;
+        else if (!strcmp(argv[i], "--exposure") && i + 1 < argc) postSettings.exposure = std::max(0.0f, (float)atof(argv[++i]));
+        else if (!strcmp(argv[i], "--bloom-scale") && i + 1 < argc) postSettings.bloomDivisor = (int)std::min(std::max(0L, atol(argv[++i])), 8L);
+        else if (!strcmp(argv[i], "--post-budget") && i + 1 < argc) postBudgetMs = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--no-taa")) taaSettings.enabled = false;
+        else if (!strcmp(argv[i], "--render-scale") && i + 1 < argc) taaSettings.renderScale = std::min(std::max(0.5f, (float)atof(argv[++i])), 1.0f);
+        else if (!strcmp(argv[i], "--ssao") && i + 1 < argc)
+        {
+            const char* q = argv[++i];
+            aoSettings.quality = !strcmp(q, "off") ? AOQuality::Off : !strcmp(q, "low") ? AOQuality::Low
+                               : !strcmp(q, "high") ? AOQuality::High : AOQuality::Medium;
+        }
+        else if (!strcmp(argv[i], "--no-lightmap")) bakedLighting = false;
+        else if (!strcmp(argv[i], "--no-probes")) probeLighting = false;
+        else if (!strcmp(argv[i], "--ssao-sweep") && i + 1 < argc) aoSweepFrames = (unsigned int)std::max(0L, atol(argv[++i]));
+        else if (!strcmp(argv[i], "--reflection-scale") && i + 1 < argc) planarSettings.resolutionDivisor = (int)std::min(std::max(0L, atol(argv[++i])), 8L);
+        else if (!strcmp(argv[i], "--level") && i + 1 < argc) levelPath = argv[++i];
+        else if (!strcmp(argv[i], "--convert-level") && i + 2 < argc)
+        {
+            std::string error;
+            if (!convertLevelText(argv[i + 1], argv[i + 2], &error)) { std::cerr << error << "\n"; return -1; }
+            std::cout << "wrote " << argv[i + 2] << "\n";
+            return 0;
+        }
+        else if (!strcmp(argv[i], "--deterministic")) deterministicPhysics() = true;
+        else if (!strcmp(argv[i], "--record") && i + 1 < argc) recordPath = argv[++i];
+        else if (!strcmp(argv[i], "--replay") && i + 1 < argc) replayPath = argv[++i];
+        else if (!strcmp(argv[i], "--bench") && i + 1 < argc)
+        {
+            std::string bench = argv[++i];
+            if (bench == "broadphase") runBroadphaseBenchmark();
+            else if (bench == "bvh") runBVHBenchmark();
+            else if (bench == "narrowphase") runNarrowphaseBenchmark();
+            else if (bench == "traffic") runTrafficBenchmark();
+            else if (bench == "jobs") runJobsBenchmark();
+            else if (bench == "vehicle") runVehicleBenchmark();
+            else if (bench == "stream") runWorldStreamBenchmark();
+            else if (bench == "heightfield") runHeightfieldBenchmark();
+            else if (bench == "roads") runRoadsBenchmark();
+            else if (bench == "level") runLevelBenchmark();
+            else if (bench == "camera") runCameraBenchmark();
+            else if (bench == "views") runViewsBenchmark();
+            else if (bench == "ibl") runIBLBenchmark();
+            else if (bench == "lightmap") runLightmapBenchmark();
+            else if (bench == "probes") runLightProbeBenchmark();
+            else if (bench == "mesh") runMeshColliderBenchmark(FileSystem::getPath("resources/objects/AC Cobra/Shelby.obj"), carModelToBody());
+            else { std::cerr << "Unknown benchmark: " << bench << "\n"; return -1; }
+            return 0;
+        }
+    }
+#ifndef USE_VULKAN
+    if (useVulkan) { std::cerr << "Built without Vulkan support (define USE_VULKAN)\n"; return -1; }
 #endif
+    if (headless && !useVulkan) { std::cerr << "--headless needs the Vulkan backend\n"; return -1; }
+    if (headless && maxFrames < 0) maxFrames = 1000;
 
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Car + Skybox + Textured Floor", nullptr, nullptr);
-    if (!window) { std::cerr << "Failed to create GLFW window\n"; glfwTerminate(); return -1; }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetKeyCallback(window, key_callback);
-
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) { std::cerr << "Failed to initialize GLAD\n"; return -1; }
-    glEnable(GL_DEPTH_TEST);
-
-    // ---- Shaders ----
-    Shader modelShader("1.model_loading.vs", "1.model_loading.fs"); // your existing model shader
-    Shader skyboxShader("6.2.skybox.vs", "6.2.skybox.fs");         // your existing skybox shader
-    Shader floorShader("floor.vs", "floor.fs");                   // floor shader provided below
-
-    // ---- FLOOR geometry (big tiled quad) ----
-    float floorVertices[] = {
-        // positions            // normals         // texcoords
-        -50.0f, 0.0f, -50.0f,    0.0f, 1.0f, 0.0f,    0.0f, 50.0f,
-         50.0f, 0.0f, -50.0f,    0.0f, 1.0f, 0.0f,   50.0f, 50.0f,
-         50.0f, 0.0f,  50.0f,    0.0f, 1.0f, 0.0f,   50.0f,  0.0f,
-        -50.0f, 0.0f,  50.0f,    0.0f, 1.0f, 0.0f,    0.0f,  0.0f
-    };
-    unsigned int floorIndices[] = { 0, 1, 2, 2, 3, 0 };
-
-    unsigned int floorVAO, floorVBO, floorEBO;
-    glGenVertexArrays(1, &floorVAO);
-    glGenBuffers(1, &floorVBO);
-    glGenBuffers(1, &floorEBO);
-
-    glBindVertexArray(floorVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, floorVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(floorVertices), floorVertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, floorEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(floorIndices), floorIndices, GL_STATIC_DRAW);
-
-    // pos
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // normal
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    // texcoord
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glBindVertexArray(0);
+    // recordings carry the settings that shape the simulation
+    PhysicsRecording recording, replay;
+    bool replaying = !replayPath.empty();
+    if (replaying)
+    {
+        if (!replay.load(replayPath)) { std::cerr << "Failed to load recording: " << replayPath << "\n"; return -1; }
+        physicsDt = replay.physicsDt;
+        trafficCars = replay.trafficCars;
+        flatGround = replay.flatGround != 0;
+    }
+    if (replaying || !recordPath.empty()) deterministicPhysics() = true;
+    recording.physicsDt = physicsDt;
+    recording.trafficCars = trafficCars;
+    recording.flatGround = flatGround ? 1 : 0;
 
-    // ---- Load floor texture ----
-    unsigned int floorTex = loadTexture(FileSystem::getPath("resources/textures/wood.png").c_str());
-    if (floorTex == 0) std::cout << "Warning: Floor texture failed to load\n";
+    // ---- Level: static geometry, colliders, lights and spawns, mapped in place (see level.h) ----
+    Level level;
+    {
+        std::string error;
+        if (!loadLevel(level, levelPath, &error)) { std::cerr << "Failed to load level: " << error << "\n"; return -1; }
+        level.printStats(std::cout);
+        if (replaying && replay.levelHash != level.contentHash())
+            std::cout << "replay: recorded on a different level, expect it to diverge\n";
+        recording.levelHash = level.contentHash();
+        if (const LevelSpawn* spawn = level.spawn("player"))
+        {
+            carPos = glm::vec3(spawn->position[0], spawn->position[1], spawn->position[2]);
+            carYaw = spawn->yaw;
+        }
+    }
 
-    // ---- Skybox geometry ----
-    float skyboxVertices[] = {
-        // positions
-        -1.0f,  1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-
-        -1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-
-         1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-
-        -1.0f, -1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-
-        -1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f, -1.0f,
-
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f
-    };
+    // ---- GLFW init ----
+    glfwInit();
+    GLFWwindow* window = nullptr;
+    if (!headless)
+    {
+        if (useVulkan)
+        {
+            glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        }
+        else
+        {
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+            glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+            glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+        }
 
-    unsigned int skyboxVAO, skyboxVBO;
-    glGenVertexArrays(1, &skyboxVAO);
-    glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-
-    // ---- WALL geometry ----
-    float wallVertices[] = {
-        // positions          // normals          // texcoords
-        -2.0f, 0.0f, 20.0f,    0.0f, 0.0f, -1.0f,    0.0f, 0.0f, // bottom left
-        2.0f, 0.0f, 20.0f,    0.0f, 0.0f, -1.0f,    1.0f, 0.0f, // bottom right
-        2.0f, 4.0f, 20.0f,    0.0f, 0.0f, -1.0f,    1.0f, 1.0f, // top right
-        -2.0f, 4.0f, 20.0f,    0.0f, 0.0f, -1.0f,    0.0f, 1.0f  // top left
-    };
-    unsigned int wallIndices[] = { 0, 1, 2, 2, 3, 0 };
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Car + Skybox + Textured Floor", nullptr, nullptr);
+        if (!window) { std::cerr << "Failed to create GLFW window\n"; glfwTerminate(); return -1; }
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetKeyCallback(window, key_callback);
+    }
 
-    unsigned int wallVAO, wallVBO, wallEBO;
-    glGenVertexArrays(1, &wallVAO);
-    glGenBuffers(1, &wallVBO);
-    glGenBuffers(1, &wallEBO);
+    std::unique_ptr<Renderer> backend;
+#ifdef USE_VULKAN
+    if (useVulkan) backend.reset(new VulkanRenderer(window, SCR_WIDTH, SCR_HEIGHT));
+#endif
+    if (!backend)
+    {
+        glfwMakeContextCurrent(window);
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) { std::cerr << "Failed to initialize GLAD\n"; return -1; }
+        backend.reset(new GLRenderer(window));
+    }
+    renderer = backend.get();
+
+    // ---- Ground: heightfield terrain drawn as clipmaps around the camera (see terrain.h),
+    // or with --flat level chunks streamed in around the car (see world_stream.h) ----
+    std::unique_ptr<Heightfield> terrain;
+    std::unique_ptr<TerrainClipmap> clipmap;
+    std::unique_ptr<WorldStreamer> world;
+    if (flatGround)
+    {
+        WorldStreamConfig streamConfig;
+        if (streamBudgetMB > 0) streamConfig.budgetBytes = (size_t)streamBudgetMB << 20;
+        world.reset(new WorldStreamer(renderer, streamConfig));
+    }
+    else
+    {
+        terrain.reset(new Heightfield());
+        clipmap.reset(new TerrainClipmap(renderer, *terrain));
+        traffic.setGround(terrain.get());
+        std::cout << "Terrain: " << terrain->size() << "^2 heights generated in " << terrain->generateMs() << " ms\n";
+        clipmap->printStats(std::cout);
+    }
+    auto groundHeight = [&terrain](const glm::vec3& p) { return terrain ? terrain->height(p.x, p.z) : 0.0f; };
+    auto groundNormal = [&terrain](const glm::vec3& p) { return terrain ? terrain->normal(p.x, p.z) : glm::vec3(0.0f, 1.0f, 0.0f); };
 
-    glBindVertexArray(wallVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, wallVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(wallVertices), wallVertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, wallEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(wallIndices), wallIndices, GL_STATIC_DRAW);
+    // ---- Roads: spline network meshed per chunk on the job system, cached on disk; its
+    // barriers are static colliders next to the BVH below (see roads.h) ----
+    std::unique_ptr<RoadNetwork> roads(new RoadNetwork(renderer, terrain.get()));
+    generateRoads(*roads, 1);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glBindVertexArray(0);
+    // ---- Load floor texture ----
+    unsigned int floorTex = renderer->loadTexture(FileSystem::getPath("resources/textures/wood.png"));
+    if (floorTex == 0) std::cout << "Warning: Floor texture failed to load\n";
 
+    // ---- Level geometry: one mesh per geometry (models load from their files), with
+    // its texture; textures shared between geometries load once ----
+    std::vector<unsigned int> levelMeshes, levelTextures;
+    {
+        std::unordered_map<uint32_t, unsigned int> textureByName;
+        for (const LevelGeometry& g : level.geometries())
+        {
+            if (g.model) levelMeshes.push_back(renderer->loadModel(FileSystem::getPath(level.string(g.model))));
+            else levelMeshes.push_back(renderer->createMesh(&level.vertices()[(size_t)g.firstVertex * 8], g.vertexCount, &level.indices()[g.firstIndex], g.indexCount));
+            auto tex = textureByName.find(g.texture);
+            if (g.texture && tex == textureByName.end())
+                tex = textureByName.emplace(g.texture, renderer->loadTexture(FileSystem::getPath(level.string(g.texture)))).first;
+            levelTextures.push_back(g.texture ? tex->second : 0);
+        }
+    }
 
     // ---- Load cubemap textures ----
     std::vector<std::string> faces
@@ -222,165 +373,465 @@ int main()
         FileSystem::getPath("resources/textures/skybox/front.jpg"),
         FileSystem::getPath("resources/textures/skybox/back.jpg")
     };
-    unsigned int cubemapTexture = loadCubemap(faces);
-    skyboxShader.use();
-    skyboxShader.setInt("skybox", 0);
+    renderer->setSkybox(faces);
+    renderer->setReflections(reflections);
+    renderer->setPlanarReflections(planarSettings);
+    // HDR target, bloom and tonemap, kept inside a GPU budget (see post.h)
+    PostProcessBudget postBudget(postSettings, postBudgetMs);
+    renderer->setPostProcess(postBudget.settings());
+    // jittered screen views resolved over time, optionally from a smaller scene (see taa.h)
+    renderer->setTemporalAA(taaSettings);
+    TemporalAA temporalAA(taaSettings);
+    // ambient occlusion from the screen views' depth (see ssao.h)
+    AmbientOcclusionProfile aoProfile(aoSettings, aoSweepFrames);
+    renderer->setAmbientOcclusion(aoProfile.settings());
+    glm::mat4 prevCarModelMat(0.0f);
+    std::vector<glm::mat4> prevTrafficModels;
+    // image-based lighting from the same faces: computed on the first run, then read
+    // from the cache next to them (ibl.h)
+    if (environmentLighting)
+    {
+        IBLData ibl;
+        IBLStats iblStats;
+        std::string error;
+        if (loadIBL(faces, ibl, &iblStats, "", IBLConfig(), &error))
+        {
+            renderer->setEnvironmentLighting(ibl);
+            iblStats.print(std::cout);
+        }
+        else std::cerr << "ibl: " << error << "\n";
+    }
+
+    // ---- Lightmap: the level's lights traced onto the ground and the level's flat
+    // geometry on the first run, then read from the cache next to the level (lightmap.h) ----
+    Lightmap lightmap;
+    if (bakedLighting)
+    {
+        LightmapStats lightmapStats;
+        std::string error;
+        if (loadLightmap(level, terrain.get(), lightmap, &lightmapStats, std::filesystem::path(levelPath).parent_path().string(),
+                         LightmapConfig(), &error))
+        {
+            renderer->setLightmap(lightmap.data);
+            lightmapStats.print(std::cout);
+        }
+        else std::cerr << "lightmap: " << error << "\n";
+    }
+
+    // ---- Light probes: the same lights and scene sampled at points above the ground
+    // for the cars, baked and cached alongside the lightmap (light_probes.h) ----
+    LightProbeGrid lightProbes;
+    if (probeLighting)
+    {
+        LightProbeStats probeStats;
+        std::string error;
+        if (loadLightProbes(level, terrain.get(), lightProbes, &probeStats, std::filesystem::path(levelPath).parent_path().string(),
+                            LightProbeConfig(), LightmapConfig(), &error))
+            probeStats.print(std::cout);
+        else std::cerr << "light probes: " << error << "\n";
+    }
 
     // ---- Load car model ----
-    Model carModel(FileSystem::getPath("resources/objects/AC Cobra/Shelby.obj"));
+    unsigned int carMesh = renderer->loadModel(FileSystem::getPath("resources/objects/AC Cobra/Shelby.obj"));
+
+    // ---- Car collision proxy (triangle BVH + convex parts) ----
+    if (carCollider.load(FileSystem::getPath("resources/objects/AC Cobra/Shelby.obj"), carModelToBody()))
+    {
+        // fit the box used by the sweep and the broadphase to the real body
+        carSize = carCollider.bounds().max - carCollider.bounds().min;
+        carCenter = (carCollider.bounds().max + carCollider.bounds().min) * 0.5f;
+        std::cout << "Car collider: " << carCollider.triangleCount() << " triangles, " << carCollider.partCount() << " convex parts, "
+                  << carCollider.memoryBytes() / 1024 << " KB, built in " << carCollider.buildMs() << " ms\n";
+    }
+
+    // ---- Colliders ----
+    std::vector<BVHBox> worldColliders;
+    worldColliders.reserve(level.colliders().size());
+    for (const LevelCollider& c : level.colliders())
+        worldColliders.push_back({ glm::vec3(c.min[0], c.min[1], c.min[2]), glm::vec3(c.max[0], c.max[1], c.max[2]) });
+    staticWorld.build(worldColliders);
+    unsigned int carBody = broadphase.add(carPos + carCenter, carSize);
+    playerCar.add(carPos, carYaw);
+
+    // ---- AI traffic: four ring lanes clear of the wall, alternating direction ----
+    const int TRAFFIC_LANES = 4;
+    traffic.setCarSize(carSize);
+    for (int l = 0; l < TRAFFIC_LANES; l++)
+    {
+        unsigned int lane = traffic.addLane(TrafficSystem::ringLane(glm::vec3(0.0f), 28.0f + 4.0f * l, l & 1), 10.0f);
+        traffic.spawn(lane, trafficCars / TRAFFIC_LANES + (l < (int)(trafficCars % TRAFFIC_LANES) ? 1 : 0));
+    }
+    std::vector<unsigned int> contacts;
+    std::vector<BVHBox> sweepBoxes;     // static boxes near the player's move, swept as an OBB
+    OBBArrays narrowCar, narrowOther;   // narrowphase pairs: car OBB vs each candidate
+    ContactArrays narrowOut;
 
-    // Light position (for floor lighting)
+    // Light position (for floor lighting): the backends light with the level's first light
     glm::vec3 lightPos(0.0f, 10.0f, 0.0f);
+    if (!level.lights().empty()) lightPos = glm::vec3(level.lights()[0].position[0], level.lights()[0].position[1], level.lights()[0].position[2]);
 
     // initial camera position behind car
     {
         glm::vec3 forward = glm::vec3(sin(glm::radians(carYaw)), 0.0f, cos(glm::radians(carYaw)));
         cameraPos = carPos - forward * 8.0f + glm::vec3(0.0f, 3.0f, 0.0f);
+        chaseCamera.reset(cameraPos);
     }
+    // split-screen: the other views chase AI cars (or circle the player without traffic)
+    // on spring arms of their own; one culler sorts the shared draw list between views
+    std::vector<SpringArmCamera> viewCameras(viewCount);
+    bool viewCamerasPlaced = false;
+    ViewCuller culler;
+    // one reflection probe around the player's car, a few faces per frame (see probe.h)
+    ReflectionProbe probe(probeConfig);
+    bool probeEnabled = reflections.probeSize > 0 && probeConfig.facesPerFrame > 0;
+    // the floor's reflection: one mirrored view per screen view (see planar_reflection.h)
+    PlanarReflection planarReflection(planarSettings);
+    bool planarEnabled = planarSettings.resolutionDivisor > 0;
+
+    glm::vec3 prevCarPos = carPos;
+    float prevCarYaw = carYaw;
+    float physicsAccumulator = 0.0f;
+    size_t physicsTick = 0;
+    long firstMismatch = -1;
+    StateHash lastHash;
+
+    std::vector<DrawItem> drawList;
+    double submitMsTotal = 0.0;
+    double viewSubmitMsTotal[MAX_VIEWS] = {};
+    long frameCount = 0;
 
     // ---- Render loop ----
-    while (!glfwWindowShouldClose(window))
+    while (headless || !glfwWindowShouldClose(window))
     {
-        // per-frame time
-        float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        if (maxFrames >= 0 && frameCount >= maxFrames) break;
+        if (replaying && physicsTick >= replay.ticks.size()) break;
+
+        // per-frame time (fixed step when there is no window to pace us)
+        if (headless)
+        {
+            deltaTime = 1.0f / 60.0f;
+        }
+        else
+        {
+            float currentFrame = static_cast<float>(glfwGetTime());
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+        }
 
         // ---- input / physics ----
-        // accelerate / brake
-        float accelInput = 0.0f;
-        if (keys[GLFW_KEY_W]) accelInput += 1.0f;
-        if (keys[GLFW_KEY_S]) accelInput -= 1.0f;
-
-        // steering
-        float steerInput = 0.0f;
-        if (keys[GLFW_KEY_A]) steerInput += 1.0f;
-        if (keys[GLFW_KEY_D]) steerInput -= 1.0f;
-
-        // update speed
-        if (accelInput > 0.0f) {
-            carSpeed += ACCELERATION * accelInput * deltaTime;
-        } else if (accelInput < 0.0f) {
-            carSpeed += -BRAKE * (-accelInput) * deltaTime;
-        } else {
-            // friction / rolling resistance
-            if (carSpeed > 0.0f) carSpeed -= FRICTION * deltaTime;
-            else if (carSpeed < 0.0f) carSpeed += FRICTION * deltaTime;
+        // physics runs at a fixed rate (--physics-hz) independent of the frame rate;
+        // the swept collision below keeps low tick rates from tunnelling through walls
+        physicsAccumulator = std::min(physicsAccumulator + deltaTime, 0.25f); // no catch-up spiral after a stall
+        while (physicsAccumulator >= physicsDt && !(replaying && physicsTick >= replay.ticks.size()))
+        {
+            physicsAccumulator -= physicsDt;
+            prevCarPos = carPos;
+            prevCarYaw = carYaw;
+
+            // accelerate / brake
+            float accelInput = 0.0f;
+            if (keys[GLFW_KEY_W]) accelInput += 1.0f;
+            if (keys[GLFW_KEY_S]) accelInput -= 1.0f;
+
+            // steering
+            float steerInput = 0.0f;
+            if (keys[GLFW_KEY_A]) steerInput += 1.0f;
+            if (keys[GLFW_KEY_D]) steerInput -= 1.0f;
+
+            if (replaying)
+            {
+                accelInput = replay.ticks[physicsTick].throttle;
+                steerInput = replay.ticks[physicsTick].steer;
+            }
+
+            // vehicle dynamics (S brakes, then reverses); the model proposes the motion,
+            // collision below decides how much of it happens
+            playerCar.throttle[0] = accelInput;
+            playerCar.steer[0] = steerInput;
+            playerCar.step(carParams, physicsDt);
+            carYaw = playerCar.yaw[0];
+
+            glm::mat3 carAxes = yawAxes(carYaw);
+            glm::vec3 carHalf = carSize * 0.5f;
+            glm::vec3 carExtent = glm::abs(carAxes[0]) * carHalf.x + glm::abs(carAxes[1]) * carHalf.y + glm::abs(carAxes[2]) * carHalf.z;
+            glm::vec3 boxOffset = carAxes * carCenter;
+
+            // static world: sweep the car's oriented box, stop just short of the first
+            // contact and slide along its surface with the rest of the motion. The world BVH
+            // and the road barriers only supply the boxes the yawed car's AABB passes over;
+            // each is then swept exactly against the oriented box, so a turned car still
+            // drives right up to a wall
+            glm::vec3 target = playerCar.position(0);
+            target.y = groundHeight(target);
+            glm::vec3 move = target - carPos;
+            glm::vec3 nextPos = carPos;
+            auto sweepStatic = [&](const glm::vec3& center, const glm::vec3& delta, BVHRayHit& hit) {
+                glm::vec3 lo = glm::min(center, center + delta) - carExtent, hi = glm::max(center, center + delta) + carExtent;
+                roads->overlap(lo, hi, sweepBoxes);
+                staticWorld.visitOverlap(lo, hi, [&](unsigned int p) { sweepBoxes.push_back(staticWorld.primitive(p)); return true; });
+                bool any = false;
+                for (const BVHBox& b : sweepBoxes)
+                {
+                    float t;
+                    glm::vec3 normal;
+                    if (sweepOBBAgainstBox(center, carHalf, carAxes, delta, b.min, b.max, t, normal) && (!any || t < hit.t))
+                    {
+                        hit.t = t;
+                        hit.normal = normal;
+                        any = true;
+                    }
+                }
+                return any;
+            };
+            for (int contact = 0; contact < MAX_SLIDES; contact++)
+            {
+                BVHRayHit hit;
+                // contacts we are moving away from (already touching) are skipped by the
+                // sweep itself, so the next wall along the move is still tested
+                if (!sweepStatic(nextPos + boxOffset, move, hit))
+                {
+                    nextPos += move;
+                    break;
+                }
+                float t = std::max(0.0f, hit.t - CONTACT_SKIN / glm::length(move));
+                nextPos += move * t;
+                move *= 1.0f - t;
+                move -= hit.normal * glm::dot(move, hit.normal);
+                // keep only the part of the velocity that runs along the surface
+                glm::vec3 velocity = playerCar.velocity(0);
+                playerCar.setVelocity(0, velocity - hit.normal * std::min(0.0f, glm::dot(velocity, hit.normal)));
+            }
+
+            // AI cars move first (in parallel), so the player tests against this tick's traffic
+            traffic.update(physicsDt);
+
+            // other moving bodies: discrete oriented-box test at the resolved position,
+            // confirmed against the car's triangles
+            narrowCar.clear();
+            narrowOther.clear();
+            broadphase.update(carBody, nextPos + boxOffset, carExtent * 2.0f);
+            broadphase.query(carBody, contacts);
+            for (unsigned int other : contacts)
+            {
+                narrowOther.push(broadphase.position(other), broadphase.size(other) * 0.5f, glm::mat3(1.0f));
+                narrowCar.push(nextPos + boxOffset, carHalf, carAxes);
+            }
+            narrowOut.resize(narrowOther.size());
+            batchOverlapOBB(narrowCar.batch(), narrowOther.batch(), narrowOther.size(), narrowOut.batch());
+            bool blocked = false;
+            glm::mat3 worldToBody = glm::transpose(carAxes);
+            for (size_t i = 0; i < narrowOther.size() && !blocked; i++)
+            {
+                if (narrowOut.depth[i] <= 0.0f) continue;
+                unsigned int other = contacts[i];
+                blocked = carCollider.triangleCount() == 0 ||
+                          carCollider.overlapBox(worldToBody * (broadphase.position(other) - nextPos), broadphase.size(other) * 0.5f, worldToBody);
+            }
+
+            if (!blocked) {
+                carPos = nextPos;
+            } else {
+                broadphase.update(carBody, carPos + boxOffset, carExtent * 2.0f);
+                playerCar.setVelocity(0, glm::vec3(0.0f));
+                playerCar.yawRate[0] = 0.0f;
+            }
+            // follow the ground; its slope feeds the next step
+            carPos.y = groundHeight(carPos);
+            playerCar.setPose(0, carPos, carYaw);
+            playerCar.setGround(0, groundNormal(carPos));
+
+            // state hash of this tick, for recordings and replays
+            StateHash hash;
+            hash.add(carPos);
+            hash.add(carYaw);
+            playerCar.hash(hash);
+            traffic.hash(hash);
+            if (!recordPath.empty()) recording.ticks.push_back({ accelInput, steerInput, hash.value });
+            if (replaying && firstMismatch < 0 && hash.value != replay.ticks[physicsTick].hash) firstMismatch = (long)physicsTick;
+            lastHash = hash;
+            physicsTick++;
         }
-        // clamp small speeds to zero
-        if (fabs(carSpeed) < 0.01f) carSpeed = 0.0f;
-        // clamp to max
-        if (carSpeed > MAX_SPEED) carSpeed = MAX_SPEED;
-        if (carSpeed < -MAX_SPEED * 0.5f) carSpeed = -MAX_SPEED * 0.5f; // slower reverse
 
-        // turning scales with speed (simple car feel)
-        float turnAmount = TURN_SPEED * (carSpeed >= 0 ? 1.0f : -1.0f) * deltaTime;
-        carYaw += steerInput * turnAmount;
+        // stream the world around the car, prefetching along its velocity
+        if (world) world->update(carPos, playerCar.velocity(0));
+        roads->update(carPos);
+
+        // render the car between the last two physics states
+        float alpha = physicsAccumulator / physicsDt;
+        glm::vec3 drawCarPos = glm::mix(prevCarPos, carPos, alpha);
+        float drawCarYaw = prevCarYaw + (carYaw - prevCarYaw) * alpha;
+        glm::vec3 forward = glm::vec3(sin(glm::radians(drawCarYaw)), 0.0f, cos(glm::radians(drawCarYaw)));
+
+        // ---- update camera: behind and above the car on a spring arm that a sphere cast
+        // through the static world (BVH and road barriers) shortens when something is in the way ----
+        glm::vec3 cameraTarget = drawCarPos + glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec3 desiredCameraPos = drawCarPos - forward * 8.0f + glm::vec3(0.0f, 3.0f, 0.0f);
+        desiredCameraPos.y = std::max(desiredCameraPos.y, groundHeight(desiredCameraPos) + 1.0f);   // stay above hills
+        auto armCast = [&](const glm::vec3& origin, const glm::vec3& dir, float maxT, float radius, BVHRayHit& hit) {
+            BVHRayHit barrier;
+            bool any = staticWorld.sphereCast(origin, dir, maxT, radius, hit);
+            if (roads->sphereCast(origin, dir, any ? hit.t : maxT, radius, barrier)) { hit = barrier; any = true; }
+            return any;
+        };
+        cameraPos = chaseCamera.update(cameraTarget, desiredCameraPos, deltaTime, armCast);
+        cameraPos.y = std::max(cameraPos.y, groundHeight(cameraPos) + 0.5f);
+
+        // ---- views: the player's, then one per extra split-screen player ----
+        FrameParams frame;
+        frame.views.resize(viewCount);
+        for (unsigned int v = 0; v < viewCount; v++)
+        {
+            ViewParams& vp = frame.views[v];
+            vp.rect = splitScreenRect(viewCount, v);
+            glm::vec3 eye = cameraPos, target = cameraTarget;
+            if (v > 0)
+            {
+                glm::vec3 subject = drawCarPos;
+                float yaw = drawCarYaw + 90.0f * v;
+                if (traffic.vehicleCount() > 0)
+                {
+                    size_t car = (v - 1) * traffic.vehicleCount() / (viewCount - 1);
+                    subject = traffic.position(car);
+                    yaw = traffic.yaw(car);
+                }
+                glm::vec3 dir(sin(glm::radians(yaw)), 0.0f, cos(glm::radians(yaw)));
+                target = subject + glm::vec3(0.0f, 1.0f, 0.0f);
+                glm::vec3 desired = subject - dir * 8.0f + glm::vec3(0.0f, 3.0f, 0.0f);
+                desired.y = std::max(desired.y, groundHeight(desired) + 1.0f);
+                if (!viewCamerasPlaced) viewCameras[v].reset(desired);
+                eye = viewCameras[v].update(target, desired, deltaTime, armCast);
+                eye.y = std::max(eye.y, groundHeight(eye) + 0.5f);
+            }
+            vp.viewPos = eye;
+            vp.view = glm::lookAt(eye, target, cameraUp);
+            // reversed-Z with no far plane: the view reaches the horizon without z-fighting
+            vp.projection = reversedZPerspective(glm::radians(45.0f), (SCR_WIDTH * vp.rect.z) / (SCR_HEIGHT * vp.rect.w), 0.1f);
+        }
+        viewCamerasPlaced = true;
+        // mirrored views next, culled against their oblique near plane like any other
+        if (planarEnabled) planarReflection.addViews(frame.views, viewCount);
+        // the probe faces are views too, after the screen ones; the player's car stays out of them
+        uint32_t probeViews = probeEnabled ? probe.addViews(frame.views, drawCarPos + glm::vec3(0.0f, 0.8f, 0.0f)) : 0u;
+        // sub-pixel jitter of the screen views, in pixels of the scene target
+        if (postSettings.hdr)
+        {
+            int fbWidth = SCR_WIDTH, fbHeight = SCR_HEIGHT;
+            if (window) glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
+            temporalAA.apply(frame, (int)(fbWidth * taaSettings.renderScale + 0.5f), (int)(fbHeight * taaSettings.renderScale + 0.5f));
+        }
 
-        // update car position
-        glm::vec3 forward = glm::vec3(sin(glm::radians(carYaw)), 0.0f, cos(glm::radians(carYaw)));
-        // carPos += forward * carSpeed * deltaTime;
-        glm::vec3 nextPos = carPos + forward * carSpeed * deltaTime;
-
-        // check wall collision
-        if (!checkCollision(nextPos, carSize, wallPos, wallSize)) {
-            carPos = nextPos; // safe to move
-        } else {
-            // simple reaction: stop movement
-            carSpeed = 0.0f;
-            
-            // optional: slide along wall
-            // carPos += glm::vec3(0.0f, 0.0f, 0.0f); // or adjust direction
+        // ---- render ----
+        frame.lightPos = lightPos;
+        frame.clearColor = glm::vec3(0.05f, 0.05f, 0.07f);
+        renderer->beginFrame(frame);
+
+        drawList.clear();
+        // 1) ground: clipmap levels around each view's camera or streamed chunks (textured)
+        if (clipmap) clipmap->draw(drawList, frame.views, floorTex);
+        else world->draw(drawList, floorTex);
+        for (DrawItem& item : drawList) item.lightmapChart = lightmap.groundChart;
+        roads->draw(drawList, floorTex);
+
+        // 2) car model
+        glm::mat4 carModelMat = glm::mat4(1.0f);
+        carModelMat = glm::translate(carModelMat, drawCarPos);
+        carModelMat = carModelMat * groundTilt(groundNormal(drawCarPos));
+        carModelMat = glm::rotate(carModelMat, glm::radians(drawCarYaw), glm::vec3(0,1,0));
+        carModelMat = carModelMat * carModelToBody();
+        DrawItem playerCarItem = { carMesh, Material::Car, carModelMat, 0 };
+        playerCarItem.viewMask = ~probeViews;
+        // last frame's pose gives the motion vectors (see taa.h); the first frame has none
+        if (prevCarModelMat[3][3] != 0.0f) playerCarItem.prevModel = prevCarModelMat;
+        prevCarModelMat = carModelMat;
+        // baked light where the car stands: eight probes blended, per car per frame
+        playerCarItem.hasLightProbe = lightProbes.valid();
+        if (playerCarItem.hasLightProbe) playerCarItem.lightProbe = lightProbes.sample(drawCarPos);
+        drawList.push_back(playerCarItem);
+
+        // 2b) AI traffic, same model; a car spawned since last frame has no previous pose
+        bool trafficHistory = prevTrafficModels.size() == traffic.vehicleCount();
+        prevTrafficModels.resize(traffic.vehicleCount());
+        for (size_t i = 0; i < traffic.vehicleCount(); i++)
+        {
+            glm::mat4 m = glm::translate(glm::mat4(1.0f), traffic.position(i)) * groundTilt(traffic.normal(i));
+            m = glm::rotate(m, glm::radians(traffic.yaw(i)), glm::vec3(0, 1, 0));
+            DrawItem car = { carMesh, Material::Car, m * carModelToBody(), 0 };
+            if (trafficHistory) car.prevModel = prevTrafficModels[i];
+            prevTrafficModels[i] = car.model;
+            car.hasLightProbe = lightProbes.valid();
+            if (car.hasLightProbe) car.lightProbe = lightProbes.sample(traffic.position(i));
+            drawList.push_back(car);
         }
 
+        // 3) level geometry; the skybox is drawn last by the backend
+        for (size_t i = 0; i < level.instances().size(); i++)
+        {
+            const LevelInstance& inst = level.instances()[i];
+            DrawItem item = { levelMeshes[inst.geometry], (Material)inst.material, levelModelMatrix(inst), levelTextures[inst.geometry] };
+            if (i < lightmap.instanceCharts.size()) item.lightmapChart = lightmap.instanceCharts[i];
+            drawList.push_back(item);
+        }
 
-        // ---- update camera: place behind car and lerp for smoothing ----
-        glm::vec3 desiredCameraPos = carPos - forward * 8.0f + glm::vec3(0.0f, 3.0f, 0.0f);
-        // smooth interpolate
-        cameraPos = glm::mix(cameraPos, desiredCameraPos, glm::clamp(cameraSmoothSpeed * deltaTime, 0.0f, 1.0f));
-        glm::vec3 cameraTarget = carPos + glm::vec3(0.0f, 1.0f, 0.0f);
-        glm::mat4 view = glm::lookAt(cameraPos, cameraTarget, cameraUp);
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 200.0f);
+        // 4) decide which views see each item, once for all of them (see culling.h)
+        culler.cull(drawList, frame.views, [&](unsigned int mesh, glm::vec3& lo, glm::vec3& hi) { return renderer->meshBounds(mesh, lo, hi); });
+
+        renderer->submit(drawList);
+        renderer->endFrame();
+        RendererStats rs = renderer->stats();
+        submitMsTotal += rs.submitCpuMs;
+        for (unsigned int v = 0; v < rs.viewCount; v++) viewSubmitMsTotal[v] += rs.viewCpuMs[v];
+        if (probeEnabled) probe.record(rs);
+        if (planarEnabled) planarReflection.record(rs);
+        if (postBudget.update(rs)) renderer->setPostProcess(postBudget.settings());
+        temporalAA.record(rs);
+        if (aoProfile.update(rs)) renderer->setAmbientOcclusion(aoProfile.settings());
+        frameCount++;
+
+        // poll; GL work queued by jobs runs here
+        if (window) glfwPollEvents();
+        jobSystem().pumpMainThread();
+    }
 
-        // ---- render ----
-        glClearColor(0.05f, 0.05f, 0.07f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // 1) draw floor (textured)
-        floorShader.use();
-        glm::mat4 floorModel = glm::mat4(1.0f);
-        floorShader.setMat4("projection", projection);
-        floorShader.setMat4("view", view);
-        floorShader.setMat4("model", floorModel);
-        floorShader.setVec3("lightPos", lightPos);
-        floorShader.setVec3("viewPos", cameraPos);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, floorTex);
-        floorShader.setInt("floorTexture", 0);
-
-        glBindVertexArray(floorVAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // 2) draw car model
-        modelShader.use();
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", view);
-        glm::mat4 carModelMat = glm::mat4(1.0f);
-        carModelMat = glm::translate(carModelMat, carPos + glm::vec3(0.0f, 0.1f, 0.0f)); // small lift
-        carModelMat = glm::rotate(carModelMat, glm::radians(90.0f), glm::vec3(0, 1, 0));
-        carModelMat = glm::rotate(carModelMat, glm::radians(carYaw), glm::vec3(0,1,0));
-        carModelMat = glm::scale(carModelMat, glm::vec3(0.6f)); // adjust to taste
-        modelShader.setMat4("model", carModelMat);
-        // if your model shader needs camera pos or lights, set them here:
-        modelShader.setVec3("viewPos", cameraPos);
-        modelShader.setVec3("lightPos", lightPos);
-        carModel.Draw(modelShader);
-
-        // 3) draw skybox (last)
-        glDepthFunc(GL_LEQUAL);
-        skyboxShader.use();
-        // remove translation from the view matrix
-        glm::mat4 skyView = glm::mat4(glm::mat3(view));
-        skyboxShader.setMat4("view", skyView);
-        skyboxShader.setMat4("projection", projection);
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glDepthFunc(GL_LESS);
-
-        // 1.5) draw wall
-        floorShader.use();
-        glm::mat4 wallModel = glm::mat4(1.0f);
-        floorShader.setMat4("projection", projection);
-        floorShader.setMat4("view", view);
-        floorShader.setMat4("model", wallModel);
-        floorShader.setVec3("lightPos", lightPos);
-        floorShader.setVec3("viewPos", cameraPos);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, floorTex); // reuse floor texture for simplicity
-        floorShader.setInt("floorTexture", 0);
-
-        glBindVertexArray(wallVAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-
-        // swap and poll
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    if (frameCount > 0)
+        std::cout << renderer->name() << ": average CPU submission " << submitMsTotal / frameCount
+                  << " ms/frame over " << frameCount << " frames (" << renderer->stats().drawCalls << " draws)\n";
+    if (frameCount > 0)
+    {
+        for (unsigned int v = 0; v < viewCount && viewCount > 1; v++)
+            std::cout << "  view " << v << ": " << viewSubmitMsTotal[v] / frameCount << " ms/frame submission ("
+                      << renderer->stats().viewDrawCalls[v] << " draws)\n";
+        culler.printStats(std::cout);
+        if (probeEnabled) probe.printStats(std::cout, reflections.probeSize);
+        if (planarEnabled) planarReflection.printStats(std::cout);
+        postBudget.printStats(std::cout);
+        temporalAA.printStats(std::cout);
+        aoProfile.printStats(std::cout);
+        if (world) world->printStats(std::cout);
+        roads->printStats(std::cout);
+        chaseCamera.printStats(std::cout);
+        jobSystem().printStats(std::cout);
     }
 
-    // cleanup (optional)
-    glDeleteVertexArrays(1, &floorVAO);
-    glDeleteBuffers(1, &floorVBO);
-    glDeleteBuffers(1, &floorEBO);
-    glDeleteVertexArrays(1, &skyboxVAO);
-    glDeleteBuffers(1, &skyboxVBO);
+    if (deterministicPhysics())
+        std::cout << "physics: " << physicsTick << " ticks, final state hash " << std::hex << lastHash.value << std::dec << "\n";
+    if (!recordPath.empty())
+    {
+        if (recording.save(recordPath)) std::cout << "recorded " << recording.ticks.size() << " ticks to " << recordPath << "\n";
+        else std::cerr << "Failed to write recording: " << recordPath << "\n";
+    }
+    if (replaying)
+    {
+        if (firstMismatch >= 0) std::cout << "replay: diverged at tick " << firstMismatch << " of " << replay.ticks.size() << "\n";
+        else if (physicsTick < replay.ticks.size()) std::cout << "replay: stopped after " << physicsTick << " of " << replay.ticks.size() << " ticks, all matched\n";
+        else std::cout << "replay: all " << physicsTick << " ticks matched\n";
+    }
 
+    // cleanup
+    roads.reset();
+    clipmap.reset();
+    world.reset();
+    renderer = nullptr;
+    backend.reset();
     glfwTerminate();
     return 0;
 }
@@ -388,78 +839,15 @@ int main()
 // ----- callbacks and helpers -----
 void framebuffer_size_callback(GLFWwindow* /*window*/, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    if (renderer) renderer->resize(width, height);
 }
 
-void key_callback(GLFWwindow* /*window*/, int key, int /*scancode*/, int action, int /*mods*/)
+void key_callback(GLFWwindow* window, int key, int /*scancode*/, int action, int /*mods*/)
 {
-    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) glfwSetWindowShouldClose(glfwGetCurrentContext(), true);
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) glfwSetWindowShouldClose(window, true);
     if (key >= 0 && key < 1024)
     {
         if (action == GLFW_PRESS) keys[key] = true;
         else if (action == GLFW_RELEASE) keys[key] = false;
     }
 }
-
-unsigned int loadTexture(const char *path)
-{
-    stbi_set_flip_vertically_on_load(true);
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format = (nrComponents == 1) ? GL_RED : (nrComponents == 3) ? GL_RGB : GL_RGBA;
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        // texture params
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Failed to load texture at path: " << path << std::endl;
-        stbi_image_free(data);
-        return 0;
-    }
-    return textureID;
-}
-
-unsigned int loadCubemap(std::vector<std::string> faces)
-{
-    stbi_set_flip_vertically_on_load(false); // cubemaps usually not flipped
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            GLenum format = (nrChannels == 3) ? GL_RGB : GL_RGBA;
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
-}
@@ -0,0 +1,295 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+// Frustum culling for one or more views (split-screen) over a single draw list.
+//
+// The draw list is built once per frame and shared by every view; culling decides,
+// per item, which views draw it (DrawItem::viewMask) and drops items no view sees. The
+// mask an item comes in with limits the views it may appear in (e.g. the car is kept
+// out of its own reflection probe).
+// The work is split so that nothing is done once per view that could be done once:
+//
+// - shared: each item's world box is computed once (mesh bounds from the renderer,
+//   transformed by the model matrix), then tested against the union frustum: the
+//   planes of any view that every other view's frustum lies behind as well. A box
+//   outside one of those is outside all views and costs one test instead of one per
+//   view. With one view the union is that view's frustum and this is the whole cull.
+// - per view: the survivors are tested against each view's 5 planes in one tight loop
+//   over the packed boxes (centre/extent arrays), setting that view's bit.
+//
+// Frustums are taken from the reversed-Z projection (reversedZPerspective()): left,
+// right, bottom, top and near; with no far plane there is nothing to cull behind. The
+// near plane may be oblique (planar reflections clip at the mirror, see
+// planar_reflection.h), in which case everything behind the mirror is culled too.
+// Terrain items keep their mask: their height comes from the heightmap in the vertex
+// shader, so their mesh bounds are flat (TerrainClipmap already draws per view).
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// inside where dot(plane.xyz, p) + plane.w >= 0
+struct Frustum
+{
+    glm::vec4 planes[5];
+    glm::vec3 eye;
+    glm::vec3 nearCorners[4];
+    bool bounded = true;    // false when the near plane is oblique enough that some corner ray never meets it
+};
+
+inline Frustum viewFrustum(const ViewParams& view)
+{
+    Frustum f;
+    glm::mat4 m = view.projection * view.view;
+    glm::vec4 row[4];
+    for (int r = 0; r < 4; r++) row[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+    glm::vec4 planes[5] = { row[3] + row[0], row[3] - row[0], row[3] + row[1], row[3] - row[1], row[3] - row[2] };
+    for (int p = 0; p < 5; p++) f.planes[p] = planes[p] / glm::length(glm::vec3(planes[p]));
+
+    f.eye = view.viewPos;
+    glm::mat4 inv = glm::inverse(m);
+    for (int c = 0; c < 4; c++)
+    {
+        glm::vec4 h = inv * glm::vec4((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, 1.0f, 1.0f);
+        if (h.w <= 1e-12f) { f.bounded = false; h.w = 1.0f; }
+        f.nearCorners[c] = glm::vec3(h) / h.w;
+    }
+    return f;
+}
+
+// the frustum is the near quad swept away from the eye, so it lies inside a plane when
+// the near corners do and the edges running out from them never cross it
+inline bool frustumInside(const Frustum& f, const glm::vec4& plane)
+{
+    if (!f.bounded) return false;   // can't tell; not sharing the plane is always safe
+    glm::vec3 n(plane);
+    for (const glm::vec3& c : f.nearCorners)
+        if (glm::dot(n, c) + plane.w < -1e-4f || glm::dot(n, c - f.eye) < -1e-6f) return false;
+    return true;
+}
+
+// planes every frustum is inside of; a box outside any of them is outside all views
+inline std::vector<glm::vec4> unionPlanes(const std::vector<Frustum>& frustums)
+{
+    std::vector<glm::vec4> planes;
+    for (size_t a = 0; a < frustums.size(); a++)
+        for (const glm::vec4& plane : frustums[a].planes)
+        {
+            bool shared = true;
+            for (size_t b = 0; b < frustums.size() && shared; b++)
+                shared = b == a || frustumInside(frustums[b], plane);
+            if (shared) planes.push_back(plane);
+        }
+    return planes;
+}
+
+inline bool boxOutside(const glm::vec4& plane, const glm::vec3& centre, const glm::vec3& extent)
+{
+    return glm::dot(glm::vec3(plane), centre) + plane.w + glm::dot(glm::abs(glm::vec3(plane)), extent) < 0.0f;
+}
+
+struct CullStats
+{
+    uint64_t frames = 0, items = 0, unionRejected = 0;
+    unsigned int viewCount = 0;
+    double sharedMs = 0.0, viewMs[MAX_VIEWS] = {};
+    uint64_t visible[MAX_VIEWS] = {};
+};
+
+class ViewCuller
+{
+public:
+    // bounds(mesh, min, max) -> bool: mesh-space box, e.g. Renderer::meshBounds.
+    // Items without bounds are kept for every view.
+    template <typename Bounds>
+    void cull(std::vector<DrawItem>& items, const std::vector<ViewParams>& views, Bounds bounds)
+    {
+        typedef std::chrono::high_resolution_clock Clock;
+        auto t0 = Clock::now();
+        unsigned int viewCount = (unsigned int)std::min<size_t>(views.size(), MAX_VIEWS);
+        frustums.clear();
+        for (unsigned int v = 0; v < viewCount; v++) frustums.push_back(viewFrustum(views[v]));
+        std::vector<glm::vec4> shared = unionPlanes(frustums);
+        uint32_t allViews = viewCount >= 32 ? ~0u : (1u << viewCount) - 1u;
+
+        // shared: world boxes once per item, union frustum test, pack the survivors
+        clearPacked();
+        size_t total = items.size(), rejected = 0;
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            DrawItem& item = items[i];
+            glm::vec3 lo, hi;
+            if (item.material == Material::Terrain || !bounds(item.mesh, lo, hi))
+            {
+                item.viewMask &= allViews;
+                continue;
+            }
+            glm::vec3 centre = glm::vec3(item.model * glm::vec4((lo + hi) * 0.5f, 1.0f));
+            glm::mat3 axes(item.model);
+            glm::vec3 half = (hi - lo) * 0.5f;
+            glm::vec3 extent = glm::abs(axes[0]) * half.x + glm::abs(axes[1]) * half.y + glm::abs(axes[2]) * half.z;
+            bool outside = false;
+            for (const glm::vec4& plane : shared)
+                if (boxOutside(plane, centre, extent)) { outside = true; break; }
+            uint32_t allowed = item.viewMask & allViews;
+            item.viewMask = 0;
+            if (outside) { rejected++; continue; }
+            if (viewCount == 1) { item.viewMask = allowed; counters.visible[0] += allowed; continue; }   // the union is the view: done
+            pack(i, centre, extent, allowed);
+        }
+        auto t1 = Clock::now();
+        counters.sharedMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+        // per view: 5 planes against every packed box
+        for (unsigned int v = 0; v < viewCount; v++)
+        {
+            auto tv = Clock::now();
+            uint32_t bit = 1u << v;
+            uint64_t seen = 0;
+            const glm::vec4* planes = frustums[v].planes;
+            for (size_t k = 0; k < index.size(); k++)
+            {
+                bool inside = true;
+                for (int p = 0; p < 5; p++)
+                {
+                    const glm::vec4& pl = planes[p];
+                    float d = pl.x * cx[k] + pl.y * cy[k] + pl.z * cz[k] + pl.w
+                            + std::fabs(pl.x) * ex[k] + std::fabs(pl.y) * ey[k] + std::fabs(pl.z) * ez[k];
+                    inside &= d >= 0.0f;
+                }
+                if (inside && (allowed[k] & bit)) { items[index[k]].viewMask |= bit; seen++; }
+            }
+            counters.visible[v] += seen;
+            counters.viewMs[v] += std::chrono::duration<double, std::milli>(Clock::now() - tv).count();
+        }
+
+        // drop what no view sees, keeping the list's order
+        items.erase(std::remove_if(items.begin(), items.end(), [](const DrawItem& item) { return item.viewMask == 0; }), items.end());
+        counters.frames++;
+        counters.items += total;
+        counters.unionRejected += rejected;
+        counters.viewCount = viewCount;
+    }
+
+    const CullStats& stats() const { return counters; }
+
+    void printStats(std::ostream& out) const
+    {
+        if (!counters.frames) return;
+        double frames = (double)counters.frames;
+        out << "culling: " << counters.viewCount << " view(s), shared " << counters.sharedMs / frames << " ms/frame for "
+            << counters.items / counters.frames << " boxes (" << 100.0 * counters.unionRejected / std::max<uint64_t>(1, counters.items)
+            << "% out of every view)\n";
+        for (unsigned int v = 0; v < counters.viewCount; v++)
+            out << "  view " << v << ": " << counters.viewMs[v] / frames << " ms/frame, " << counters.visible[v] / counters.frames << " visible\n";
+    }
+
+private:
+    std::vector<Frustum> frustums;
+    std::vector<float> cx, cy, cz, ex, ey, ez;
+    std::vector<size_t> index;
+    std::vector<uint32_t> allowed;
+    CullStats counters;
+
+    void clearPacked()
+    {
+        for (std::vector<float>* v : { &cx, &cy, &cz, &ex, &ey, &ez }) v->clear();
+        index.clear();
+        allowed.clear();
+    }
+
+    void pack(size_t item, const glm::vec3& centre, const glm::vec3& extent, uint32_t mask)
+    {
+        allowed.push_back(mask);
+        cx.push_back(centre.x); cy.push_back(centre.y); cz.push_back(centre.z);
+        ex.push_back(extent.x); ey.push_back(extent.y); ez.push_back(extent.z);
+        index.push_back(item);
+    }
+};
+
+// ---- benchmark: joint culling vs culling each view on its own ----
+// 20k unit boxes under random yawed and scaled transforms on a 1 km square; 1-4 chase
+// cameras a few car lengths apart (split-screen racing). "separate" is what running the
+// single-view cull once per view costs: bounds and 5 planes per item per view.
+inline void runViewsBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const int ITEMS = 20000, RUNS = 50;
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> coord(-500.0f, 500.0f), angle(0.0f, 6.2831853f), size(0.5f, 4.0f);
+    std::vector<DrawItem> source(ITEMS);
+    for (DrawItem& item : source)
+    {
+        glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(coord(rng), 0.0f, coord(rng)));
+        m = glm::rotate(m, angle(rng), glm::vec3(0.0f, 1.0f, 0.0f));
+        item = { 0, Material::Floor, glm::scale(m, glm::vec3(size(rng))), 0 };
+    }
+    auto unitBox = [](unsigned int, glm::vec3& lo, glm::vec3& hi) { lo = glm::vec3(-0.5f); hi = glm::vec3(0.5f); return true; };
+
+    std::cout << "views" << std::setw(14) << "separate ms" << std::setw(12) << "joint ms" << std::setw(14) << "per view ms"
+              << std::setw(12) << "union rej%" << std::setw(12) << "visible" << "\n";
+    for (unsigned int n = 1; n <= MAX_SCREEN_VIEWS; n++)
+    {
+        std::vector<ViewParams> views(n);
+        for (unsigned int v = 0; v < n; v++)
+        {
+            glm::vec3 car(6.0f * v, 0.0f, 10.0f * v), forward(std::sin(0.2f * v), 0.0f, std::cos(0.2f * v));
+            views[v].viewPos = car - forward * 8.0f + glm::vec3(0.0f, 3.0f, 0.0f);
+            views[v].view = glm::lookAt(views[v].viewPos, car + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            views[v].rect = splitScreenRect(n, v);
+            views[v].projection = reversedZPerspective(glm::radians(45.0f), (16.0f * views[v].rect.z) / (9.0f * views[v].rect.w), 0.1f);
+        }
+
+        // separate: a full single-view cull per view
+        std::vector<Frustum> frustums;
+        for (const ViewParams& v : views) frustums.push_back(viewFrustum(v));
+        size_t separateVisible = 0;
+        auto t0 = Clock::now();
+        for (int run = 0; run < RUNS; run++)
+            for (const Frustum& f : frustums)
+                for (const DrawItem& item : source)
+                {
+                    glm::vec3 lo, hi;
+                    unitBox(item.mesh, lo, hi);
+                    glm::vec3 centre = glm::vec3(item.model * glm::vec4((lo + hi) * 0.5f, 1.0f));
+                    glm::mat3 axes(item.model);
+                    glm::vec3 half = (hi - lo) * 0.5f;
+                    glm::vec3 extent = glm::abs(axes[0]) * half.x + glm::abs(axes[1]) * half.y + glm::abs(axes[2]) * half.z;
+                    bool outside = false;
+                    for (const glm::vec4& plane : f.planes) outside = outside || boxOutside(plane, centre, extent);
+                    separateVisible += !outside;
+                }
+        double separateMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count() / RUNS;
+
+        ViewCuller culler;
+        std::vector<DrawItem> items;
+        double jointMs = 0.0;
+        for (int run = 0; run < RUNS; run++)
+        {
+            items = source;
+            auto tj = Clock::now();
+            culler.cull(items, views, unitBox);
+            jointMs += std::chrono::duration<double, std::milli>(Clock::now() - tj).count();
+        }
+        jointMs /= RUNS;
+        const CullStats& s = culler.stats();
+        double perView = 0.0;
+        uint64_t visible = 0;
+        for (unsigned int v = 0; v < n; v++) { perView += s.viewMs[v] / RUNS; visible += s.visible[v] / RUNS; }
+        if (visible != separateVisible / RUNS) std::cout << "  (mismatch: separate saw " << separateVisible / RUNS << ")\n";
+        std::cout << std::setw(5) << n << std::setw(14) << separateMs << std::setw(12) << jointMs << std::setw(14) << perView / n
+                  << std::setw(12) << 100.0 * s.unionRejected / s.items << std::setw(12) << visible << "\n";
+    }
+}
+
+#endif
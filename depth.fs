@@ -0,0 +1,6 @@
+#version 330 core
+
+// depth only (ssao.h): the rasterizer writes it, there is no colour target
+void main()
+{
+}
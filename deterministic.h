@@ -0,0 +1,228 @@
+#ifndef DETERMINISTIC_H
+#define DETERMINISTIC_H
+
+// Deterministic physics: the pieces that make a recorded run replay bit-exactly on
+// another machine or build.
+//
+//  - Table trig. Library sin/cos/atan differ between libm versions, so physics code
+//    uses tableSin/tableCos/tableAtan/tableAtan2 instead: tables built from series in
+//    plain double arithmetic, read with linear interpolation (error < 1e-6 within a
+//    turn of zero; the phase of larger angles loses float precision, deterministically).
+//  - No FMA contraction. Fusing a*b+c changes rounding, and whether the compiler does
+//    it depends on flags and target. The scalar and SSE2 narrowphase and vehicle
+//    kernels and these tables are compiled with fp-contract off; in deterministic mode
+//    the dispatchers (physicsSimdLevel) never go wider than SSE2, which every x86-64
+//    CPU has. The rest of the physics step (collision response, traffic control) is
+//    ordinary code, so builds meant to replay each other's recordings also need
+//    -ffp-contract=off and no -ffast-math.
+//  - StateHash: FNV-1a over the bit patterns of the simulation state, taken every tick;
+//    PhysicsRecording stores the inputs and hash of each tick so a replay can report the
+//    first tick that diverged.
+
+#include <glm/glm.hpp>
+
+#include "file_io.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// on: physics picks only the strict kernels (see above)
+inline bool& deterministicPhysics()
+{
+    static bool enabled = false;
+    return enabled;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+struct TrigTables
+{
+    static const int SIN_SIZE = 4096;    // entries per turn (power of two)
+    static const int ATAN_SIZE = 1024;   // entries over [0, 1]
+    float sine[SIN_SIZE + 1];
+    float atan[ATAN_SIZE + 1];
+
+    TrigTables()
+    {
+        const double halfPi = 1.57079632679489661923;
+        for (int i = 0; i <= SIN_SIZE; i++)
+        {
+            // reduce to a quarter turn so the series converges fast; only +, *, / are used
+            int quadrant = (i / (SIN_SIZE / 4)) & 3;
+            double x = (i % (SIN_SIZE / 4)) * (4.0 * halfPi / SIN_SIZE);
+            double s = series(x, false), c = series(x, true);
+            double v = quadrant == 0 ? s : quadrant == 1 ? c : quadrant == 2 ? -s : -c;
+            sine[i] = (float)v;
+        }
+        for (int i = 0; i <= ATAN_SIZE; i++)
+        {
+            // atan t = 2 atan(t / (1 + sqrt(1 + t^2))) brings t below tan(pi/8)
+            double t = (double)i / ATAN_SIZE;
+            double u = t / (1.0 + std::sqrt(1.0 + t * t));
+            double term = u, sum = 0.0;
+            for (int k = 0; k < 40; k++)
+            {
+                sum += term / (2 * k + 1);
+                term *= -u * u;
+            }
+            atan[i] = (float)(2.0 * sum);
+        }
+    }
+
+    // Taylor series of sin (cosine = false) or cos on [0, pi/2]
+    static double series(double x, bool cosine)
+    {
+        double term = cosine ? 1.0 : x, sum = 0.0;
+        for (int n = cosine ? 0 : 1; n < 30; n += 2)
+        {
+            sum += term;
+            term *= -x * x / ((n + 1) * (n + 2));
+        }
+        return sum;
+    }
+};
+
+inline const TrigTables& trigTables()
+{
+    static const TrigTables tables;
+    return tables;
+}
+
+inline float tableSin(float radians)
+{
+    const TrigTables& t = trigTables();
+    float x = radians * (TrigTables::SIN_SIZE / 6.28318530718f);
+    float k = std::floor(x);
+    int i = (int)((int64_t)k & (TrigTables::SIN_SIZE - 1));
+    float f = x - k;
+    return t.sine[i] + (t.sine[i + 1] - t.sine[i]) * f;
+}
+
+inline float tableCos(float radians)
+{
+    return tableSin(radians + 1.57079632679f);
+}
+
+inline float tableAtan(float x)
+{
+    const TrigTables& t = trigTables();
+    float ax = std::fabs(x);
+    bool folded = ax > 1.0f;
+    float u = (folded ? 1.0f / ax : ax) * TrigTables::ATAN_SIZE;
+    int i = std::min((int)u, TrigTables::ATAN_SIZE - 1);
+    float a = t.atan[i] + (t.atan[i + 1] - t.atan[i]) * (u - (float)i);
+    if (folded) a = 1.57079632679f - a;
+    return x < 0.0f ? -a : a;
+}
+
+// same quadrant conventions as std::atan2
+inline float tableAtan2(float y, float x)
+{
+    float ax = std::fabs(x), ay = std::fabs(y);
+    if (ax == 0.0f && ay == 0.0f) return 0.0f;
+    float a = ay <= ax ? tableAtan(ay / ax) : 1.57079632679f - tableAtan(ax / ay);
+    if (x < 0.0f) a = 3.14159265359f - a;
+    return y < 0.0f ? -a : a;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+// ---- per-tick state hash ----
+
+struct StateHash
+{
+    uint64_t value = 1469598103934665603ull;   // FNV-1a offset basis
+
+    void add(uint32_t bits)
+    {
+        for (int b = 0; b < 4; b++)
+        {
+            value ^= (bits >> (8 * b)) & 0xFF;
+            value *= 1099511628211ull;
+        }
+    }
+    void add(float f)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        add(bits);
+    }
+    void add(const glm::vec3& v) { add(v.x); add(v.y); add(v.z); }
+    void add(const std::vector<float>& values) { for (float f : values) add(f); }
+    void add(const std::vector<uint32_t>& values) { for (uint32_t u : values) add(u); }
+};
+
+// ---- recorded runs: settings, then inputs and state hash per physics tick ----
+
+struct PhysicsRecording
+{
+    struct Tick
+    {
+        float throttle, steer;
+        uint64_t hash;
+    };
+
+    float physicsDt = 1.0f / 60.0f;
+    uint32_t trafficCars = 0;
+    uint32_t flatGround = 0;    // 1: --flat, otherwise the heightfield terrain
+    uint64_t levelHash = 0;     // Level::contentHash() of the level played
+    std::vector<Tick> ticks;
+
+    bool save(const std::string& path) const
+    {
+        uint32_t count = (uint32_t)ticks.size();
+        std::vector<uint8_t> bytes;
+        bytes.reserve(4 + sizeof(float) + 3 * sizeof(uint32_t) + sizeof(uint64_t) + ticks.size() * sizeof(Tick));
+        appendBytes(bytes, MAGIC, 4);
+        appendBytes(bytes, &physicsDt, sizeof(physicsDt));
+        appendBytes(bytes, &trafficCars, sizeof(trafficCars));
+        appendBytes(bytes, &flatGround, sizeof(flatGround));
+        appendBytes(bytes, &levelHash, sizeof(levelHash));
+        appendBytes(bytes, &count, sizeof(count));
+        appendBytes(bytes, ticks.data(), ticks.size() * sizeof(Tick));
+        return writeFileAtomically(path, bytes);
+    }
+
+    bool load(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        char magic[4];
+        uint32_t count = 0;
+        if (!in.read(magic, 4) || std::memcmp(magic, MAGIC, 4) != 0) return false;
+        if (!in.read((char*)&physicsDt, sizeof(physicsDt)) || !in.read((char*)&trafficCars, sizeof(trafficCars)) ||
+            !in.read((char*)&flatGround, sizeof(flatGround)) || !in.read((char*)&levelHash, sizeof(levelHash)) ||
+            !in.read((char*)&count, sizeof(count)))
+            return false;
+        // the tick length drives the fixed-step accumulator: zero would never advance it
+        if (!std::isfinite(physicsDt) || physicsDt <= 0.0f || flatGround > 1) return false;
+        // the ticks must be exactly the rest of the file before any are allocated
+        std::streamoff header = in.tellg();
+        in.seekg(0, std::ios::end);
+        std::streamoff rest = in.tellg() - header;
+        in.seekg(header);
+        if (!in || rest < 0 || (uint64_t)count * sizeof(Tick) != (uint64_t)rest) return false;
+        ticks.resize(count);
+        in.read((char*)ticks.data(), (std::streamsize)(ticks.size() * sizeof(Tick)));
+        if (!in)
+        {
+            ticks.clear();
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static constexpr const char* MAGIC = "PRC3";
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+// Replacing files that other readers may open at any moment (level files, on-disk caches).
+//
+// writeFileAtomically writes the bytes to a temporary file next to the target and renames
+// it over the target, so a reader sees the old file or the new one, never half of one. The
+// temporary name is unique per process and per write: two builds of the same cache file
+// (one process rebuilding it, or two copies of the game starting at once) each write
+// their own, and the last rename wins. A failed write removes its temporary file.
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+inline std::string uniqueTempPath(const std::string& path)
+{
+    static std::atomic<uint64_t> count{ 0 };
+#ifdef _WIN32
+    unsigned long pid = (unsigned long)GetCurrentProcessId();
+#else
+    unsigned long pid = (unsigned long)getpid();
+#endif
+    return path + "." + std::to_string(pid) + "." + std::to_string(count++) + ".tmp";
+}
+
+inline bool writeFileAtomically(const std::string& path, const std::vector<uint8_t>& bytes, std::string* error = nullptr)
+{
+    std::string tmp = uniqueTempPath(path);
+    std::error_code ec;
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        out.write((const char*)bytes.data(), (std::streamsize)bytes.size());
+        out.close();    // the last flush can fail too (disk full), so check after it
+        if (!out)
+        {
+            std::filesystem::remove(tmp, ec);
+            if (error) *error = "cannot write " + tmp;
+            return false;
+        }
+    }
+    std::filesystem::rename(tmp, path, ec);
+    if (ec)
+    {
+        if (error) *error = "cannot replace " + path + ": " + ec.message();
+        std::error_code removeError;
+        std::filesystem::remove(tmp, removeError);
+        return false;
+    }
+    return true;
+}
+
+// appends the raw bytes of size bytes at data, for building a file to write in one go
+inline void appendBytes(std::vector<uint8_t>& bytes, const void* data, size_t size)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    bytes.insert(bytes.end(), p, p + size);
+}
+
+#endif
@@ -1,35 +1,107 @@
 #version 330 core
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec2 Velocity;    // motion vectors (taa.h); dropped by targets without them
 
 in vec2 TexCoord;
 in vec3 Normal;
 in vec3 FragPos;
+in vec4 CurrClip;   // unjittered, this frame and last
+in vec4 PrevClip;
 
 uniform sampler2D floorTexture;
 uniform vec3 lightPos;
 uniform vec3 viewPos;
+uniform bool environmentLighting;   // ambient from the skybox's irradiance (ibl.h)
+uniform vec3 sh[9];
+uniform float lodBias;              // coarser texture reads in reflection views
+uniform sampler2D planarReflection; // the scene mirrored in y = planarHeight, screen-aligned (planar_reflection.h)
+uniform float planarStrength;       // 0: not in this view
+uniform float planarHeight;
+uniform vec2 targetSize;
+uniform bool occlusionEnabled;      // screen-space ambient occlusion (ssao.h), half resolution
+uniform sampler2D occlusion;
+uniform sampler2D occlusionDepth;   // the depth it was computed from
+uniform bool lightmapped;           // direct light baked for this surface (lightmap.h)
+uniform sampler2D lightmap;
+uniform vec4 lightmapU, lightmapV;  // world position -> atlas: u = dot(lightmapU.xyz, p) + lightmapU.w
+uniform vec4 lightmapRect;          // the chart's part of the atlas: min uv, max uv
+
+vec3 irradiance(vec3 n)
+{
+    return sh[0] * 0.282095
+         + (sh[1] * n.y + sh[2] * n.z + sh[3] * n.x) * 0.488603
+         + (sh[4] * n.x * n.y + sh[5] * n.y * n.z + sh[7] * n.x * n.z) * 1.092548
+         + sh[6] * 0.315392 * (3.0 * n.z * n.z - 1.0)
+         + sh[8] * 0.546274 * (n.x * n.x - n.y * n.y);
+}
+
+// this fragment's ambient occlusion from the half-resolution result: the four nearest
+// texels, bilinear, each weighted down by how far its depth is from this fragment's so
+// that nothing bleeds across silhouettes
+float ambientOcclusion()
+{
+    if (!occlusionEnabled) return 1.0;
+    vec2 coord = gl_FragCoord.xy * 0.5 - 0.5;
+    ivec2 base = ivec2(floor(coord));
+    vec2 f = coord - vec2(base);
+    ivec2 last = textureSize(occlusion, 0) - 1;
+    float sum = 0.0, total = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 o = ivec2(i & 1, i >> 1);
+        ivec2 p = clamp(base + o, ivec2(0), last);
+        float bilinear = (o.x == 1 ? f.x : 1.0 - f.x) * (o.y == 1 ? f.y : 1.0 - f.y);
+        // reversed-Z depth is near / distance: relative distance difference
+        float difference = abs(texelFetch(occlusionDepth, p, 0).r - gl_FragCoord.z) / gl_FragCoord.z;
+        float w = (bilinear + 1e-3) / (difference + 1e-3);
+        sum += w * texelFetch(occlusion, p, 0).r;
+        total += w;
+    }
+    return sum / total;
+}
+
+// the baked light at this fragment; false outside the chart (the ground's covers only
+// the middle of the terrain), which is lit as before
+bool bakedLight(out vec3 light)
+{
+    light = vec3(0.0);
+    if (!lightmapped) return false;
+    vec2 uv = vec2(dot(lightmapU.xyz, FragPos) + lightmapU.w, dot(lightmapV.xyz, FragPos) + lightmapV.w);
+    if (any(lessThan(uv, lightmapRect.xy)) || any(greaterThan(uv, lightmapRect.zw))) return false;
+    light = texture(lightmap, uv).rgb;
+    return true;
+}
 
 void main()
 {
-    vec3 texColor = texture(floorTexture, TexCoord).rgb;
+    // screen motion since last frame, in texture coordinates
+    Velocity = (CurrClip.xy / CurrClip.w - PrevClip.xy / PrevClip.w) * 0.5;
+    vec3 texColor = texture(floorTexture, TexCoord, lodBias).rgb;
 
     // Lighting
     vec3 norm = normalize(Normal);
     vec3 lightDir = normalize(lightPos - FragPos);
     vec3 viewDir = normalize(viewPos - FragPos);
 
-    // Diffuse
+    // Diffuse: baked (shadows and a bounce included) where the lightmap covers this
+    // fragment, else from the light
+    vec3 baked;
+    bool fromLightmap = bakedLight(baked);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = diff * texColor;
+    vec3 diffuse = (fromLightmap ? baked : vec3(diff)) * texColor;
 
     // Ambient
-    vec3 ambient = 0.3 * texColor;
+    vec3 ambient = (environmentLighting ? irradiance(norm) : vec3(0.3)) * texColor * ambientOcclusion();
 
-    // Specular (optional highlight)
+    // Specular (optional highlight); not on baked surfaces, where it would ignore their shadows
     vec3 reflectDir = reflect(-lightDir, norm);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 16.0);
+    float spec = fromLightmap ? 0.0 : pow(max(dot(viewDir, reflectDir), 0.0), 16.0);
     vec3 specular = 0.2 * spec * vec3(1.0);
 
     vec3 result = ambient + diffuse + specular;
+
+    // only what lies flat on the mirror plane reflects
+    if (planarStrength > 0.0 && norm.y > 0.99 && abs(FragPos.y - planarHeight) < 0.05)
+        result = mix(result, texture(planarReflection, gl_FragCoord.xy / targetSize).rgb, planarStrength);
     FragColor = vec4(result, 1.0);
 }
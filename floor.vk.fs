@@ -0,0 +1,124 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec2 Velocity;    // motion vectors (taa.h)
+
+layout (location = 0) in vec2 TexCoord;
+layout (location = 1) in vec3 FragPos;
+layout (location = 2) in vec3 Normal;
+layout (location = 3) in vec4 CurrClip;
+layout (location = 4) in vec4 PrevClip;
+
+layout (set = 0, binding = 0) uniform sampler2D textures[];
+layout (set = 0, binding = 5) uniform sampler2D planarReflection;  // the scene mirrored in the floor, screen-aligned (planar_reflection.h)
+layout (set = 0, binding = 6) uniform sampler2D occlusion;         // screen-space ambient occlusion (ssao.h), half resolution
+layout (set = 0, binding = 7) uniform sampler2D occlusionDepth;    // the depth it was computed from
+layout (set = 0, binding = 8) uniform sampler2D lightmap;          // direct light baked for static surfaces (lightmap.h)
+
+layout (set = 1, binding = 0) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    mat4 skyView;
+    mat4 viewProjection;        // unjittered, for motion vectors (taa.h)
+    mat4 prevViewProjection;    // last frame's
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 environment;
+    vec4 ibl;           // x: 1 = environment lighting (ambient from the skybox's irradiance, ibl.h)
+    vec4 sh[9];         // irradiance / pi
+    vec4 planar;        // x: reflection strength (0: not in this view), y: texture lod bias, z: mirror height
+    vec4 target;        // xy: 1 / target size
+    vec4 occlusion;     // x: 1 = sample the ambient occlusion in this view
+    vec4 lightmap;      // x: charts in lightmapCharts (0: no lightmap)
+    vec4 lightmapCharts[48];    // per chart: u plane, v plane, its rect (min uv, max uv)
+} frame;
+
+layout (push_constant) uniform Push
+{
+    mat4 model;
+    uint textureIndex;
+    uint heightmapIndex;
+    float heightSpacing;
+    int lightmapChart;      // -1: lit by lightPos
+} push;
+
+vec3 irradiance(vec3 n)
+{
+    return frame.sh[0].rgb * 0.282095
+         + (frame.sh[1].rgb * n.y + frame.sh[2].rgb * n.z + frame.sh[3].rgb * n.x) * 0.488603
+         + (frame.sh[4].rgb * n.x * n.y + frame.sh[5].rgb * n.y * n.z + frame.sh[7].rgb * n.x * n.z) * 1.092548
+         + frame.sh[6].rgb * 0.315392 * (3.0 * n.z * n.z - 1.0)
+         + frame.sh[8].rgb * 0.546274 * (n.x * n.x - n.y * n.y);
+}
+
+// this fragment's ambient occlusion from the half-resolution result: the four nearest
+// texels, bilinear, each weighted down by how far its depth is from this fragment's so
+// that nothing bleeds across silhouettes
+float ambientOcclusion()
+{
+    if (frame.occlusion.x < 0.5) return 1.0;
+    vec2 coord = gl_FragCoord.xy * 0.5 - 0.5;
+    ivec2 base = ivec2(floor(coord));
+    vec2 f = coord - vec2(base);
+    ivec2 last = textureSize(occlusion, 0) - 1;
+    float sum = 0.0, total = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 o = ivec2(i & 1, i >> 1);
+        ivec2 p = clamp(base + o, ivec2(0), last);
+        float bilinear = (o.x == 1 ? f.x : 1.0 - f.x) * (o.y == 1 ? f.y : 1.0 - f.y);
+        // reversed-Z depth is near / distance: relative distance difference
+        float difference = abs(texelFetch(occlusionDepth, p, 0).r - gl_FragCoord.z) / gl_FragCoord.z;
+        float w = (bilinear + 1e-3) / (difference + 1e-3);
+        sum += w * texelFetch(occlusion, p, 0).r;
+        total += w;
+    }
+    return sum / total;
+}
+
+// the baked light at this fragment; false outside the chart (the ground's covers only
+// the middle of the terrain), which is lit as before
+bool bakedLight(out vec3 light)
+{
+    light = vec3(0.0);
+    int chart = push.lightmapChart;
+    if (chart < 0 || float(chart) >= frame.lightmap.x) return false;
+    vec4 u = frame.lightmapCharts[chart * 3], v = frame.lightmapCharts[chart * 3 + 1], rect = frame.lightmapCharts[chart * 3 + 2];
+    vec2 uv = vec2(dot(u.xyz, FragPos) + u.w, dot(v.xyz, FragPos) + v.w);
+    if (any(lessThan(uv, rect.xy)) || any(greaterThan(uv, rect.zw))) return false;
+    light = texture(lightmap, uv).rgb;
+    return true;
+}
+
+void main()
+{
+    // screen motion since last frame, in texture coordinates
+    Velocity = (CurrClip.xy / CurrClip.w - PrevClip.xy / PrevClip.w) * 0.5;
+    vec3 texColor = texture(textures[push.textureIndex], TexCoord, frame.planar.y).rgb;
+
+    // Lighting
+    vec3 norm = normalize(Normal);
+    vec3 lightDir = normalize(frame.lightPos.xyz - FragPos);
+    vec3 viewDir = normalize(frame.viewPos.xyz - FragPos);
+
+    // Diffuse: baked (shadows and a bounce included) where the lightmap covers this
+    // fragment, else from the light
+    vec3 baked;
+    bool fromLightmap = bakedLight(baked);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = (fromLightmap ? baked : vec3(diff)) * texColor;
+
+    // Ambient
+    vec3 ambient = (frame.ibl.x > 0.5 ? irradiance(norm) : vec3(0.3)) * texColor * ambientOcclusion();
+
+    // Specular (optional highlight); not on baked surfaces, where it would ignore their shadows
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = fromLightmap ? 0.0 : pow(max(dot(viewDir, reflectDir), 0.0), 16.0);
+    vec3 specular = 0.2 * spec * vec3(1.0);
+
+    vec3 result = ambient + diffuse + specular;
+    if (frame.planar.x > 0.0 && norm.y > 0.99 && abs(FragPos.y - frame.planar.z) < 0.05)
+        result = mix(result, texture(planarReflection, gl_FragCoord.xy * frame.target.xy).rgb, frame.planar.x);
+    FragColor = vec4(result, 1.0);
+}
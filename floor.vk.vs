@@ -0,0 +1,38 @@
+#version 450
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+
+layout (location = 0) out vec2 TexCoord;
+layout (location = 1) out vec3 FragPos;
+layout (location = 2) out vec3 Normal;
+layout (location = 3) out vec4 CurrClip;   // unjittered, this frame and last
+layout (location = 4) out vec4 PrevClip;
+
+layout (set = 1, binding = 0) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    mat4 skyView;
+    mat4 viewProjection;        // unjittered, for motion vectors (taa.h)
+    mat4 prevViewProjection;    // last frame's
+    vec4 viewPos;
+    vec4 lightPos;
+} frame;
+
+layout (push_constant) uniform Push
+{
+    mat4 model;
+    uint textureIndex;
+    layout (offset = 80) mat3x4 prevModel;     // last frame's model, its top three rows
+} push;
+
+void main()
+{
+    FragPos = vec3(push.model * vec4(aPos, 1.0));
+    Normal  = mat3(transpose(inverse(push.model))) * aNormal;
+    TexCoord = aTexCoord;
+    gl_Position = frame.projection * frame.view * vec4(FragPos, 1.0);
+    CurrClip = frame.viewProjection * vec4(FragPos, 1.0);
+    PrevClip = frame.prevViewProjection * vec4(vec4(aPos, 1.0) * push.prevModel, 1.0);
+}
@@ -6,10 +6,15 @@ layout (location = 2) in vec2 aTexCoord;
 out vec2 TexCoord;
 out vec3 FragPos;
 out vec3 Normal;
+out vec4 CurrClip;   // motion vectors (taa.h): this frame's and last frame's clip position, unjittered
+out vec4 PrevClip;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform mat4 prevModel;            // last frame's model
+uniform mat4 viewProjection;       // unjittered projection * view
+uniform mat4 prevViewProjection;   // last frame's
 
 void main()
 {
@@ -17,4 +22,6 @@ void main()
     Normal  = mat3(transpose(inverse(model))) * aNormal;
     TexCoord = aTexCoord;
     gl_Position = projection * view * vec4(FragPos, 1.0);
+    CurrClip = viewProjection * vec4(FragPos, 1.0);
+    PrevClip = prevViewProjection * prevModel * vec4(aPos, 1.0);
 }
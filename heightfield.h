@@ -0,0 +1,320 @@
+#ifndef HEIGHTFIELD_H
+#define HEIGHTFIELD_H
+
+// Terrain heights for physics and rendering.
+//
+// A square grid of 2^sizeLog2 samples per side, `spacing` world units apart, generated
+// procedurally (periodic value-noise octaves) on the job system at startup. The grid
+// repeats with its own period, so the ground is continuous everywhere in the unbounded
+// world without streaming height data. Within flatRadius of the origin (and of every
+// repeat of it) the ground is exactly y = 0 so the arena, the wall and the traffic rings
+// stay level; the hills fade in over flatBlend.
+//
+// Queries are bilinear between the four surrounding samples; normals come from central
+// differences one sample apart. query() takes SoA arrays of points and runs the kernel
+// in heightfield_kernels.inl with the instruction set from physicsSimdLevel() (gathers
+// on AVX2/AVX-512), so traffic can look up every car in one call. height()/normal() are
+// the single-point forms for the player car. The terrain shaders read the same samples
+// with the same formula, so the car sits on the ground that is drawn.
+//
+// The generator uses only +, *, / and sqrt under fp-contract off, so every build produces
+// the same samples (see deterministic.h).
+
+#include <glm/glm.hpp>
+
+#include "collision_simd.h"
+#include "deterministic.h"
+#include "jobs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+struct HeightfieldConfig
+{
+    int sizeLog2 = 10;          // samples per side = 2^sizeLog2 (the period of the terrain)
+    float spacing = 1.0f;       // world units between samples
+    float amplitude = 7.0f;     // hills reach about this high (and valleys this deep)
+    float flatRadius = 48.0f;   // level ground around the origin
+    float flatBlend = 48.0f;    // distance over which the hills fade in
+    uint32_t seed = 7;
+};
+
+// what the kernels need to read the grid
+struct HeightfieldView
+{
+    const float* samples;
+    int shift;                  // sizeLog2: row stride as a shift
+    int32_t mask;               // size - 1: wraps indices
+    float invSpacing;
+};
+
+// SoA query: heights for (x[i], z[i]); normals too when nx/ny/nz are set
+struct HeightQuery
+{
+    const float *x, *z;
+    float* height;
+    float *nx = nullptr, *ny = nullptr, *nz = nullptr;
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")   // strict: see deterministic.h
+#endif
+namespace heightfield_scalar
+{
+    typedef collision_scalar::Simd Simd;
+#include "heightfield_kernels.inl"
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+#ifdef COLLISION_SIMD_X86
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#pragma GCC optimize("fp-contract=off")   // strict: see deterministic.h
+#endif
+namespace heightfield_sse2
+{
+    typedef collision_sse2::Simd Simd;
+#include "heightfield_kernels.inl"
+}
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+namespace heightfield_avx2
+{
+    typedef collision_avx2::Simd Simd;
+#include "heightfield_kernels.inl"
+}
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#endif
+namespace heightfield_avx512
+{
+    typedef collision_avx512::Simd Simd;
+#include "heightfield_kernels.inl"
+}
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif // COLLISION_SIMD_X86
+
+// ---- generation (strict, so every build makes the same terrain) ----
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// lattice value in [-1, 1] for cell corner (x, z) of an octave
+inline float heightfieldLattice(uint32_t x, uint32_t z, uint32_t octave, uint32_t seed)
+{
+    uint32_t h = x * 0x8da6b343u ^ z * 0xd8163841u ^ (octave + 1) * 0xcb1ab31fu ^ seed * 0x9e3779b9u;
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    return (float)(h & 0xFFFFFF) * (2.0f / 16777215.0f) - 1.0f;
+}
+
+inline float heightfieldSmooth(float t) { return t * t * (3.0f - 2.0f * t); }
+
+// octaves of value noise with cells from size/4 samples down to size/128; each octave's
+// lattice wraps at the grid size, so the sum tiles seamlessly
+inline void generateHeightfieldRow(const HeightfieldConfig& c, int z, float* row)
+{
+    const int OCTAVES = 6;
+    int n = 1 << c.sizeLog2;
+    float dz = std::min(z, n - z) * c.spacing;
+    for (int x = 0; x < n; x++)
+    {
+        float sum = 0.0f, weight = 1.0f, total = 0.0f;
+        for (int o = 0; o < OCTAVES; o++)
+        {
+            int cell = std::max(2, n >> (2 + o));
+            uint32_t cells = (uint32_t)(n / cell);
+            uint32_t cx = (uint32_t)(x / cell), cz = (uint32_t)(z / cell);
+            uint32_t nx = (cx + 1) % cells, nz = (cz + 1) % cells;
+            float tx = heightfieldSmooth((float)(x % cell) / cell), tz = heightfieldSmooth((float)(z % cell) / cell);
+            float h00 = heightfieldLattice(cx, cz, o, c.seed), h10 = heightfieldLattice(nx, cz, o, c.seed);
+            float h01 = heightfieldLattice(cx, nz, o, c.seed), h11 = heightfieldLattice(nx, nz, o, c.seed);
+            float a = h00 + (h10 - h00) * tx, b = h01 + (h11 - h01) * tx;
+            sum += (a + (b - a) * tz) * weight;
+            total += weight;
+            weight *= 0.5f;
+        }
+        // level around the origin, measured to the nearest repeat of it
+        float dx = std::min(x, n - x) * c.spacing;
+        float fade = std::max(0.0f, std::min(1.0f, (std::sqrt(dx * dx + dz * dz) - c.flatRadius) / c.flatBlend));
+        row[x] = c.amplitude * (sum / total) * heightfieldSmooth(fade);
+    }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+class Heightfield
+{
+public:
+    explicit Heightfield(const HeightfieldConfig& config = HeightfieldConfig(), JobSystem& jobs = jobSystem())
+        : config(config), n(1 << config.sizeLog2), samplesVec((size_t)n * n)
+    {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        jobs.parallelFor((size_t)n, 16, [this](size_t begin, size_t end, size_t) {
+            for (size_t row = begin; row < end; row++) generateHeightfieldRow(this->config, (int)row, samplesVec.data() + row * n);
+        });
+        generationMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+
+        // bilinear slope along each axis is at most the steepest step between neighbours
+        float step = 0.0f;
+        for (int z = 0; z < n; z++)
+            for (int x = 0; x < n; x++)
+            {
+                float h = samplesVec[(size_t)z * n + x];
+                step = std::max(step, std::fabs(samplesVec[(size_t)z * n + ((x + 1) & (n - 1))] - h));
+                step = std::max(step, std::fabs(samplesVec[(size_t)(((z + 1) & (n - 1))) * n + x] - h));
+            }
+        gradientBound = std::sqrt(2.0f) * step / config.spacing;
+    }
+
+    // heights (and optionally normals) for count points, widest allowed instruction set
+    void query(const HeightQuery& q, size_t count) const { query(q, 0, count); }
+
+    void query(const HeightQuery& q, size_t begin, size_t end) const
+    {
+        HeightfieldView f = view();
+        size_t done = begin;
+#ifdef COLLISION_SIMD_X86
+        switch (physicsSimdLevel())
+        {
+        case SimdLevel::AVX512: done = heightfield_avx512::heightKernel(f, q, begin, end); break;
+        case SimdLevel::AVX2: done = heightfield_avx2::heightKernel(f, q, begin, end); break;
+        case SimdLevel::SSE2: done = heightfield_sse2::heightKernel(f, q, begin, end); break;
+        default: break;
+        }
+#endif
+        heightfield_scalar::heightKernel(f, q, done, end);
+    }
+
+    float height(float x, float z) const
+    {
+        HeightQuery q = { &x, &z, nullptr };
+        float h;
+        q.height = &h;
+        heightfield_scalar::heightKernel(view(), q, 0, 1);
+        return h;
+    }
+
+    glm::vec3 normal(float x, float z) const
+    {
+        float h;
+        glm::vec3 nrm;
+        HeightQuery q = { &x, &z, &h, &nrm.x, &nrm.y, &nrm.z };
+        heightfield_scalar::heightKernel(view(), q, 0, 1);
+        return nrm;
+    }
+
+    HeightfieldView view() const { return { samplesVec.data(), config.sizeLog2, n - 1, 1.0f / config.spacing }; }
+
+    int size() const { return n; }
+    float spacing() const { return config.spacing; }
+    const std::vector<float>& samples() const { return samplesVec; }
+    const HeightfieldConfig& settings() const { return config; }
+    double generateMs() const { return generationMs; }
+    // no two points d apart differ in height by more than d * maxGradient()
+    float maxGradient() const { return gradientBound; }
+
+private:
+    HeightfieldConfig config;
+    int n;
+    std::vector<float> samplesVec;
+    double generationMs = 0.0;
+    float gradientBound = 0.0f;
+};
+
+// ---- benchmark: queries per second per instruction set ----
+// Random points over four periods of the grid (so most lookups miss the cache), heights
+// alone and with normals. Every level is compared with the scalar kernel: the strict
+// scalar and SSE2 kernels agree bit for bit, the wider ones within rounding.
+inline void runHeightfieldBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const size_t n = 1 << 20;
+    const int passes = 8;
+
+    Heightfield field;
+    float extent = 2.0f * field.size() * field.spacing();
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> coord(-extent, extent);
+    std::vector<float> x(n), z(n), h(n), nx(n), ny(n), nz(n), refH(n), refNy(n);
+    for (size_t i = 0; i < n; i++) { x[i] = coord(rng); z[i] = coord(rng); }
+
+    SimdLevel best = detectSimdLevel();
+    setSimdLevel(SimdLevel::Scalar);
+    field.query({ x.data(), z.data(), refH.data(), nx.data(), refNy.data(), nz.data() }, n);
+
+    std::cout << "heightfield: " << field.size() << "^2 samples generated in " << field.generateMs() << " ms, "
+              << n << " random queries, best available " << simdLevelName(best) << "\n";
+    std::cout << std::setw(10) << "isa" << std::setw(16) << "Mheights/s" << std::setw(18) << "M+normals/s"
+              << std::setw(14) << "max h err" << std::setw(14) << "max n err" << "\n";
+    for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512 })
+    {
+        if (level > best) continue;
+        setSimdLevel(level);
+        HeightQuery heights = { x.data(), z.data(), h.data() };
+        HeightQuery full = { x.data(), z.data(), h.data(), nx.data(), ny.data(), nz.data() };
+        field.query(heights, n);   // warm-up
+
+        auto t0 = Clock::now();
+        for (int p = 0; p < passes; p++) field.query(heights, n);
+        double heightSecs = std::chrono::duration<double>(Clock::now() - t0).count();
+        t0 = Clock::now();
+        for (int p = 0; p < passes; p++) field.query(full, n);
+        double fullSecs = std::chrono::duration<double>(Clock::now() - t0).count();
+
+        double maxH = 0.0, maxN = 0.0;
+        for (size_t i = 0; i < n; i++)
+        {
+            maxH = std::max(maxH, (double)std::fabs(h[i] - refH[i]));
+            maxN = std::max(maxN, (double)std::fabs(ny[i] - refNy[i]));
+        }
+        double queries = (double)n * passes;
+        std::cout << std::setw(10) << simdLevelName(level) << std::setw(16) << queries / heightSecs / 1e6
+                  << std::setw(18) << queries / fullSecs / 1e6 << std::setw(14) << maxH << std::setw(14) << maxN << "\n";
+    }
+    setSimdLevel(best);
+}
+
+#endif
@@ -0,0 +1,49 @@
+// Batched heightfield lookups, written once against the SIMD wrapper from collision_simd.h.
+// heightfield.h includes this file once per instruction set, inside a namespace that
+// typedefs `Simd` and under the matching target pragma. The kernel handles whole
+// W-wide blocks starting at `begin` and returns where it stopped; the caller finishes
+// the tail with the scalar variant.
+
+// bilinear height at grid coordinates (world / spacing); the grid wraps, so indices
+// are masked into the power-of-two sample array
+inline Simd::V bilinear(const HeightfieldView& f, Simd::V gx, Simd::V gz)
+{
+    typedef Simd::V V;
+    typedef Simd::I I;
+    V fx = Simd::floor(gx), fz = Simd::floor(gz);
+    V tx = Simd::sub(gx, fx), tz = Simd::sub(gz, fz);
+    I ix = Simd::toInt(fx), iz = Simd::toInt(fz);
+    const I one = Simd::iset1(1);
+    I x0 = Simd::iand(ix, f.mask), x1 = Simd::iand(Simd::iadd(ix, one), f.mask);
+    I z0 = Simd::ishl(Simd::iand(iz, f.mask), f.shift), z1 = Simd::ishl(Simd::iand(Simd::iadd(iz, one), f.mask), f.shift);
+
+    V h00 = Simd::gather(f.samples, Simd::iadd(z0, x0)), h10 = Simd::gather(f.samples, Simd::iadd(z0, x1));
+    V h01 = Simd::gather(f.samples, Simd::iadd(z1, x0)), h11 = Simd::gather(f.samples, Simd::iadd(z1, x1));
+    V a = Simd::add(h00, Simd::mul(Simd::sub(h10, h00), tx));
+    V b = Simd::add(h01, Simd::mul(Simd::sub(h11, h01), tx));
+    return Simd::add(a, Simd::mul(Simd::sub(b, a), tz));
+}
+
+inline size_t heightKernel(const HeightfieldView& f, const HeightQuery& q, size_t begin, size_t end)
+{
+    typedef Simd::V V;
+    const V invSpacing = Simd::set1(f.invSpacing), halfInvSpacing = Simd::set1(0.5f * f.invSpacing);
+    const V one = Simd::set1(1.0f), zero = Simd::set1(0.0f);
+
+    size_t i = begin;
+    for (; i + Simd::W <= end; i += Simd::W)
+    {
+        V gx = Simd::mul(Simd::load(q.x + i), invSpacing), gz = Simd::mul(Simd::load(q.z + i), invSpacing);
+        Simd::store(q.height + i, bilinear(f, gx, gz));
+        if (!q.nx) continue;
+
+        // central differences one sample either side: n = normalize(-dh/dx, 1, -dh/dz)
+        V sx = Simd::mul(Simd::sub(bilinear(f, Simd::add(gx, one), gz), bilinear(f, Simd::sub(gx, one), gz)), halfInvSpacing);
+        V sz = Simd::mul(Simd::sub(bilinear(f, gx, Simd::add(gz, one)), bilinear(f, gx, Simd::sub(gz, one))), halfInvSpacing);
+        V invLen = Simd::div(one, Simd::sqrt(Simd::add(one, Simd::add(Simd::mul(sx, sx), Simd::mul(sz, sz)))));
+        Simd::store(q.nx + i, Simd::sub(zero, Simd::mul(sx, invLen)));
+        Simd::store(q.ny + i, invLen);
+        Simd::store(q.nz + i, Simd::sub(zero, Simd::mul(sz, invLen)));
+    }
+    return i;
+}
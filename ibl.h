@@ -0,0 +1,600 @@
+#ifndef IBL_H
+#define IBL_H
+
+// Image-based lighting from the skybox, precomputed on the CPU at load (IBLData in
+// renderer.h).
+//
+// Integrating the sky over the hemisphere per fragment is hundreds of texture reads;
+// instead the integrals are done once and the shaders read the results:
+//  - diffuse: the sky projected onto the nine l <= 2 spherical harmonics and convolved
+//    with the cosine lobe (Ramamoorthi and Hanrahan), so irradiance is a short
+//    polynomial in the normal;
+//  - specular: the split-sum approximation. The sky convolved with the GGX lobe
+//    (importance sampled, reading a mip whose texels match each sample's solid angle)
+//    for roughness 0 at mip 0 up to 1 at the last mip, and a table over (N.V,
+//    roughness) of the scale and bias that the BRDF applies to F0.
+//
+// The work splits into rows spread over the job system. The result is cached in the
+// skybox directory as ibl-<hash>.bin, keyed by a hash of the face files' bytes and the
+// settings, so later launches only read a file; a changed skybox or setting misses the
+// cache and recomputes. Like the rest of the renderer, sky texels are used as they are
+// (no sRGB decode).
+
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include "deterministic.h"
+#include "file_io.h"
+#include "jobs.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct IBLConfig
+{
+    int specularSize = 128;     // face size of the prefiltered mip 0 (the sky is box-filtered down to it)
+    int specularMips = 6;       // roughness (mip / (mips - 1)); 128 down to 4 texels
+    int specularSamples = 64;   // GGX samples per texel
+    int shSize = 32;            // face size the harmonics are projected from
+    int lutSize = 64;
+    int lutSamples = 256;
+};
+
+struct IBLStats
+{
+    bool cached = false;
+    unsigned int threads = 0;
+    double hashMs = 0.0, decodeMs = 0.0, shMs = 0.0, specularMs = 0.0, lutMs = 0.0, cacheMs = 0.0;
+
+    void print(std::ostream& out) const
+    {
+        out << "ibl: " << (cached ? "read from cache" : "computed") << ", hash " << hashMs << " ms, ";
+        if (cached) out << "cache read " << cacheMs << " ms\n";
+        else
+            out << "decode " << decodeMs << " ms, SH " << shMs << " ms, GGX prefilter " << specularMs << " ms, BRDF LUT "
+                << lutMs << " ms on " << threads << " threads, cache write " << cacheMs << " ms\n";
+    }
+};
+
+// ---- half floats ----
+
+inline uint16_t floatToHalf(float f)
+{
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000u;
+    int exponent = (int)((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = x & 0x7fffffu;
+    if (exponent >= 31) return (uint16_t)(sign | 0x7c00u);     // overflow and inf (no NaNs here)
+    if (exponent <= 0)
+    {
+        if (exponent < -10) return (uint16_t)sign;
+        mantissa |= 0x800000u;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        return (uint16_t)(sign | ((mantissa + (1u << (shift - 1))) >> shift));
+    }
+    uint32_t h = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    return (uint16_t)(h + ((mantissa >> 12) & 1));   // round half up; a carry rolls into the exponent
+}
+
+// ---- float cubemaps on the CPU ----
+
+// six faces per level, GL's cubemap layout: row 0 of a face is t = 0
+struct CubeImage
+{
+    int size = 0;
+    std::vector<std::vector<glm::vec3>> levels;     // levels[m]: 6 * (size >> m)^2 texels
+
+    int levelSize(int m) const { return std::max(1, size >> m); }
+    glm::vec3& at(int m, int face, int x, int y) { int s = levelSize(m); return levels[m][((size_t)face * s + y) * s + x]; }
+    const glm::vec3& at(int m, int face, int x, int y) const { int s = levelSize(m); return levels[m][((size_t)face * s + y) * s + x]; }
+
+    // direction through (u, v) in [0, 1]^2 of a face
+    static glm::vec3 direction(int face, float u, float v)
+    {
+        float sc = 2.0f * u - 1.0f, tc = 2.0f * v - 1.0f;
+        switch (face)
+        {
+        case 0: return glm::vec3(1.0f, -tc, -sc);
+        case 1: return glm::vec3(-1.0f, -tc, sc);
+        case 2: return glm::vec3(sc, 1.0f, tc);
+        case 3: return glm::vec3(sc, -1.0f, -tc);
+        case 4: return glm::vec3(sc, -tc, 1.0f);
+        default: return glm::vec3(-sc, -tc, -1.0f);
+        }
+    }
+
+    static void faceCoords(const glm::vec3& d, int& face, float& u, float& v)
+    {
+        glm::vec3 a = glm::abs(d);
+        float sc, tc, ma;
+        if (a.x >= a.y && a.x >= a.z) { face = d.x > 0 ? 0 : 1; ma = a.x; sc = d.x > 0 ? -d.z : d.z; tc = -d.y; }
+        else if (a.y >= a.z) { face = d.y > 0 ? 2 : 3; ma = a.y; sc = d.x; tc = d.y > 0 ? d.z : -d.z; }
+        else { face = d.z > 0 ? 4 : 5; ma = a.z; sc = d.z > 0 ? d.x : -d.x; tc = -d.y; }
+        u = 0.5f * (sc / ma + 1.0f);
+        v = 0.5f * (tc / ma + 1.0f);
+    }
+
+    // bilinear within the face (clamped at its edges), linear between levels
+    glm::vec3 sample(const glm::vec3& d, float lod) const
+    {
+        int face;
+        float u, v;
+        faceCoords(d, face, u, v);
+        lod = glm::clamp(lod, 0.0f, (float)(levels.size() - 1));
+        int m0 = (int)lod, m1 = std::min(m0 + 1, (int)levels.size() - 1);
+        glm::vec3 a = bilinear(m0, face, u, v);
+        if (m1 == m0) return a;
+        return glm::mix(a, bilinear(m1, face, u, v), lod - (float)m0);
+    }
+
+    glm::vec3 bilinear(int m, int face, float u, float v) const
+    {
+        int s = levelSize(m);
+        float x = glm::clamp(u * s - 0.5f, 0.0f, (float)(s - 1)), y = glm::clamp(v * s - 0.5f, 0.0f, (float)(s - 1));
+        int x0 = (int)x, y0 = (int)y, x1 = std::min(x0 + 1, s - 1), y1 = std::min(y0 + 1, s - 1);
+        float fx = x - (float)x0, fy = y - (float)y0;
+        return glm::mix(glm::mix(at(m, face, x0, y0), at(m, face, x1, y0), fx),
+                        glm::mix(at(m, face, x0, y1), at(m, face, x1, y1), fx), fy);
+    }
+
+    // 2x2 box filter down to 1 texel
+    void buildMips()
+    {
+        while (levelSize((int)levels.size() - 1) > 1)
+        {
+            int m = (int)levels.size(), s = levelSize(m);
+            levels.emplace_back((size_t)6 * s * s);
+            for (int face = 0; face < 6; face++)
+                for (int y = 0; y < s; y++)
+                    for (int x = 0; x < s; x++)
+                        at(m, face, x, y) = 0.25f * (at(m - 1, face, 2 * x, 2 * y) + at(m - 1, face, 2 * x + 1, 2 * y) +
+                                                     at(m - 1, face, 2 * x, 2 * y + 1) + at(m - 1, face, 2 * x + 1, 2 * y + 1));
+        }
+    }
+};
+
+// solid angle of the texel (x, y) of a size^2 face
+inline float cubeTexelSolidAngle(int x, int y, int size)
+{
+    auto area = [](float u, float v) { return std::atan2(u * v, std::sqrt(u * u + v * v + 1.0f)); };
+    float u0 = 2.0f * x / size - 1.0f, u1 = 2.0f * (x + 1) / size - 1.0f;
+    float v0 = 2.0f * y / size - 1.0f, v1 = 2.0f * (y + 1) / size - 1.0f;
+    return area(u0, v0) - area(u0, v1) - area(u1, v0) + area(u1, v1);
+}
+
+// the nine real l <= 2 harmonics at unit direction d
+inline void shBasis(const glm::vec3& d, float out[9])
+{
+    out[0] = 0.282095f;
+    out[1] = 0.488603f * d.y;
+    out[2] = 0.488603f * d.z;
+    out[3] = 0.488603f * d.x;
+    out[4] = 1.092548f * d.x * d.y;
+    out[5] = 1.092548f * d.y * d.z;
+    out[6] = 0.315392f * (3.0f * d.z * d.z - 1.0f);
+    out[7] = 1.092548f * d.x * d.z;
+    out[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+}
+
+inline glm::vec3 evalSH(const glm::vec3 sh[9], const glm::vec3& n)
+{
+    float basis[9];
+    shBasis(n, basis);
+    glm::vec3 sum(0.0f);
+    for (int i = 0; i < 9; i++) sum += sh[i] * basis[i];
+    return sum;
+}
+
+inline glm::vec2 hammersley(uint32_t i, uint32_t count)
+{
+    uint32_t bits = i;
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return glm::vec2((float)i / (float)count, (float)bits * 2.3283064365386963e-10f);
+}
+
+// half vector around n for GGX with alpha = roughness^2
+inline glm::vec3 importanceSampleGGX(const glm::vec2& xi, const glm::vec3& n, float alpha)
+{
+    float phi = 6.2831853f * xi.x;
+    float cosTheta = std::sqrt((1.0f - xi.y) / (1.0f + (alpha * alpha - 1.0f) * xi.y));
+    float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+    glm::vec3 h(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+    glm::vec3 up = std::abs(n.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 tx = glm::normalize(glm::cross(up, n));
+    glm::vec3 ty = glm::cross(n, tx);
+    return tx * h.x + ty * h.y + n * h.z;
+}
+
+// ---- the three precomputes ----
+
+inline void projectSH(const CubeImage& sky, int level, glm::vec3 sh[9], JobSystem& jobs)
+{
+    const int s = sky.levelSize(level);
+    // one partial sum per face, added up in order so the result does not depend on timing
+    std::vector<glm::vec3> partial((size_t)6 * 9, glm::vec3(0.0f));
+    std::vector<float> weights(6, 0.0f);
+    jobs.parallelFor(6, 1, [&](size_t begin, size_t end, size_t) {
+        for (size_t face = begin; face < end; face++)
+            for (int y = 0; y < s; y++)
+                for (int x = 0; x < s; x++)
+                {
+                    glm::vec3 d = glm::normalize(CubeImage::direction((int)face, (x + 0.5f) / s, (y + 0.5f) / s));
+                    float w = cubeTexelSolidAngle(x, y, s), basis[9];
+                    shBasis(d, basis);
+                    const glm::vec3& c = sky.at(level, (int)face, x, y);
+                    for (int i = 0; i < 9; i++) partial[face * 9 + i] += c * (basis[i] * w);
+                    weights[face] += w;
+                }
+    });
+    float total = 0.0f;
+    for (float w : weights) total += w;
+    // cosine lobe (pi, 2pi/3, pi/4 per band) over pi, and the texel weights normalised to 4 pi
+    const float band[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+    for (int i = 0; i < 9; i++)
+    {
+        glm::vec3 sum(0.0f);
+        for (int face = 0; face < 6; face++) sum += partial[face * 9 + i];
+        sh[i] = sum * (band[i] * 12.566371f / total);
+    }
+}
+
+inline void prefilterGGX(const CubeImage& sky, const IBLConfig& config, IBLData& out, JobSystem& jobs)
+{
+    out.specularSize = sky.size;
+    out.specularMips = std::min(config.specularMips, (int)sky.levels.size());
+    out.specular.assign(out.specularOffset(out.specularMips), 0);
+    const float texelSolidAngle = 12.566371f / (6.0f * sky.size * sky.size);
+
+    // every (mip, face, row), one list so that the small mips balance with the rest
+    struct Row { int mip, face, y; };
+    std::vector<Row> rows;
+    for (int m = 0; m < out.specularMips; m++)
+        for (int face = 0; face < 6; face++)
+            for (int y = 0; y < out.mipSize(m); y++) rows.push_back({ m, face, y });
+
+    jobs.parallelFor(rows.size(), 4, [&](size_t begin, size_t end, size_t) {
+        for (size_t r = begin; r < end; r++)
+        {
+            const Row& row = rows[r];
+            const int s = out.mipSize(row.mip);
+            float roughness = out.specularMips > 1 ? (float)row.mip / (out.specularMips - 1) : 0.0f;
+            float alpha = roughness * roughness;
+            uint16_t* dst = &out.specular[out.specularOffset(row.mip) + (((size_t)row.face * s + row.y) * s) * 4];
+            for (int x = 0; x < s; x++)
+            {
+                glm::vec3 n = glm::normalize(CubeImage::direction(row.face, (x + 0.5f) / s, (row.y + 0.5f) / s));
+                glm::vec3 color(0.0f);
+                if (row.mip == 0) color = sky.sample(n, 0.0f);     // a mirror: the sky itself
+                else
+                {
+                    // split sum: N = V = R, samples weighted by N.L
+                    float weight = 0.0f, a2 = alpha * alpha;
+                    for (int i = 0; i < config.specularSamples; i++)
+                    {
+                        glm::vec3 h = importanceSampleGGX(hammersley((uint32_t)i, (uint32_t)config.specularSamples), n, alpha);
+                        float nh = glm::dot(n, h);
+                        glm::vec3 l = 2.0f * nh * h - n;
+                        float nl = glm::dot(n, l);
+                        if (nl <= 0.0f) continue;
+                        // pdf of l is D * N.H / (4 V.H) = D / 4 here; read the level whose
+                        // texels cover about the solid angle of one sample
+                        float denom = nh * nh * (a2 - 1.0f) + 1.0f;
+                        float pdf = a2 / (3.14159265f * denom * denom) * 0.25f;
+                        float sampleSolidAngle = 1.0f / (config.specularSamples * pdf + 1e-4f);
+                        float lod = 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f;
+                        color += sky.sample(l, lod) * nl;
+                        weight += nl;
+                    }
+                    if (weight > 0.0f) color /= weight;
+                }
+                dst[x * 4 + 0] = floatToHalf(color.r);
+                dst[x * 4 + 1] = floatToHalf(color.g);
+                dst[x * 4 + 2] = floatToHalf(color.b);
+                dst[x * 4 + 3] = floatToHalf(1.0f);
+            }
+        }
+    });
+}
+
+// scale and bias to F0 of the GGX / Smith (Schlick, k = alpha / 2) BRDF integrated over the hemisphere
+inline void integrateBRDF(const IBLConfig& config, IBLData& out, JobSystem& jobs)
+{
+    const int n = config.lutSize;
+    out.lutSize = n;
+    out.brdfLut.assign((size_t)n * n * 2, 0);
+    jobs.parallelFor((size_t)n, 4, [&](size_t begin, size_t end, size_t) {
+        for (size_t y = begin; y < end; y++)
+        {
+            float roughness = (y + 0.5f) / n, alpha = roughness * roughness, k = alpha * 0.5f;
+            for (int x = 0; x < n; x++)
+            {
+                float nv = (x + 0.5f) / n;
+                glm::vec3 v(std::sqrt(1.0f - nv * nv), 0.0f, nv), normal(0.0f, 0.0f, 1.0f);
+                float a = 0.0f, b = 0.0f;
+                for (int i = 0; i < config.lutSamples; i++)
+                {
+                    glm::vec3 h = importanceSampleGGX(hammersley((uint32_t)i, (uint32_t)config.lutSamples), normal, alpha);
+                    glm::vec3 l = 2.0f * glm::dot(v, h) * h - v;
+                    float nl = std::max(l.z, 0.0f), nh = std::max(h.z, 0.0f), vh = std::max(glm::dot(v, h), 0.0f);
+                    if (nl <= 0.0f) continue;
+                    float g = (nv / (nv * (1.0f - k) + k)) * (nl / (nl * (1.0f - k) + k));
+                    float gVis = g * vh / (nh * nv + 1e-6f);
+                    float fc = std::pow(1.0f - vh, 5.0f);
+                    a += (1.0f - fc) * gVis;
+                    b += fc * gVis;
+                }
+                out.brdfLut[(y * n + x) * 2 + 0] = floatToHalf(a / config.lutSamples);
+                out.brdfLut[(y * n + x) * 2 + 1] = floatToHalf(b / config.lutSamples);
+            }
+        }
+    });
+}
+
+// all three from six decoded faces (rgb, width x width each); the sky is box-filtered
+// to config.specularSize first
+inline void computeIBL(const std::vector<const unsigned char*>& faces, int width, const IBLConfig& config, IBLData& out,
+                       IBLStats& stats, JobSystem& jobs)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    auto t0 = Clock::now();
+    CubeImage sky;
+    sky.size = std::min(config.specularSize, width);
+    sky.levels.emplace_back((size_t)6 * sky.size * sky.size);
+    const int block = std::max(1, width / sky.size);
+    jobs.parallelFor((size_t)6 * sky.size, 8, [&](size_t begin, size_t end, size_t) {
+        for (size_t r = begin; r < end; r++)
+        {
+            int face = (int)(r / sky.size), y = (int)(r % sky.size);
+            for (int x = 0; x < sky.size; x++)
+            {
+                glm::vec3 sum(0.0f);
+                for (int by = 0; by < block; by++)
+                {
+                    const unsigned char* p = faces[face] + ((size_t)(y * width / sky.size + by) * width + (size_t)x * width / sky.size) * 3;
+                    for (int bx = 0; bx < block; bx++, p += 3) sum += glm::vec3(p[0], p[1], p[2]);
+                }
+                sky.at(0, face, x, y) = sum / (255.0f * block * block);
+            }
+        }
+    });
+    sky.buildMips();
+    stats.decodeMs += std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+    t0 = Clock::now();
+    int shLevel = 0;
+    while (sky.levelSize(shLevel) > config.shSize && shLevel + 1 < (int)sky.levels.size()) shLevel++;
+    projectSH(sky, shLevel, out.sh, jobs);
+    auto t1 = Clock::now();
+    prefilterGGX(sky, config, out, jobs);
+    auto t2 = Clock::now();
+    integrateBRDF(config, out, jobs);
+    auto t3 = Clock::now();
+    stats.shMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    stats.specularMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+    stats.lutMs = std::chrono::duration<double, std::milli>(t3 - t2).count();
+    stats.threads = jobs.threadCount();
+}
+
+// ---- cache file: header, 27 SH floats, specular halves, LUT halves ----
+
+struct IBLCacheHeader
+{
+    char magic[4];              // "IBL1"
+    uint32_t version;
+    uint32_t specularSize, specularMips, lutSize;
+    uint32_t keyLow, keyHigh;   // the hash it was computed for
+};
+
+const uint32_t IBL_CACHE_VERSION = 1;
+
+// the skybox files' bytes and every setting that changes the result
+inline uint64_t iblCacheKey(const std::vector<std::string>& faces, const IBLConfig& config, std::string* error = nullptr)
+{
+    StateHash hash;
+    hash.add(IBL_CACHE_VERSION);
+    for (int v : { config.specularSize, config.specularMips, config.specularSamples, config.shSize, config.lutSize, config.lutSamples })
+        hash.add((uint32_t)v);
+    for (const std::string& path : faces)
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (!in.good() && !in.eof())
+        {
+            if (error) *error = "cannot read " + path;
+            return 0;
+        }
+        for (size_t i = 0; i < bytes.size(); i += 4)
+        {
+            uint32_t word = 0;
+            std::memcpy(&word, &bytes[i], std::min<size_t>(4, bytes.size() - i));
+            hash.add(word);
+        }
+        hash.add((uint32_t)bytes.size());
+    }
+    return hash.value;
+}
+
+inline bool readIBLCache(const std::string& path, uint64_t key, IBLData& out)
+{
+    std::ifstream in(path, std::ios::binary);
+    IBLCacheHeader h;
+    if (!in.read((char*)&h, sizeof(h))) return false;
+    if (std::memcmp(h.magic, "IBL1", 4) != 0 || h.version != IBL_CACHE_VERSION || h.keyLow != (uint32_t)key ||
+        h.keyHigh != (uint32_t)(key >> 32) || h.specularSize == 0 || h.specularSize > 4096 || h.specularMips == 0 ||
+        h.specularMips > 13 || h.lutSize == 0 || h.lutSize > 1024)
+        return false;
+    out.specularSize = (int)h.specularSize;
+    out.specularMips = (int)h.specularMips;
+    out.lutSize = (int)h.lutSize;
+    out.specular.resize(out.specularOffset(out.specularMips));
+    out.brdfLut.resize((size_t)out.lutSize * out.lutSize * 2);
+    float sh[27];
+    in.read((char*)sh, sizeof(sh));
+    in.read((char*)out.specular.data(), (std::streamsize)(out.specular.size() * sizeof(uint16_t)));
+    in.read((char*)out.brdfLut.data(), (std::streamsize)(out.brdfLut.size() * sizeof(uint16_t)));
+    if (!in)
+    {
+        out = IBLData();
+        return false;
+    }
+    for (int i = 0; i < 9; i++) out.sh[i] = glm::vec3(sh[i * 3], sh[i * 3 + 1], sh[i * 3 + 2]);
+    return true;
+}
+
+// replaced atomically (file_io.h)
+inline bool writeIBLCache(const std::string& path, uint64_t key, const IBLData& data, std::string* error = nullptr)
+{
+    IBLCacheHeader h;
+    std::memcpy(h.magic, "IBL1", 4);
+    h.version = IBL_CACHE_VERSION;
+    h.specularSize = (uint32_t)data.specularSize;
+    h.specularMips = (uint32_t)data.specularMips;
+    h.lutSize = (uint32_t)data.lutSize;
+    h.keyLow = (uint32_t)key;
+    h.keyHigh = (uint32_t)(key >> 32);
+    float sh[27];
+    for (int i = 0; i < 9; i++) { sh[i * 3] = data.sh[i].x; sh[i * 3 + 1] = data.sh[i].y; sh[i * 3 + 2] = data.sh[i].z; }
+
+    std::vector<uint8_t> bytes;
+    bytes.reserve(sizeof(h) + sizeof(sh) + (data.specular.size() + data.brdfLut.size()) * sizeof(uint16_t));
+    appendBytes(bytes, &h, sizeof(h));
+    appendBytes(bytes, sh, sizeof(sh));
+    appendBytes(bytes, data.specular.data(), data.specular.size() * sizeof(uint16_t));
+    appendBytes(bytes, data.brdfLut.data(), data.brdfLut.size() * sizeof(uint16_t));
+    return writeFileAtomically(path, bytes, error);
+}
+
+// the IBL for a skybox (faces in +X, -X, +Y, -Y, +Z, -Z order): from the cache in
+// cacheDir (default: the skybox's directory) when present, else computed and cached.
+// A failed cache write is reported but not an error.
+inline bool loadIBL(const std::vector<std::string>& faces, IBLData& out, IBLStats* stats = nullptr, std::string cacheDir = "",
+                    const IBLConfig& config = IBLConfig(), std::string* error = nullptr)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    IBLStats local;
+    IBLStats& st = stats ? *stats : local;
+    if (faces.size() != 6)
+    {
+        if (error) *error = "a skybox has 6 faces";
+        return false;
+    }
+
+    auto t0 = Clock::now();
+    uint64_t key = iblCacheKey(faces, config, error);
+    if (!key) return false;
+    st.hashMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    if (cacheDir.empty()) cacheDir = std::filesystem::path(faces[0]).parent_path().string();
+    std::ostringstream name;
+    name << "ibl-" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+    std::string cachePath = (std::filesystem::path(cacheDir) / name.str()).string();
+
+    t0 = Clock::now();
+    if (readIBLCache(cachePath, key, out))
+    {
+        st.cached = true;
+        st.cacheMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        return true;
+    }
+
+    // decode the faces in parallel (as rgb; the flip flag is global in stb_image, so set it first)
+    stbi_set_flip_vertically_on_load(false);
+    std::vector<unsigned char*> pixels(6, nullptr);
+    std::vector<int> widths(6, 0), heights(6, 0);
+    jobSystem().parallelFor(6, 1, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; i++)
+        {
+            int n;
+            pixels[i] = stbi_load(faces[i].c_str(), &widths[i], &heights[i], &n, 3);
+        }
+    });
+    bool ok = true;
+    for (int i = 0; i < 6; i++)
+        if (!pixels[i] || widths[i] != widths[0] || heights[i] != widths[0])
+        {
+            if (error) *error = "cannot use " + faces[i] + " as a skybox face (missing or not square like the others)";
+            ok = false;
+            break;
+        }
+    if (ok)
+    {
+        st.decodeMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        std::vector<const unsigned char*> faceData(pixels.begin(), pixels.end());
+        computeIBL(faceData, widths[0], config, out, st, jobSystem());
+    }
+    for (unsigned char* p : pixels) stbi_image_free(p);
+    if (!ok) return false;
+
+    t0 = Clock::now();
+    std::string cacheError;
+    if (!writeIBLCache(cachePath, key, out, &cacheError)) std::cerr << "ibl: " << cacheError << " (not cached)\n";
+    st.cacheMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    return true;
+}
+
+// ---- benchmark: precompute cost against thread count, and the cached path ----
+// A procedural sky (gradient and a sun) with 512^2 faces and the default settings.
+inline void runIBLBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const int width = 512;
+    std::vector<std::vector<unsigned char>> faces(6, std::vector<unsigned char>((size_t)width * width * 3));
+    const glm::vec3 sun = glm::normalize(glm::vec3(0.4f, 0.6f, 0.3f));
+    for (int face = 0; face < 6; face++)
+        for (int y = 0; y < width; y++)
+            for (int x = 0; x < width; x++)
+            {
+                glm::vec3 d = glm::normalize(CubeImage::direction(face, (x + 0.5f) / width, (y + 0.5f) / width));
+                glm::vec3 c = glm::mix(glm::vec3(0.35f, 0.3f, 0.25f), glm::vec3(0.3f, 0.5f, 0.9f), glm::clamp(d.y * 2.0f + 0.5f, 0.0f, 1.0f));
+                if (glm::dot(d, sun) > 0.995f) c = glm::vec3(1.0f);
+                unsigned char* p = &faces[face][((size_t)y * width + x) * 3];
+                for (int i = 0; i < 3; i++) p[i] = (unsigned char)(glm::clamp(c[i], 0.0f, 1.0f) * 255.0f);
+            }
+    std::vector<const unsigned char*> faceData;
+    for (const auto& f : faces) faceData.push_back(f.data());
+
+    std::cout << "ibl precompute" << std::setw(10) << "threads" << std::setw(12) << "SH ms" << std::setw(14) << "GGX ms"
+              << std::setw(12) << "LUT ms" << std::setw(12) << "total ms" << "\n";
+    IBLConfig config;
+    IBLData data;
+    for (unsigned int threads : { 1u, 2u, 4u, 8u })
+    {
+        JobSystem js(threads - 1);
+        IBLStats stats;
+        data = IBLData();
+        computeIBL(faceData, width, config, data, stats, js);
+        std::cout << std::setw(24) << threads << std::setw(12) << stats.shMs << std::setw(14) << stats.specularMs << std::setw(12)
+                  << stats.lutMs << std::setw(12) << stats.decodeMs + stats.shMs + stats.specularMs + stats.lutMs << "\n";
+    }
+
+    const std::string path = "ibl_bench.bin";
+    auto t0 = Clock::now();
+    writeIBLCache(path, 1, data);
+    double writeMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    IBLData cached;
+    t0 = Clock::now();
+    bool ok = readIBLCache(path, 1, cached);
+    double readMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    std::cout << "cache: " << (data.specular.size() + data.brdfLut.size()) * 2 / 1024 << " KiB, write " << writeMs << " ms, read "
+              << readMs << " ms" << (ok && cached.specular == data.specular ? "" : " (MISMATCH)") << "\n";
+    std::cout << "irradiance up " << evalSH(data.sh, glm::vec3(0, 1, 0)).b << ", down " << evalSH(data.sh, glm::vec3(0, -1, 0)).b << " (blue)\n";
+    std::filesystem::remove(path);
+}
+
+#endif
@@ -0,0 +1,386 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+// Engine-wide job system: one worker thread per extra core, each with its own deque.
+//
+// - a thread pushes and pops its own jobs at the back (LIFO, cache-warm); idle threads
+//   steal from the front of a random other deque. Deques are short mutex-guarded
+//   std::deques: jobs here are coarse (a chunk of cars, a BVH subtree, a face decode),
+//   so lock cost is noise next to the work.
+// - completion is tracked with JobCounters: run() increments, finishing decrements.
+//   A job may be held back until another counter drains (dependencies), and wait()
+//   runs other jobs instead of blocking, so jobs can wait on jobs.
+// - main-thread jobs (GL calls) go to a separate queue that only the thread that
+//   created the system drains, in pumpMainThread() or while it waits.
+// - per-thread stats: jobs run, busy time, steal attempts and successes.
+//
+// The thread that constructs the system is thread 0 and takes part in the work while
+// it waits; use jobSystem() for the shared instance and call it first from main().
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+class JobCounter
+{
+public:
+    // the lock makes sure the finishing thread has let go of the counter, so a waiter may
+    // destroy it as soon as this returns true
+    bool done()
+    {
+        if (pending.load(std::memory_order_acquire) != 0) return false;
+        std::lock_guard<std::mutex> l(lock);
+        return true;
+    }
+
+private:
+    friend class JobSystem;
+    struct Deferred
+    {
+        std::function<void()> fn;
+        JobCounter* counter;
+    };
+    std::atomic<int> pending{ 0 };
+    std::mutex lock;
+    std::vector<Deferred> waiting;   // jobs that start once this counter drains
+};
+
+class JobSystem
+{
+public:
+    struct ThreadStats
+    {
+        uint64_t jobs;
+        uint64_t stealAttempts, steals;
+        double busyMs;
+    };
+
+    static const unsigned int AUTO_WORKERS = ~0u;   // one worker per remaining core
+
+    // workers: threads besides the calling one; 0 runs every job on the calling thread
+    // (inside wait() and runPending()), AUTO_WORKERS sizes the system to the machine
+    explicit JobSystem(unsigned int workers = AUTO_WORKERS)
+    {
+        if (workers == AUTO_WORKERS) workers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        queues.resize(workers + 1);
+        for (auto& q : queues) q.reset(new Queue());
+        previous = local();
+        local().owner = this;
+        local().index = 0;
+        resetStats();
+        for (unsigned int i = 1; i <= workers; i++) threads.emplace_back([this, i]() { workerLoop(i); });
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> l(sleepLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : threads) t.join();
+        if (local().owner == this) local() = previous;   // nested systems (benchmarks) restore the outer one
+    }
+
+    unsigned int threadCount() const { return (unsigned int)queues.size(); }
+
+    // queues fn; `counter` (optional) drains when it has run. With `after`, the job is
+    // held back until that counter has drained.
+    void run(std::function<void()> fn, JobCounter* counter = nullptr, JobCounter* after = nullptr)
+    {
+        if (counter) counter->pending.fetch_add(1, std::memory_order_relaxed);
+        if (after)
+        {
+            std::lock_guard<std::mutex> l(after->lock);
+            if (after->pending.load(std::memory_order_acquire) != 0)
+            {
+                after->waiting.push_back({ std::move(fn), counter });
+                return;
+            }
+        }
+        push({ std::move(fn), counter });
+    }
+
+    // for work that must happen on thread 0 (GL calls); runs in pumpMainThread() or while
+    // thread 0 waits
+    void runOnMainThread(std::function<void()> fn, JobCounter* counter = nullptr)
+    {
+        if (counter) counter->pending.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> l(mainLock);
+        mainJobs.push_back({ std::move(fn), counter });
+    }
+
+    // runs queued main-thread jobs; call once per frame from thread 0
+    unsigned int pumpMainThread()
+    {
+        std::deque<Job> jobs;
+        {
+            std::lock_guard<std::mutex> l(mainLock);
+            jobs.swap(mainJobs);
+        }
+        for (Job& job : jobs) execute(job, 0);
+        return (unsigned int)jobs.size();
+    }
+
+    // runs one queued job on this thread, if any; lets thread 0 make progress on
+    // background work when there are no workers (single core)
+    bool runPending() { return runOne(index()); }
+
+    // returns once counter has drained, running other jobs in the meantime
+    void wait(JobCounter& counter)
+    {
+        int self = index();
+        while (!counter.done())
+        {
+            if (self == 0 && pumpMainThread()) continue;
+            if (!runOne(self)) std::this_thread::yield();
+        }
+    }
+
+    // splits [0, count) into `chunks` contiguous ranges and calls fn(begin, end, chunk)
+    // for each, chunk 0 on this thread; returns when all are done
+    template <typename F>
+    void parallelChunks(size_t count, size_t chunks, F fn)
+    {
+        chunks = std::max<size_t>(1, std::min(chunks, count));
+        JobCounter done;
+        for (size_t c = 1; c < chunks; c++)
+            run([&fn, count, chunks, c]() { fn(count * c / chunks, count * (c + 1) / chunks, c); }, &done);
+        // chunk 0 goes through execute() too so this thread's share shows up in stats()
+        Job first{ [&fn, count, chunks]() { fn(0, count / chunks, 0); }, nullptr };
+        execute(first, index());
+        wait(done);
+    }
+
+    // parallel for over [0, count) in chunks of at least minChunk, a few per thread so
+    // uneven chunks balance out through stealing
+    template <typename F>
+    void parallelFor(size_t count, size_t minChunk, F fn)
+    {
+        size_t chunks = std::min<size_t>(threadCount() * 4, (count + minChunk - 1) / std::max<size_t>(1, minChunk));
+        parallelChunks(count, chunks, fn);
+    }
+
+    std::vector<ThreadStats> stats() const
+    {
+        std::vector<ThreadStats> out;
+        for (const auto& q : queues)
+            out.push_back({ q->executed.load(), q->stealAttempts.load(), q->steals.load(), q->busyNs.load() / 1e6 });
+        return out;
+    }
+
+    void resetStats()
+    {
+        for (auto& q : queues) { q->executed = 0; q->stealAttempts = 0; q->steals = 0; q->busyNs = 0; }
+        statsStart = Clock::now();
+    }
+
+    // utilization = time spent inside jobs / wall time since resetStats()
+    void printStats(std::ostream& out) const
+    {
+        double wallMs = std::chrono::duration<double, std::milli>(Clock::now() - statsStart).count();
+        std::streamsize precision = out.precision();
+        out << "jobs" << std::setw(8) << "thread" << std::setw(10) << "jobs" << std::setw(10) << "busy %"
+            << std::setw(12) << "steals" << std::setw(12) << "steal %" << "\n";
+        std::vector<ThreadStats> s = stats();
+        for (size_t i = 0; i < s.size(); i++)
+            out << std::setw(12) << i << std::setw(10) << s[i].jobs << std::setw(10) << std::fixed << std::setprecision(1)
+                << (wallMs > 0.0 ? 100.0 * s[i].busyMs / wallMs : 0.0) << std::setw(12) << s[i].steals << std::setw(12)
+                << (s[i].stealAttempts ? 100.0 * s[i].steals / s[i].stealAttempts : 0.0) << std::defaultfloat << "\n";
+        out << std::setprecision(precision);
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Job
+    {
+        std::function<void()> fn;
+        JobCounter* counter;
+    };
+
+    struct alignas(64) Queue
+    {
+        std::mutex lock;
+        std::deque<Job> items;
+        std::atomic<uint64_t> executed{ 0 }, stealAttempts{ 0 }, steals{ 0 }, busyNs{ 0 };
+    };
+
+    struct ThreadLocal
+    {
+        const JobSystem* owner = nullptr;
+        int index = -1;
+        uint32_t rng = 0x9e3779b9u;
+    };
+    static ThreadLocal& local()
+    {
+        static thread_local ThreadLocal t;
+        return t;
+    }
+    ThreadLocal previous;
+
+    std::vector<std::unique_ptr<Queue>> queues;   // [0] is the creating thread's
+    std::vector<std::thread> threads;
+    std::atomic<int> queued{ 0 };
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::mutex mainLock;
+    std::deque<Job> mainJobs;
+    Clock::time_point statsStart;
+
+    // this thread's queue, or -1 for threads the system doesn't own
+    int index() const { return local().owner == this ? local().index : -1; }
+
+    void push(Job job)
+    {
+        int self = index();
+        Queue& q = *queues[self < 0 ? 0 : self];
+        {
+            std::lock_guard<std::mutex> l(q.lock);
+            q.items.push_back(std::move(job));
+        }
+        queued.fetch_add(1, std::memory_order_release);
+        {
+            // pairs with the predicate check in workerLoop so a wake-up can't be lost
+            std::lock_guard<std::mutex> l(sleepLock);
+        }
+        wake.notify_one();
+    }
+
+    bool take(int self, Job& job)
+    {
+        if (self >= 0)
+        {
+            Queue& own = *queues[self];
+            std::lock_guard<std::mutex> l(own.lock);
+            if (!own.items.empty())
+            {
+                job = std::move(own.items.back());
+                own.items.pop_back();
+                return true;
+            }
+        }
+        // steal from the front of someone else's deque, starting at a random victim
+        uint32_t& r = local().rng;
+        r ^= r << 13; r ^= r >> 17; r ^= r << 5;
+        size_t n = queues.size();
+        for (size_t k = 0; k < n; k++)
+        {
+            size_t victim = (r + k) % n;
+            if ((int)victim == self) continue;
+            if (self >= 0) queues[self]->stealAttempts.fetch_add(1, std::memory_order_relaxed);
+            Queue& q = *queues[victim];
+            std::lock_guard<std::mutex> l(q.lock);
+            if (q.items.empty()) continue;
+            job = std::move(q.items.front());
+            q.items.pop_front();
+            if (self >= 0) queues[self]->steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    bool runOne(int self)
+    {
+        Job job;
+        if (!take(self, job)) return false;
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        execute(job, self);
+        return true;
+    }
+
+    void execute(Job& job, int self)
+    {
+        auto t0 = Clock::now();
+        job.fn();
+        if (self >= 0)
+        {
+            Queue& q = *queues[self];
+            q.busyNs.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count(), std::memory_order_relaxed);
+            q.executed.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (job.counter) finish(*job.counter);
+    }
+
+    void finish(JobCounter& counter)
+    {
+        // drained: release the jobs that were waiting on it. Both happen under the lock;
+        // `counter` must not be touched after it is released.
+        std::vector<JobCounter::Deferred> ready;
+        {
+            std::lock_guard<std::mutex> l(counter.lock);
+            if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) ready.swap(counter.waiting);
+        }
+        for (JobCounter::Deferred& d : ready) push({ std::move(d.fn), d.counter });
+    }
+
+    void workerLoop(int self)
+    {
+        local().owner = this;
+        local().index = self;
+        local().rng = 0x9e3779b9u * (uint32_t)(self + 1);
+        for (;;)
+        {
+            if (runOne(self)) continue;
+            // a few yields before sleeping keeps latency low for bursts of small jobs
+            bool found = false;
+            for (int spin = 0; spin < 16 && !found; spin++)
+            {
+                std::this_thread::yield();
+                found = queued.load(std::memory_order_acquire) > 0;
+            }
+            if (found) continue;
+            std::unique_lock<std::mutex> l(sleepLock);
+            wake.wait(l, [this]() { return stopping || queued.load(std::memory_order_acquire) > 0; });
+            if (stopping) return;
+        }
+    }
+};
+
+// the engine-wide instance; the first caller becomes thread 0 (call it first from main)
+inline JobSystem& jobSystem()
+{
+    static JobSystem system(JobSystem::AUTO_WORKERS);
+    return system;
+}
+
+// ---- benchmark: parallel-for throughput, utilization and steal rates ----
+// Uneven work (every 8th chunk is 8x heavier) so stealing has something to balance.
+inline void runJobsBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    std::cout << "jobs: " << std::thread::hardware_concurrency() << " hardware threads\n";
+    for (unsigned int threads : { 1u, 2u, 4u, 8u })
+    {
+        JobSystem js(threads - 1);
+        const size_t items = 1 << 20;
+        std::vector<float> data(items, 1.0f);
+        js.resetStats();
+        auto t0 = Clock::now();
+        for (int rep = 0; rep < 20; rep++)
+            js.parallelFor(items, 4096, [&](size_t begin, size_t end, size_t chunk) {
+                int passes = (chunk % 8 == 0) ? 8 : 1;
+                for (int p = 0; p < passes; p++)
+                    for (size_t i = begin; i < end; i++) data[i] = std::sqrt(data[i] * 1.0001f + 0.5f);
+            });
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count() / 20;
+        std::cout << threads << " threads: " << ms << " ms per parallel-for\n";
+        js.printStats(std::cout);
+    }
+}
+
+#endif
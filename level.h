@@ -0,0 +1,652 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+// Levels: static geometry, the instances that place it, colliders, lights and spawn
+// points, in a flat binary file that is memory-mapped and used in place.
+//
+// The file is a header followed by one packed array per section. Every reference is a
+// 32-bit offset or index, never a pointer: strings are byte offsets into the string
+// section, instances index geometries, geometries index ranges of the shared vertex
+// and index arrays. So opening a level is mmap plus a validation pass that checks the
+// header, the content hash of the payload (recordings and the baked lighting caches are
+// keyed on it), that every section lies inside the file and that every index is in
+// range; nothing is parsed or copied, and the accessors hand out pointers into the
+// mapping.
+// Records hold only 32-bit fields and sections are 16-byte aligned; the layout is
+// little-endian, like every target we build for.
+//
+// Levels are written as text and compiled with convertLevelText() (or --convert-level);
+// loadLevel() recompiles a text level when its binary is missing or older. The text
+// format, one record per line, '#' starts a comment:
+//
+//   geometry NAME model PATH                      a model file (rest of the line), drawn with its own textures
+//   geometry NAME quad TEXTURE  x y z  x y z  x y z  x y z
+//                                                 one textured quad; it faces the side its
+//                                                 corners run clockwise from
+//   instance GEOMETRY MATERIAL  x y z  [yaw [scale]]   MATERIAL: floor, car or terrain
+//   collider  x y z  sx sy sz                     static box: centre and size
+//   light     x y z  [r g b  [range]]
+//   spawn     NAME  x y z  [yaw]                  yaw in degrees, 0 faces +Z
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "deterministic.h"
+#include "file_io.h"
+#include "renderer.h"
+
+#include <cctype>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ---- file layout ----
+
+enum class LevelSection : uint32_t { Strings, Vertices, Indices, Geometries, Instances, Colliders, Lights, Spawns, Count };
+
+struct LevelRange
+{
+    uint32_t offset;    // bytes from the start of the file
+    uint32_t count;     // elements
+};
+
+struct LevelHeader
+{
+    char magic[4];      // "LVL1"
+    uint32_t version;
+    uint32_t fileBytes;
+    uint32_t reserved;
+    uint32_t contentHash[2];    // FNV-1a of everything after the header (low, high)
+    LevelRange sections[(size_t)LevelSection::Count];
+};
+
+// vertices are 8 floats (position, normal, uv) like Renderer::createMesh; indices are
+// relative to firstVertex. Model geometries have no vertices and name a file instead
+struct LevelGeometry
+{
+    uint32_t name, model, texture;      // string offsets; 0 is the empty string
+    uint32_t firstVertex, vertexCount;
+    uint32_t firstIndex, indexCount;
+};
+
+struct LevelInstance
+{
+    uint32_t geometry;
+    uint32_t material;                  // Material
+    float model[12];                    // affine transform, 4 columns of xyz
+};
+
+struct LevelCollider { float min[3], max[3]; };
+
+struct LevelLight { float position[3], color[3], range; };
+
+struct LevelSpawn
+{
+    uint32_t name;
+    float position[3];
+    float yaw;                          // degrees
+};
+
+static_assert(sizeof(LevelHeader) == 24 + 8 * (size_t)LevelSection::Count, "LevelHeader must be packed");
+static_assert(sizeof(LevelGeometry) == 28 && sizeof(LevelInstance) == 56 && sizeof(LevelCollider) == 24 &&
+              sizeof(LevelLight) == 28 && sizeof(LevelSpawn) == 20, "level records must be packed");
+
+const uint32_t LEVEL_VERSION = 1;
+const uint32_t LEVEL_MATERIALS = 3;     // Floor, Car, Terrain
+
+inline glm::mat4 levelModelMatrix(const LevelInstance& instance)
+{
+    glm::mat4 m(1.0f);
+    for (int c = 0; c < 4; c++) m[c] = glm::vec4(instance.model[c * 3], instance.model[c * 3 + 1], instance.model[c * 3 + 2], c == 3 ? 1.0f : 0.0f);
+    return m;
+}
+
+// a section of the mapped file
+template <typename T>
+struct LevelArray
+{
+    const T* data = nullptr;
+    uint32_t count = 0;
+
+    const T& operator[](size_t i) const { return data[i]; }
+    const T* begin() const { return data; }
+    const T* end() const { return data + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+};
+
+// FNV-1a (StateHash) over the 32-bit words after the header; files are padded to 16 bytes
+inline uint64_t levelContentHash(const uint8_t* file, size_t bytes)
+{
+    StateHash hash;
+    for (size_t i = sizeof(LevelHeader); i + 4 <= bytes; i += 4)
+    {
+        uint32_t word;
+        std::memcpy(&word, file + i, 4);
+        hash.add(word);
+    }
+    return hash.value;
+}
+
+// ---- reading: map the file and use it in place ----
+
+class Level
+{
+public:
+    Level() = default;
+    ~Level() { close(); }
+
+    Level(const Level&) = delete;
+    Level& operator=(const Level&) = delete;
+
+    bool open(const std::string& path, std::string* error = nullptr)
+    {
+        close();
+        auto t0 = std::chrono::high_resolution_clock::now();
+        if (!map(path)) return fail(error, path + ": cannot map file");
+        if (!validate(error))
+        {
+            close();
+            return false;
+        }
+        openMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+        return true;
+    }
+
+    // a level already in memory (not owned; must outlive this object)
+    bool open(const void* data, size_t bytes, std::string* error = nullptr)
+    {
+        close();
+        base = (const uint8_t*)data;
+        size = bytes;
+        if (!validate(error))
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        unmap();
+        base = nullptr;
+        size = 0;
+    }
+
+    bool isOpen() const { return base != nullptr; }
+
+    LevelArray<float> vertices() const { return section<float>(LevelSection::Vertices); }
+    LevelArray<uint32_t> indices() const { return section<uint32_t>(LevelSection::Indices); }
+    LevelArray<LevelGeometry> geometries() const { return section<LevelGeometry>(LevelSection::Geometries); }
+    LevelArray<LevelInstance> instances() const { return section<LevelInstance>(LevelSection::Instances); }
+    LevelArray<LevelCollider> colliders() const { return section<LevelCollider>(LevelSection::Colliders); }
+    LevelArray<LevelLight> lights() const { return section<LevelLight>(LevelSection::Lights); }
+    LevelArray<LevelSpawn> spawns() const { return section<LevelSpawn>(LevelSection::Spawns); }
+
+    const char* string(uint32_t offset) const { return (const char*)base + header().sections[(size_t)LevelSection::Strings].offset + offset; }
+
+    const LevelSpawn* spawn(const char* name) const
+    {
+        for (const LevelSpawn& s : spawns())
+            if (!std::strcmp(string(s.name), name)) return &s;
+        return nullptr;
+    }
+
+    uint64_t contentHash() const { return (uint64_t)header().contentHash[1] << 32 | header().contentHash[0]; }
+    size_t bytes() const { return size; }
+    double openMilliseconds() const { return openMs; }
+
+    void printStats(std::ostream& out) const
+    {
+        out << "level: " << geometries().size() << " geometries, " << instances().size() << " instances, "
+            << colliders().size() << " colliders, " << lights().size() << " lights, " << spawns().size() << " spawns ("
+            << size / 1024 << " KB) opened in " << openMs << " ms\n";
+    }
+
+private:
+    const uint8_t* base = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    double openMs = 0.0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE, mapping = nullptr;
+#endif
+
+    const LevelHeader& header() const { return *(const LevelHeader*)base; }
+
+    template <typename T>
+    LevelArray<T> section(LevelSection s) const
+    {
+        LevelArray<T> a;
+        if (!base) return a;
+        const LevelRange& r = header().sections[(size_t)s];
+        a.data = (const T*)(base + r.offset);
+        a.count = r.count;
+        return a;
+    }
+
+    static bool fail(std::string* error, const std::string& message)
+    {
+        if (error) *error = message;
+        return false;
+    }
+
+    // O(header + indices): the header, section bounds, and every cross-reference
+    bool validate(std::string* error) const
+    {
+        static const size_t ELEMENT[] = { 1, sizeof(float), sizeof(uint32_t), sizeof(LevelGeometry), sizeof(LevelInstance),
+                                          sizeof(LevelCollider), sizeof(LevelLight), sizeof(LevelSpawn) };
+        if (size < sizeof(LevelHeader) || std::memcmp(header().magic, "LVL1", 4) != 0) return fail(error, "not a level file");
+        if (header().version != LEVEL_VERSION) return fail(error, "level version " + std::to_string(header().version) + ", expected " + std::to_string(LEVEL_VERSION));
+        if (header().fileBytes != size) return fail(error, "level file truncated");
+        if (levelContentHash(base, size) != contentHash()) return fail(error, "level file corrupted (content hash mismatch)");
+        for (size_t s = 0; s < (size_t)LevelSection::Count; s++)
+        {
+            const LevelRange& r = header().sections[s];
+            if (r.offset % 16 != 0 || (uint64_t)r.offset + (uint64_t)r.count * ELEMENT[s] > size)
+                return fail(error, "level section " + std::to_string(s) + " out of bounds");
+        }
+
+        uint32_t stringBytes = header().sections[(size_t)LevelSection::Strings].count;
+        if (stringBytes == 0 || string(stringBytes - 1)[0] != '\0') return fail(error, "level strings not terminated");
+        LevelArray<uint32_t> index = indices();
+        uint32_t vertexCount = vertices().count / 8;
+        for (const LevelGeometry& g : geometries())
+        {
+            if (g.name >= stringBytes || g.model >= stringBytes || g.texture >= stringBytes) return fail(error, "level geometry name out of range");
+            if ((uint64_t)g.firstVertex + g.vertexCount > vertexCount || (uint64_t)g.firstIndex + g.indexCount > index.count)
+                return fail(error, std::string("level geometry '") + string(g.name) + "' out of range");
+            for (uint32_t i = 0; i < g.indexCount; i++)
+                if (index[g.firstIndex + i] >= g.vertexCount) return fail(error, std::string("level geometry '") + string(g.name) + "' has a bad index");
+        }
+        uint32_t geometryCount = geometries().count;
+        for (const LevelInstance& inst : instances())
+            if (inst.geometry >= geometryCount || inst.material >= LEVEL_MATERIALS) return fail(error, "level instance out of range");
+        for (const LevelSpawn& s : spawns())
+            if (s.name >= stringBytes) return fail(error, "level spawn name out of range");
+        return true;
+    }
+
+#ifdef _WIN32
+    bool map(const std::string& path)
+    {
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER bytes;
+        if (!GetFileSizeEx(file, &bytes) || bytes.QuadPart == 0) return false;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) return false;
+        base = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        size = (size_t)bytes.QuadPart;
+        mapped = base != nullptr;
+        return mapped;
+    }
+
+    void unmap()
+    {
+        if (mapped) UnmapViewOfFile(base);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+        mapped = false;
+    }
+#else
+    bool map(const std::string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        void* p = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);    // the mapping keeps the file
+        if (p == MAP_FAILED) return false;
+        base = (const uint8_t*)p;
+        size = (size_t)st.st_size;
+        mapped = true;
+        return true;
+    }
+
+    void unmap()
+    {
+        if (mapped) munmap((void*)base, size);
+        mapped = false;
+    }
+#endif
+};
+
+// ---- writing ----
+
+class LevelBuilder
+{
+public:
+    LevelBuilder() { strings.push_back('\0'); }
+
+    uint32_t addString(const std::string& s)
+    {
+        if (s.empty()) return 0;
+        auto it = stringOffsets.find(s);
+        if (it != stringOffsets.end()) return it->second;
+        uint32_t offset = (uint32_t)strings.size();
+        strings.insert(strings.end(), s.begin(), s.end());
+        strings.push_back('\0');
+        stringOffsets[s] = offset;
+        return offset;
+    }
+
+    uint32_t addModel(const std::string& name, const std::string& path)
+    {
+        geometries.push_back({ addString(name), addString(path), 0, 0, 0, 0, 0 });
+        return (uint32_t)geometries.size() - 1;
+    }
+
+    uint32_t addMesh(const std::string& name, const std::string& texture, const float* vertexData, uint32_t vertexCount, const uint32_t* indexData, uint32_t indexCount)
+    {
+        LevelGeometry g = { addString(name), 0, addString(texture), (uint32_t)(vertices.size() / 8), vertexCount, (uint32_t)indices.size(), indexCount };
+        vertices.insert(vertices.end(), vertexData, vertexData + (size_t)vertexCount * 8);
+        indices.insert(indices.end(), indexData, indexData + indexCount);
+        geometries.push_back(g);
+        return (uint32_t)geometries.size() - 1;
+    }
+
+    void addInstance(uint32_t geometry, Material material, const glm::mat4& model)
+    {
+        LevelInstance inst;
+        inst.geometry = geometry;
+        inst.material = (uint32_t)material;
+        for (int c = 0; c < 4; c++)
+            for (int r = 0; r < 3; r++) inst.model[c * 3 + r] = model[c][r];
+        instances.push_back(inst);
+    }
+
+    void addCollider(const glm::vec3& min, const glm::vec3& max) { colliders.push_back({ { min.x, min.y, min.z }, { max.x, max.y, max.z } }); }
+
+    void addLight(const glm::vec3& position, const glm::vec3& color, float range)
+    {
+        lights.push_back({ { position.x, position.y, position.z }, { color.x, color.y, color.z }, range });
+    }
+
+    void addSpawn(const std::string& name, const glm::vec3& position, float yaw)
+    {
+        spawns.push_back({ addString(name), { position.x, position.y, position.z }, yaw });
+    }
+
+    int findGeometry(const std::string& name) const
+    {
+        auto it = stringOffsets.find(name);
+        if (it == stringOffsets.end()) return -1;
+        for (size_t g = 0; g < geometries.size(); g++)
+            if (geometries[g].name == it->second) return (int)g;
+        return -1;
+    }
+
+    std::vector<uint8_t> serialize() const
+    {
+        LevelHeader h = {};
+        std::memcpy(h.magic, "LVL1", 4);
+        h.version = LEVEL_VERSION;
+        std::vector<uint8_t> out(sizeof(LevelHeader));
+        auto append = [&](LevelSection s, const void* data, size_t count, size_t element) {
+            out.resize((out.size() + 15) & ~(size_t)15);
+            h.sections[(size_t)s] = { (uint32_t)out.size(), (uint32_t)count };
+            out.insert(out.end(), (const uint8_t*)data, (const uint8_t*)data + count * element);
+        };
+        append(LevelSection::Strings, strings.data(), strings.size(), 1);
+        append(LevelSection::Vertices, vertices.data(), vertices.size(), sizeof(float));
+        append(LevelSection::Indices, indices.data(), indices.size(), sizeof(uint32_t));
+        append(LevelSection::Geometries, geometries.data(), geometries.size(), sizeof(LevelGeometry));
+        append(LevelSection::Instances, instances.data(), instances.size(), sizeof(LevelInstance));
+        append(LevelSection::Colliders, colliders.data(), colliders.size(), sizeof(LevelCollider));
+        append(LevelSection::Lights, lights.data(), lights.size(), sizeof(LevelLight));
+        append(LevelSection::Spawns, spawns.data(), spawns.size(), sizeof(LevelSpawn));
+        out.resize((out.size() + 15) & ~(size_t)15);
+        h.fileBytes = (uint32_t)out.size();
+
+        uint64_t hash = levelContentHash(out.data(), out.size());
+        h.contentHash[0] = (uint32_t)hash;
+        h.contentHash[1] = (uint32_t)(hash >> 32);
+        std::memcpy(out.data(), &h, sizeof(h));
+        return out;
+    }
+
+    // replaced atomically (file_io.h), so a running game never maps half a file
+    bool save(const std::string& path, std::string* error = nullptr) const
+    {
+        return writeFileAtomically(path, serialize(), error);
+    }
+
+    size_t instanceCount() const { return instances.size(); }
+
+private:
+    std::vector<char> strings;
+    std::unordered_map<std::string, uint32_t> stringOffsets;
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<LevelGeometry> geometries;
+    std::vector<LevelInstance> instances;
+    std::vector<LevelCollider> colliders;
+    std::vector<LevelLight> lights;
+    std::vector<LevelSpawn> spawns;
+};
+
+// ---- text format -> binary ----
+
+inline bool parseLevelText(std::istream& in, const std::string& source, LevelBuilder& level, std::string* error = nullptr)
+{
+    std::string line;
+    int lineNumber = 0;
+    auto fail = [&](const std::string& message) {
+        if (error) *error = source + ":" + std::to_string(lineNumber) + ": " + message;
+        return false;
+    };
+    while (std::getline(in, line))
+    {
+        lineNumber++;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        std::istringstream words(line);
+        std::string kind;
+        if (!(words >> kind)) continue;
+
+        if (kind == "geometry")
+        {
+            std::string name, type;
+            if (!(words >> name >> type)) return fail("expected: geometry NAME model|quad ...");
+            if (level.findGeometry(name) >= 0) return fail("geometry '" + name + "' defined twice");
+            if (type == "model")
+            {
+                std::string path;   // the rest of the line: model paths may hold spaces
+                std::getline(words >> std::ws, path);
+                while (!path.empty() && std::isspace((unsigned char)path.back())) path.pop_back();
+                if (path.empty()) return fail("expected: geometry NAME model PATH");
+                level.addModel(name, path);
+            }
+            else if (type == "quad")
+            {
+                std::string texture;
+                glm::vec3 p[4];
+                if (!(words >> texture)) return fail("expected: geometry NAME quad TEXTURE x y z x y z x y z x y z");
+                for (glm::vec3& c : p)
+                    if (!(words >> c.x >> c.y >> c.z)) return fail("quad needs four corners");
+                glm::vec3 n = glm::cross(p[3] - p[0], p[1] - p[0]);
+                if (glm::length(n) == 0.0f) return fail("degenerate quad");
+                n = glm::normalize(n);
+                const float uv[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+                float v[32];
+                for (int k = 0; k < 4; k++)
+                {
+                    float vertex[8] = { p[k].x, p[k].y, p[k].z, n.x, n.y, n.z, uv[k][0], uv[k][1] };
+                    std::memcpy(v + k * 8, vertex, sizeof(vertex));
+                }
+                const uint32_t quad[6] = { 0, 1, 2, 2, 3, 0 };
+                level.addMesh(name, texture, v, 4, quad, 6);
+            }
+            else return fail("unknown geometry type '" + type + "'");
+        }
+        else if (kind == "instance")
+        {
+            std::string name, material;
+            glm::vec3 p;
+            if (!(words >> name >> material >> p.x >> p.y >> p.z)) return fail("expected: instance GEOMETRY MATERIAL x y z [yaw [scale]]");
+            float yaw = 0.0f, scale = 1.0f;
+            if (words >> yaw) words >> scale;
+            int g = level.findGeometry(name);
+            if (g < 0) return fail("unknown geometry '" + name + "'");
+            Material m;
+            if (material == "floor") m = Material::Floor;
+            else if (material == "car") m = Material::Car;
+            else if (material == "terrain") m = Material::Terrain;
+            else return fail("unknown material '" + material + "'");
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), p);
+            model = glm::rotate(model, glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f));
+            level.addInstance((uint32_t)g, m, glm::scale(model, glm::vec3(scale)));
+        }
+        else if (kind == "collider")
+        {
+            glm::vec3 c, s;
+            if (!(words >> c.x >> c.y >> c.z >> s.x >> s.y >> s.z)) return fail("expected: collider x y z sx sy sz");
+            level.addCollider(c - s * 0.5f, c + s * 0.5f);
+        }
+        else if (kind == "light")
+        {
+            glm::vec3 p, color(1.0f);
+            float range = 0.0f;
+            if (!(words >> p.x >> p.y >> p.z)) return fail("expected: light x y z [r g b [range]]");
+            if (words >> color.r)
+            {
+                if (!(words >> color.g >> color.b)) return fail("light colour needs all of r g b");
+                words >> range;
+            }
+            level.addLight(p, color, range);
+        }
+        else if (kind == "spawn")
+        {
+            std::string name;
+            glm::vec3 p;
+            float yaw = 0.0f;
+            if (!(words >> name >> p.x >> p.y >> p.z)) return fail("expected: spawn NAME x y z [yaw]");
+            words >> yaw;
+            level.addSpawn(name, p, yaw);
+        }
+        else return fail("unknown record '" + kind + "'");
+    }
+    return true;
+}
+
+inline bool convertLevelText(const std::string& textPath, const std::string& levelPath, std::string* error = nullptr)
+{
+    std::ifstream in(textPath);
+    if (!in)
+    {
+        if (error) *error = "cannot read " + textPath;
+        return false;
+    }
+    LevelBuilder level;
+    return parseLevelText(in, textPath, level, error) && level.save(levelPath, error);
+}
+
+// opens a binary level; for a .txt level, opens its compiled .lvl next to it,
+// (re)compiling it first when it is missing or older than the text
+inline bool loadLevel(Level& level, const std::string& path, std::string* error = nullptr)
+{
+    const std::string ext = ".txt";
+    if (path.size() < ext.size() || path.compare(path.size() - ext.size(), ext.size(), ext) != 0) return level.open(path, error);
+
+    std::string binary = path.substr(0, path.size() - ext.size()) + ".lvl";
+    std::error_code ec;
+    auto textTime = std::filesystem::last_write_time(path, ec);
+    if (ec)
+    {
+        if (error) *error = "cannot read " + path;
+        return false;
+    }
+    auto binaryTime = std::filesystem::last_write_time(binary, ec);
+    if ((ec || binaryTime < textTime) && !convertLevelText(path, binary, error)) return false;
+    return level.open(binary, error);
+}
+
+// ---- benchmark: text conversion and opening a level with 100k entities ----
+// 100k instances of a handful of geometries plus 100k colliders, 1k lights and 1k
+// spawns. "open" maps and validates the file; "open + read" also walks every instance
+// and collider once, which is what building the scene touches.
+inline void runLevelBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const int ENTITIES = 100000, EXTRAS = 1000, RUNS = 20;
+    const std::string textPath = "level_bench.txt", levelPath = "level_bench.lvl";
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> coord(-1000.0f, 1000.0f), unit(0.0f, 1.0f);
+    {
+        std::ofstream text(textPath);
+        text << "geometry car model resources/objects/AC Cobra/Shelby.obj\n";
+        for (int g = 0; g < 8; g++)
+            text << "geometry panel" << g << " quad resources/textures/wood.png  -2 0 0  2 0 0  2 4 0  -2 4 0\n";
+        for (int i = 0; i < ENTITIES; i++)
+            text << "instance panel" << i % 8 << " floor " << coord(rng) << " 0 " << coord(rng) << " " << unit(rng) * 360.0f << "\n";
+        for (int i = 0; i < ENTITIES; i++)
+            text << "collider " << coord(rng) << " 2 " << coord(rng) << " 4 4 0.5\n";
+        for (int i = 0; i < EXTRAS; i++)
+            text << "light " << coord(rng) << " 10 " << coord(rng) << " 1 0.9 0.8 30\n";
+        for (int i = 0; i < EXTRAS; i++)
+            text << "spawn start" << i << " " << coord(rng) << " 0 " << coord(rng) << " " << unit(rng) * 360.0f << "\n";
+    }
+
+    std::string error;
+    auto t0 = Clock::now();
+    if (!convertLevelText(textPath, levelPath, &error)) { std::cerr << error << "\n"; return; }
+    double convertMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+    Level level;
+    double openMs = 1e30, readMs = 1e30;
+    float checksum = 0.0f;
+    for (int r = 0; r < RUNS; r++)
+    {
+        t0 = Clock::now();
+        if (!level.open(levelPath, &error)) { std::cerr << error << "\n"; return; }
+        openMs = std::min(openMs, std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+        for (const LevelInstance& inst : level.instances()) checksum += inst.model[9];
+        for (const LevelCollider& c : level.colliders()) checksum += c.max[0] - c.min[0];
+        readMs = std::min(readMs, std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+        level.close();
+    }
+
+    level.open(levelPath);
+    std::cout << "level: " << ENTITIES << " instances + " << ENTITIES << " colliders + " << EXTRAS << " lights + " << EXTRAS
+              << " spawns, " << level.bytes() / 1024 << " KB (text " << std::filesystem::file_size(textPath) / 1024 << " KB)\n";
+    std::cout << std::setw(20) << "convert text" << std::setw(12) << convertMs << " ms\n";
+    std::cout << std::setw(20) << "open (map+check)" << std::setw(12) << openMs << " ms  (best of " << RUNS << ")\n";
+    std::cout << std::setw(20) << "open + read all" << std::setw(12) << readMs << " ms  (checksum " << checksum << ")\n";
+    level.close();
+    std::remove(textPath.c_str());
+    std::remove(levelPath.c_str());
+}
+
+#endif
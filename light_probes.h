@@ -0,0 +1,486 @@
+#ifndef LIGHT_PROBES_H
+#define LIGHT_PROBES_H
+
+// Baked light for what moves (LightProbeSH in renderer.h): a grid of light probes over
+// the level, traced once with the static scene.
+//
+// The lightmap (lightmap.h) lights what never moves; the cars got nothing from the
+// level's lights at all, only the sky's ambient and their reflections. Real-time lights
+// per car would cost per fragment and per car, thousands of times over with traffic.
+// Instead the light around the ground is sampled ahead of time at points in the air:
+//  - the grid: columns every `spacing` units over the square of `radius` around
+//    `centre` (the lightmap's ground chart by default), `layers` probes per column from
+//    firstLayer above the ground up, layerSpacing apart. Layers follow the ground, so
+//    the terrain never buries a probe and a car sits in its column's lowest layers
+//    wherever it drives.
+//  - each probe: L1 spherical harmonics per colour channel, four numbers each, of the
+//    light arriving there. Every level light that a shadow ray reaches adds its colour
+//    as a clamped cosine lobe toward it (faded over its range like the lightmap's direct
+//    term), and `samples` rays spread evenly over the sphere (a spherical Fibonacci set,
+//    four to a packet) gather the direct light where they hit the scene times albedo,
+//    the lightmap's one bounce. Escaped rays gather nothing: the sky stays the runtime
+//    SH ambient, which the cars already get.
+//
+// The scene, its packet tracer, albedo and bias are the lightmap's (buildLightmapScene,
+// lightmapDirect). Probes are spread over the job system in fours. At run time
+// LightProbeGrid::sample() blends the eight probes around a point - 12 floats each,
+// trilinear - once per car per frame on the CPU, and the car shaders evaluate the
+// result per fragment with their normal: one dot product per channel, no lights to
+// loop over. The grid is cached next to the level as lightprobes-<hash>.bin, keyed by
+// the traced triangles, the lights, the probe positions and the settings.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "bvh.h"
+#include "deterministic.h"
+#include "file_io.h"
+#include "heightfield.h"
+#include "jobs.h"
+#include "level.h"
+#include "lightmap.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct LightProbeConfig
+{
+    glm::vec2 centre = glm::vec2(0.0f);   // xz
+    float radius = 64.0f;               // half the side of the grid
+    float spacing = 4.0f;               // between columns; rounded so that columns land on both edges
+    int layers = 3;
+    float firstLayer = 0.5f;            // above the ground
+    float layerSpacing = 2.0f;
+    int samples = 64;                   // rays per probe, rounded down to a multiple of 4
+};
+
+struct LightProbeStats
+{
+    bool cached = false;
+    unsigned int threads = 0;
+    size_t probes = 0;
+    uint64_t rays = 0;
+    double sceneMs = 0.0, hashMs = 0.0, bakeMs = 0.0, cacheMs = 0.0;
+
+    void print(std::ostream& out) const
+    {
+        out << "light probes: " << probes << " probes, scene " << sceneMs << " ms, hash " << hashMs << " ms, ";
+        if (cached) out << "cache read " << cacheMs << " ms\n";
+        else
+            out << "bake " << bakeMs << " ms (" << rays / 1e6 << "M rays, " << rays / 1e3 / std::max(1e-3, bakeMs) << " Mrays/s) on "
+                << threads << " threads, cache write " << cacheMs << " ms\n";
+    }
+};
+
+struct LightProbeGrid
+{
+    glm::vec2 origin = glm::vec2(0.0f);     // xz of column (0, 0)
+    float spacing = 1.0f;
+    float firstLayer = 0.0f, layerSpacing = 1.0f;
+    int columnsX = 0, columnsZ = 0, layers = 0;
+    std::vector<float> ground;              // per column, the ground's height under it
+    std::vector<LightProbeSH> probes;       // x fastest, then z, then the layer
+
+    bool valid() const { return !probes.empty(); }
+
+    size_t index(int x, int z, int layer) const { return ((size_t)layer * columnsZ + z) * columnsX + x; }
+
+    glm::vec3 position(int x, int z, int layer) const
+    {
+        return glm::vec3(origin.x + x * spacing, ground[(size_t)z * columnsX + x] + firstLayer + layer * layerSpacing,
+                         origin.y + z * spacing);
+    }
+
+    // the probes around p, blended trilinearly; outside the grid, its nearest edge
+    LightProbeSH sample(const glm::vec3& p) const
+    {
+        LightProbeSH out = { glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f) };
+        if (!valid()) return out;
+        auto cell = [](float f, int n, int& i0, int& i1) {
+            f = glm::clamp(f, 0.0f, (float)(n - 1));
+            i0 = std::min((int)f, n - 1);
+            i1 = std::min(i0 + 1, n - 1);
+            return f - (float)i0;
+        };
+        int x0, x1, z0, z1, y0, y1;
+        float tx = cell((p.x - origin.x) / spacing, columnsX, x0, x1);
+        float tz = cell((p.z - origin.y) / spacing, columnsZ, z0, z1);
+        // height above the ground, which the layers follow
+        float h = glm::mix(glm::mix(ground[(size_t)z0 * columnsX + x0], ground[(size_t)z0 * columnsX + x1], tx),
+                           glm::mix(ground[(size_t)z1 * columnsX + x0], ground[(size_t)z1 * columnsX + x1], tx), tz);
+        float ty = cell((p.y - h - firstLayer) / layerSpacing, layers, y0, y1);
+        for (int c = 0; c < 8; c++)
+        {
+            int x = c & 1 ? x1 : x0, z = c & 2 ? z1 : z0, y = c & 4 ? y1 : y0;
+            float w = (c & 1 ? tx : 1.0f - tx) * (c & 2 ? tz : 1.0f - tz) * (c & 4 ? ty : 1.0f - ty);
+            const LightProbeSH& probe = probes[index(x, z, y)];
+            out.r += probe.r * w;
+            out.g += probe.g * w;
+            out.b += probe.b * w;
+        }
+        return out;
+    }
+};
+
+// the light a probe's SH gives a surface facing n, as the car shaders evaluate it
+inline glm::vec3 lightProbeIrradiance(const LightProbeSH& sh, const glm::vec3& n)
+{
+    glm::vec4 d(1.0f, n);
+    return glm::max(glm::vec3(glm::dot(sh.r, d), glm::dot(sh.g, d), glm::dot(sh.b, d)), glm::vec3(0.0f));
+}
+
+// light of `color` arriving from direction d, projected onto L1 with the cosine lobe
+// folded in: a lobe of one light is 1/4 + n.d / 2, one of n samples over the sphere
+// 1/n + 2 n.d / n (times 4 pi over n samples, over pi for the floor's scale)
+inline void addLightProbeLobe(LightProbeSH& sh, const glm::vec3& color, const glm::vec3& d, float constant, float linear)
+{
+    sh.r += glm::vec4(constant, d * linear) * color.r;
+    sh.g += glm::vec4(constant, d * linear) * color.g;
+    sh.b += glm::vec4(constant, d * linear) * color.b;
+}
+
+// places the grid's columns and layers over the ground (flat at y = 0 when null); no probes yet
+inline void layoutLightProbes(const LightProbeConfig& config, const Heightfield* ground, LightProbeGrid& grid)
+{
+    float side = 2.0f * std::max(config.radius, 1e-3f);
+    int columns = std::max(2, (int)std::ceil(side / std::max(config.spacing, 1e-3f)) + 1);
+    grid.origin = config.centre - glm::vec2(config.radius);
+    grid.spacing = side / (float)(columns - 1);
+    grid.columnsX = grid.columnsZ = columns;
+    grid.layers = std::max(1, config.layers);
+    grid.firstLayer = config.firstLayer;
+    grid.layerSpacing = std::max(config.layerSpacing, 1e-3f);
+    grid.ground.assign((size_t)columns * columns, 0.0f);
+    if (ground)
+        for (int z = 0; z < columns; z++)
+            for (int x = 0; x < columns; x++)
+                grid.ground[(size_t)z * columns + x] = ground->height(grid.origin.x + x * grid.spacing, grid.origin.y + z * grid.spacing);
+    grid.probes.clear();
+}
+
+// traces every probe of a laid out grid through the lightmap scene
+inline void bakeLightProbes(const LightmapScene& scene, const LightmapConfig& sceneConfig, const LightProbeConfig& config,
+                            LightProbeGrid& grid, LightProbeStats& stats, JobSystem& jobs)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    size_t count = (size_t)grid.columnsX * grid.columnsZ * grid.layers;
+    grid.probes.assign(count, LightProbeSH{ glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f) });
+
+    // the same directions for every probe, evenly spread: spherical Fibonacci
+    int samples = std::max(4, config.samples & ~3);
+    std::vector<glm::vec3> dirs(samples);
+    for (int k = 0; k < samples; k++)
+    {
+        float y = 1.0f - (2.0f * k + 1.0f) / samples, r = std::sqrt(std::max(0.0f, 1.0f - y * y));
+        float phi = 2.3999632f * k;     // the golden angle
+        dirs[k] = glm::vec3(r * std::cos(phi), y, r * std::sin(phi));
+    }
+    std::atomic<uint64_t> rays(0);
+
+    auto t0 = Clock::now();
+    jobs.parallelFor((count + 3) / 4, 4, [&](size_t begin, size_t end, size_t) {
+        uint64_t local = 0;
+        for (size_t group = begin; group < end; group++)
+        {
+            glm::vec3 p[4];
+            int lanes = 0;
+            for (int r = 0; r < 4 && group * 4 + r < count; r++)
+            {
+                size_t i = group * 4 + r;
+                int layer = (int)(i / ((size_t)grid.columnsX * grid.columnsZ));
+                size_t column = i % ((size_t)grid.columnsX * grid.columnsZ);
+                p[r] = grid.position((int)(column % grid.columnsX), (int)(column / grid.columnsX), layer);
+                lanes |= 1 << r;
+            }
+
+            // direct: one shadow packet per light for the four probes
+            for (const LevelLight& light : scene.lights)
+            {
+                glm::vec3 position(light.position[0], light.position[1], light.position[2]);
+                BVHRayPacket packet = emptyLightmapPacket();
+                glm::vec3 d[4];
+                float fade[4] = {};
+                int cast = 0;
+                for (int r = 0; r < 4; r++)
+                {
+                    if (!(lanes & (1 << r))) continue;
+                    d[r] = position - p[r];
+                    float distance = glm::length(d[r]);
+                    if (distance < 1e-4f) continue;
+                    d[r] /= distance;
+                    fade[r] = 1.0f;
+                    if (light.range > 0.0f)
+                    {
+                        fade[r] = glm::clamp(1.0f - distance / light.range, 0.0f, 1.0f);
+                        fade[r] *= fade[r];
+                    }
+                    if (fade[r] <= 0.0f) continue;
+                    setLightmapRay(packet, r, p[r], d[r], distance);
+                    cast |= 1 << r;
+                }
+                if (!cast) continue;
+                BVHRayHit hits[4];
+                int blocked = traceLightmapPacket(scene, packet, hits, true);
+                glm::vec3 color(light.color[0], light.color[1], light.color[2]);
+                for (int r = 0; r < 4; r++)
+                {
+                    if (!(cast & (1 << r))) continue;
+                    local++;
+                    if (!(blocked & (1 << r))) addLightProbeLobe(grid.probes[group * 4 + r], color * fade[r], d[r], 0.25f, 0.5f);
+                }
+            }
+
+            // one bounce: each probe's rays four at a time
+            for (int r = 0; r < 4; r++)
+            {
+                if (!(lanes & (1 << r))) continue;
+                LightProbeSH& sh = grid.probes[group * 4 + r];
+                for (int k = 0; k < samples; k += 4)
+                {
+                    BVHRayPacket packet;
+                    for (int s = 0; s < 4; s++) setLightmapRay(packet, s, p[r], dirs[k + s], 1e30f);
+                    BVHRayHit hits[4];
+                    int hit = traceLightmapPacket(scene, packet, hits, false);
+                    local += 4;
+                    if (!hit) continue;
+                    glm::vec3 hp[4], hn[4], direct[4];
+                    for (int s = 0; s < 4; s++)
+                    {
+                        if (!(hit & (1 << s))) continue;
+                        hp[s] = p[r] + dirs[k + s] * hits[s].t;
+                        hn[s] = scene.triangles[hits[s].prim].normal;
+                        if (glm::dot(hn[s], dirs[k + s]) > 0.0f) hn[s] = -hn[s];
+                    }
+                    lightmapDirect(scene, sceneConfig, hp, hn, hit, direct, local);
+                    for (int s = 0; s < 4; s++)
+                        if (hit & (1 << s))
+                            addLightProbeLobe(sh, direct[s] * sceneConfig.albedo, dirs[k + s], 1.0f / samples, 2.0f / samples);
+                }
+            }
+        }
+        rays += local;
+    });
+    stats.bakeMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    stats.probes = count;
+    stats.rays = rays;
+    stats.threads = jobs.threadCount();
+}
+
+// ---- disk cache ----
+
+struct LightProbeCacheHeader
+{
+    char magic[4];              // "LPG1"
+    uint32_t version;
+    uint32_t columnsX, columnsZ, layers;
+    uint32_t keyLow, keyHigh;   // the hash it was baked for
+};
+
+const uint32_t LIGHT_PROBE_CACHE_VERSION = 1;
+
+// everything the probes depend on: the traced triangles, the lights, where the probes stand and the settings
+inline uint64_t lightProbeCacheKey(const LightmapScene& scene, const LightmapConfig& sceneConfig, const LightProbeConfig& config,
+                                   const LightProbeGrid& grid)
+{
+    StateHash hash;
+    hash.add(LIGHT_PROBE_CACHE_VERSION);
+    for (float f : { sceneConfig.albedo, sceneConfig.bias, grid.origin.x, grid.origin.y, grid.spacing, grid.firstLayer, grid.layerSpacing })
+        hash.add(f);
+    for (int v : { config.samples, grid.columnsX, grid.columnsZ, grid.layers })
+        hash.add((uint32_t)v);
+    hash.add(grid.ground);
+    for (const LightmapTriangle& t : scene.triangles)
+    {
+        hash.add(t.v0);
+        hash.add(t.e1);
+        hash.add(t.e2);
+    }
+    for (const LevelLight& l : scene.lights)
+        for (float f : { l.position[0], l.position[1], l.position[2], l.color[0], l.color[1], l.color[2], l.range })
+            hash.add(f);
+    return hash.value;
+}
+
+inline bool readLightProbeCache(const std::string& path, uint64_t key, LightProbeGrid& grid)
+{
+    std::ifstream in(path, std::ios::binary);
+    LightProbeCacheHeader h;
+    if (!in.read((char*)&h, sizeof(h))) return false;
+    if (std::memcmp(h.magic, "LPG1", 4) != 0 || h.version != LIGHT_PROBE_CACHE_VERSION || h.keyLow != (uint32_t)key ||
+        h.keyHigh != (uint32_t)(key >> 32) || h.columnsX != (uint32_t)grid.columnsX || h.columnsZ != (uint32_t)grid.columnsZ ||
+        h.layers != (uint32_t)grid.layers)
+        return false;
+    grid.probes.resize((size_t)grid.columnsX * grid.columnsZ * grid.layers);
+    in.read((char*)grid.probes.data(), (std::streamsize)(grid.probes.size() * sizeof(LightProbeSH)));
+    if (!in)
+    {
+        grid.probes.clear();
+        return false;
+    }
+    return true;
+}
+
+inline bool writeLightProbeCache(const std::string& path, uint64_t key, const LightProbeGrid& grid, std::string* error = nullptr)
+{
+    LightProbeCacheHeader h;
+    std::memcpy(h.magic, "LPG1", 4);
+    h.version = LIGHT_PROBE_CACHE_VERSION;
+    h.columnsX = (uint32_t)grid.columnsX;
+    h.columnsZ = (uint32_t)grid.columnsZ;
+    h.layers = (uint32_t)grid.layers;
+    h.keyLow = (uint32_t)key;
+    h.keyHigh = (uint32_t)(key >> 32);
+
+    std::vector<uint8_t> bytes;
+    bytes.reserve(sizeof(h) + grid.probes.size() * sizeof(LightProbeSH));
+    appendBytes(bytes, &h, sizeof(h));
+    appendBytes(bytes, grid.probes.data(), grid.probes.size() * sizeof(LightProbeSH));
+    return writeFileAtomically(path, bytes, error);
+}
+
+// the light probes of a level over its ground (flat when ground is null), through the
+// scene sceneConfig describes: from the cache in cacheDir when present, else baked on the
+// job system and cached. A failed cache write is reported but not an error; a level
+// without lights has nothing to bake.
+inline bool loadLightProbes(const Level& level, const Heightfield* ground, LightProbeGrid& out, LightProbeStats* stats = nullptr,
+                            const std::string& cacheDir = "", const LightProbeConfig& config = LightProbeConfig(),
+                            const LightmapConfig& sceneConfig = LightmapConfig(), std::string* error = nullptr)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    LightProbeStats local;
+    LightProbeStats& st = stats ? *stats : local;
+    if (level.lights().empty())
+    {
+        if (error) *error = "the level has no lights to bake";
+        return false;
+    }
+
+    auto t0 = Clock::now();
+    LightmapScene scene;
+    buildLightmapScene(level, ground, sceneConfig, scene);
+    layoutLightProbes(config, ground, out);
+    st.sceneMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    st.probes = (size_t)out.columnsX * out.columnsZ * out.layers;
+
+    t0 = Clock::now();
+    uint64_t key = lightProbeCacheKey(scene, sceneConfig, config, out);
+    st.hashMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    std::ostringstream name;
+    name << "lightprobes-" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+    std::string cachePath = (std::filesystem::path(cacheDir) / name.str()).string();
+
+    t0 = Clock::now();
+    if (readLightProbeCache(cachePath, key, out))
+    {
+        st.cached = true;
+        st.cacheMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        return true;
+    }
+
+    bakeLightProbes(scene, sceneConfig, config, out, st, jobSystem());
+    t0 = Clock::now();
+    std::string cacheError;
+    if (!writeLightProbeCache(cachePath, key, out, &cacheError)) std::cerr << "light probes: " << cacheError << " (not cached)\n";
+    st.cacheMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    return true;
+}
+
+// ---- benchmark: bake time against thread count, and the per-car sampling cost ----
+// The lightmap benchmark's arena (a panel and a ring of twelve under one light, over the
+// default heightfield terrain), then 4096 cars scattered over the grid sampled per frame.
+inline void runLightProbeBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    LevelBuilder builder;
+    const float quad[] = { -2, 0, 0, 0, 0, 1, 0, 0,   2, 0, 0, 0, 0, 1, 1, 0,   2, 4, 0, 0, 0, 1, 1, 1,   -2, 4, 0, 0, 0, 1, 0, 1 };
+    const uint32_t quadIndices[] = { 0, 1, 2, 0, 2, 3 };
+    uint32_t panel = builder.addMesh("panel", "", quad, 4, quadIndices, 6);
+    builder.addInstance(panel, Material::Floor, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 20.0f)));
+    for (int i = 0; i < 12; i++)
+    {
+        float angle = glm::radians(30.0f * i);
+        glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(std::sin(angle), 0.0f, std::cos(angle)) * 12.0f);
+        builder.addInstance(panel, Material::Floor, glm::rotate(m, angle, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+    builder.addLight(glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(1.0f), 0.0f);
+    std::vector<uint8_t> bytes = builder.serialize();
+    Level level;
+    std::string error;
+    if (!level.open(bytes.data(), bytes.size(), &error)) { std::cerr << error << "\n"; return; }
+    Heightfield ground;
+
+    LightmapConfig sceneConfig;
+    LightProbeConfig config;
+    LightmapScene scene;
+    LightProbeGrid grid;
+    auto t0 = Clock::now();
+    buildLightmapScene(level, &ground, sceneConfig, scene);
+    layoutLightProbes(config, &ground, grid);
+    double sceneMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    std::cout << "light probes: " << grid.columnsX << "x" << grid.columnsZ << "x" << grid.layers << " probes, "
+              << std::max(4, config.samples & ~3) << " rays each, " << scene.triangles.size() << " triangles, scene and BVH "
+              << sceneMs << " ms\n";
+
+    std::cout << "probe bake" << std::setw(14) << "threads" << std::setw(12) << "bake ms" << std::setw(10) << "Mrays/s"
+              << std::setw(10) << "speedup\n";
+    double serialMs = 0.0;
+    for (unsigned int threads : { 1u, 2u, 4u, 8u })
+    {
+        JobSystem js(threads - 1);
+        LightProbeStats stats;
+        bakeLightProbes(scene, sceneConfig, config, grid, stats, js);
+        if (threads == 1) serialMs = stats.bakeMs;
+        std::cout << std::setw(24) << threads << std::setw(12) << stats.bakeMs << std::setw(10)
+                  << stats.rays / 1e3 / std::max(1e-3, stats.bakeMs) << std::setw(9) << serialMs / stats.bakeMs << "x\n";
+    }
+
+    // what a frame of traffic costs: one sample per car, on the ground like the cars
+    const int cars = 4096, frames = 100;
+    std::vector<glm::vec3> positions(cars);
+    uint32_t seed = 1;
+    for (glm::vec3& p : positions)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        p.x = config.centre.x + ((seed >> 8) / 16777216.0f * 2.0f - 1.0f) * config.radius;
+        seed = seed * 1664525u + 1013904223u;
+        p.z = config.centre.y + ((seed >> 8) / 16777216.0f * 2.0f - 1.0f) * config.radius;
+        p.y = ground.height(p.x, p.z);
+    }
+    std::vector<LightProbeSH> sampled(cars);
+    t0 = Clock::now();
+    for (int f = 0; f < frames; f++)
+        for (int c = 0; c < cars; c++) sampled[c] = grid.sample(positions[c]);
+    double sampleMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count() / frames;
+    glm::vec3 mean(0.0f);
+    for (const LightProbeSH& sh : sampled) mean += lightProbeIrradiance(sh, glm::vec3(0.0f, 1.0f, 0.0f));
+    mean /= (float)cars;
+    std::cout << "sample: " << cars << " cars in " << sampleMs << " ms per frame (" << sampleMs * 1e6 / cars
+              << " ns per car), mean light from above " << mean.x << "\n";
+
+    const std::string path = "lightprobes_bench.bin";
+    t0 = Clock::now();
+    writeLightProbeCache(path, 1, grid);
+    double writeMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    LightProbeGrid cached = grid;
+    t0 = Clock::now();
+    bool ok = readLightProbeCache(path, 1, cached);
+    double readMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    ok = ok && std::memcmp(cached.probes.data(), grid.probes.data(), grid.probes.size() * sizeof(LightProbeSH)) == 0;
+    std::cout << "cache: " << grid.probes.size() * sizeof(LightProbeSH) / 1024 << " KiB, write " << writeMs << " ms, read " << readMs
+              << " ms" << (ok ? "" : " (MISMATCH)") << "\n";
+    std::filesystem::remove(path);
+}
+
+#endif
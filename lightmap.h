@@ -0,0 +1,744 @@
+#ifndef LIGHTMAP_H
+#define LIGHTMAP_H
+
+// Baked lighting for the static geometry (LightmapData in renderer.h).
+//
+// Neither the level's lights nor the ground and the wall ever move, yet floor.fs worked
+// out the same diffuse and specular terms for them in every fragment of every frame,
+// and without shadows. Here that light is traced once on the CPU and stored in an atlas
+// the floor and terrain shaders read instead:
+//  - charts: one per planar level quad (Floor or Terrain material) and one for the
+//    ground within groundRadius of groundCentre, projected along y (the ground is a
+//    height field, so the projection never folds). A chart is a rectangle of its
+//    surface's plane at texelsPerUnit, padded with copies of its edge texels so that
+//    bilinear filtering never reads a neighbour, and charts are packed in shelves.
+//    Models and curved meshes keep their runtime lighting.
+//  - the scene: the level's non-model geometry and the ground (triangulated every
+//    groundStep units over the chart and a margin around it) in a StaticBVH, traced
+//    with four-ray packets (StaticBVH::raycastPacket) and an SSE Moller-Trumbore test
+//    of the four rays against each triangle in a leaf
+//  - direct light: every level light, its colour times N.L as floor.fs had it (faded
+//    out over the light's range when it has one) where a shadow ray reaches it. Four
+//    neighbouring texels share a packet, and so nearly the same path down the tree
+//  - one bounce: bounceSamples cosine-distributed rays per texel, four to a packet;
+//    where one hits the scene it gathers the direct light there times albedo. Rays that
+//    escape gather nothing: the sky's light stays the runtime ambient (SH irradiance
+//    and SSAO), the same that the cars get.
+//
+// Texels hold what multiplies the surface colour, like floor.fs's diffuse term, as
+// RGBA16F. Chart rows are spread over the job system. The result is cached next to the
+// level as lightmap-<hash>.bin, keyed by the traced triangles, the lights, the charts
+// and the settings, so the bake runs on the first launch and again only when one of
+// those changes.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "bvh.h"
+#include "deterministic.h"
+#include "file_io.h"
+#include "heightfield.h"
+#include "ibl.h"
+#include "jobs.h"
+#include "level.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct LightmapConfig
+{
+    float texelsPerUnit = 4.0f;         // level quads
+    float groundTexelsPerUnit = 2.0f;
+    glm::vec2 groundCentre = glm::vec2(0.0f);   // xz
+    float groundRadius = 64.0f;         // half the side of the ground's chart
+    float groundStep = 1.0f;            // size of the traced ground's triangles
+    float groundMargin = 16.0f;         // traced ground beyond the chart, which shadows and reflects into it
+    int maxChartTexels = 1024;          // per side; larger surfaces get fewer texels per unit
+    int padding = 2;                    // texels around each chart
+    int bounceSamples = 32;             // per texel, rounded down to a multiple of 4
+    float albedo = 0.5f;                // of what light bounces off (about the wood texture's average)
+    float bias = 0.05f;                 // ray origins lifted off their surface
+};
+
+struct LightmapStats
+{
+    bool cached = false;
+    unsigned int threads = 0;
+    size_t triangles = 0, charts = 0;
+    int width = 0, height = 0;
+    uint64_t rays = 0;
+    double sceneMs = 0.0, hashMs = 0.0, directMs = 0.0, bounceMs = 0.0, cacheMs = 0.0;
+
+    void print(std::ostream& out) const
+    {
+        out << "lightmap: " << charts << " charts in " << width << "x" << height << " texels over " << triangles
+            << " triangles, scene " << sceneMs << " ms, hash " << hashMs << " ms, ";
+        if (cached) out << "cache read " << cacheMs << " ms\n";
+        else
+            out << "direct " << directMs << " ms, bounce " << bounceMs << " ms (" << rays / 1e6 << "M rays, "
+                << rays / 1e3 / std::max(1e-3, directMs + bounceMs) << " Mrays/s) on " << threads << " threads, cache write "
+                << cacheMs << " ms\n";
+    }
+};
+
+struct LightmapTriangle
+{
+    glm::vec3 v0, e1, e2;   // corners v0, v0 + e1, v0 + e2
+    glm::vec3 normal;
+};
+
+// one chart: a rectangle of a surface's plane, p = origin + s * axisU + t * axisV
+struct LightmapSurface
+{
+    glm::vec3 origin, axisU, axisV, normal;
+    glm::vec2 min, max;             // the surface's extent in (s, t)
+    float texelsPerUnit = 1.0f;
+    bool ground = false;            // p.y and the normal come from the height field
+    int instance = -1;              // the level instance it lights, -1 for the ground
+    int x = 0, y = 0, width = 0, height = 0;   // in the atlas, padding included
+};
+
+struct LightmapScene
+{
+    std::vector<LightmapTriangle> triangles;
+    StaticBVH bvh;
+    std::vector<LevelLight> lights;
+    const Heightfield* ground = nullptr;    // flat at y = 0 when null
+    std::vector<LightmapSurface> surfaces;
+    int width = 0, height = 0;              // the atlas
+    int padding = 0;
+};
+
+// what the game needs: the atlas, and which chart each of its draws reads
+struct Lightmap
+{
+    LightmapData data;
+    int groundChart = -1;
+    std::vector<int> instanceCharts;    // per level instance; -1 keeps runtime lighting
+};
+
+// ---- the scene ----
+
+inline void addLightmapTriangle(LightmapScene& scene, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    glm::vec3 n = glm::cross(b - a, c - a);
+    float len = glm::length(n);
+    if (len < 1e-12f) return;
+    scene.triangles.push_back({ a, b - a, c - a, n / len });
+}
+
+// shelves of charts, tallest first, in an atlas a power of two wide
+inline void packLightmapCharts(LightmapScene& scene, const LightmapConfig& config)
+{
+    int pad = scene.padding = std::max(1, config.padding);
+    int widest = 1;
+    size_t area = 0;
+    for (LightmapSurface& s : scene.surfaces)
+    {
+        float extent = std::max(std::max(s.max.x - s.min.x, s.max.y - s.min.y), 1e-3f);
+        s.texelsPerUnit = std::min(s.texelsPerUnit, (float)(config.maxChartTexels - 2 * pad) / extent);
+        s.width = std::max(1, (int)std::ceil((s.max.x - s.min.x) * s.texelsPerUnit)) + 2 * pad;
+        s.height = std::max(1, (int)std::ceil((s.max.y - s.min.y) * s.texelsPerUnit)) + 2 * pad;
+        widest = std::max(widest, s.width);
+        area += (size_t)s.width * s.height;
+    }
+    int width = 64;
+    while (width < widest || (size_t)width * width < area) width *= 2;
+
+    std::vector<size_t> order(scene.surfaces.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return scene.surfaces[a].height > scene.surfaces[b].height; });
+    int x = 0, y = 0, shelf = 0;
+    for (size_t i : order)
+    {
+        LightmapSurface& s = scene.surfaces[i];
+        if (x + s.width > width) { x = 0; y += shelf; shelf = 0; }
+        s.x = x;
+        s.y = y;
+        x += s.width;
+        shelf = std::max(shelf, s.height);
+    }
+    scene.width = width;
+    scene.height = (y + shelf + 3) & ~3;
+}
+
+// the triangles and charts of a level's static geometry over the ground (flat when
+// ground is null), packed, and the BVH over the triangles
+inline void buildLightmapScene(const Level& level, const Heightfield* ground, const LightmapConfig& config, LightmapScene& scene)
+{
+    scene.triangles.clear();
+    scene.surfaces.clear();
+    scene.lights.assign(level.lights().begin(), level.lights().end());
+    scene.ground = ground;
+
+    // the ground's chart first, then its triangles: a grid of cells over the chart and
+    // the margin, or two triangles when it is flat
+    LightmapSurface groundChart;
+    groundChart.origin = glm::vec3(config.groundCentre.x, 0.0f, config.groundCentre.y);
+    groundChart.axisU = glm::vec3(1.0f, 0.0f, 0.0f);
+    groundChart.axisV = glm::vec3(0.0f, 0.0f, 1.0f);
+    groundChart.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+    groundChart.min = glm::vec2(-config.groundRadius);
+    groundChart.max = glm::vec2(config.groundRadius);
+    groundChart.texelsPerUnit = config.groundTexelsPerUnit;
+    groundChart.ground = true;
+    scene.surfaces.push_back(groundChart);
+
+    float reach = config.groundRadius + config.groundMargin;
+    int cells = ground ? std::max(1, (int)std::ceil(2.0f * reach / config.groundStep)) : 1;
+    float step = 2.0f * reach / cells;
+    auto groundPoint = [&](int i, int j) {
+        float x = config.groundCentre.x - reach + i * step, z = config.groundCentre.y - reach + j * step;
+        return glm::vec3(x, ground ? ground->height(x, z) : 0.0f, z);
+    };
+    for (int j = 0; j < cells; j++)
+        for (int i = 0; i < cells; i++)
+        {
+            glm::vec3 a = groundPoint(i, j), b = groundPoint(i + 1, j), c = groundPoint(i + 1, j + 1), d = groundPoint(i, j + 1);
+            addLightmapTriangle(scene, a, d, c);
+            addLightmapTriangle(scene, a, c, b);
+        }
+
+    // level geometry: every mesh instance is traced, planar Floor and Terrain ones get a chart
+    LevelArray<float> vertices = level.vertices();
+    LevelArray<uint32_t> indices = level.indices();
+    for (size_t i = 0; i < level.instances().size(); i++)
+    {
+        const LevelInstance& inst = level.instances()[i];
+        const LevelGeometry& geometry = level.geometries()[inst.geometry];
+        if (geometry.model || !geometry.indexCount) continue;
+        glm::mat4 model = levelModelMatrix(inst);
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+        std::vector<glm::vec3> points(geometry.vertexCount);
+        glm::vec3 normalSum(0.0f);
+        for (uint32_t k = 0; k < geometry.vertexCount; k++)
+        {
+            const float* v = &vertices[((size_t)geometry.firstVertex + k) * 8];
+            points[k] = glm::vec3(model * glm::vec4(v[0], v[1], v[2], 1.0f));
+            normalSum += normalMatrix * glm::vec3(v[3], v[4], v[5]);
+        }
+        size_t first = scene.triangles.size();
+        for (uint32_t k = 0; k + 2 < geometry.indexCount; k += 3)
+        {
+            const uint32_t* tri = &indices[(size_t)geometry.firstIndex + k];
+            if (tri[0] < points.size() && tri[1] < points.size() && tri[2] < points.size())
+                addLightmapTriangle(scene, points[tri[0]], points[tri[1]], points[tri[2]]);
+        }
+        if (scene.triangles.size() == first || scene.surfaces.size() >= MAX_LIGHTMAP_CHARTS) continue;
+        if (inst.material != (uint32_t)Material::Floor && inst.material != (uint32_t)Material::Terrain) continue;
+
+        // a chart when every vertex lies in the first triangle's plane, facing the way the vertex normals do
+        const LightmapTriangle& t = scene.triangles[first];
+        glm::vec3 n = glm::dot(t.normal, normalSum) < 0.0f ? -t.normal : t.normal;
+        bool planar = true;
+        for (const glm::vec3& p : points) planar = planar && std::fabs(glm::dot(p - t.v0, n)) < 1e-3f;
+        if (!planar) continue;
+        LightmapSurface s;
+        s.origin = t.v0;
+        s.axisU = glm::normalize(t.e1);
+        s.axisV = glm::cross(n, s.axisU);
+        s.normal = n;
+        s.min = glm::vec2(std::numeric_limits<float>::max());
+        s.max = -s.min;
+        for (const glm::vec3& p : points)
+        {
+            glm::vec2 st(glm::dot(p - s.origin, s.axisU), glm::dot(p - s.origin, s.axisV));
+            s.min = glm::min(s.min, st);
+            s.max = glm::max(s.max, st);
+        }
+        s.texelsPerUnit = config.texelsPerUnit;
+        s.instance = (int)i;
+        scene.surfaces.push_back(s);
+    }
+    packLightmapCharts(scene, config);
+
+    // a hair of thickness, so flat triangles have boxes the slab test can hit
+    std::vector<BVHBox> boxes(scene.triangles.size());
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        const LightmapTriangle& t = scene.triangles[i];
+        glm::vec3 b = t.v0 + t.e1, c = t.v0 + t.e2;
+        boxes[i] = { glm::min(t.v0, glm::min(b, c)) - glm::vec3(1e-4f), glm::max(t.v0, glm::max(b, c)) + glm::vec3(1e-4f) };
+    }
+    scene.bvh.build(boxes);
+}
+
+// the charts as the renderer takes them: world position to atlas coordinates
+inline std::vector<LightmapChart> lightmapCharts(const LightmapScene& scene)
+{
+    std::vector<LightmapChart> charts;
+    glm::vec2 size((float)scene.width, (float)scene.height);
+    for (const LightmapSurface& s : scene.surfaces)
+    {
+        // u = (x + padding + (dot(axisU, p - origin) - min.s) * texelsPerUnit) / width
+        LightmapChart c;
+        c.u = glm::vec4(s.axisU * (s.texelsPerUnit / size.x),
+                        (s.x + scene.padding - (glm::dot(s.axisU, s.origin) + s.min.x) * s.texelsPerUnit) / size.x);
+        c.v = glm::vec4(s.axisV * (s.texelsPerUnit / size.y),
+                        (s.y + scene.padding - (glm::dot(s.axisV, s.origin) + s.min.y) * s.texelsPerUnit) / size.y);
+        c.rect = glm::vec4(s.x / size.x, s.y / size.y, (s.x + s.width) / size.x, (s.y + s.height) / size.y);
+        charts.push_back(c);
+    }
+    return charts;
+}
+
+// ---- tracing ----
+
+// four rays of a packet against one triangle (two-sided): the lanes that hit it
+// between 1e-4 and closest[lane], with t[lane] set
+inline int intersectLightmapTriangle(const BVHRayPacket& packet, const LightmapTriangle& tri, int lanes, const float* closest, float* t)
+{
+#ifdef BVH_SSE
+    __m128 dx = _mm_load_ps(packet.dx), dy = _mm_load_ps(packet.dy), dz = _mm_load_ps(packet.dz);
+    __m128 e1x = _mm_set1_ps(tri.e1.x), e1y = _mm_set1_ps(tri.e1.y), e1z = _mm_set1_ps(tri.e1.z);
+    __m128 e2x = _mm_set1_ps(tri.e2.x), e2y = _mm_set1_ps(tri.e2.y), e2z = _mm_set1_ps(tri.e2.z);
+    // p = d x e2, det = e1 . p
+    __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), det);
+    // s = o - v0, u = (s . p) / det
+    __m128 sx = _mm_sub_ps(_mm_load_ps(packet.ox), _mm_set1_ps(tri.v0.x));
+    __m128 sy = _mm_sub_ps(_mm_load_ps(packet.oy), _mm_set1_ps(tri.v0.y));
+    __m128 sz = _mm_sub_ps(_mm_load_ps(packet.oz), _mm_set1_ps(tri.v0.z));
+    __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inv);
+    // q = s x e1, v = (d . q) / det, t = (e2 . q) / det
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv);
+    __m128 tt = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv);
+    __m128 zero = _mm_setzero_ps();
+    __m128 mask = _mm_cmpgt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), det), _mm_set1_ps(1e-12f));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    mask = _mm_and_ps(mask, _mm_cmpgt_ps(tt, _mm_set1_ps(1e-4f)));
+    mask = _mm_and_ps(mask, _mm_cmplt_ps(tt, _mm_loadu_ps(closest)));
+    _mm_storeu_ps(t, tt);
+    return _mm_movemask_ps(mask) & lanes;
+#else
+    int hit = 0;
+    for (int r = 0; r < 4; r++)
+    {
+        if (!(lanes & (1 << r))) continue;
+        glm::vec3 d(packet.dx[r], packet.dy[r], packet.dz[r]);
+        glm::vec3 p = glm::cross(d, tri.e2);
+        float det = glm::dot(tri.e1, p);
+        if (std::fabs(det) <= 1e-12f) continue;
+        float inv = 1.0f / det;
+        glm::vec3 s = glm::vec3(packet.ox[r], packet.oy[r], packet.oz[r]) - tri.v0;
+        float u = glm::dot(s, p) * inv;
+        glm::vec3 q = glm::cross(s, tri.e1);
+        float v = glm::dot(d, q) * inv;
+        t[r] = glm::dot(tri.e2, q) * inv;
+        if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t[r] > 1e-4f && t[r] < closest[r]) hit |= 1 << r;
+    }
+    return hit;
+#endif
+}
+
+inline int traceLightmapPacket(const LightmapScene& scene, const BVHRayPacket& packet, BVHRayHit hits[4], bool anyHit)
+{
+    return scene.bvh.raycastPacket(packet, hits, [&](unsigned int prim, int lanes, const float* closest, float* t) {
+        return intersectLightmapTriangle(packet, scene.triangles[prim], lanes, closest, t);
+    }, anyHit);
+}
+
+inline void setLightmapRay(BVHRayPacket& packet, int lane, const glm::vec3& o, const glm::vec3& d, float maxT)
+{
+    packet.ox[lane] = o.x; packet.oy[lane] = o.y; packet.oz[lane] = o.z;
+    packet.dx[lane] = d.x; packet.dy[lane] = d.y; packet.dz[lane] = d.z;
+    packet.maxT[lane] = maxT;
+}
+
+inline BVHRayPacket emptyLightmapPacket()
+{
+    BVHRayPacket packet;
+    for (int r = 0; r < 4; r++) setLightmapRay(packet, r, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
+    return packet;
+}
+
+// direct light at the points p[lane] (normals n[lane]) in `lanes`, one shadow packet per light
+inline void lightmapDirect(const LightmapScene& scene, const LightmapConfig& config, const glm::vec3* p, const glm::vec3* n, int lanes,
+                           glm::vec3* out, uint64_t& rays)
+{
+    for (int r = 0; r < 4; r++) out[r] = glm::vec3(0.0f);
+    for (const LevelLight& light : scene.lights)
+    {
+        glm::vec3 position(light.position[0], light.position[1], light.position[2]);
+        BVHRayPacket packet = emptyLightmapPacket();
+        float weight[4] = {};
+        int cast = 0;
+        for (int r = 0; r < 4; r++)
+        {
+            if (!(lanes & (1 << r))) continue;
+            glm::vec3 o = p[r] + n[r] * config.bias;
+            glm::vec3 d = position - o;
+            float distance = glm::length(d);
+            if (distance < 1e-4f) continue;
+            d /= distance;
+            float fade = 1.0f;
+            if (light.range > 0.0f)
+            {
+                fade = glm::clamp(1.0f - distance / light.range, 0.0f, 1.0f);
+                fade *= fade;
+            }
+            weight[r] = std::max(glm::dot(n[r], d), 0.0f) * fade;
+            if (weight[r] <= 0.0f) continue;
+            setLightmapRay(packet, r, o, d, distance);
+            cast |= 1 << r;
+        }
+        if (!cast) continue;
+        BVHRayHit hits[4];
+        int blocked = traceLightmapPacket(scene, packet, hits, true);
+        glm::vec3 color(light.color[0], light.color[1], light.color[2]);
+        for (int r = 0; r < 4; r++)
+            if ((cast & ~blocked) & (1 << r)) out[r] += color * weight[r];
+        for (int r = 0; r < 4; r++) rays += (cast >> r) & 1;
+    }
+}
+
+// light arriving at p from the scene after one bounce, as a multiple of the surface colour
+inline glm::vec3 lightmapBounce(const LightmapScene& scene, const LightmapConfig& config, const glm::vec3& p, const glm::vec3& n,
+                                uint32_t seed, uint64_t& rays)
+{
+    glm::vec3 tangent = glm::normalize(glm::cross(n, std::fabs(n.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f)));
+    glm::vec3 bitangent = glm::cross(n, tangent);
+    glm::vec3 o = p + n * config.bias;
+    int samples = std::max(4, config.bounceSamples & ~3);
+    // stratified in cos^2 of the angle, a golden-ratio spiral around n turned per texel
+    float turn = (float)(seed * 2654435761u >> 8) / 16777216.0f;
+    glm::vec3 sum(0.0f);
+    for (int k = 0; k < samples; k += 4)
+    {
+        BVHRayPacket packet;
+        glm::vec3 dirs[4];
+        for (int r = 0; r < 4; r++)
+        {
+            float u1 = (k + r + 0.5f) / samples, u2 = (k + r) * 0.618034f + turn;
+            float radius = std::sqrt(u1), phi = 6.2831853f * (u2 - std::floor(u2));
+            dirs[r] = tangent * (radius * std::cos(phi)) + bitangent * (radius * std::sin(phi)) + n * std::sqrt(std::max(0.0f, 1.0f - u1));
+            setLightmapRay(packet, r, o, dirs[r], 1e30f);
+        }
+        BVHRayHit hits[4];
+        int hit = traceLightmapPacket(scene, packet, hits, false);
+        rays += 4;
+        if (!hit) continue;
+        glm::vec3 hp[4], hn[4], light[4];
+        for (int r = 0; r < 4; r++)
+        {
+            if (!(hit & (1 << r))) continue;
+            hp[r] = o + dirs[r] * hits[r].t;
+            hn[r] = scene.triangles[hits[r].prim].normal;
+            if (glm::dot(hn[r], dirs[r]) > 0.0f) hn[r] = -hn[r];
+        }
+        lightmapDirect(scene, config, hp, hn, hit, light, rays);
+        for (int r = 0; r < 4; r++)
+            if (hit & (1 << r)) sum += light[r];
+    }
+    return sum * (config.albedo / samples);
+}
+
+// the point and normal that texel (i, j) of a chart stands for; the padding repeats the edge
+inline void lightmapTexel(const LightmapScene& scene, const LightmapSurface& s, int i, int j, glm::vec3& p, glm::vec3& n)
+{
+    glm::vec2 st = glm::clamp(s.min + (glm::vec2((float)i, (float)j) + 0.5f - (float)scene.padding) / s.texelsPerUnit, s.min, s.max);
+    p = s.origin + s.axisU * st.x + s.axisV * st.y;
+    n = s.normal;
+    if (s.ground && scene.ground)
+    {
+        p.y = scene.ground->height(p.x, p.z);
+        n = scene.ground->normal(p.x, p.z);
+    }
+}
+
+// traces every chart: direct light first, then the bounce, each a parallel pass over chart rows
+inline void bakeLightmap(const LightmapScene& scene, const LightmapConfig& config, LightmapData& out, LightmapStats& stats, JobSystem& jobs)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    out.width = scene.width;
+    out.height = scene.height;
+    out.charts = lightmapCharts(scene);
+    std::vector<glm::vec3> light((size_t)scene.width * scene.height, glm::vec3(0.0f));
+    std::vector<std::pair<int, int>> rows;  // (surface, row)
+    for (size_t s = 0; s < scene.surfaces.size(); s++)
+        for (int j = 0; j < scene.surfaces[s].height; j++) rows.push_back({ (int)s, j });
+    std::atomic<uint64_t> rays(0);
+
+    auto t0 = Clock::now();
+    jobs.parallelFor(rows.size(), 4, [&](size_t begin, size_t end, size_t) {
+        uint64_t local = 0;
+        for (size_t row = begin; row < end; row++)
+        {
+            const LightmapSurface& s = scene.surfaces[rows[row].first];
+            int j = rows[row].second;
+            for (int i = 0; i < s.width; i += 4)
+            {
+                glm::vec3 p[4], n[4], direct[4];
+                int lanes = 0;
+                for (int r = 0; r < 4 && i + r < s.width; r++)
+                {
+                    lightmapTexel(scene, s, i + r, j, p[r], n[r]);
+                    lanes |= 1 << r;
+                }
+                lightmapDirect(scene, config, p, n, lanes, direct, local);
+                for (int r = 0; r < 4 && i + r < s.width; r++) light[(size_t)(s.y + j) * scene.width + s.x + i + r] = direct[r];
+            }
+        }
+        rays += local;
+    });
+    stats.directMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+    t0 = Clock::now();
+    jobs.parallelFor(rows.size(), 1, [&](size_t begin, size_t end, size_t) {
+        uint64_t local = 0;
+        for (size_t row = begin; row < end; row++)
+        {
+            const LightmapSurface& s = scene.surfaces[rows[row].first];
+            int j = rows[row].second;
+            for (int i = 0; i < s.width; i++)
+            {
+                glm::vec3 p, n;
+                lightmapTexel(scene, s, i, j, p, n);
+                uint32_t x = (uint32_t)(s.x + i), y = (uint32_t)(s.y + j);
+                light[(size_t)y * scene.width + x] += lightmapBounce(scene, config, p, n, x * 73856093u ^ y * 19349663u, local);
+            }
+        }
+        rays += local;
+    });
+    stats.bounceMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+    out.texels.assign(light.size() * 4, 0);
+    for (size_t i = 0; i < light.size(); i++)
+    {
+        for (int c = 0; c < 3; c++) out.texels[i * 4 + c] = floatToHalf(light[i][c]);
+        out.texels[i * 4 + 3] = floatToHalf(1.0f);
+    }
+    stats.rays = rays;
+    stats.threads = jobs.threadCount();
+}
+
+// ---- disk cache ----
+
+struct LightmapCacheHeader
+{
+    char magic[4];              // "LMP1"
+    uint32_t version;
+    uint32_t width, height;
+    uint32_t keyLow, keyHigh;   // the hash it was baked for
+};
+
+const uint32_t LIGHTMAP_CACHE_VERSION = 1;
+
+// everything the texels depend on: the traced triangles, the lights, the charts and the settings
+inline uint64_t lightmapCacheKey(const LightmapScene& scene, const LightmapConfig& config)
+{
+    StateHash hash;
+    hash.add(LIGHTMAP_CACHE_VERSION);
+    for (float f : { config.albedo, config.bias })
+        hash.add(f);
+    hash.add((uint32_t)config.bounceSamples);
+    for (const LightmapTriangle& t : scene.triangles)
+    {
+        hash.add(t.v0);
+        hash.add(t.e1);
+        hash.add(t.e2);
+    }
+    for (const LevelLight& l : scene.lights)
+        for (float f : { l.position[0], l.position[1], l.position[2], l.color[0], l.color[1], l.color[2], l.range })
+            hash.add(f);
+    for (const LightmapSurface& s : scene.surfaces)
+    {
+        hash.add(s.origin);
+        hash.add(s.axisU);
+        hash.add(s.axisV);
+        hash.add(s.normal);
+        for (float f : { s.min.x, s.min.y, s.max.x, s.max.y, s.texelsPerUnit })
+            hash.add(f);
+        for (int v : { s.x, s.y, s.width, s.height })
+            hash.add((uint32_t)v);
+    }
+    hash.add((uint32_t)scene.width);
+    hash.add((uint32_t)scene.height);
+    hash.add((uint32_t)scene.padding);
+    return hash.value;
+}
+
+inline bool readLightmapCache(const std::string& path, uint64_t key, int width, int height, std::vector<uint16_t>& texels)
+{
+    std::ifstream in(path, std::ios::binary);
+    LightmapCacheHeader h;
+    if (!in.read((char*)&h, sizeof(h))) return false;
+    if (std::memcmp(h.magic, "LMP1", 4) != 0 || h.version != LIGHTMAP_CACHE_VERSION || h.keyLow != (uint32_t)key ||
+        h.keyHigh != (uint32_t)(key >> 32) || h.width != (uint32_t)width || h.height != (uint32_t)height)
+        return false;
+    texels.resize((size_t)width * height * 4);
+    in.read((char*)texels.data(), (std::streamsize)(texels.size() * sizeof(uint16_t)));
+    if (!in)
+    {
+        texels.clear();
+        return false;
+    }
+    return true;
+}
+
+// replaced atomically (file_io.h); two games baking at once each write their own
+// temporary file
+inline bool writeLightmapCache(const std::string& path, uint64_t key, const LightmapData& data, std::string* error = nullptr)
+{
+    LightmapCacheHeader h;
+    std::memcpy(h.magic, "LMP1", 4);
+    h.version = LIGHTMAP_CACHE_VERSION;
+    h.width = (uint32_t)data.width;
+    h.height = (uint32_t)data.height;
+    h.keyLow = (uint32_t)key;
+    h.keyHigh = (uint32_t)(key >> 32);
+
+    std::vector<uint8_t> bytes;
+    bytes.reserve(sizeof(h) + data.texels.size() * sizeof(uint16_t));
+    appendBytes(bytes, &h, sizeof(h));
+    appendBytes(bytes, data.texels.data(), data.texels.size() * sizeof(uint16_t));
+    return writeFileAtomically(path, bytes, error);
+}
+
+// the lightmap of a level over its ground (flat when ground is null): from the cache in
+// cacheDir when present, else baked on the job system and cached. A failed cache write
+// is reported but not an error; a level without lights has nothing to bake.
+inline bool loadLightmap(const Level& level, const Heightfield* ground, Lightmap& out, LightmapStats* stats = nullptr,
+                         const std::string& cacheDir = "", const LightmapConfig& config = LightmapConfig(), std::string* error = nullptr)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    LightmapStats local;
+    LightmapStats& st = stats ? *stats : local;
+    if (level.lights().empty())
+    {
+        if (error) *error = "the level has no lights to bake";
+        return false;
+    }
+
+    auto t0 = Clock::now();
+    LightmapScene scene;
+    buildLightmapScene(level, ground, config, scene);
+    st.sceneMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    st.triangles = scene.triangles.size();
+    st.charts = scene.surfaces.size();
+    st.width = scene.width;
+    st.height = scene.height;
+    out.instanceCharts.assign(level.instances().size(), -1);
+    for (size_t s = 0; s < scene.surfaces.size(); s++)
+    {
+        if (scene.surfaces[s].ground) out.groundChart = (int)s;
+        else out.instanceCharts[scene.surfaces[s].instance] = (int)s;
+    }
+
+    t0 = Clock::now();
+    uint64_t key = lightmapCacheKey(scene, config);
+    st.hashMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    std::ostringstream name;
+    name << "lightmap-" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+    std::string cachePath = (std::filesystem::path(cacheDir) / name.str()).string();
+
+    t0 = Clock::now();
+    if (readLightmapCache(cachePath, key, scene.width, scene.height, out.data.texels))
+    {
+        out.data.width = scene.width;
+        out.data.height = scene.height;
+        out.data.charts = lightmapCharts(scene);
+        st.cached = true;
+        st.cacheMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        return true;
+    }
+
+    bakeLightmap(scene, config, out.data, st, jobSystem());
+    t0 = Clock::now();
+    std::string cacheError;
+    if (!writeLightmapCache(cachePath, key, out.data, &cacheError)) std::cerr << "lightmap: " << cacheError << " (not cached)\n";
+    st.cacheMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    return true;
+}
+
+// ---- benchmark: bake time against thread count, and the cached path ----
+// The arena's wall and light with a ring of twelve more panels, over the default
+// heightfield terrain, baked with the default settings.
+inline void runLightmapBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    LevelBuilder builder;
+    const float quad[] = { -2, 0, 0, 0, 0, 1, 0, 0,   2, 0, 0, 0, 0, 1, 1, 0,   2, 4, 0, 0, 0, 1, 1, 1,   -2, 4, 0, 0, 0, 1, 0, 1 };
+    const uint32_t quadIndices[] = { 0, 1, 2, 0, 2, 3 };
+    uint32_t panel = builder.addMesh("panel", "", quad, 4, quadIndices, 6);
+    builder.addInstance(panel, Material::Floor, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 20.0f)));
+    for (int i = 0; i < 12; i++)
+    {
+        float angle = glm::radians(30.0f * i);
+        glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(std::sin(angle), 0.0f, std::cos(angle)) * 12.0f);
+        builder.addInstance(panel, Material::Floor, glm::rotate(m, angle, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+    builder.addLight(glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(1.0f), 0.0f);
+    std::vector<uint8_t> bytes = builder.serialize();
+    Level level;
+    std::string error;
+    if (!level.open(bytes.data(), bytes.size(), &error)) { std::cerr << error << "\n"; return; }
+    Heightfield ground;
+
+    LightmapConfig config;
+    LightmapScene scene;
+    auto t0 = Clock::now();
+    buildLightmapScene(level, &ground, config, scene);
+    double sceneMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    std::cout << "lightmap: " << scene.surfaces.size() << " charts in " << scene.width << "x" << scene.height << " texels, "
+              << scene.triangles.size() << " triangles, scene and BVH " << sceneMs << " ms"
+#ifdef BVH_SSE
+              << ", SSE packets\n";
+#else
+              << ", scalar packets\n";
+#endif
+
+    // rows past the machine's hardware threads share cores and cannot speed up
+    std::cout << "lightmap bake on " << std::thread::hardware_concurrency() << " hardware threads\n";
+    std::cout << "lightmap bake" << std::setw(11) << "threads" << std::setw(13) << "direct ms" << std::setw(13) << "bounce ms"
+              << std::setw(12) << "total ms" << std::setw(10) << "Mrays/s" << std::setw(10) << "speedup\n";
+    LightmapData data;
+    double serialMs = 0.0;
+    for (unsigned int threads : { 1u, 2u, 4u, 8u })
+    {
+        JobSystem js(threads - 1);
+        LightmapStats stats;
+        data = LightmapData();
+        bakeLightmap(scene, config, data, stats, js);
+        double totalMs = stats.directMs + stats.bounceMs;
+        if (threads == 1) serialMs = totalMs;
+        std::cout << std::setw(24) << threads << std::setw(13) << stats.directMs << std::setw(13) << stats.bounceMs << std::setw(12)
+                  << totalMs << std::setw(10) << stats.rays / 1e3 / std::max(1e-3, totalMs) << std::setw(9) << serialMs / totalMs << "x\n";
+    }
+
+    const std::string path = "lightmap_bench.bin";
+    t0 = Clock::now();
+    writeLightmapCache(path, 1, data);
+    double writeMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    std::vector<uint16_t> cached;
+    t0 = Clock::now();
+    bool ok = readLightmapCache(path, 1, data.width, data.height, cached);
+    double readMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    std::cout << "cache: " << data.texels.size() * 2 / 1024 << " KiB, write " << writeMs << " ms, read " << readMs << " ms"
+              << (ok && cached == data.texels ? "" : " (MISMATCH)") << "\n";
+    std::filesystem::remove(path);
+}
+
+#endif
@@ -0,0 +1,537 @@
+#ifndef MESH_COLLIDER_H
+#define MESH_COLLIDER_H
+
+// Collision proxy for a triangle mesh (the car model), built once at import.
+//
+// Two levels, both stored in the body's own frame (callers move their queries into it):
+//   - a StaticBVH over the welded triangles for exact box and ray queries, so nothing
+//     ever walks the render Mesh vertex arrays;
+//   - a few convex parts for cheap mesh-vs-mesh tests with GJK.
+// The convex decomposition is spatial: triangles are split at the median centroid along
+// the longest axis. Each part keeps its extreme points along HULL_DIRECTIONS fixed
+// directions, then the vertex farthest from every kept point, again and again, until
+// all of its vertices are within 1% of its size of one (or MAX_HULL_POINTS are kept).
+// The hull of those points alone lies inside the part's true hull, so GJK tests it
+// grown by a margin: the largest distance left from a vertex to its nearest kept
+// point. That covers the whole part (a test built on it never misses a touch) and
+// over-covers by at most the margin; use the triangle queries where exact contact
+// matters.
+
+#include <glm/glm.hpp>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "bvh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct MeshRayHit
+{
+    unsigned int triangle;
+    float t;
+    glm::vec3 normal;   // geometric normal, facing the ray origin
+};
+
+class MeshCollider
+{
+public:
+    static const unsigned int HULL_DIRECTIONS = 64;
+    static const unsigned int MAX_HULL_POINTS = 128;    // per part, refinement included
+    static const unsigned int MIN_PART_TRIANGLES = 64;
+
+    // reads every mesh in the file, maps positions through toBody (model -> body frame)
+    // and builds the proxy; false if the file can't be read
+    bool load(const std::string& path, const glm::mat4& toBody = glm::mat4(1.0f), unsigned int maxParts = 16)
+    {
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
+        if (!scene || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) || !scene->mRootNode)
+        {
+            std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+            return false;
+        }
+        std::vector<glm::vec3> positions;
+        std::vector<unsigned int> indices;
+        for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+        {
+            const aiMesh* mesh = scene->mMeshes[m];
+            unsigned int base = (unsigned int)positions.size();
+            for (unsigned int v = 0; v < mesh->mNumVertices; v++)
+            {
+                glm::vec4 p = toBody * glm::vec4(mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z, 1.0f);
+                positions.push_back(glm::vec3(p.x, p.y, p.z));
+            }
+            for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+                if (mesh->mFaces[f].mNumIndices == 3)
+                    for (unsigned int i = 0; i < 3; i++) indices.push_back(base + mesh->mFaces[f].mIndices[i]);
+        }
+        build(positions, indices, maxParts);
+        return !tris.empty();
+    }
+
+    // triangleIndices: three per triangle into positions
+    void build(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& triangleIndices, unsigned int maxParts = 16)
+    {
+        typedef std::chrono::high_resolution_clock Clock;
+        auto t0 = Clock::now();
+
+        // weld identical positions (the render mesh splits them per normal / uv) and drop
+        // degenerate triangles
+        vertices.clear();
+        tris.clear();
+        std::unordered_map<PositionKey, uint32_t, PositionHash> welded;
+        std::vector<uint32_t> remap(positions.size());
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            PositionKey key;
+            std::memcpy(key.bits, &positions[i], sizeof(key.bits));
+            auto it = welded.find(key);
+            if (it != welded.end()) { remap[i] = it->second; continue; }
+            remap[i] = welded[key] = (uint32_t)vertices.size();
+            vertices.push_back(positions[i]);
+        }
+        for (size_t i = 0; i + 2 < triangleIndices.size(); i += 3)
+        {
+            uint32_t a = remap[triangleIndices[i]], b = remap[triangleIndices[i + 1]], c = remap[triangleIndices[i + 2]];
+            if (a == b || b == c || c == a) continue;
+            glm::vec3 n = glm::cross(vertices[b] - vertices[a], vertices[c] - vertices[a]);
+            if (glm::dot(n, n) == 0.0f) continue;
+            tris.push_back(a); tris.push_back(b); tris.push_back(c);
+        }
+
+        std::vector<BVHBox> boxes(triangleCount());
+        box = { glm::vec3(std::numeric_limits<float>::infinity()), glm::vec3(-std::numeric_limits<float>::infinity()) };
+        for (unsigned int t = 0; t < triangleCount(); t++)
+        {
+            const glm::vec3 &a = vertex(t, 0), &b = vertex(t, 1), &c = vertex(t, 2);
+            boxes[t] = { glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c)) };
+            box.min = glm::min(box.min, boxes[t].min);
+            box.max = glm::max(box.max, boxes[t].max);
+        }
+        tree.build(boxes);
+        buildParts(maxParts);
+        buildTime = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    }
+
+    // exact: does the oriented box (body frame; axes are its unit columns) touch any triangle?
+    bool overlapBox(const glm::vec3& center, const glm::vec3& half, const glm::mat3& axes) const
+    {
+        glm::vec3 extent = glm::abs(axes[0]) * half.x + glm::abs(axes[1]) * half.y + glm::abs(axes[2]) * half.z;
+        glm::mat3 toBox = glm::transpose(axes);
+        bool hit = false;
+        tree.visitOverlap(center - extent, center + extent, [&](unsigned int t) {
+            glm::vec3 v[3] = { toBox * (vertex(t, 0) - center), toBox * (vertex(t, 1) - center), toBox * (vertex(t, 2) - center) };
+            hit = triangleOverlapsBox(v, half);
+            return !hit;
+        });
+        return hit;
+    }
+
+    // reference for overlapBox(): every triangle, no hierarchy
+    bool overlapBoxLinear(const glm::vec3& center, const glm::vec3& half, const glm::mat3& axes) const
+    {
+        glm::mat3 toBox = glm::transpose(axes);
+        for (unsigned int t = 0; t < triangleCount(); t++)
+        {
+            glm::vec3 v[3] = { toBox * (vertex(t, 0) - center), toBox * (vertex(t, 1) - center), toBox * (vertex(t, 2) - center) };
+            if (triangleOverlapsBox(v, half)) return true;
+        }
+        return false;
+    }
+
+    // closest triangle along origin + t * dir, t in [0, maxT]; dir must be normalized
+    bool raycast(const glm::vec3& origin, const glm::vec3& dir, float maxT, MeshRayHit& hit) const
+    {
+        BVHRayHit h;
+        bool found = tree.raycast(origin, dir, maxT, h, [&](unsigned int t, float closest, float& tHit) {
+            return rayTriangle(origin, dir, vertex(t, 0), vertex(t, 1), vertex(t, 2), closest, tHit);
+        });
+        if (!found) return false;
+        hit.triangle = h.prim;
+        hit.t = h.t;
+        hit.normal = glm::normalize(glm::cross(vertex(h.prim, 1) - vertex(h.prim, 0), vertex(h.prim, 2) - vertex(h.prim, 0)));
+        if (glm::dot(hit.normal, dir) > 0.0f) hit.normal = -hit.normal;
+        return true;
+    }
+
+    // convex parts of `other`, placed by otherToThis (its body frame -> ours), against ours
+    bool overlapMesh(const MeshCollider& other, const glm::mat4& otherToThis) const
+    {
+        std::vector<glm::vec3> moved;
+        for (const Part& b : other.parts)
+        {
+            // otherToThis is rigid, so the margin carries over unchanged
+            moved.resize(b.points.size());
+            BVHBox bb = { glm::vec3(std::numeric_limits<float>::infinity()), glm::vec3(-std::numeric_limits<float>::infinity()) };
+            for (size_t i = 0; i < moved.size(); i++)
+            {
+                glm::vec4 p = otherToThis * glm::vec4(b.points[i], 1.0f);
+                moved[i] = glm::vec3(p.x, p.y, p.z);
+                bb.min = glm::min(bb.min, moved[i]);
+                bb.max = glm::max(bb.max, moved[i]);
+            }
+            bb.min -= glm::vec3(b.margin);
+            bb.max += glm::vec3(b.margin);
+            for (const Part& a : parts)
+            {
+                if (a.bounds.max.x < bb.min.x || a.bounds.max.y < bb.min.y || a.bounds.max.z < bb.min.z ||
+                    bb.max.x < a.bounds.min.x || bb.max.y < a.bounds.min.y || bb.max.z < a.bounds.min.z) continue;
+                if (gjkIntersect(a.points, a.margin, moved, b.margin)) return true;
+            }
+        }
+        return false;
+    }
+
+    const BVHBox& bounds() const { return box; }
+    unsigned int triangleCount() const { return (unsigned int)(tris.size() / 3); }
+    size_t vertexCount() const { return vertices.size(); }
+    size_t partCount() const { return parts.size(); }
+    size_t hullPointCount() const
+    {
+        size_t n = 0;
+        for (const Part& p : parts) n += p.points.size();
+        return n;
+    }
+    size_t memoryBytes() const
+    {
+        return vertices.size() * sizeof(glm::vec3) + tris.size() * sizeof(uint32_t) + tree.memoryBytes() +
+               hullPointCount() * sizeof(glm::vec3) + parts.size() * sizeof(Part);
+    }
+    double buildMs() const { return buildTime; }
+
+private:
+    struct Part
+    {
+        std::vector<glm::vec3> points;   // hull support points
+        float margin = 0.0f;             // every vertex of the part lies within this of a point
+        BVHBox bounds;                   // of all its vertices
+    };
+
+    struct PositionKey
+    {
+        uint32_t bits[3];
+        bool operator==(const PositionKey& o) const { return bits[0] == o.bits[0] && bits[1] == o.bits[1] && bits[2] == o.bits[2]; }
+    };
+    struct PositionHash
+    {
+        size_t operator()(const PositionKey& k) const { return (k.bits[0] * 73856093u) ^ (k.bits[1] * 19349663u) ^ (k.bits[2] * 83492791u); }
+    };
+
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> tris;
+    StaticBVH tree;
+    std::vector<Part> parts;
+    BVHBox box = { glm::vec3(0.0f), glm::vec3(0.0f) };
+    double buildTime = 0.0;
+
+    const glm::vec3& vertex(unsigned int t, int corner) const { return vertices[tris[t * 3 + corner]]; }
+
+    void buildParts(unsigned int maxParts)
+    {
+        parts.clear();
+        unsigned int n = triangleCount();
+        if (!n) return;
+        std::vector<unsigned int> order(n);
+        std::vector<glm::vec3> centroid(n);
+        for (unsigned int t = 0; t < n; t++)
+        {
+            order[t] = t;
+            centroid[t] = (vertex(t, 0) + vertex(t, 1) + vertex(t, 2)) / 3.0f;
+        }
+
+        // repeatedly halve the largest part at its median centroid
+        std::vector<std::pair<unsigned int, unsigned int>> ranges(1, std::make_pair(0u, n));
+        while (ranges.size() < maxParts)
+        {
+            size_t largest = 0;
+            for (size_t r = 1; r < ranges.size(); r++)
+                if (ranges[r].second - ranges[r].first > ranges[largest].second - ranges[largest].first) largest = r;
+            unsigned int begin = ranges[largest].first, end = ranges[largest].second;
+            if (end - begin < 2 * MIN_PART_TRIANGLES) break;
+
+            glm::vec3 lo(std::numeric_limits<float>::infinity()), hi(-std::numeric_limits<float>::infinity());
+            for (unsigned int i = begin; i < end; i++) { lo = glm::min(lo, centroid[order[i]]); hi = glm::max(hi, centroid[order[i]]); }
+            glm::vec3 d = hi - lo;
+            int axis = d.x > d.y && d.x > d.z ? 0 : (d.y > d.z ? 1 : 2);
+            unsigned int mid = begin + (end - begin) / 2;
+            std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                             [&](unsigned int a, unsigned int b) { return centroid[a][axis] < centroid[b][axis]; });
+            ranges[largest].second = mid;
+            ranges.push_back(std::make_pair(mid, end));
+        }
+
+        // support points: the extreme vertex along each direction of a Fibonacci sphere
+        glm::vec3 dirs[HULL_DIRECTIONS];
+        for (unsigned int i = 0; i < HULL_DIRECTIONS; i++)
+        {
+            float y = 1.0f - 2.0f * (i + 0.5f) / HULL_DIRECTIONS, r = std::sqrt(1.0f - y * y), phi = 2.39996323f * i;
+            dirs[i] = glm::vec3(r * std::cos(phi), y, r * std::sin(phi));
+        }
+        for (const auto& range : ranges)
+        {
+            Part part;
+            part.bounds = { glm::vec3(std::numeric_limits<float>::infinity()), glm::vec3(-std::numeric_limits<float>::infinity()) };
+            uint32_t best[HULL_DIRECTIONS];
+            float bestDot[HULL_DIRECTIONS];
+            for (unsigned int k = 0; k < HULL_DIRECTIONS; k++) bestDot[k] = -std::numeric_limits<float>::infinity();
+            for (unsigned int i = range.first; i < range.second; i++)
+                for (int c = 0; c < 3; c++)
+                {
+                    uint32_t v = tris[order[i] * 3 + c];
+                    part.bounds.min = glm::min(part.bounds.min, vertices[v]);
+                    part.bounds.max = glm::max(part.bounds.max, vertices[v]);
+                    for (unsigned int k = 0; k < HULL_DIRECTIONS; k++)
+                    {
+                        float d = glm::dot(vertices[v], dirs[k]);
+                        if (d > bestDot[k]) { bestDot[k] = d; best[k] = v; }
+                    }
+                }
+            std::sort(best, best + HULL_DIRECTIONS);
+            uint32_t* last = std::unique(best, best + HULL_DIRECTIONS);
+            for (uint32_t* v = best; v != last; v++) part.points.push_back(vertices[*v]);
+
+            // farthest-point refinement: each vertex's distance to its nearest kept point
+            std::vector<uint32_t> used;
+            for (unsigned int i = range.first; i < range.second; i++)
+                for (int c = 0; c < 3; c++) used.push_back(tris[order[i] * 3 + c]);
+            std::sort(used.begin(), used.end());
+            used.erase(std::unique(used.begin(), used.end()), used.end());
+            std::vector<float> gap(used.size(), std::numeric_limits<float>::infinity());
+            auto nearer = [&](const glm::vec3& q) {
+                for (size_t i = 0; i < used.size(); i++) gap[i] = std::min(gap[i], glm::length(vertices[used[i]] - q));
+            };
+            for (const glm::vec3& q : part.points) nearer(q);
+            float tolerance = 0.01f * glm::length(part.bounds.max - part.bounds.min);
+            for (;;)
+            {
+                size_t worst = (size_t)(std::max_element(gap.begin(), gap.end()) - gap.begin());
+                part.margin = gap[worst];
+                if (part.margin <= tolerance || part.points.size() >= MAX_HULL_POINTS) break;
+                part.points.push_back(vertices[used[worst]]);
+                nearer(part.points.back());
+            }
+            parts.push_back(part);
+        }
+    }
+
+    // Moller-Trumbore, both faces
+    static bool rayTriangle(const glm::vec3& o, const glm::vec3& d, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float maxT, float& tHit)
+    {
+        glm::vec3 e1 = b - a, e2 = c - a, p = glm::cross(d, e2);
+        float det = glm::dot(e1, p);
+        if (std::fabs(det) < 1e-12f) return false;
+        float inv = 1.0f / det;
+        glm::vec3 s = o - a;
+        float u = glm::dot(s, p) * inv;
+        if (u < 0.0f || u > 1.0f) return false;
+        glm::vec3 q = glm::cross(s, e1);
+        float v = glm::dot(d, q) * inv;
+        if (v < 0.0f || u + v > 1.0f) return false;
+        float t = glm::dot(e2, q) * inv;
+        if (t < 0.0f || t > maxT) return false;
+        tHit = t;
+        return true;
+    }
+
+    // separating-axis test of a triangle (box-local coordinates) against a box of
+    // half extents h: 3 box faces, the triangle normal and 9 edge cross products
+    static bool triangleOverlapsBox(const glm::vec3 v[3], const glm::vec3& h)
+    {
+        for (int a = 0; a < 3; a++)
+            if (std::min(v[0][a], std::min(v[1][a], v[2][a])) > h[a] || std::max(v[0][a], std::max(v[1][a], v[2][a])) < -h[a]) return false;
+
+        glm::vec3 e[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+        glm::vec3 n = glm::cross(e[0], e[1]);
+        if (std::fabs(glm::dot(n, v[0])) > glm::dot(h, glm::abs(n))) return false;
+
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+            {
+                glm::vec3 axis(0.0f);
+                axis[i] = 1.0f;
+                axis = glm::cross(axis, e[j]);
+                float p0 = glm::dot(axis, v[0]), p1 = glm::dot(axis, v[1]), p2 = glm::dot(axis, v[2]);
+                float r = glm::dot(h, glm::abs(axis));
+                if (std::max(p0, std::max(p1, p2)) < -r || std::min(p0, std::min(p1, p2)) > r) return false;
+            }
+        return true;
+    }
+
+    static glm::vec3 support(const std::vector<glm::vec3>& points, const glm::vec3& d)
+    {
+        size_t best = 0;
+        float bestDot = glm::dot(points[0], d);
+        for (size_t i = 1; i < points.size(); i++)
+        {
+            float p = glm::dot(points[i], d);
+            if (p > bestDot) { bestDot = p; best = i; }
+        }
+        return points[best];
+    }
+
+    // the hull of points grown by a sphere of radius margin
+    static glm::vec3 support(const std::vector<glm::vec3>& points, float margin, const glm::vec3& d)
+    {
+        return support(points, d) + d * (margin / glm::length(d));
+    }
+
+    // GJK boolean query on the Minkowski difference (a grown by ra) - (b grown by rb)
+    static bool gjkIntersect(const std::vector<glm::vec3>& a, float ra, const std::vector<glm::vec3>& b, float rb)
+    {
+        if (a.empty() || b.empty()) return false;
+        glm::vec3 s[4];
+        int n = 1;
+        glm::vec3 d(1.0f, 0.0f, 0.0f);
+        s[0] = support(a, ra, d) - support(b, rb, -d);
+        d = -s[0];
+        for (int iter = 0; iter < 64; iter++)
+        {
+            if (glm::dot(d, d) < 1e-12f) return true;   // origin lies on the simplex
+            glm::vec3 p = support(a, ra, d) - support(b, rb, -d);
+            if (glm::dot(p, d) < 0.0f) return false;    // p didn't pass the origin: separated
+            s[3] = s[2]; s[2] = s[1]; s[1] = s[0]; s[0] = p;
+            n++;
+            if (nearestSimplex(s, n, d)) return true;
+        }
+        return true;   // no progress; treat as touching
+    }
+
+    // reduces the simplex (newest point first) to the feature nearest the origin and sets
+    // the next search direction; true once a tetrahedron encloses the origin
+    static bool nearestSimplex(glm::vec3 s[4], int& n, glm::vec3& d)
+    {
+        glm::vec3 a = s[0], ao = -a;
+        if (n == 2)
+        {
+            glm::vec3 ab = s[1] - a;
+            if (glm::dot(ab, ao) > 0.0f) d = glm::cross(glm::cross(ab, ao), ab);
+            else { n = 1; d = ao; }
+            return false;
+        }
+        if (n == 3) return nearestTriangle(s, n, d);
+
+        glm::vec3 b = s[1], c = s[2], e = s[3];
+        glm::vec3 abc = glm::cross(b - a, c - a), ace = glm::cross(c - a, e - a), aeb = glm::cross(e - a, b - a);
+        if (glm::dot(abc, ao) > 0.0f) { n = 3; return nearestTriangle(s, n, d); }
+        if (glm::dot(ace, ao) > 0.0f) { s[1] = c; s[2] = e; n = 3; return nearestTriangle(s, n, d); }
+        if (glm::dot(aeb, ao) > 0.0f) { s[1] = e; s[2] = b; n = 3; return nearestTriangle(s, n, d); }
+        return true;
+    }
+
+    static bool nearestTriangle(glm::vec3 s[4], int& n, glm::vec3& d)
+    {
+        glm::vec3 a = s[0], b = s[1], c = s[2], ao = -a;
+        glm::vec3 ab = b - a, ac = c - a, abc = glm::cross(ab, ac);
+        if (glm::dot(glm::cross(abc, ac), ao) > 0.0f)
+        {
+            if (glm::dot(ac, ao) > 0.0f) { s[1] = c; n = 2; d = glm::cross(glm::cross(ac, ao), ac); return false; }
+            return nearestEdge(n, d, ab, ao);
+        }
+        if (glm::dot(glm::cross(ab, abc), ao) > 0.0f) return nearestEdge(n, d, ab, ao);
+        if (glm::dot(abc, ao) > 0.0f) d = abc;
+        else { s[1] = c; s[2] = b; d = -abc; }   // keep the winding facing the origin
+        return false;
+    }
+
+    static bool nearestEdge(int& n, glm::vec3& d, const glm::vec3& ab, const glm::vec3& ao)
+    {
+        if (glm::dot(ab, ao) > 0.0f) { n = 2; d = glm::cross(glm::cross(ab, ao), ab); }
+        else { n = 1; d = ao; }
+        return false;
+    }
+};
+
+// ---- benchmark: proxy build, memory and query throughput on a model file ----
+// Box queries are compared against a brute-force walk over every triangle, which is
+// what reading the render mesh for exact checks would cost.
+inline void runMeshColliderBenchmark(const MeshCollider& mesh)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    std::cout << "mesh: " << mesh.triangleCount() << " triangles, " << mesh.vertexCount() << " vertices, "
+              << mesh.partCount() << " convex parts (" << mesh.hullPointCount() << " hull points), "
+              << mesh.memoryBytes() / 1024 << " KB, built in " << mesh.buildMs() << " ms\n";
+
+    const BVHBox& b = mesh.bounds();
+    glm::vec3 c = (b.min + b.max) * 0.5f, h = (b.max - b.min) * 0.5f;
+    std::mt19937 rng(99);
+    std::uniform_real_distribution<float> u(-1.5f, 1.5f), angle(0.0f, 360.0f);
+    const int queries = 100000;
+
+    // small boxes (bollards, debris) scattered around the body
+    std::vector<glm::vec3> centers(queries);
+    std::vector<glm::mat3> axes(queries);
+    for (int q = 0; q < queries; q++)
+    {
+        centers[q] = c + glm::vec3(u(rng), u(rng), u(rng)) * h;
+        float a = glm::radians(angle(rng));
+        axes[q] = glm::mat3(glm::vec3(std::cos(a), 0.0f, -std::sin(a)), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(std::sin(a), 0.0f, std::cos(a)));
+    }
+    glm::vec3 half(0.15f);
+    size_t boxHits = 0;
+    auto t0 = Clock::now();
+    for (int q = 0; q < queries; q++) boxHits += mesh.overlapBox(centers[q], half, axes[q]);
+    double boxRate = queries / std::chrono::duration<double>(Clock::now() - t0).count() / 1e6;
+
+    // the same exact test over every triangle, on a subset of the queries
+    const int linearQueries = std::min(queries, 1000);
+    size_t mismatches = 0;
+    t0 = Clock::now();
+    for (int q = 0; q < linearQueries; q++)
+        mismatches += mesh.overlapBoxLinear(centers[q], half, axes[q]) != mesh.overlapBox(centers[q], half, axes[q]);
+    double linearRate = linearQueries / std::chrono::duration<double>(Clock::now() - t0).count() / 1e6;
+
+    // rays from a shell around the car towards random points inside its bounds
+    size_t rayHits = 0;
+    t0 = Clock::now();
+    for (int q = 0; q < queries; q++)
+    {
+        glm::vec3 from = c + glm::normalize(glm::vec3(u(rng), u(rng), u(rng)) + glm::vec3(1e-3f)) * glm::length(h) * 2.0f;
+        glm::vec3 to = c + glm::vec3(u(rng), u(rng), u(rng)) * h * 0.5f;
+        MeshRayHit hit;
+        rayHits += mesh.raycast(from, glm::normalize(to - from), 100.0f, hit);
+    }
+    double rayRate = queries / std::chrono::duration<double>(Clock::now() - t0).count() / 1e6;
+
+    // car vs car (convex parts) at random nearby poses
+    size_t meshHits = 0;
+    const int meshQueries = queries / 10;
+    t0 = Clock::now();
+    for (int q = 0; q < meshQueries; q++)
+    {
+        float a = glm::radians(angle(rng));
+        glm::mat4 pose(1.0f);
+        pose[0] = glm::vec4(std::cos(a), 0.0f, -std::sin(a), 0.0f);
+        pose[2] = glm::vec4(std::sin(a), 0.0f, std::cos(a), 0.0f);
+        pose[3] = glm::vec4(glm::vec3(u(rng), 0.0f, u(rng)) * h * 2.0f, 1.0f);
+        meshHits += mesh.overlapMesh(mesh, pose);
+    }
+    double meshRate = meshQueries / std::chrono::duration<double>(Clock::now() - t0).count() / 1e3;
+
+    std::cout << std::setw(16) << "box Mq/s" << std::setw(16) << "linear Mq/s" << std::setw(16) << "ray Mq/s" << std::setw(16) << "mesh Kq/s" << "\n";
+    std::cout << std::setw(16) << boxRate << std::setw(16) << linearRate << std::setw(16) << rayRate << std::setw(16) << meshRate
+              << (mismatches ? "  (MISMATCH vs linear)" : "") << "\n";
+    std::cout << "hit rates: box " << boxHits * 100 / queries << "%, ray " << rayHits * 100 / queries
+              << "%, mesh " << meshHits * 100 / meshQueries << "%\n";
+}
+
+inline void runMeshColliderBenchmark(const std::string& path, const glm::mat4& toBody = glm::mat4(1.0f))
+{
+    MeshCollider mesh;
+    if (!mesh.load(path, toBody)) { std::cout << "mesh: failed to load " << path << "\n"; return; }
+    runMeshColliderBenchmark(mesh);
+}
+
+#endif
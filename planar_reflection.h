@@ -0,0 +1,124 @@
+#ifndef PLANAR_REFLECTION_H
+#define PLANAR_REFLECTION_H
+
+// Planar reflection of the scene in the floor (PlanarReflectionSettings in renderer.h).
+//
+// Screen-space reflections march the depth buffer per pixel, and a second full-size
+// pass over the mirrored scene doubles the frame. Here each screen view gets one
+// mirrored view, added to the frame like any other, which the backend renders into
+// the same rect of a reflection target at half or quarter resolution. The floor then
+// reads that target at its own screen position.
+//
+// The mirrored view is the screen view's camera reflected in the plane. Its projection
+// has an oblique near plane (Lengyel) lying on the mirror, so everything below the
+// floor is clipped by the rasterizer rather than by a clip distance in every shader,
+// and the culler (culling.h) takes the same plane as the frustum's near plane and
+// drops the items below the floor before they are drawn. The near plane sits a little
+// above the mirror so that the floor does not draw into its own reflection.
+//
+// With the reversed-Z infinite projection the near plane row becomes w - a * (distance
+// to the mirror), so depth = 1 - a * distance / w. It still falls along every ray (the
+// mirrored eye is under the floor), and with a no more than the cosine of the frustum's
+// half-diagonal angle it stays >= 0 everywhere in view; the oblique plane doubles as
+// the far limit there is otherwise none of.
+//
+// The backend times the pass as "reflection"; record() collects it next to "scene", so
+// the cost is reported relative to the base frame.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// reflection in the plane y = height
+inline glm::mat4 mirrorMatrix(float height)
+{
+    glm::mat4 m(1.0f);
+    m[1][1] = -1.0f;
+    m[3][1] = 2.0f * height;
+    return m;
+}
+
+// replaces the near plane of a reversed-Z projection with viewPlane (view space,
+// inside where dot(plane.xyz, p) + plane.w >= 0, xyz of unit length)
+inline glm::mat4 obliqueNearPlane(const glm::mat4& projection, const glm::vec4& viewPlane)
+{
+    // a = cos of the half-diagonal angle: nothing in view is further from the plane than a * w
+    float tx = 1.0f / projection[0][0], ty = 1.0f / projection[1][1];
+    float a = 0.99f / std::sqrt(1.0f + tx * tx + ty * ty);
+    glm::mat4 m = projection;
+    for (int c = 0; c < 4; c++) m[c][2] = projection[c][3] - a * viewPlane[c];
+    return m;
+}
+
+inline ViewParams mirroredView(const ViewParams& view, float height, float clipOffset)
+{
+    ViewParams v = view;
+    v.view = view.view * mirrorMatrix(height);
+    v.viewPos = glm::vec3(view.viewPos.x, 2.0f * height - view.viewPos.y, view.viewPos.z);
+    // the world plane y = height + clipOffset, keeping what is above it, in view space
+    glm::vec4 plane = glm::transpose(glm::inverse(v.view)) * glm::vec4(0.0f, 1.0f, 0.0f, -(height + clipOffset));
+    v.projection = obliqueNearPlane(view.projection, plane / glm::length(glm::vec3(plane)));
+    v.target = ViewTarget::PlanarReflection;
+    return v;
+}
+
+class PlanarReflection
+{
+public:
+    explicit PlanarReflection(const PlanarReflectionSettings& settings = PlanarReflectionSettings(), float clipOffset = 0.01f)
+        : settings(settings), clipOffset(clipOffset) {}
+
+    // appends a mirrored view for each of the first screenViews views; returns their view bits
+    uint32_t addViews(std::vector<ViewParams>& views, size_t screenViews) const
+    {
+        uint32_t mask = 0;
+        for (size_t v = 0; v < screenViews && views.size() < MAX_VIEWS; v++)
+        {
+            if (views[v].target != ViewTarget::Screen) continue;
+            mask |= 1u << views.size();
+            views.push_back(mirroredView(views[v], settings.planeHeight, clipOffset));
+        }
+        return mask;
+    }
+
+    void record(const RendererStats& stats)
+    {
+        const PassTiming* reflection = stats.pass("reflection");
+        const PassTiming* scene = stats.pass("scene");
+        if (!reflection || !scene) return;
+        frames++;
+        cpuMs += reflection->cpuMs;
+        sceneCpuMs += scene->cpuMs;
+        if (reflection->gpuMs >= 0.0 && scene->gpuMs >= 0.0)
+        {
+            gpuMs += reflection->gpuMs;
+            sceneGpuMs += scene->gpuMs;
+            gpuFrames++;
+        }
+    }
+
+    void printStats(std::ostream& out) const
+    {
+        if (!frames) return;
+        out << "planar reflection: 1/" << settings.resolutionDivisor << " resolution, " << cpuMs / frames << " ms CPU ("
+            << 100.0 * cpuMs / std::max(1e-9, sceneCpuMs) << "% of the scene pass)";
+        if (gpuFrames)
+            out << ", " << gpuMs / gpuFrames << " ms GPU (" << 100.0 * gpuMs / std::max(1e-9, sceneGpuMs) << "% of the scene pass)";
+        out << " per frame over " << frames << " frames\n";
+    }
+
+private:
+    PlanarReflectionSettings settings;
+    float clipOffset;
+    uint64_t frames = 0, gpuFrames = 0;
+    double cpuMs = 0.0, sceneCpuMs = 0.0, gpuMs = 0.0, sceneGpuMs = 0.0;
+};
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef POST_H
+#define POST_H
+
+// HDR post-processing (PostProcessSettings in renderer.h) held to a GPU time budget.
+//
+// The backends run three post passes after the scene, each timed on the GPU:
+// "bloom-down" (the thresholded target halved level by level, 13 taps per texel with
+// the brightest taps weighted down on the first level so single hot pixels do not
+// flicker), "bloom-up" (a 3x3 tent back up the chain, added onto each larger level)
+// and "tonemap" (scene + bloom, exposure and the ACES fit in one fullscreen pass that
+// writes the window, in place of the old copy).
+//
+// Nearly all of the bloom's cost is its first level, so the budget steps that down:
+// the chain starts at half resolution, then at quarter resolution with one level fewer,
+// then bloom is off and only the tonemap is left. PostProcessBudget averages the post
+// passes over a window of frames and moves a step down when they run over the budget,
+// and back up when the finer step's last measured cost, scaled by how the scene has
+// changed since, fits again.
+
+#include "renderer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+
+class PostProcessBudget
+{
+public:
+    static const int STEPS = 3;         // half-resolution bloom, quarter resolution, no bloom
+    static const int STAGES = 3;        // bloom-down, bloom-up, tonemap
+
+    // budgetMs <= 0 never changes the settings, only collects the timings
+    explicit PostProcessBudget(const PostProcessSettings& settings, double budgetMs = 1.0, unsigned int window = 30)
+        : requested(settings), budgetMs(budgetMs), window(window)
+    {
+        step = settings.bloomDivisor <= 0 ? STEPS - 1 : settings.bloomDivisor >= 4 ? 1 : 0;
+        top = step;
+    }
+
+    // the settings for the current step
+    PostProcessSettings settings() const
+    {
+        PostProcessSettings s = requested;
+        if (step == 1) { s.bloomDivisor = std::max(4, requested.bloomDivisor); s.bloomLevels = std::max(1, requested.bloomLevels - 1); }
+        if (step == 2) s.bloomDivisor = 0;
+        return s;
+    }
+
+    // collects this frame's post timings; true when settings() changed and should go to the renderer
+    bool update(const RendererStats& stats)
+    {
+        if (!requested.hdr) return false;
+        double frameMs = 0.0;
+        bool timed = false;
+        for (int stage = 0; stage < STAGES; stage++)
+        {
+            const PassTiming* pass = stats.pass(stageNames()[stage]);
+            if (!pass || pass->gpuMs < 0.0) continue;
+            stageMs[step][stage] += pass->gpuMs;
+            frameMs += pass->gpuMs;
+            timed = true;
+        }
+        if (!timed) return false;
+        stepFrames[step]++;
+        windowMs += frameMs;
+        if (++windowFrames < window) return false;
+
+        double mean = windowMs / windowFrames;
+        windowMs = 0.0;
+        windowFrames = 0;
+        measuredMs[step] = mean;
+        if (arrivalMs[step] <= 0.0) arrivalMs[step] = mean;
+        if (budgetMs <= 0.0) return false;
+        if (mean > budgetMs && step < STEPS - 1)
+        {
+            step++;
+            arrivalMs[step] = 0.0;
+            changes++;
+            return true;
+        }
+        if (step > top && measuredMs[step - 1] > 0.0 && arrivalMs[step] > 0.0)
+        {
+            // the finer step's cost when it was left, scaled by how this step's has moved since
+            double estimate = measuredMs[step - 1] * mean / arrivalMs[step];
+            if (estimate < 0.8 * budgetMs)
+            {
+                step--;
+                arrivalMs[step] = 0.0;
+                changes++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void printStats(std::ostream& out) const
+    {
+        if (!requested.hdr) return;
+        static const char* stepNames[STEPS] = { "half-res bloom", "quarter-res bloom", "no bloom" };
+        out << "post: budget " << budgetMs << " ms GPU, " << changes << " step change(s), now " << stepNames[step] << "\n";
+        for (int s = 0; s < STEPS; s++)
+        {
+            if (!stepFrames[s]) continue;
+            out << "  " << std::left << std::setw(18) << stepNames[s] << std::right << std::setw(6) << stepFrames[s] << " frames";
+            double total = 0.0;
+            for (int stage = 0; stage < STAGES; stage++)
+            {
+                out << "  " << stageNames()[stage] << " " << std::fixed << std::setprecision(3) << stageMs[s][stage] / stepFrames[s];
+                total += stageMs[s][stage];
+            }
+            out << "  total " << total / stepFrames[s] << " ms\n" << std::defaultfloat << std::setprecision(6);
+        }
+    }
+
+private:
+    static const char* const* stageNames()
+    {
+        static const char* names[STAGES] = { "bloom-down", "bloom-up", "tonemap" };
+        return names;
+    }
+
+    PostProcessSettings requested;
+    double budgetMs;
+    unsigned int window;
+    int step = 0, top = 0;              // top: the finest step allowed, as requested
+    uint64_t changes = 0;
+    uint64_t stepFrames[STEPS] = {};
+    double stageMs[STEPS][STAGES] = {};
+    double measuredMs[STEPS] = {};      // last window's mean at each step
+    double arrivalMs[STEPS] = {};       // first window's mean since moving to each step
+    double windowMs = 0.0;
+    unsigned int windowFrames = 0;
+};
+
+#endif
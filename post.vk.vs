@@ -0,0 +1,11 @@
+#version 450
+layout (location = 0) out vec2 TexCoord;
+
+// one triangle covering the target, from gl_VertexIndex alone (no vertex buffer); with
+// Vulkan's y-down viewport the texture's first row lands at the top, as it should
+void main()
+{
+    vec2 p = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    TexCoord = p;
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
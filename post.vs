@@ -0,0 +1,10 @@
+#version 330 core
+out vec2 TexCoord;
+
+// one triangle covering the target, from gl_VertexID alone (no vertex buffer)
+void main()
+{
+    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoord = p;
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
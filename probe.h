@@ -0,0 +1,96 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+// Dynamic reflection probe: a small cubemap of the scene around the player's car, which
+// the car shader reflects (see ReflectionSettings in renderer.h).
+//
+// Rendering all six faces every frame would be six extra scene passes. Instead the probe
+// is updated a few faces per frame, round-robin (facesPerFrame, 1 to 6): each face is
+// one more view of the frame, appended after the screen views, so it shares the frame's
+// draw list and joint culling (culling.h) and costs only what it draws at probe
+// resolution. A full refresh takes 6 / facesPerFrame frames; at 60 Hz and the default
+// of 2, the reflection lags by at most 50 ms, which a blurred lookup hides well.
+//
+// Faces use the usual cubemap orientation for a GL render target (the image's "up" is
+// -Y for the side faces). The backends render probe faces without any clip-space flip,
+// so the same views fill the Vulkan cube too.
+//
+// The backend times the probe as the "probe" pass; record() collects it every frame.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "renderer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+struct ReflectionProbeConfig
+{
+    int facesPerFrame = 2;      // 0 disables the updates (the cars keep reflecting the skybox)
+    float nearPlane = 0.1f;
+};
+
+class ReflectionProbe
+{
+public:
+    explicit ReflectionProbe(const ReflectionProbeConfig& config = ReflectionProbeConfig()) : config(config) {}
+
+    // appends this frame's faces, centred on `position`; returns the mask of their view bits
+    uint32_t addViews(std::vector<ViewParams>& views, const glm::vec3& position)
+    {
+        uint32_t mask = 0;
+        int faces = std::min(config.facesPerFrame, 6);
+        for (int i = 0; i < faces && views.size() < MAX_VIEWS; i++)
+        {
+            mask |= 1u << views.size();
+            views.push_back(faceView(nextFace, position, config.nearPlane));
+            nextFace = (nextFace + 1) % 6;
+            facesRendered++;
+        }
+        return mask;
+    }
+
+    static ViewParams faceView(int face, const glm::vec3& position, float nearPlane)
+    {
+        static const glm::vec3 dirs[6] = { glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+                                           glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) };
+        static const glm::vec3 ups[6] = { glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1),
+                                          glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0) };
+        ViewParams v;
+        v.view = glm::lookAt(position, position + dirs[face], ups[face]);
+        v.projection = reversedZPerspective(glm::radians(90.0f), 1.0f, nearPlane);
+        v.viewPos = position;
+        v.target = ViewTarget::ReflectionProbe;
+        v.face = face;
+        return v;
+    }
+
+    void record(const RendererStats& stats)
+    {
+        frames++;
+        const PassTiming* pass = stats.pass("probe");
+        if (!pass) return;
+        cpuMs += pass->cpuMs;
+        if (pass->gpuMs >= 0.0) { gpuMs += pass->gpuMs; gpuFrames++; }
+    }
+
+    void printStats(std::ostream& out, int size) const
+    {
+        if (!frames || !config.facesPerFrame) return;
+        out << "reflection probe: " << size << "^2 x 6, " << config.facesPerFrame << " face(s)/frame (full refresh every "
+            << (6 + config.facesPerFrame - 1) / config.facesPerFrame << " frames), " << cpuMs / frames << " ms CPU";
+        if (gpuFrames) out << ", " << gpuMs / gpuFrames << " ms GPU";
+        out << " per frame over " << frames << " frames, " << facesRendered << " faces\n";
+    }
+
+private:
+    ReflectionProbeConfig config;
+    int nextFace = 0;
+    uint64_t frames = 0, gpuFrames = 0, facesRendered = 0;
+    double cpuMs = 0.0, gpuMs = 0.0;
+};
+
+#endif
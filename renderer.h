@@ -0,0 +1,326 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+// Backend-neutral renderer interface.
+// main() owns the simulation and builds a flat draw list every frame; the active
+// backend (OpenGL 3.3 or Vulkan) turns that list into API calls. Handles returned
+// by the create/load functions are small integers owned by the backend.
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// which shader pair a draw item is rendered with
+enum class Material
+{
+    Floor,  // floor.vs / floor.fs: textured Phong (floor, wall)
+    Car,    // 1.model_loading.vs / .fs: model textures
+    Terrain // terrain.vs / floor.fs: flat grid displaced by DrawItem::heightmap in the vertex shader
+};
+
+// Baked light around a point, from the light probe grid (light_probes.h): per colour
+// channel, L1 spherical harmonics in the form light(n) = max(x + dot(yzw, n), 0), scaled
+// like the floor's diffuse term (what multiplies the surface colour).
+struct LightProbeSH
+{
+    glm::vec4 r, g, b;
+};
+
+struct DrawItem
+{
+    unsigned int mesh;      // handle from createMesh() or loadModel()
+    Material material;
+    glm::mat4 model;
+    unsigned int texture;   // handle from loadTexture(), ignored for models (they carry their own)
+    unsigned int heightmap = 0;   // handle from createHeightmap(), Material::Terrain only
+    uint32_t viewMask = ~0u;      // bit v set: drawn in FrameParams::views[v] (see culling.h)
+    glm::mat4 prevModel = glm::mat4(0.0f);  // last frame's model, for motion vectors; all zero: it has not moved
+    int lightmapChart = -1;       // LightmapData::charts index: direct light from the lightmap (Floor and Terrain only)
+    bool hasLightProbe = false;   // Material::Car: lit by lightProbe as well as the sky
+    LightProbeSH lightProbe = { glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f) };  // the light probe grid sampled at the item
+};
+
+const unsigned int MAX_SCREEN_VIEWS = 4;   // split-screen players
+const unsigned int MAX_VIEWS = 16;          // all views of a frame, offscreen ones included
+
+// where a view renders to
+enum class ViewTarget
+{
+    Screen,             // its rect of the frame
+    ReflectionProbe,    // face `face` of the reflection probe cubemap (see probe.h)
+    PlanarReflection    // its rect of the floor's reflection target, mirrored (see planar_reflection.h)
+};
+
+// one camera of the frame, drawn into its own part of the target
+struct ViewParams
+{
+    glm::mat4 view;
+    glm::mat4 projection;   // reversed-Z, see reversedZPerspective(); backends convert if needed
+    glm::vec3 viewPos;
+    glm::vec4 rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);  // viewport x, y (from the bottom left), width, height as fractions
+    ViewTarget target = ViewTarget::Screen;
+    int face = 0;           // cube face for ReflectionProbe views: +X, -X, +Y, -Y, +Z, -Z
+    // temporal anti-aliasing (taa.h): the sub-pixel offset in NDC already applied to
+    // projection (see jitteredProjection()), and last frame's unjittered projection * view;
+    // all zero: no history, the camera has not moved
+    glm::vec2 jitter = glm::vec2(0.0f);
+    glm::mat4 prevViewProjection = glm::mat4(0.0f);
+};
+
+struct FrameParams
+{
+    std::vector<ViewParams> views;  // up to MAX_VIEWS; every view sees the same draw list
+    glm::vec3 lightPos;
+    glm::vec3 clearColor;
+};
+
+// Cars reflect an environment cubemap: the skybox, or with probeSize > 0 a cubemap of
+// that size rendered around the car by ReflectionProbe views. The reflection is read
+// from mip level blurLod, which is both the cheap blur for a glossy paint and fewer
+// texels touched than the full-resolution face.
+struct ReflectionSettings
+{
+    int probeSize = 128;        // 0: no probe, reflect the skybox only
+    float reflectivity = 0.15f; // reflectance facing the camera; grazing angles reach 1 (Schlick)
+    float blurLod = 1.0f;
+    float roughness = 0.3f;     // paint roughness for the prefiltered skybox and the BRDF table (IBLData)
+};
+
+// The floor (Material::Floor and Terrain fragments lying flat on y = planeHeight)
+// mirrors the scene: PlanarReflection views render it into a target 1/resolutionDivisor
+// of the scene's size, sampling textures lodBias mips coarser, and the floor blends it
+// in by strength. resolutionDivisor 0 turns the target off.
+struct PlanarReflectionSettings
+{
+    int resolutionDivisor = 2;  // 2: half resolution, 4: quarter
+    float strength = 0.35f;
+    float lodBias = 1.0f;
+    float planeHeight = 0.0f;
+};
+
+// HDR output (post.h): with hdr set, the screen views render into a half-float target
+// and one fused pass tonemaps it to the window (ACES filmic fit, after exposure) with
+// bloom added. Bloom takes what is brighter than bloomThreshold, downsamples it from
+// 1/bloomDivisor of the target's size through bloomLevels halvings and blurs it back
+// up. With hdr off the frame is 8-bit and copied to the window as it is.
+const int MAX_BLOOM_LEVELS = 8;
+
+struct PostProcessSettings
+{
+    bool hdr = true;
+    float exposure = 1.0f;
+    int bloomDivisor = 2;       // 2: the chain starts at half resolution, 4: quarter, 0: no bloom
+    int bloomLevels = 5;        // up to MAX_BLOOM_LEVELS
+    float bloomThreshold = 1.0f;
+    float bloomStrength = 0.5f;
+};
+
+// Temporal anti-aliasing (taa.h), on the HDR path only: the screen views are jittered by
+// a sub-pixel offset every frame, write motion vectors next to their colour, and one
+// resolve pass blends each pixel with last frame's result, found through the motion
+// vector and clamped to the current pixel's neighbourhood. With renderScale < 1 the
+// scene renders at that fraction of the window's size and the resolve upsamples it, so
+// the jitter fills in the missing pixels over a few frames.
+struct TemporalAASettings
+{
+    bool enabled = true;
+    float renderScale = 1.0f;   // scene size per window size, 0.5 to 1
+    float feedback = 0.9f;      // history weight per frame
+};
+
+// Screen-space ambient occlusion (ssao.h) for the screen views: their depth drawn again
+// at half resolution, the occlusion computed from it with normals reconstructed from the
+// depth, a depth-aware blur, and the floor and car shaders upsampling the result by
+// depth to darken their ambient light. The presets trade samples and blur width.
+enum class AOQuality { Off, Low, Medium, High };
+
+struct AmbientOcclusionSettings
+{
+    AOQuality quality = AOQuality::Medium;
+    float radius = 0.6f;        // world units around each pixel that can occlude it
+    float intensity = 1.0f;
+};
+
+// occlusion samples per pixel and blur taps either side of it for a preset
+inline int aoSampleCount(AOQuality quality)
+{
+    return quality == AOQuality::High ? 16 : quality == AOQuality::Medium ? 8 : quality == AOQuality::Low ? 4 : 0;
+}
+
+inline int aoBlurRadius(AOQuality quality)
+{
+    return quality == AOQuality::High ? 4 : quality == AOQuality::Medium ? 2 : quality == AOQuality::Low ? 1 : 0;
+}
+
+// Image-based lighting precomputed from the skybox (ibl.h): diffuse irradiance as nine
+// spherical-harmonic coefficients, the skybox convolved with the GGX lobe for rising
+// roughness down a mip chain, and the split-sum BRDF table that scales and biases the
+// reflectance F0. Half floats, so the backends upload them as they are.
+struct IBLData
+{
+    glm::vec3 sh[9] = {};           // irradiance / pi per basis function (evaluate with the l <= 2 basis)
+    int specularSize = 0, specularMips = 0;
+    std::vector<uint16_t> specular; // RGBA16F, mip by mip, the six faces (+X, -X, +Y, -Y, +Z, -Z) within a mip
+    int lutSize = 0;
+    std::vector<uint16_t> brdfLut;  // RG16F, lutSize^2: x = N.V, y = roughness
+
+    bool valid() const { return specularMips > 0 && lutSize > 0; }
+    int mipSize(int mip) const { return std::max(1, specularSize >> mip); }
+    // index of the first half of a mip in `specular`
+    size_t specularOffset(int mip) const
+    {
+        size_t offset = 0;
+        for (int m = 0; m < mip; m++) offset += (size_t)mipSize(m) * mipSize(m) * 4 * 6;
+        return offset;
+    }
+};
+
+// Light baked for the static geometry (lightmap.h): an atlas of the light reaching each
+// texel from the level's lights, direct and bounced once, shadows included, and the
+// charts that place surfaces in it. A chart is two world-space planes, u = dot(u.xyz, p)
+// + u.w and likewise v, which maps a planar surface (or, projected along y, the ground)
+// straight to atlas coordinates, so meshes need no second set of texcoords. rect is the
+// chart's part of the atlas (min uv, max uv); fragments outside it are lit as before.
+const unsigned int MAX_LIGHTMAP_CHARTS = 16;
+
+struct LightmapChart
+{
+    glm::vec4 u, v, rect;
+};
+
+struct LightmapData
+{
+    int width = 0, height = 0;
+    std::vector<uint16_t> texels;   // RGBA16F, width x height, row 0 at v = 0
+    std::vector<LightmapChart> charts;
+
+    bool valid() const { return width > 0 && height > 0 && !charts.empty(); }
+};
+
+// Split-screen layouts: one view fills the target, two stack top and bottom, three and
+// four share a 2x2 grid (with three, the first view spans the top row).
+inline glm::vec4 splitScreenRect(unsigned int count, unsigned int index)
+{
+    if (count <= 1) return glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    if (count == 2) return glm::vec4(0.0f, index == 0 ? 0.5f : 0.0f, 1.0f, 0.5f);
+    if (count == 3 && index == 0) return glm::vec4(0.0f, 0.5f, 1.0f, 0.5f);
+    unsigned int cell = count == 3 ? index + 1 : index;
+    return glm::vec4((cell & 1) ? 0.5f : 0.0f, cell < 2 ? 0.5f : 0.0f, 0.5f, 0.5f);
+}
+
+// Perspective projection with reversed depth and no far plane: clip z is the constant
+// zNear, so depth = z / w = zNear / distance runs from 1 at the near plane to 0 at
+// infinity. Stored in a float depth buffer, the float exponent cancels the 1/distance
+// falloff and precision stays roughly constant relative to distance all the way out,
+// where a fixed-point buffer (or forward Z) runs out within a few hundred units.
+// Backends clear depth to 0 and keep fragments with GREATER depth.
+inline glm::mat4 reversedZPerspective(float fovy, float aspect, float zNear)
+{
+    float f = 1.0f / std::tan(fovy * 0.5f);
+    glm::mat4 m(0.0f);
+    m[0][0] = f / aspect;
+    m[1][1] = f;
+    m[2][3] = -1.0f;    // w = distance in front of the camera
+    m[3][2] = zNear;
+    return m;
+}
+
+// projection shifted by ndcOffset in clip x and y; with the w = -z projections here the
+// shift is the same at every depth. jitteredProjection(p, -offset) undoes it.
+inline glm::mat4 jitteredProjection(const glm::mat4& projection, const glm::vec2& ndcOffset)
+{
+    glm::mat4 m = projection;
+    m[2][0] -= ndcOffset.x;
+    m[2][1] -= ndcOffset.y;
+    return m;
+}
+
+// The matrices the scene shaders take motion vectors from (taa.h): this frame's
+// unjittered projection * view and last frame's, in GL's clip space, scaled to the
+// view's rect so that the difference of their NDC is motion across the whole target
+inline void motionMatrices(const ViewParams& view, glm::mat4& current, glm::mat4& previous)
+{
+    glm::mat4 toTarget(1.0f);
+    toTarget[0][0] = view.rect.z;
+    toTarget[1][1] = view.rect.w;
+    glm::mat4 viewProjection = jitteredProjection(view.projection, -view.jitter) * view.view;
+    current = toTarget * viewProjection;
+    previous = toTarget * (view.prevViewProjection == glm::mat4(0.0f) ? viewProjection : view.prevViewProjection);
+}
+
+// CPU time of a render pass in the last frame and its GPU time a few frames back (the
+// backends read timer queries late rather than wait for them); gpuMs < 0 until known
+struct PassTiming
+{
+    const char* name = "";
+    double cpuMs = 0.0;
+    double gpuMs = -1.0;
+};
+
+const unsigned int MAX_PASSES = 16;
+
+struct RendererStats
+{
+    double submitCpuMs = 0.0;   // CPU time spent turning the last draw list into API work
+    unsigned int drawCalls = 0;
+    unsigned int viewCount = 0;
+    double viewCpuMs[MAX_VIEWS] = {};       // the part of submitCpuMs spent on each view
+    unsigned int viewDrawCalls[MAX_VIEWS] = {};
+    unsigned int passCount = 0;
+    PassTiming passes[MAX_PASSES];
+
+    const PassTiming* pass(const char* name) const
+    {
+        for (unsigned int p = 0; p < passCount; p++)
+            if (std::string(passes[p].name) == name) return &passes[p];
+        return nullptr;
+    }
+};
+
+class Renderer
+{
+public:
+    virtual ~Renderer() {}
+
+    virtual const char* name() const = 0;
+
+    // interleaved vertices: position(3) normal(3) texcoord(2)
+    virtual unsigned int createMesh(const float* vertices, size_t vertexCount,
+                                    const unsigned int* indices, size_t indexCount) = 0;
+    virtual unsigned int loadModel(const std::string& path) = 0;
+    // releases a mesh from createMesh(); its handle may be handed out again
+    virtual void destroyMesh(unsigned int mesh) = 0;
+    // mesh-space bounding box of a mesh or model (for culling); false if it has no vertices
+    virtual bool meshBounds(unsigned int mesh, glm::vec3& min, glm::vec3& max) const = 0;
+    virtual unsigned int loadTexture(const std::string& path) = 0;
+    // size x size float heights (size a power of two), rows along +x stacked along +z,
+    // `spacing` world units apart; the terrain shader repeats them in both directions
+    virtual unsigned int createHeightmap(const float* heights, int size, float spacing) = 0;
+    // faces in +X, -X, +Y, -Y, +Z, -Z order; drawn behind everything once set
+    virtual void setSkybox(const std::vector<std::string>& faces) = 0;
+    virtual void setReflections(const ReflectionSettings& settings) = 0;
+    virtual void setPlanarReflections(const PlanarReflectionSettings& settings) = 0;
+    // lights the cars and the ground with the skybox on top of lightPos; until set (or
+    // when !ibl.valid()) they keep their constant ambient
+    virtual void setEnvironmentLighting(const IBLData& ibl) = 0;
+    virtual void setPostProcess(const PostProcessSettings& settings) = 0;
+    // takes effect with PostProcessSettings::hdr
+    virtual void setTemporalAA(const TemporalAASettings& settings) = 0;
+    virtual void setAmbientOcclusion(const AmbientOcclusionSettings& settings) = 0;
+    // items with a lightmapChart take their direct light from here instead of lightPos;
+    // the first MAX_LIGHTMAP_CHARTS charts are used
+    virtual void setLightmap(const LightmapData& lightmap) = 0;
+
+    virtual void resize(int width, int height) = 0;
+    virtual void beginFrame(const FrameParams& frame) = 0;
+    virtual void submit(const std::vector<DrawItem>& items) = 0;
+    virtual void endFrame() = 0;    // presents
+
+    virtual RendererStats stats() const = 0;
+};
+
+#endif
@@ -0,0 +1,1302 @@
+#ifndef RENDERER_GL_H
+#define RENDERER_GL_H
+
+// OpenGL 3.3 core backend: the original single-threaded render path behind the
+// Renderer interface.
+//
+// The scene renders into an offscreen target with a 32-bit float depth buffer (the
+// default framebuffer's depth is fixed-point) and is blitted to the window at the end
+// of the frame. Depth is reversed (see reversedZPerspective()): cleared to 0, tested
+// with GL_GREATER. With glClipControl (GL 4.5 or ARB_clip_control) clip-space depth is
+// [0, 1] and used as is; without it the projection is remapped to GL's [-1, 1], which
+// renders the same but gives back much of the precision gain.
+//
+// Each view of the frame draws into its own viewport of that target. The camera
+// uniforms (view, projection, viewPos, light) are set once per shader per view rather
+// than per item; only the model matrix and textures change between draws.
+//
+// Reflection probe faces (probe.h) render into a cubemap before the screen views, its
+// mips are rebuilt, and the car shader reflects it. Each pass is timed on the CPU and
+// with GL_TIME_ELAPSED queries (RendererStats::passes).
+//
+// With environment lighting set (ibl.h), the cars and the ground take their ambient
+// from the sky's spherical harmonics (a uniform array), and the car's reflection is
+// the prefiltered skybox, or the probe when there is one, scaled by the BRDF table.
+//
+// Planar reflection views (planar_reflection.h) render into a reduced-resolution
+// target of their own between the probe and the scene; the floor shader samples it at
+// the fragment's screen position.
+//
+// With HDR on (post.h) the scene target is RGBA16F and endFrame() replaces the blit with
+// the post passes: the bloom chain (R11F_G11F_B10F, half the bytes of RGBA16F; one FBO
+// whose attachment changes per level, like the probe's) and the tonemap, drawn straight
+// into the window. They are fullscreen triangles from an empty VAO.
+//
+// Temporal anti-aliasing (taa.h) needs the HDR path: the scene target gets an RG16F
+// motion vector attachment (cleared to zero, so the sky and anything drawn without one
+// stays put) and the resolve runs first in postProcess(), blending the scene into one
+// of two history textures at the window's size, which then stands in for the scene in
+// bloom and the tonemap. With TemporalAASettings::renderScale < 1 the scene target is
+// that much smaller than the window and the resolve upsamples it.
+//
+// Ambient occlusion (ssao.h) runs between the reflections and the scene: the screen
+// views' depth drawn again into a half-resolution depth texture (position only, the
+// floor's and the terrain's vertex shaders with an empty fragment shader), the
+// occlusion from it into an R8 texture, and a separable blur through a second one and
+// back. The floor, terrain and car shaders then read it with the depth next to it.
+//
+// The lightmap (lightmap.h) is one RGBA16F texture; a floor or terrain draw with a
+// chart gets the chart's planes and rect as uniforms next to its model matrix.
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <stb_image.h>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/model.h>
+
+#include "jobs.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+#ifndef GL_LOWER_LEFT
+#define GL_LOWER_LEFT 0x8CA1
+#endif
+#ifndef GL_ZERO_TO_ONE
+#define GL_ZERO_TO_ONE 0x935F
+#endif
+typedef void (APIENTRYP ClipControlProc)(GLenum origin, GLenum depth);
+
+unsigned int loadTexture(const char *path);
+unsigned int loadCubemap(std::vector<std::string> faces);
+
+class GLRenderer : public Renderer
+{
+public:
+    static const int ENVIRONMENT_UNIT = 8;   // above the units Model::Draw binds its textures to
+    static const int SPECULAR_UNIT = 9;
+    static const int BRDF_LUT_UNIT = 10;
+    static const int PLANAR_UNIT = 11;
+    static const int OCCLUSION_UNIT = 12;
+    static const int OCCLUSION_DEPTH_UNIT = 13;
+    static const int LIGHTMAP_UNIT = 14;
+
+    GLRenderer(GLFWwindow* window)
+        : window(window),
+          modelShader("1.model_loading.vs", "1.model_loading.fs"),
+          skyboxShader("6.2.skybox.vs", "6.2.skybox.fs"),
+          floorShader("floor.vs", "floor.fs"),
+          terrainShader("terrain.vs", "floor.fs"),
+          bloomDownShader("post.vs", "bloom_downsample.fs"),
+          bloomUpShader("post.vs", "bloom_upsample.fs"),
+          tonemapShader("post.vs", "tonemap.fs"),
+          taaShader("post.vs", "taa.fs"),
+          aoDepthShader("floor.vs", "depth.fs"),
+          aoTerrainDepthShader("terrain.vs", "depth.fs"),
+          ssaoShader("post.vs", "ssao.fs"),
+          ssaoBlurShader("post.vs", "ssao_blur.fs")
+    {
+        // reversed-Z: [0, 1] clip depth where the driver allows it
+        ClipControlProc clipControl = nullptr;
+        if (glfwExtensionSupported("GL_ARB_clip_control") || glfwGetWindowAttrib(window, GLFW_CONTEXT_VERSION_MAJOR) * 10 + glfwGetWindowAttrib(window, GLFW_CONTEXT_VERSION_MINOR) >= 45)
+            clipControl = (ClipControlProc)glfwGetProcAddress("glClipControl");
+        if (clipControl) clipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+        zeroToOneDepth = clipControl != nullptr;
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_GREATER);
+        glClearDepth(0.0);
+
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        createTargets(width, height);
+
+        float skyboxVertices[] = {
+            -1.0f,  1.0f, -1.0f,  -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,
+             1.0f, -1.0f, -1.0f,   1.0f,  1.0f, -1.0f,  -1.0f,  1.0f, -1.0f,
+
+            -1.0f, -1.0f,  1.0f,  -1.0f, -1.0f, -1.0f,  -1.0f,  1.0f, -1.0f,
+            -1.0f,  1.0f, -1.0f,  -1.0f,  1.0f,  1.0f,  -1.0f, -1.0f,  1.0f,
+
+             1.0f, -1.0f, -1.0f,   1.0f, -1.0f,  1.0f,   1.0f,  1.0f,  1.0f,
+             1.0f,  1.0f,  1.0f,   1.0f,  1.0f, -1.0f,   1.0f, -1.0f, -1.0f,
+
+            -1.0f, -1.0f,  1.0f,  -1.0f,  1.0f,  1.0f,   1.0f,  1.0f,  1.0f,
+             1.0f,  1.0f,  1.0f,   1.0f, -1.0f,  1.0f,  -1.0f, -1.0f,  1.0f,
+
+            -1.0f,  1.0f, -1.0f,   1.0f,  1.0f, -1.0f,   1.0f,  1.0f,  1.0f,
+             1.0f,  1.0f,  1.0f,  -1.0f,  1.0f,  1.0f,  -1.0f,  1.0f, -1.0f,
+
+            -1.0f, -1.0f, -1.0f,  -1.0f, -1.0f,  1.0f,   1.0f, -1.0f, -1.0f,
+             1.0f, -1.0f, -1.0f,  -1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f
+        };
+        glGenVertexArrays(1, &skyboxVAO);
+        glGenBuffers(1, &skyboxVBO);
+        glBindVertexArray(skyboxVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glBindVertexArray(0);
+
+        skyboxShader.use();
+        skyboxShader.setInt("skybox", 0);
+        glGenVertexArrays(1, &postVAO);
+        tonemapShader.use();
+        tonemapShader.setInt("scene", 0);
+        tonemapShader.setInt("bloom", 1);
+        taaShader.use();
+        taaShader.setInt("current", 0);
+        taaShader.setInt("history", 1);
+        taaShader.setInt("velocity", 2);
+        ssaoShader.use();
+        ssaoShader.setInt("depth", 0);
+        ssaoBlurShader.use();
+        ssaoBlurShader.setInt("occlusion", 0);
+        ssaoBlurShader.setInt("depth", 1);
+        aoTerrainDepthShader.use();
+        aoTerrainDepthShader.setInt("heightmap", 1);
+    }
+
+    ~GLRenderer()
+    {
+        for (const MeshEntry& m : meshes)
+        {
+            if (m.model || !m.VAO) continue;
+            glDeleteVertexArrays(1, &m.VAO);
+            glDeleteBuffers(1, &m.VBO);
+            glDeleteBuffers(1, &m.EBO);
+        }
+        glDeleteVertexArrays(1, &skyboxVAO);
+        glDeleteBuffers(1, &skyboxVBO);
+        glDeleteVertexArrays(1, &postVAO);
+        destroyTargets();
+        if (probeTexture) destroyProbe();
+        glDeleteTextures(1, &iblSpecular);
+        glDeleteTextures(1, &iblLut);
+        glDeleteTextures(1, &lightmapTexture);
+        probeTimer.destroy();
+        planarTimer.destroy();
+        sceneTimer.destroy();
+        bloomDownTimer.destroy();
+        bloomUpTimer.destroy();
+        tonemapTimer.destroy();
+        taaTimer.destroy();
+        aoDepthTimer.destroy();
+        ssaoTimer.destroy();
+        ssaoBlurTimer.destroy();
+    }
+
+    const char* name() const override { return "OpenGL 3.3"; }
+
+    unsigned int createMesh(const float* vertices, size_t vertexCount,
+                            const unsigned int* indices, size_t indexCount) override
+    {
+        MeshEntry m;
+        m.indexCount = (unsigned int)indexCount;
+        glGenVertexArrays(1, &m.VAO);
+        glGenBuffers(1, &m.VBO);
+        glGenBuffers(1, &m.EBO);
+
+        glBindVertexArray(m.VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m.VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * 8 * sizeof(float), vertices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+
+        // pos
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        // normal
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        // texcoord
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glBindVertexArray(0);
+
+        for (size_t v = 0; v < vertexCount; v++)
+            m.extend(glm::vec3(vertices[v * 8], vertices[v * 8 + 1], vertices[v * 8 + 2]));
+
+        if (!freeMeshes.empty())
+        {
+            unsigned int handle = freeMeshes.back();
+            freeMeshes.pop_back();
+            meshes[handle] = std::move(m);
+            return handle;
+        }
+        meshes.push_back(std::move(m));
+        return (unsigned int)meshes.size() - 1;
+    }
+
+    void destroyMesh(unsigned int mesh) override
+    {
+        MeshEntry& m = meshes[mesh];
+        if (m.model || !m.VAO) return;
+        glDeleteVertexArrays(1, &m.VAO);
+        glDeleteBuffers(1, &m.VBO);
+        glDeleteBuffers(1, &m.EBO);
+        m = MeshEntry();
+        freeMeshes.push_back(mesh);
+    }
+
+    unsigned int loadModel(const std::string& path) override
+    {
+        MeshEntry m;
+        m.model.reset(new Model(path));
+        for (const Mesh& mesh : m.model->meshes)
+            for (const Vertex& v : mesh.vertices) m.extend(v.Position);
+        meshes.push_back(std::move(m));
+        return (unsigned int)meshes.size() - 1;
+    }
+
+    bool meshBounds(unsigned int mesh, glm::vec3& min, glm::vec3& max) const override
+    {
+        const MeshEntry& m = meshes[mesh];
+        if (m.boundsMin.x > m.boundsMax.x) return false;
+        min = m.boundsMin;
+        max = m.boundsMax;
+        return true;
+    }
+
+    // the GL backend hands out raw texture names; 0 means "failed to load"
+    unsigned int loadTexture(const std::string& path) override
+    {
+        return ::loadTexture(path.c_str());
+    }
+
+    unsigned int createHeightmap(const float* heights, int size, float spacing) override
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, size, size, 0, GL_RED, GL_FLOAT, heights);
+        // read with texelFetch and filtered in the shader, exactly like the CPU queries
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        heightSpacing[textureID] = spacing;
+        return textureID;
+    }
+
+    void setSkybox(const std::vector<std::string>& faces) override
+    {
+        cubemapTexture = loadCubemap(faces);
+    }
+
+    void setReflections(const ReflectionSettings& settings) override
+    {
+        reflections = settings;
+        if (probeSize == settings.probeSize) return;
+        if (probeTexture) destroyProbe();
+        if (settings.probeSize > 0) createProbe(settings.probeSize);
+    }
+
+    void setPlanarReflections(const PlanarReflectionSettings& settings) override
+    {
+        destroyPlanarTarget();
+        planar = settings;
+        createPlanarTarget();
+    }
+
+    void setEnvironmentLighting(const IBLData& data) override
+    {
+        glDeleteTextures(1, &iblSpecular);
+        glDeleteTextures(1, &iblLut);
+        iblSpecular = iblLut = 0;
+        ibl = IBLData();
+        if (!data.valid()) return;
+        ibl.specularMips = data.specularMips;
+        for (int i = 0; i < 9; i++) ibl.sh[i] = data.sh[i];
+
+        // the mips are the roughness levels, uploaded as computed rather than generated
+        glGenTextures(1, &iblSpecular);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, iblSpecular);
+        for (int mip = 0; mip < data.specularMips; mip++)
+        {
+            int size = data.mipSize(mip);
+            for (int face = 0; face < 6; face++)
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mip, GL_RGBA16F, size, size, 0, GL_RGBA, GL_HALF_FLOAT,
+                             &data.specular[data.specularOffset(mip) + (size_t)face * size * size * 4]);
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, data.specularMips - 1);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        for (GLenum wrap : { GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R })
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, wrap, GL_CLAMP_TO_EDGE);
+        // the rough mips are a few texels a side; without this their face edges show
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+        glGenTextures(1, &iblLut);
+        glBindTexture(GL_TEXTURE_2D, iblLut);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, data.lutSize, data.lutSize, 0, GL_RG, GL_HALF_FLOAT, data.brdfLut.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    void setLightmap(const LightmapData& data) override
+    {
+        glDeleteTextures(1, &lightmapTexture);
+        lightmapTexture = 0;
+        lightmapCharts.clear();
+        if (!data.valid()) return;
+        lightmapCharts.assign(data.charts.begin(), data.charts.begin() + std::min<size_t>(data.charts.size(), MAX_LIGHTMAP_CHARTS));
+
+        glGenTextures(1, &lightmapTexture);
+        glBindTexture(GL_TEXTURE_2D, lightmapTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, data.width, data.height, 0, GL_RGBA, GL_HALF_FLOAT, data.texels.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    void setPostProcess(const PostProcessSettings& settings) override
+    {
+        destroyTargets();
+        post = settings;
+        createTargets(outputWidth, outputHeight);
+    }
+
+    void setTemporalAA(const TemporalAASettings& settings) override
+    {
+        destroyTargets();
+        taa = settings;
+        createTargets(outputWidth, outputHeight);
+    }
+
+    void setAmbientOcclusion(const AmbientOcclusionSettings& settings) override
+    {
+        // the presets share the targets; only turning it on or off changes them
+        bool resize = (settings.quality == AOQuality::Off) != (ao.quality == AOQuality::Off);
+        if (resize) destroyOcclusionTargets();
+        ao = settings;
+        if (resize) createOcclusionTargets();
+    }
+
+    // access for GL-only features that need the underlying objects
+    Model* model(unsigned int handle) { return meshes[handle].model.get(); }
+
+    void resize(int width, int height) override
+    {
+        if (width == 0 || height == 0) return;   // minimized
+        destroyTargets();
+        createTargets(width, height);
+    }
+
+    void beginFrame(const FrameParams& f) override
+    {
+        frame = f;
+        if (!zeroToOneDepth)
+        {
+            // [0, 1] -> [-1, 1]: z' = 2z - w
+            glm::mat4 remap(1.0f);
+            remap[2][2] = 2.0f;
+            remap[3][2] = -1.0f;
+            for (ViewParams& v : frame.views) v.projection = remap * v.projection;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+        glViewport(0, 0, targetWidth, targetHeight);
+        glClearColor(f.clearColor.r, f.clearColor.g, f.clearColor.b, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (sceneVelocity)
+        {
+            const float still[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            glClearBufferfv(GL_COLOR, 1, still);
+        }
+    }
+
+    void submit(const std::vector<DrawItem>& items) override
+    {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        unsigned int draws = 0;
+        lastStats.viewCount = (unsigned int)std::min<size_t>(frame.views.size(), MAX_VIEWS);
+        lastStats.passCount = 0;
+        frameNumber++;
+
+        // reflection probe faces first, so this frame's cars already reflect them
+        auto passStart = std::chrono::high_resolution_clock::now();
+        bool probeDrawn = false;
+        for (unsigned int v = 0; v < lastStats.viewCount; v++)
+        {
+            const ViewParams& view = frame.views[v];
+            if (view.target != ViewTarget::ReflectionProbe || !probeTexture) continue;
+            if (!probeDrawn) probeTimer.begin(frameNumber);
+            probeDrawn = true;
+            glBindFramebuffer(GL_FRAMEBUFFER, probeFBO);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + view.face, probeTexture, 0);
+            glViewport(0, 0, probeSize, probeSize);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            draws += drawView(items, v);
+        }
+        if (probeDrawn)
+        {
+            // the mip chain is the blurred lookup (ReflectionSettings::blurLod)
+            glBindTexture(GL_TEXTURE_CUBE_MAP, probeTexture);
+            glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+            probeTimer.end(frameNumber);
+            probeValid = true;
+            addPass("probe", passStart, probeTimer);
+        }
+
+        // mirrored views into the floor's reflection target, each in its view's rect
+        passStart = std::chrono::high_resolution_clock::now();
+        planarDrawn = false;
+        for (unsigned int v = 0; v < lastStats.viewCount; v++)
+        {
+            const ViewParams& view = frame.views[v];
+            if (view.target != ViewTarget::PlanarReflection || !planarFBO) continue;
+            if (!planarDrawn)
+            {
+                planarTimer.begin(frameNumber);
+                glBindFramebuffer(GL_FRAMEBUFFER, planarFBO);
+                glViewport(0, 0, planarWidth, planarHeight);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            }
+            planarDrawn = true;
+            glViewport((int)(view.rect.x * planarWidth), (int)(view.rect.y * planarHeight),
+                       (int)(view.rect.z * planarWidth), (int)(view.rect.w * planarHeight));
+            draws += drawView(items, v);
+        }
+        if (planarDrawn)
+        {
+            planarTimer.end(frameNumber);
+            addPass("reflection", passStart, planarTimer);
+        }
+
+        if (aoDepthFBO) draws += ambientOcclusion(items);
+
+        passStart = std::chrono::high_resolution_clock::now();
+        sceneTimer.begin(frameNumber);
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+        for (unsigned int v = 0; v < lastStats.viewCount; v++)
+        {
+            const ViewParams& view = frame.views[v];
+            if (view.target != ViewTarget::Screen) continue;
+            glViewport((int)(view.rect.x * targetWidth), (int)(view.rect.y * targetHeight),
+                       (int)(view.rect.z * targetWidth), (int)(view.rect.w * targetHeight));
+            draws += drawView(items, v);
+        }
+        sceneTimer.end(frameNumber);
+        addPass("scene", passStart, sceneTimer);
+
+        lastStats.submitCpuMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+        lastStats.drawCalls = draws;
+    }
+
+    void endFrame() override
+    {
+        if (post.hdr) postProcess();
+        else
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, targetWidth, targetHeight, 0, 0, outputWidth, outputHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glfwSwapBuffers(window);
+    }
+
+    RendererStats stats() const override { return lastStats; }
+
+private:
+    struct MeshEntry
+    {
+        unsigned int VAO = 0, VBO = 0, EBO = 0;
+        unsigned int indexCount = 0;
+        std::unique_ptr<Model> model;   // set for imported models instead of VAO
+        glm::vec3 boundsMin = glm::vec3(1e30f), boundsMax = glm::vec3(-1e30f);
+
+        void extend(const glm::vec3& p) { boundsMin = glm::min(boundsMin, p); boundsMax = glm::max(boundsMax, p); }
+    };
+
+    GLFWwindow* window;
+    Shader modelShader;
+    Shader skyboxShader;
+    Shader floorShader;
+    Shader terrainShader;
+    Shader bloomDownShader;
+    Shader bloomUpShader;
+    Shader tonemapShader;
+    Shader taaShader;
+    Shader aoDepthShader;
+    Shader aoTerrainDepthShader;
+    Shader ssaoShader;
+    Shader ssaoBlurShader;
+
+    std::vector<MeshEntry> meshes;
+    std::vector<unsigned int> freeMeshes;   // destroyed createMesh() slots
+    unsigned int skyboxVAO = 0, skyboxVBO = 0;
+    unsigned int cubemapTexture = 0;
+    std::map<unsigned int, float> heightSpacing;   // createHeightmap() textures
+
+    // offscreen scene target: colour (a texture the post passes read) + float depth, and
+    // motion vectors with TAA; the window is outputWidth x outputHeight
+    unsigned int sceneFBO = 0, sceneColor = 0, sceneDepth = 0, sceneVelocity = 0;
+    int targetWidth = 0, targetHeight = 0;
+    int outputWidth = 0, outputHeight = 0;
+    bool zeroToOneDepth = false;   // glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE) is active
+
+    // post-processing (setPostProcess): bloom levels from 1/bloomDivisor of the target down
+    PostProcessSettings post;
+    unsigned int postVAO = 0, bloomFBO = 0;
+    unsigned int bloomTextures[MAX_BLOOM_LEVELS] = {};
+    int bloomWidth[MAX_BLOOM_LEVELS] = {}, bloomHeight[MAX_BLOOM_LEVELS] = {};
+    int bloomCount = 0;
+
+    // temporal anti-aliasing (setTemporalAA): the resolve writes history[historyIndex]
+    // and reads the other one, last frame's
+    TemporalAASettings taa;
+    unsigned int historyFBO = 0, historyTextures[2] = {};
+    int historyIndex = 0;
+    bool historyValid = false;  // the other history texture holds last frame
+
+    bool taaActive() const { return post.hdr && taa.enabled; }
+
+    // ambient occlusion (setAmbientOcclusion), half the scene target's size: the screen
+    // views' depth, and the occlusion in occlusionTextures[0] (the blur's first axis goes
+    // through [1])
+    AmbientOcclusionSettings ao;
+    unsigned int aoDepthFBO = 0, aoDepth = 0, aoFBO = 0, occlusionTextures[2] = {};
+    int aoWidth = 0, aoHeight = 0;
+
+    static unsigned int createTargetTexture(GLenum format, int width, int height)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    void createTargets(int width, int height)
+    {
+        outputWidth = width;
+        outputHeight = height;
+        float scale = taaActive() ? std::min(std::max(taa.renderScale, 0.5f), 1.0f) : 1.0f;
+        targetWidth = std::max(1, (int)(width * scale + 0.5f));
+        targetHeight = std::max(1, (int)(height * scale + 0.5f));
+        sceneColor = createTargetTexture(post.hdr ? GL_RGBA16F : GL_RGBA8, targetWidth, targetHeight);
+        glGenRenderbuffers(1, &sceneDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, sceneDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, targetWidth, targetHeight);
+        glGenFramebuffers(1, &sceneFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneColor, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, sceneDepth);
+        if (taaActive())
+        {
+            // read texel by texel: no filtering between neighbouring objects' motion
+            sceneVelocity = createTargetTexture(GL_RG16F, targetWidth, targetHeight);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, sceneVelocity, 0);
+            const GLenum buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+            glDrawBuffers(2, buffers);
+        }
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "Scene framebuffer incomplete\n";
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        createPlanarTarget();
+        createHistoryTargets();
+        createBloomTargets();
+        createOcclusionTargets();
+    }
+
+    void destroyTargets()
+    {
+        glDeleteFramebuffers(1, &sceneFBO);
+        glDeleteTextures(1, &sceneColor);
+        glDeleteTextures(1, &sceneVelocity);
+        glDeleteRenderbuffers(1, &sceneDepth);
+        sceneFBO = sceneColor = sceneDepth = sceneVelocity = 0;
+        destroyPlanarTarget();
+        destroyHistoryTargets();
+        destroyBloomTargets();
+        destroyOcclusionTargets();
+    }
+
+    void createOcclusionTargets()
+    {
+        if (ao.quality == AOQuality::Off || !targetWidth) return;
+        aoWidth = std::max(1, targetWidth / 2);
+        aoHeight = std::max(1, targetHeight / 2);
+        glGenTextures(1, &aoDepth);
+        glBindTexture(GL_TEXTURE_2D, aoDepth);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, aoWidth, aoHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glGenFramebuffers(1, &aoDepthFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, aoDepthFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, aoDepth, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "Ambient occlusion depth framebuffer incomplete\n";
+        for (unsigned int& texture : occlusionTextures) texture = createTargetTexture(GL_R8, aoWidth, aoHeight);
+        glGenFramebuffers(1, &aoFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void destroyOcclusionTargets()
+    {
+        if (!aoDepthFBO) return;
+        glDeleteFramebuffers(1, &aoDepthFBO);
+        glDeleteFramebuffers(1, &aoFBO);
+        glDeleteTextures(1, &aoDepth);
+        glDeleteTextures(2, occlusionTextures);
+        aoDepthFBO = aoFBO = aoDepth = 0;
+        occlusionTextures[0] = occlusionTextures[1] = 0;
+    }
+
+    // the screen views' depth at half resolution, their occlusion, then the blur; returns
+    // the depth pass's draw calls
+    unsigned int ambientOcclusion(const std::vector<DrawItem>& items)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        unsigned int draws = 0;
+        aoDepthTimer.begin(frameNumber);
+        glBindFramebuffer(GL_FRAMEBUFFER, aoDepthFBO);
+        glViewport(0, 0, aoWidth, aoHeight);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        for (unsigned int v = 0; v < lastStats.viewCount; v++)
+        {
+            const ViewParams& view = frame.views[v];
+            if (view.target != ViewTarget::Screen) continue;
+            glViewport((int)(view.rect.x * aoWidth), (int)(view.rect.y * aoHeight), (int)(view.rect.z * aoWidth), (int)(view.rect.w * aoHeight));
+            for (Shader* shader : { &aoDepthShader, &aoTerrainDepthShader })
+            {
+                shader->use();
+                shader->setMat4("projection", view.projection);
+                shader->setMat4("view", view.view);
+            }
+            for (const DrawItem& item : items)
+            {
+                if (!(item.viewMask & (1u << v))) continue;
+                const MeshEntry& m = meshes[item.mesh];
+                Shader& shader = item.material == Material::Terrain ? aoTerrainDepthShader : aoDepthShader;
+                shader.use();
+                shader.setMat4("model", item.model);
+                if (item.material == Material::Terrain)
+                {
+                    shader.setFloat("heightSpacing", heightSpacing[item.heightmap]);
+                    glActiveTexture(GL_TEXTURE1);
+                    glBindTexture(GL_TEXTURE_2D, item.heightmap);
+                    glActiveTexture(GL_TEXTURE0);
+                }
+                if (m.model)
+                {
+                    m.model->Draw(shader);
+                    draws += (unsigned int)m.model->meshes.size();
+                }
+                else
+                {
+                    glBindVertexArray(m.VAO);
+                    glDrawElements(GL_TRIANGLES, m.indexCount, GL_UNSIGNED_INT, 0);
+                    glBindVertexArray(0);
+                    draws++;
+                }
+            }
+        }
+        aoDepthTimer.end(frameNumber);
+        addPass("ao-depth", start, aoDepthTimer);
+
+        start = std::chrono::high_resolution_clock::now();
+        ssaoTimer.begin(frameNumber);
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(postVAO);
+        glBindFramebuffer(GL_FRAMEBUFFER, aoFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, occlusionTextures[0], 0);
+        ssaoShader.use();
+        ssaoShader.setFloat("radius", ao.radius);
+        ssaoShader.setFloat("intensity", ao.intensity);
+        ssaoShader.setInt("samples", aoSampleCount(ao.quality));
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, aoDepth);
+        for (unsigned int v = 0; v < lastStats.viewCount; v++)
+        {
+            const ViewParams& view = frame.views[v];
+            if (view.target != ViewTarget::Screen) continue;
+            int x = (int)(view.rect.x * aoWidth), y = (int)(view.rect.y * aoHeight);
+            int w = (int)(view.rect.z * aoWidth), h = (int)(view.rect.w * aoHeight);
+            glViewport(x, y, w, h);
+            ssaoShader.setVec4("viewport", glm::vec4((float)x, (float)y, (float)w, (float)h));
+            const glm::mat4& p = view.projection;
+            ssaoShader.setVec4("projectionInfo", glm::vec4(p[0][0], p[1][1], p[2][0], p[2][1]));
+            // the [-1, 1] remap in beginFrame() doubled it
+            ssaoShader.setFloat("near", zeroToOneDepth ? p[3][2] : 0.5f * p[3][2]);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        ssaoTimer.end(frameNumber);
+        addPass("ssao", start, ssaoTimer);
+
+        start = std::chrono::high_resolution_clock::now();
+        ssaoBlurTimer.begin(frameNumber);
+        glViewport(0, 0, aoWidth, aoHeight);
+        ssaoBlurShader.use();
+        ssaoBlurShader.setInt("radius", aoBlurRadius(ao.quality));
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, aoDepth);
+        glActiveTexture(GL_TEXTURE0);
+        for (int axis = 0; axis < 2; axis++)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, occlusionTextures[axis ^ 1], 0);
+            glBindTexture(GL_TEXTURE_2D, occlusionTextures[axis]);
+            ssaoBlurShader.setVec2("direction", axis == 0 ? glm::vec2(1.0f, 0.0f) : glm::vec2(0.0f, 1.0f));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        ssaoBlurTimer.end(frameNumber);
+        addPass("ssao-blur", start, ssaoBlurTimer);
+
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+        return draws;
+    }
+
+    void createHistoryTargets()
+    {
+        if (!taaActive() || !outputWidth) return;
+        for (unsigned int& texture : historyTextures) texture = createTargetTexture(GL_RGBA16F, outputWidth, outputHeight);
+        glGenFramebuffers(1, &historyFBO);
+        historyValid = false;
+    }
+
+    void destroyHistoryTargets()
+    {
+        if (!historyFBO) return;
+        glDeleteFramebuffers(1, &historyFBO);
+        glDeleteTextures(2, historyTextures);
+        historyFBO = 0;
+        historyTextures[0] = historyTextures[1] = 0;
+        historyValid = false;
+    }
+
+    void createBloomTargets()
+    {
+        if (!post.hdr || post.bloomDivisor <= 0 || !outputWidth) return;
+        int width = outputWidth / post.bloomDivisor, height = outputHeight / post.bloomDivisor;
+        for (bloomCount = 0; bloomCount < std::min(post.bloomLevels, MAX_BLOOM_LEVELS) && width >= 2 && height >= 2; bloomCount++)
+        {
+            bloomWidth[bloomCount] = width;
+            bloomHeight[bloomCount] = height;
+            bloomTextures[bloomCount] = createTargetTexture(GL_R11F_G11F_B10F, width, height);
+            width /= 2;
+            height /= 2;
+        }
+        glGenFramebuffers(1, &bloomFBO);
+    }
+
+    void destroyBloomTargets()
+    {
+        if (!bloomFBO) return;
+        glDeleteFramebuffers(1, &bloomFBO);
+        glDeleteTextures(bloomCount, bloomTextures);
+        bloomFBO = 0;
+        bloomCount = 0;
+    }
+
+    // the TAA resolve, bloom down and back up the chain, then the tonemap into the window
+    void postProcess()
+    {
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(postVAO);
+        glActiveTexture(GL_TEXTURE0);
+
+        // what bloom and the tonemap read: the scene, or its resolve at the window's size
+        unsigned int resolved = sceneColor;
+        int resolvedWidth = targetWidth, resolvedHeight = targetHeight;
+        if (historyFBO)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            taaTimer.begin(frameNumber);
+            // every screen view is jittered by the same fraction of a target pixel
+            glm::vec2 jitter(0.0f);
+            for (const ViewParams& view : frame.views)
+                if (view.target == ViewTarget::Screen) { jitter = view.jitter * 0.5f * glm::vec2(view.rect.z, view.rect.w); break; }
+            historyIndex ^= 1;
+            glBindFramebuffer(GL_FRAMEBUFFER, historyFBO);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, historyTextures[historyIndex], 0);
+            glViewport(0, 0, outputWidth, outputHeight);
+            taaShader.use();
+            taaShader.setVec2("jitter", jitter);
+            taaShader.setFloat("feedback", historyValid ? std::min(std::max(taa.feedback, 0.0f), 0.98f) : 0.0f);
+            glBindTexture(GL_TEXTURE_2D, sceneColor);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, historyTextures[historyIndex ^ 1]);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, sceneVelocity);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glActiveTexture(GL_TEXTURE0);
+            historyValid = true;
+            taaTimer.end(frameNumber);
+            addPass("taa", start, taaTimer);
+            resolved = historyTextures[historyIndex];
+            resolvedWidth = outputWidth;
+            resolvedHeight = outputHeight;
+        }
+
+        if (bloomCount)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            bloomDownTimer.begin(frameNumber);
+            glBindFramebuffer(GL_FRAMEBUFFER, bloomFBO);
+            bloomDownShader.use();
+            bloomDownShader.setInt("source", 0);
+            for (int i = 0; i < bloomCount; i++)
+            {
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bloomTextures[i], 0);
+                glViewport(0, 0, bloomWidth[i], bloomHeight[i]);
+                glBindTexture(GL_TEXTURE_2D, i == 0 ? resolved : bloomTextures[i - 1]);
+                bloomDownShader.setVec2("texelSize", i == 0 ? glm::vec2(1.0f / resolvedWidth, 1.0f / resolvedHeight)
+                                                            : glm::vec2(1.0f / bloomWidth[i - 1], 1.0f / bloomHeight[i - 1]));
+                bloomDownShader.setFloat("threshold", i == 0 ? post.bloomThreshold : -1.0f);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }
+            bloomDownTimer.end(frameNumber);
+            addPass("bloom-down", start, bloomDownTimer);
+
+            start = std::chrono::high_resolution_clock::now();
+            bloomUpTimer.begin(frameNumber);
+            bloomUpShader.use();
+            bloomUpShader.setInt("source", 0);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+            for (int i = bloomCount - 2; i >= 0; i--)
+            {
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bloomTextures[i], 0);
+                glViewport(0, 0, bloomWidth[i], bloomHeight[i]);
+                glBindTexture(GL_TEXTURE_2D, bloomTextures[i + 1]);
+                bloomUpShader.setVec2("texelSize", glm::vec2(1.0f / bloomWidth[i + 1], 1.0f / bloomHeight[i + 1]));
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }
+            glDisable(GL_BLEND);
+            bloomUpTimer.end(frameNumber);
+            addPass("bloom-up", start, bloomUpTimer);
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        tonemapTimer.begin(frameNumber);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, outputWidth, outputHeight);
+        tonemapShader.use();
+        tonemapShader.setFloat("exposure", post.exposure);
+        tonemapShader.setFloat("bloomStrength", bloomCount ? post.bloomStrength / bloomCount : 0.0f);
+        glBindTexture(GL_TEXTURE_2D, resolved);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, bloomCount ? bloomTextures[0] : 0);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glActiveTexture(GL_TEXTURE0);
+        tonemapTimer.end(frameNumber);
+        addPass("tonemap", start, tonemapTimer);
+
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    void createPlanarTarget()
+    {
+        if (planar.resolutionDivisor <= 0 || !targetWidth) return;
+        planarWidth = std::max(1, targetWidth / planar.resolutionDivisor);
+        planarHeight = std::max(1, targetHeight / planar.resolutionDivisor);
+        glGenTextures(1, &planarColor);
+        glBindTexture(GL_TEXTURE_2D, planarColor);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, planarWidth, planarHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glGenRenderbuffers(1, &planarDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, planarDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, planarWidth, planarHeight);
+        glGenFramebuffers(1, &planarFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, planarFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, planarColor, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, planarDepth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "Planar reflection framebuffer incomplete\n";
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void destroyPlanarTarget()
+    {
+        if (!planarFBO) return;
+        glDeleteFramebuffers(1, &planarFBO);
+        glDeleteRenderbuffers(1, &planarDepth);
+        glDeleteTextures(1, &planarColor);
+        planarFBO = planarDepth = planarColor = 0;
+        planarDrawn = false;
+    }
+
+    FrameParams frame;
+    RendererStats lastStats;
+
+    // GL_TIME_ELAPSED for one pass, read back LATENCY frames later so the CPU never
+    // waits on the GPU for it
+    struct GpuTimer
+    {
+        static const unsigned int LATENCY = 3;
+        unsigned int queries[LATENCY] = {};
+        bool pending[LATENCY] = {};
+        double lastMs = -1.0;
+
+        void begin(unsigned int frame)
+        {
+            if (!queries[0]) glGenQueries(LATENCY, queries);
+            unsigned int slot = frame % LATENCY;
+            if (pending[slot])
+            {
+                GLuint64 ns = 0;
+                glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &ns);
+                lastMs = ns * 1e-6;
+                pending[slot] = false;
+            }
+            glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+        }
+        void end(unsigned int frame)
+        {
+            glEndQuery(GL_TIME_ELAPSED);
+            pending[frame % LATENCY] = true;
+        }
+        void destroy()
+        {
+            if (queries[0]) glDeleteQueries(LATENCY, queries);
+        }
+    };
+
+    unsigned int frameNumber = 0;
+    GpuTimer probeTimer, planarTimer, aoDepthTimer, ssaoTimer, ssaoBlurTimer, sceneTimer, taaTimer, bloomDownTimer, bloomUpTimer, tonemapTimer;
+
+    // reflection probe: cubemap with mips, rendered a face at a time through probeFBO
+    ReflectionSettings reflections;
+    unsigned int probeTexture = 0, probeDepth = 0, probeFBO = 0;
+    int probeSize = 0;
+    bool probeValid = false;    // some face has been rendered; until then cars reflect the skybox
+
+    // planar reflection target, 1/resolutionDivisor of the scene target
+    PlanarReflectionSettings planar;
+    unsigned int planarFBO = 0, planarColor = 0, planarDepth = 0;
+    int planarWidth = 0, planarHeight = 0;
+    bool planarDrawn = false;   // this frame's screen views can sample it
+
+    // environment lighting (setEnvironmentLighting); only sh and specularMips are kept on the CPU
+    IBLData ibl;
+    unsigned int iblSpecular = 0, iblLut = 0;
+    unsigned int lightmapTexture = 0;           // setLightmap(), RGBA16F
+    std::vector<LightmapChart> lightmapCharts;
+
+    void addPass(const char* name, std::chrono::high_resolution_clock::time_point start, const GpuTimer& timer)
+    {
+        if (lastStats.passCount >= MAX_PASSES) return;
+        PassTiming& pass = lastStats.passes[lastStats.passCount++];
+        pass.name = name;
+        pass.cpuMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        pass.gpuMs = timer.lastMs;
+    }
+
+    void createProbe(int size)
+    {
+        probeSize = size;
+        probeValid = false;
+        glGenTextures(1, &probeTexture);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, probeTexture);
+        for (int face = 0; face < 6; face++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        for (GLenum wrap : { GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R })
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, wrap, GL_CLAMP_TO_EDGE);
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+        glGenRenderbuffers(1, &probeDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, probeDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, size, size);
+        glGenFramebuffers(1, &probeFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, probeFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, probeTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, probeDepth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "Reflection probe framebuffer incomplete\n";
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void destroyProbe()
+    {
+        glDeleteFramebuffers(1, &probeFBO);
+        glDeleteRenderbuffers(1, &probeDepth);
+        glDeleteTextures(1, &probeTexture);
+        probeFBO = probeDepth = probeTexture = 0;
+        probeSize = 0;
+        probeValid = false;
+    }
+
+    // draws the items visible in view v into the bound target and viewport
+    unsigned int drawView(const std::vector<DrawItem>& items, unsigned int v)
+    {
+        auto viewStart = std::chrono::high_resolution_clock::now();
+        unsigned int viewDraws = 0;
+        const ViewParams& view = frame.views[v];
+
+        // cars reflect the probe; probe faces themselves (which it is being rendered
+        // from) and frames before it has any content reflect the skybox
+        bool useProbe = probeValid && view.target != ViewTarget::ReflectionProbe;
+        bool mirrored = view.target == ViewTarget::PlanarReflection;
+        bool floorReflects = planarDrawn && view.target == ViewTarget::Screen;
+        bool occluded = aoDepthFBO && view.target == ViewTarget::Screen;
+        glActiveTexture(GL_TEXTURE0 + ENVIRONMENT_UNIT);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, useProbe ? probeTexture : cubemapTexture);
+        if (iblSpecular)
+        {
+            glActiveTexture(GL_TEXTURE0 + SPECULAR_UNIT);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, iblSpecular);
+            glActiveTexture(GL_TEXTURE0 + BRDF_LUT_UNIT);
+            glBindTexture(GL_TEXTURE_2D, iblLut);
+        }
+        if (floorReflects)
+        {
+            glActiveTexture(GL_TEXTURE0 + PLANAR_UNIT);
+            glBindTexture(GL_TEXTURE_2D, planarColor);
+        }
+        if (occluded)
+        {
+            glActiveTexture(GL_TEXTURE0 + OCCLUSION_UNIT);
+            glBindTexture(GL_TEXTURE_2D, occlusionTextures[0]);
+            glActiveTexture(GL_TEXTURE0 + OCCLUSION_DEPTH_UNIT);
+            glBindTexture(GL_TEXTURE_2D, aoDepth);
+        }
+        if (lightmapTexture)
+        {
+            glActiveTexture(GL_TEXTURE0 + LIGHTMAP_UNIT);
+            glBindTexture(GL_TEXTURE_2D, lightmapTexture);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glm::mat4 viewProjection, prevViewProjection;
+        motionMatrices(view, viewProjection, prevViewProjection);
+
+        // camera uniforms go to each program once per view, when it is first used
+        Shader* cameraSet[3] = {};
+        auto use = [&](Shader& shader) {
+            shader.use();
+            for (Shader*& slot : cameraSet)
+            {
+                if (slot == &shader) return;
+                if (slot) continue;
+                slot = &shader;
+                shader.setMat4("projection", view.projection);
+                shader.setMat4("view", view.view);
+                shader.setVec3("viewPos", view.viewPos);
+                shader.setVec3("lightPos", frame.lightPos);
+                shader.setMat4("viewProjection", viewProjection);
+                shader.setMat4("prevViewProjection", prevViewProjection);
+                shader.setBool("environmentLighting", iblSpecular != 0);
+                // the reflection is blurry anyway: coarser (cheaper) texture reads
+                shader.setFloat("lodBias", mirrored ? planar.lodBias : 0.0f);
+                shader.setBool("occlusionEnabled", occluded);
+                shader.setInt("occlusion", OCCLUSION_UNIT);
+                shader.setInt("occlusionDepth", OCCLUSION_DEPTH_UNIT);
+                if (&shader != &modelShader)
+                {
+                    shader.setInt("planarReflection", PLANAR_UNIT);
+                    shader.setFloat("planarStrength", floorReflects ? planar.strength : 0.0f);
+                    shader.setFloat("planarHeight", planar.planeHeight);
+                    shader.setVec2("targetSize", glm::vec2((float)targetWidth, (float)targetHeight));
+                    shader.setInt("lightmap", LIGHTMAP_UNIT);
+                }
+                if (iblSpecular)
+                    for (int i = 0; i < 9; i++) shader.setVec3("sh[" + std::to_string(i) + "]", ibl.sh[i]);
+                if (&shader == &modelShader)
+                {
+                    shader.setInt("environment", ENVIRONMENT_UNIT);
+                    shader.setFloat("reflectivity", cubemapTexture || useProbe ? reflections.reflectivity : 0.0f);
+                    shader.setFloat("environmentLod", reflections.blurLod);
+                    shader.setBool("environmentIsProbe", useProbe);
+                    shader.setInt("specularMap", SPECULAR_UNIT);
+                    shader.setInt("brdfLut", BRDF_LUT_UNIT);
+                    shader.setFloat("specularMaxLod", (float)(ibl.specularMips - 1));
+                    shader.setFloat("roughness", reflections.roughness);
+                }
+                return;
+            }
+        };
+        // the item's lightmap chart, or none: lit by lightPos
+        auto lightmapChart = [&](Shader& shader, const DrawItem& item) {
+            bool baked = lightmapTexture && item.lightmapChart >= 0 && item.lightmapChart < (int)lightmapCharts.size();
+            shader.setBool("lightmapped", baked);
+            if (!baked) return;
+            const LightmapChart& chart = lightmapCharts[item.lightmapChart];
+            shader.setVec4("lightmapU", chart.u);
+            shader.setVec4("lightmapV", chart.v);
+            shader.setVec4("lightmapRect", chart.rect);
+        };
+
+        for (const DrawItem& item : items)
+        {
+            if (!(item.viewMask & (1u << v))) continue;
+            const MeshEntry& m = meshes[item.mesh];
+            const glm::mat4& prevModel = item.prevModel[3][3] == 0.0f ? item.model : item.prevModel;
+            if (item.material == Material::Floor)
+            {
+                use(floorShader);
+                floorShader.setMat4("model", item.model);
+                floorShader.setMat4("prevModel", prevModel);
+                lightmapChart(floorShader, item);
+
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, item.texture);
+                floorShader.setInt("floorTexture", 0);
+            }
+            else if (item.material == Material::Terrain)
+            {
+                use(terrainShader);
+                terrainShader.setMat4("model", item.model);
+                terrainShader.setFloat("heightSpacing", heightSpacing[item.heightmap]);
+                lightmapChart(terrainShader, item);
+
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, item.texture);
+                terrainShader.setInt("floorTexture", 0);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, item.heightmap);
+                terrainShader.setInt("heightmap", 1);
+                glActiveTexture(GL_TEXTURE0);
+            }
+            else
+            {
+                use(modelShader);
+                modelShader.setMat4("model", item.model);
+                modelShader.setMat4("prevModel", prevModel);
+                modelShader.setBool("lightProbeEnabled", item.hasLightProbe);
+                if (item.hasLightProbe)
+                {
+                    modelShader.setVec4("lightProbe[0]", item.lightProbe.r);
+                    modelShader.setVec4("lightProbe[1]", item.lightProbe.g);
+                    modelShader.setVec4("lightProbe[2]", item.lightProbe.b);
+                }
+            }
+
+            if (m.model)
+            {
+                m.model->Draw(item.material == Material::Floor ? floorShader : modelShader);
+                viewDraws += (unsigned int)m.model->meshes.size();
+            }
+            else
+            {
+                glBindVertexArray(m.VAO);
+                glDrawElements(GL_TRIANGLES, m.indexCount, GL_UNSIGNED_INT, 0);
+                glBindVertexArray(0);
+                viewDraws++;
+            }
+        }
+
+        // skybox (last), at infinite depth: only where nothing was drawn
+        if (cubemapTexture)
+        {
+            glDepthFunc(GL_GEQUAL);
+            skyboxShader.use();
+            skyboxShader.setFloat("farDepth", zeroToOneDepth ? 0.0f : -1.0f);
+            // remove translation from the view matrix
+            glm::mat4 skyView = glm::mat4(glm::mat3(view.view));
+            skyboxShader.setMat4("view", skyView);
+            skyboxShader.setMat4("projection", view.projection);
+            skyboxShader.setMat4("viewProjection", viewProjection);
+            skyboxShader.setMat4("prevViewProjection", prevViewProjection);
+            glBindVertexArray(skyboxVAO);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            glBindVertexArray(0);
+            glDepthFunc(GL_GREATER);
+            viewDraws++;
+        }
+
+        lastStats.viewCpuMs[v] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - viewStart).count();
+        lastStats.viewDrawCalls[v] = viewDraws;
+        return viewDraws;
+    }
+};
+
+inline unsigned int loadTexture(const char *path)
+{
+    stbi_set_flip_vertically_on_load(true);
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    int width, height, nrComponents;
+    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
+    if (data)
+    {
+        GLenum format = (nrComponents == 1) ? GL_RED : (nrComponents == 3) ? GL_RGB : GL_RGBA;
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        // texture params
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        stbi_image_free(data);
+    }
+    else
+    {
+        std::cout << "Failed to load texture at path: " << path << std::endl;
+        stbi_image_free(data);
+        return 0;
+    }
+    return textureID;
+}
+
+inline unsigned int loadCubemap(std::vector<std::string> faces)
+{
+    stbi_set_flip_vertically_on_load(false); // cubemaps usually not flipped
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+    // decode the faces on the job system; each upload is queued back to this (GL) thread
+    JobCounter done;
+    for (unsigned int i = 0; i < faces.size(); i++)
+    {
+        jobSystem().run([&faces, &done, i]() {
+            int width, height, nrChannels;
+            unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
+            jobSystem().runOnMainThread([&faces, i, data, width, height, nrChannels]() {
+                if (data)
+                {
+                    GLenum format = (nrChannels == 3) ? GL_RGB : GL_RGBA;
+                    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+                }
+                else
+                {
+                    std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+                }
+                stbi_image_free(data);
+            }, &done);
+        }, &done);
+    }
+    jobSystem().wait(done);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    return textureID;
+}
+
+#endif
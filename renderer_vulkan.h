@@ -0,0 +1,2640 @@
+#ifndef RENDERER_VULKAN_H
+#define RENDERER_VULKAN_H
+
+// Vulkan 1.2 backend (build with -DUSE_VULKAN, link vulkan + assimp).
+//
+// - draw lists are split into chunks and recorded into secondary command buffers
+//   as jobs, one command pool per chunk per frame in flight
+// - all textures live in one descriptor-indexed array (set 0) and are selected by a
+//   push constant, so recording never allocates or updates descriptor sets
+// - layout transitions are explicit barriers; the scene renders into an offscreen
+//   colour target which is blitted to the swapchain (or left there when headless)
+// - pipelines are created through a VkPipelineCache persisted in vk_pipeline_cache.bin
+// - depth is reversed (D32_SFLOAT cleared to 0, GREATER tests) with no far plane,
+//   see reversedZPerspective()
+// - each view's camera uniforms are one aligned slice of the frame's uniform buffer,
+//   picked with a dynamic offset; every chunk records all views in turn (viewport,
+//   offset, then that view's items), so the work still splits by items across threads
+// - reflection probe faces (probe.h) render before the scene, inline in the primary
+//   command buffer, into 2D views of one cubemap layer; the updated faces' mips are
+//   rebuilt with blits. Cars pick the probe or the skybox per view (FrameUniforms)
+// - passes are timed with timestamp queries, read back when the frame slot comes round
+//   again (RendererStats::passes)
+// - environment lighting (ibl.h): the SH irradiance rides in FrameUniforms, the
+//   prefiltered cube and the BRDF table are set 0 bindings 3 and 4
+// - planar reflection views (planar_reflection.h) render inline after the probe, into
+//   a reduced-resolution target (set 0 binding 5) that the floor samples by screen
+//   position
+// - the scene, probe and planar targets are RGBA16F. With HDR on (post.h) the bloom
+//   chain and the tonemap run after the scene as colour-only render passes drawing one
+//   fullscreen triangle each, with their own pipeline layout (three samplers, a vec4 of
+//   push constants); the tonemap writes an RGBA8 target that takes the scene's place in
+//   the swapchain blit. With HDR off the blit converts the scene target as it is
+// - the scene render pass has a second colour attachment, RG16F motion vectors (taa.h),
+//   so every target drawn with it carries one; only the scene's is read. With HDR on
+//   the TAA resolve is the first post pass: it writes one of two history images at the
+//   swapchain's size, which bloom and the tonemap then read instead of the scene (their
+//   descriptor sets come in pairs, one per history image). With a render scale below 1
+//   the scene, its depth and motion vectors and the planar target are sceneExtent, that
+//   fraction of the swapchain's extent
+// - ambient occlusion (ssao.h) runs inline after the planar reflection: the screen
+//   views' depth at half the scene's size (a depth-only render pass and pipelines, the
+//   floor's and the terrain's vertex shaders), the occlusion from it per view (a post
+//   pass with the frame's uniforms as set 1), and the two blur axes as post passes. The
+//   result and its depth are set 0 bindings 6 and 7
+// - the lightmap (lightmap.h) is set 0 binding 8 and its chart table rides in
+//   FrameUniforms; a draw picks its chart with the push constant after heightSpacing
+// - light probes (light_probes.h): the push constants are full, so each frame slot has
+//   a host-visible storage buffer (set 1 binding 1) the cars' sampled harmonics are
+//   written to, one entry per draw item index, and a car passes its index in the
+//   lightmap chart's push constant
+//
+// Shaders are the *.vk.vs / *.vk.fs GLSL files, compiled to SPIR-V beforehand:
+//     glslangValidator -V floor.vk.vs -o floor.vk.vs.spv   (and so on)
+// Runs on lavapipe: VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json
+
+#include <vulkan/vulkan.h>
+#include <GLFW/glfw3.h>
+#include <stb_image.h>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "file_io.h"
+#include "jobs.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#define VK_CHECK(call)                                                              \
+    do {                                                                            \
+        VkResult vkResult_ = (call);                                                \
+        if (vkResult_ != VK_SUCCESS) {                                              \
+            std::cerr << "Vulkan error " << vkResult_ << " at " << #call << "\n";   \
+            std::abort();                                                           \
+        }                                                                           \
+    } while (0)
+
+class VulkanRenderer : public Renderer
+{
+public:
+    static const unsigned int FRAMES_IN_FLIGHT = 2;
+    static const unsigned int MAX_TEXTURES = 1024;
+    static const unsigned int MIN_ITEMS_PER_THREAD = 64; // below this a chunk is not worth a thread
+    static const unsigned int MAX_LIGHT_PROBE_ITEMS = 16384;    // draw items that can carry a light probe, per frame
+    // the scene render pass's colour format, for the scene, the probe and the planar reflection
+    static const VkFormat SCENE_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+    static const VkFormat VELOCITY_FORMAT = VK_FORMAT_R16G16_SFLOAT;  // its second colour attachment, motion vectors
+
+    // window == nullptr renders offscreen only (headless lavapipe runs)
+    VulkanRenderer(GLFWwindow* window, int width, int height, unsigned int threads = 0)
+        : window(window)
+    {
+        workerCount = std::min(64u, threads ? threads : std::min(8u, jobSystem().threadCount()));
+        extent = { (uint32_t)width, (uint32_t)height };
+
+        createInstance();
+        if (window) VK_CHECK(glfwCreateWindowSurface(instance, window, nullptr, &surface));
+        pickDevice();
+        createDevice();
+        createSamplers();
+        createDescriptors();
+        createFrames();
+        if (surface) createSwapchain();
+        updateSceneExtent();
+        createRenderTarget();
+        createPipelines();
+        createPostTargets();
+        createOcclusionTargets();
+        createSkyboxMesh();
+    }
+
+    ~VulkanRenderer()
+    {
+        vkDeviceWaitIdle(device);
+        savePipelineCache();
+
+        for (Pipeline* p : { &floorPipeline, &carPipeline, &terrainPipeline, &skyboxPipeline, &aoDepthPipeline, &aoTerrainDepthPipeline,
+                             &ssaoPipeline, &ssaoBlurPipeline, &taaPipeline, &bloomDownPipeline, &bloomUpPipeline, &tonemapPipeline })
+            vkDestroyPipeline(device, p->pipeline, nullptr);
+        vkDestroyPipelineCache(device, pipelineCache, nullptr);
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        vkDestroyPipelineLayout(device, postPipelineLayout, nullptr);
+        vkDestroyPipelineLayout(device, ssaoPipelineLayout, nullptr);
+        if (probeSize) destroyProbe();
+        destroyPlanarTarget();
+        destroyPostTargets();
+        destroyOcclusionTargets();
+        for (VkRenderPass pass : { aoDepthPass, ssaoPass, taaPass, bloomDownPass, bloomUpPass, tonemapPass }) vkDestroyRenderPass(device, pass, nullptr);
+        destroyEnvironmentLighting();
+        destroyLightmap();
+        destroyRenderTarget();
+        destroySwapchain();
+
+        for (FrameData& f : frames)
+        {
+            vkDestroyCommandPool(device, f.pool, nullptr);
+            for (VkCommandPool pool : f.workerPools) vkDestroyCommandPool(device, pool, nullptr);
+            vkDestroyFence(device, f.fence, nullptr);
+            vkDestroySemaphore(device, f.imageAvailable, nullptr);
+            vkDestroySemaphore(device, f.renderDone, nullptr);
+            vkDestroyQueryPool(device, f.queries, nullptr);
+            vkUnmapMemory(device, f.uboMemory);
+            vkDestroyBuffer(device, f.ubo, nullptr);
+            vkFreeMemory(device, f.uboMemory, nullptr);
+            vkUnmapMemory(device, f.lightProbeMemory);
+            vkDestroyBuffer(device, f.lightProbes, nullptr);
+            vkFreeMemory(device, f.lightProbeMemory, nullptr);
+            for (const Buffer& b : f.retired) { vkDestroyBuffer(device, b.buffer, nullptr); vkFreeMemory(device, b.memory, nullptr); }
+        }
+        for (const Buffer& b : buffers) { vkDestroyBuffer(device, b.buffer, nullptr); vkFreeMemory(device, b.memory, nullptr); }
+        for (const Image& i : images) { vkDestroyImageView(device, i.view, nullptr); vkDestroyImage(device, i.image, nullptr); vkFreeMemory(device, i.memory, nullptr); }
+
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroyDescriptorPool(device, postPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, postSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, textureSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, frameSetLayout, nullptr);
+        vkDestroySampler(device, repeatSampler, nullptr);
+        vkDestroySampler(device, clampSampler, nullptr);
+        vkDestroyCommandPool(device, uploadPool, nullptr);
+        vkDestroyDevice(device, nullptr);
+        if (surface) vkDestroySurfaceKHR(instance, surface, nullptr);
+        vkDestroyInstance(instance, nullptr);
+    }
+
+    const char* name() const override { return "Vulkan"; }
+
+    unsigned int createMesh(const float* vertices, size_t vertexCount,
+                            const unsigned int* indices, size_t indexCount) override
+    {
+        MeshEntry entry;
+        entry.parts.push_back(uploadPart(vertices, vertexCount, indices, indexCount, 0));
+        for (size_t v = 0; v < vertexCount; v++)
+            entry.extend(glm::vec3(vertices[v * 8], vertices[v * 8 + 1], vertices[v * 8 + 2]));
+        if (!freeMeshes.empty())
+        {
+            unsigned int handle = freeMeshes.back();
+            freeMeshes.pop_back();
+            meshes[handle] = entry;
+            return handle;
+        }
+        meshes.push_back(entry);
+        return (unsigned int)meshes.size() - 1;
+    }
+
+    // frames in flight may still read the buffers, so they are freed once this frame
+    // slot's fence has been waited on again
+    void destroyMesh(unsigned int mesh) override
+    {
+        for (const MeshPart& part : meshes[mesh].parts)
+            for (VkBuffer b : { part.vertices, part.indices })
+            {
+                auto it = std::find_if(buffers.begin(), buffers.end(), [b](const Buffer& x) { return x.buffer == b; });
+                if (it == buffers.end()) continue;
+                frames[frameIndex].retired.push_back(*it);
+                *it = buffers.back();
+                buffers.pop_back();
+            }
+        meshes[mesh].parts.clear();
+        freeMeshes.push_back(mesh);
+    }
+
+    // mirrors learnopengl's Model: same import flags, diffuse texture per mesh
+    unsigned int loadModel(const std::string& path) override
+    {
+        MeshEntry entry;
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs);
+        if (!scene || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) || !scene->mRootNode)
+        {
+            std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+            meshes.push_back(entry);
+            return (unsigned int)meshes.size() - 1;
+        }
+        std::string directory = path.substr(0, path.find_last_of('/'));
+
+        std::map<std::string, unsigned int> loaded;
+        for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+        {
+            const aiMesh* mesh = scene->mMeshes[m];
+            std::vector<float> vertices;
+            vertices.reserve(mesh->mNumVertices * 8);
+            for (unsigned int v = 0; v < mesh->mNumVertices; v++)
+            {
+                entry.extend(glm::vec3(mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z));
+                vertices.push_back(mesh->mVertices[v].x);
+                vertices.push_back(mesh->mVertices[v].y);
+                vertices.push_back(mesh->mVertices[v].z);
+                vertices.push_back(mesh->HasNormals() ? mesh->mNormals[v].x : 0.0f);
+                vertices.push_back(mesh->HasNormals() ? mesh->mNormals[v].y : 1.0f);
+                vertices.push_back(mesh->HasNormals() ? mesh->mNormals[v].z : 0.0f);
+                vertices.push_back(mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][v].x : 0.0f);
+                vertices.push_back(mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][v].y : 0.0f);
+            }
+            std::vector<unsigned int> indices;
+            for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+                for (unsigned int i = 0; i < mesh->mFaces[f].mNumIndices; i++)
+                    indices.push_back(mesh->mFaces[f].mIndices[i]);
+
+            unsigned int texture = whiteTexture();
+            aiString texPath;
+            if (scene->mMaterials[mesh->mMaterialIndex]->GetTexture(aiTextureType_DIFFUSE, 0, &texPath) == AI_SUCCESS)
+            {
+                std::string file = directory + '/' + texPath.C_Str();
+                auto it = loaded.find(file);
+                if (it != loaded.end()) texture = it->second;
+                else texture = loaded[file] = loadTextureFile(file, false);
+            }
+            if (!indices.empty())
+                entry.parts.push_back(uploadPart(vertices.data(), mesh->mNumVertices, indices.data(), indices.size(), texture));
+        }
+        meshes.push_back(entry);
+        return (unsigned int)meshes.size() - 1;
+    }
+
+    bool meshBounds(unsigned int mesh, glm::vec3& min, glm::vec3& max) const override
+    {
+        const MeshEntry& m = meshes[mesh];
+        if (m.boundsMin.x > m.boundsMax.x) return false;
+        min = m.boundsMin;
+        max = m.boundsMax;
+        return true;
+    }
+
+    unsigned int loadTexture(const std::string& path) override
+    {
+        return loadTextureFile(path, true);
+    }
+
+    unsigned int createHeightmap(const float* heights, int size, float spacing) override
+    {
+        Image img = createImage((uint32_t)size, (uint32_t)size, 1, 1, VK_FORMAT_R32_SFLOAT,
+                                VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+        uploadImage(img, heights, (size_t)size * size * sizeof(float), (uint32_t)size, (uint32_t)size, 1, 1);
+        unsigned int index = registerTexture(img);
+        heightSpacing[index] = spacing;
+        return index;
+    }
+
+    void setSkybox(const std::vector<std::string>& faces) override
+    {
+        stbi_set_flip_vertically_on_load(false); // cubemaps usually not flipped
+        std::vector<unsigned char> pixels;
+        int faceSize = 0;
+        for (unsigned int i = 0; i < faces.size() && i < 6; i++)
+        {
+            int w, h, n;
+            unsigned char* data = stbi_load(faces[i].c_str(), &w, &h, &n, 4);
+            if (!data)
+            {
+                std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+                return;
+            }
+            if (i == 0) { faceSize = w; pixels.resize((size_t)w * w * 4 * 6); }
+            if (w == faceSize && h == faceSize)
+                memcpy(&pixels[(size_t)i * w * w * 4], data, (size_t)w * w * 4);
+            stbi_image_free(data);
+        }
+        Image cube = createImage((uint32_t)faceSize, (uint32_t)faceSize, 1, 6, VK_FORMAT_R8G8B8A8_UNORM,
+                                 VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+        uploadImage(cube, pixels.data(), pixels.size(), (uint32_t)faceSize, (uint32_t)faceSize, 1, 6);
+        images.push_back(cube);
+
+        VkDescriptorImageInfo info = { clampSampler, cube.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        VkWriteDescriptorSet write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        write.dstSet = textureSet;
+        write.dstBinding = 1;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &info;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+        hasSkybox = true;
+    }
+
+    void setEnvironmentLighting(const IBLData& data) override
+    {
+        vkDeviceWaitIdle(device);
+        destroyEnvironmentLighting();
+        if (!data.valid()) return;
+        for (int i = 0; i < 9; i++) iblSH[i] = data.sh[i];
+
+        // the mips are the roughness levels, uploaded as computed rather than blitted
+        iblSpecular = createImage((uint32_t)data.specularSize, (uint32_t)data.specularSize, (uint32_t)data.specularMips, 6,
+                                  VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                  VK_IMAGE_ASPECT_COLOR_BIT);
+        uploadMipLevels(iblSpecular, data.specular.data(), (uint32_t)data.specularSize, (uint32_t)data.specularMips, 6, 8);
+        iblLut = createImage((uint32_t)data.lutSize, (uint32_t)data.lutSize, 1, 1, VK_FORMAT_R16G16_SFLOAT,
+                             VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+        uploadImage(iblLut, data.brdfLut.data(), data.brdfLut.size() * sizeof(uint16_t), (uint32_t)data.lutSize, (uint32_t)data.lutSize, 1, 1);
+        iblMips = (uint32_t)data.specularMips;
+
+        VkDescriptorImageInfo infos[2] = {
+            { clampSampler, iblSpecular.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+            { clampSampler, iblLut.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL }
+        };
+        VkWriteDescriptorSet writes[2] = {};
+        for (int i = 0; i < 2; i++)
+        {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = textureSet;
+            writes[i].dstBinding = 3 + i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[i].pImageInfo = &infos[i];
+        }
+        vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+    }
+
+    void setLightmap(const LightmapData& data) override
+    {
+        vkDeviceWaitIdle(device);
+        destroyLightmap();
+        if (!data.valid()) return;
+        lightmapImage = createImage((uint32_t)data.width, (uint32_t)data.height, 1, 1, VK_FORMAT_R16G16B16A16_SFLOAT,
+                                    VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+        uploadImage(lightmapImage, data.texels.data(), data.texels.size() * sizeof(uint16_t), (uint32_t)data.width, (uint32_t)data.height, 1, 1);
+        lightmapChartCount = (unsigned int)std::min<size_t>(data.charts.size(), MAX_LIGHTMAP_CHARTS);
+        for (unsigned int c = 0; c < lightmapChartCount; c++)
+        {
+            lightmapTable[c * 3] = data.charts[c].u;
+            lightmapTable[c * 3 + 1] = data.charts[c].v;
+            lightmapTable[c * 3 + 2] = data.charts[c].rect;
+        }
+
+        VkDescriptorImageInfo info = { clampSampler, lightmapImage.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        VkWriteDescriptorSet write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        write.dstSet = textureSet;
+        write.dstBinding = 8;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &info;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    }
+
+    void setReflections(const ReflectionSettings& settings) override
+    {
+        reflections = settings;
+        if (probeSize == settings.probeSize) return;
+        vkDeviceWaitIdle(device);
+        if (probeSize) destroyProbe();
+        if (settings.probeSize > 0) createProbe((uint32_t)settings.probeSize);
+    }
+
+    void setPostProcess(const PostProcessSettings& settings) override
+    {
+        vkDeviceWaitIdle(device);
+        bool rescale = settings.hdr != post.hdr;    // TAA and its render scale follow HDR
+        destroyPostTargets();
+        post = settings;
+        if (rescale) recreateTargets();
+        else createPostTargets();
+    }
+
+    void setTemporalAA(const TemporalAASettings& settings) override
+    {
+        taa = settings;
+        recreateTargets();
+    }
+
+    void setAmbientOcclusion(const AmbientOcclusionSettings& settings) override
+    {
+        // the presets share the targets; only turning it on or off changes them
+        bool resize = (settings.quality == AOQuality::Off) != (ao.quality == AOQuality::Off);
+        if (resize) { vkDeviceWaitIdle(device); destroyOcclusionTargets(); }
+        ao = settings;
+        if (resize) createOcclusionTargets();
+    }
+
+    void setPlanarReflections(const PlanarReflectionSettings& settings) override
+    {
+        vkDeviceWaitIdle(device);
+        destroyPlanarTarget();
+        planar = settings;
+        createPlanarTarget();
+    }
+
+    void resize(int width, int height) override
+    {
+        if (width <= 0 || height <= 0) return;
+        extent = { (uint32_t)width, (uint32_t)height };
+        needsResize = true;
+    }
+
+    void beginFrame(const FrameParams& f) override
+    {
+        if (needsResize) recreateTargets();
+
+        frameIndex = (frameIndex + 1) % FRAMES_IN_FLIGHT;
+        FrameData& fd = frames[frameIndex];
+        VK_CHECK(vkWaitForFences(device, 1, &fd.fence, VK_TRUE, UINT64_MAX));
+        for (const Buffer& b : fd.retired) { vkDestroyBuffer(device, b.buffer, nullptr); vkFreeMemory(device, b.memory, nullptr); }
+        fd.retired.clear();
+        readTimestamps(fd);
+
+        if (swapchain)
+        {
+            VkResult r = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, fd.imageAvailable, VK_NULL_HANDLE, &swapIndex);
+            if (r == VK_ERROR_OUT_OF_DATE_KHR)
+            {
+                recreateTargets();
+                VK_CHECK(vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, fd.imageAvailable, VK_NULL_HANDLE, &swapIndex));
+            }
+            else if (r != VK_SUBOPTIMAL_KHR) VK_CHECK(r);
+        }
+        VK_CHECK(vkResetFences(device, 1, &fd.fence));
+
+        // GL clip space -> Vulkan: flip Y; depth is already reversed [0, 1]
+        glm::mat4 clip(1.0f);
+        clip[1][1] = -1.0f;
+
+        viewCount = (unsigned int)std::min<size_t>(f.views.size(), MAX_VIEWS);
+        bool probeReady = probeSize && (probeValid || std::any_of(f.views.begin(), f.views.end(),
+                                                                  [](const ViewParams& v) { return v.target == ViewTarget::ReflectionProbe; }));
+        planarReady = planarFramebuffer && std::any_of(f.views.begin(), f.views.end(),
+                                                       [](const ViewParams& v) { return v.target == ViewTarget::PlanarReflection; });
+        for (unsigned int v = 0; v < viewCount; v++)
+        {
+            const ViewParams& view = f.views[v];
+            bool probeFace = view.target == ViewTarget::ReflectionProbe;
+            FrameUniforms u;
+            u.view = view.view;
+            // probe faces keep GL's orientation, which is what cube sampling expects
+            u.projection = probeFace ? view.projection : clip * view.projection;
+            u.skyView = glm::mat4(glm::mat3(view.view));
+            if (probeFace)
+                u.viewProjection = u.prevViewProjection = u.projection * u.view;
+            else
+            {
+                motionMatrices(view, u.viewProjection, u.prevViewProjection);
+                u.viewProjection = clip * u.viewProjection;
+                u.prevViewProjection = clip * u.prevViewProjection;
+            }
+            u.viewPos = glm::vec4(view.viewPos, 1.0f);
+            u.lightPos = glm::vec4(f.lightPos, 1.0f);
+            // faces being rendered reflect the skybox, never the probe itself
+            u.environment = glm::vec4(hasSkybox || probeReady ? reflections.reflectivity : 0.0f, reflections.blurLod,
+                                      probeReady && !probeFace ? 1.0f : 0.0f, 0.0f);
+            u.ibl = glm::vec4(iblMips ? 1.0f : 0.0f, (float)iblMips - 1.0f, reflections.roughness, 0.0f);
+            for (int i = 0; i < 9; i++) u.sh[i] = glm::vec4(iblSH[i], 0.0f);
+            u.planar = glm::vec4(planarReady && view.target == ViewTarget::Screen ? planar.strength : 0.0f,
+                                 view.target == ViewTarget::PlanarReflection ? planar.lodBias : 0.0f, planar.planeHeight, 0.0f);
+            u.target = glm::vec4(1.0f / sceneExtent.width, 1.0f / sceneExtent.height, 0.0f, 0.0f);
+            u.occlusion = glm::vec4(aoReady && view.target == ViewTarget::Screen ? 1.0f : 0.0f, ao.radius, ao.intensity,
+                                    (float)aoSampleCount(ao.quality));
+            u.lightmap = glm::vec4((float)lightmapChartCount, 0.0f, 0.0f, 0.0f);
+            memcpy(u.lightmapCharts, lightmapTable, sizeof(lightmapTable));
+            memcpy((char*)fd.uboMapped + v * uboStride, &u, sizeof(u));
+            viewRects[v] = view.rect;
+            viewTargets[v] = view.target;
+            viewFaces[v] = view.face;
+        }
+        clearColor = f.clearColor;
+        // every screen view is jittered by the same fraction of a target pixel; y down here
+        taaJitter = glm::vec2(0.0f);
+        for (const ViewParams& view : f.views)
+            if (view.target == ViewTarget::Screen) { taaJitter = view.jitter * 0.5f * glm::vec2(view.rect.z, -view.rect.w); break; }
+    }
+
+    void submit(const std::vector<DrawItem>& items) override
+    {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        FrameData& fd = frames[frameIndex];
+
+        VK_CHECK(vkResetCommandPool(device, fd.pool, 0));
+        for (VkCommandPool pool : fd.workerPools) VK_CHECK(vkResetCommandPool(device, pool, 0));
+
+        // the cars' light probes, at their item's index; this slot's fence has passed
+        LightProbeSH* lightProbes = (LightProbeSH*)fd.lightProbeMapped;
+        for (size_t i = 0; i < std::min<size_t>(items.size(), MAX_LIGHT_PROBE_ITEMS); i++)
+            if (items[i].hasLightProbe) lightProbes[i] = items[i].lightProbe;
+
+        // split the draw list over the job system; chunk c records into its own pool and
+        // secondary buffer, chunk 0 (with the skybox) on this thread
+        unsigned int chunks = (unsigned int)std::min<size_t>(workerCount, std::max<size_t>(1, items.size() / MIN_ITEMS_PER_THREAD));
+        unsigned int chunkDraws[64][MAX_VIEWS] = {};   // workerCount is capped at 64
+        double chunkMs[64][MAX_VIEWS] = {};
+        jobSystem().parallelChunks(items.size(), chunks, [&](size_t begin, size_t end, size_t c) {
+            recordChunk(fd.workerCmds[c], items, begin, end, c == 0 && hasSkybox, chunkDraws[c], chunkMs[c]);
+        });
+        unsigned int draws = 0;
+        lastStats.viewCount = viewCount;
+        for (unsigned int v = 0; v < viewCount; v++)
+        {
+            lastStats.viewDrawCalls[v] = 0;
+            lastStats.viewCpuMs[v] = 0.0;
+            for (unsigned int c = 0; c < chunks; c++)
+            {
+                lastStats.viewDrawCalls[v] += chunkDraws[c][v];
+                lastStats.viewCpuMs[v] += chunkMs[c][v];
+            }
+            draws += lastStats.viewDrawCalls[v];
+        }
+
+        std::vector<VkCommandBuffer> secondaries(fd.workerCmds.begin(), fd.workerCmds.begin() + chunks);
+
+        VkCommandBuffer cmd = fd.primary;
+        VkCommandBufferBeginInfo begin = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK(vkBeginCommandBuffer(cmd, &begin));
+        vkCmdResetQueryPool(cmd, fd.queries, 0, 2 * PASS_COUNT);
+        lastStats.passCount = 0;
+
+        // reflection probe faces, before the scene that reflects them
+        auto probeStart = std::chrono::high_resolution_clock::now();
+        bool probeDrawn = false;
+        for (unsigned int v = 0; v < viewCount; v++)
+        {
+            if (viewTargets[v] != ViewTarget::ReflectionProbe || !probeSize) continue;
+            if (!probeDrawn)
+            {
+                vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, fd.queries, 2 * PASS_PROBE);
+                // last frame's cars may still be sampling the faces about to be cleared
+                vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                     0, 0, nullptr, 0, nullptr, 0, nullptr);
+            }
+            probeDrawn = true;
+            draws += recordProbeFace(cmd, items, v);
+        }
+        if (probeDrawn)
+        {
+            for (unsigned int v = 0; v < viewCount; v++)
+                if (viewTargets[v] == ViewTarget::ReflectionProbe) recordProbeMips(cmd, (uint32_t)viewFaces[v]);
+            vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, fd.queries, 2 * PASS_PROBE + 1);
+            fd.passWritten[PASS_PROBE] = true;
+            probeValid = true;
+            addPass("probe", std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - probeStart).count(), PASS_PROBE);
+        }
+
+        // mirrored views, each in its view's rect of the planar reflection target
+        if (planarReady)
+        {
+            auto planarStart = std::chrono::high_resolution_clock::now();
+            vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, fd.queries, 2 * PASS_REFLECTION);
+            draws += recordPlanarReflection(cmd, items);
+            vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, fd.queries, 2 * PASS_REFLECTION + 1);
+            fd.passWritten[PASS_REFLECTION] = true;
+            addPass("reflection", std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - planarStart).count(),
+                    PASS_REFLECTION);
+        }
+        if (aoReady) draws += recordAmbientOcclusion(cmd, items);
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, fd.queries, 2 * PASS_SCENE);
+
+        VkClearValue clears[3];
+        clears[0].color = { { clearColor.r, clearColor.g, clearColor.b, 1.0f } };
+        clears[1].depthStencil = { 0.0f, 0 };   // reversed-Z: 0 is infinitely far
+        clears[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };  // no motion where nothing is drawn
+        VkRenderPassBeginInfo rp = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+        rp.renderPass = renderPass;
+        rp.framebuffer = framebuffer;
+        rp.renderArea.extent = sceneExtent;
+        rp.clearValueCount = 3;
+        rp.pClearValues = clears;
+        vkCmdBeginRenderPass(cmd, &rp, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        vkCmdExecuteCommands(cmd, (uint32_t)secondaries.size(), secondaries.data());
+        vkCmdEndRenderPass(cmd);
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, fd.queries, 2 * PASS_SCENE + 1);
+        fd.passWritten[PASS_SCENE] = true;
+        // the render pass leaves the colour target in TRANSFER_SRC_OPTIMAL
+
+        double postMs[4] = { -1.0, -1.0, -1.0, -1.0 };   // taa, bloom down, bloom up, tonemap; < 0: not recorded
+        if (postReady) recordPost(cmd, postMs);
+
+        if (swapchain)
+        {
+            VkImage target = swapImages[swapIndex];
+            imageBarrier(cmd, target, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+            VkImageBlit blit = {};
+            blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+            blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+            VkExtent2D source = postReady ? extent : sceneExtent;
+            blit.srcOffsets[1] = { (int32_t)source.width, (int32_t)source.height, 1 };
+            blit.dstOffsets[1] = { (int32_t)extent.width, (int32_t)extent.height, 1 };
+            vkCmdBlitImage(cmd, postReady ? ldrTarget.image : colorTarget.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_NEAREST);
+            imageBarrier(cmd, target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                         VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+        }
+        VK_CHECK(vkEndCommandBuffer(cmd));
+
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkSubmitInfo si = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        si.commandBufferCount = 1;
+        si.pCommandBuffers = &cmd;
+        if (swapchain)
+        {
+            si.waitSemaphoreCount = 1;
+            si.pWaitSemaphores = &fd.imageAvailable;
+            si.pWaitDstStageMask = &waitStage;
+            si.signalSemaphoreCount = 1;
+            si.pSignalSemaphores = &fd.renderDone;
+        }
+        VK_CHECK(vkQueueSubmit(queue, 1, &si, fd.fence));
+
+        lastStats.submitCpuMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+        lastStats.drawCalls = draws;
+        // the scene pass is the recording of the screen views (in parallel) and the rest of this primary
+        double otherMs = 0.0;
+        for (unsigned int p = 0; p < lastStats.passCount; p++) otherMs += lastStats.passes[p].cpuMs;
+        for (double ms : postMs) otherMs += std::max(0.0, ms);
+        addPass("scene", lastStats.submitCpuMs - otherMs, PASS_SCENE);
+        if (postMs[0] >= 0.0) addPass("taa", postMs[0], PASS_TAA);
+        if (postMs[1] >= 0.0) addPass("bloom-down", postMs[1], PASS_BLOOM_DOWN);
+        if (postMs[2] >= 0.0) addPass("bloom-up", postMs[2], PASS_BLOOM_UP);
+        if (postMs[3] >= 0.0) addPass("tonemap", postMs[3], PASS_TONEMAP);
+    }
+
+    void endFrame() override
+    {
+        if (!swapchain) return;
+        FrameData& fd = frames[frameIndex];
+        VkPresentInfoKHR pi = { VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
+        pi.waitSemaphoreCount = 1;
+        pi.pWaitSemaphores = &fd.renderDone;
+        pi.swapchainCount = 1;
+        pi.pSwapchains = &swapchain;
+        pi.pImageIndices = &swapIndex;
+        VkResult r = vkQueuePresentKHR(queue, &pi);
+        if (r == VK_ERROR_OUT_OF_DATE_KHR || r == VK_SUBOPTIMAL_KHR) needsResize = true;
+        else VK_CHECK(r);
+    }
+
+    RendererStats stats() const override { return lastStats; }
+
+private:
+    struct Buffer { VkBuffer buffer; VkDeviceMemory memory; };
+    struct Image { VkImage image; VkDeviceMemory memory; VkImageView view; };
+    struct MeshPart { VkBuffer vertices; VkBuffer indices; uint32_t indexCount; uint32_t texture; };
+    struct MeshEntry
+    {
+        std::vector<MeshPart> parts;
+        glm::vec3 boundsMin = glm::vec3(1e30f), boundsMax = glm::vec3(-1e30f);
+
+        void extend(const glm::vec3& p) { boundsMin = glm::min(boundsMin, p); boundsMax = glm::max(boundsMax, p); }
+    };
+    struct Pipeline { VkPipeline pipeline = VK_NULL_HANDLE; };
+
+    struct FrameUniforms
+    {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::mat4 skyView;
+        glm::mat4 viewProjection;       // unjittered, for motion vectors (motionMatrices())
+        glm::mat4 prevViewProjection;   // last frame's
+        glm::vec4 viewPos;
+        glm::vec4 lightPos;
+        glm::vec4 environment;  // reflectivity, mip level, 1 = probe / 0 = skybox
+        glm::vec4 ibl;          // 1 = environment lighting, last prefiltered mip, roughness
+        glm::vec4 sh[9];        // irradiance / pi (IBLData::sh)
+        glm::vec4 planar;       // floor reflection strength (0: none), texture lod bias, mirror height
+        glm::vec4 target;       // 1 / scene target size
+        glm::vec4 occlusion;    // 1 = sample the ambient occlusion, radius, intensity, samples
+        glm::vec4 lightmap;     // charts in lightmapCharts (0: no lightmap)
+        glm::vec4 lightmapCharts[3 * MAX_LIGHTMAP_CHARTS];  // LightmapChart u, v, rect
+    };
+
+    // timed passes: a pair of timestamps each in the frame's query pool
+    enum Pass { PASS_PROBE, PASS_REFLECTION, PASS_AO_DEPTH, PASS_SSAO, PASS_SSAO_BLUR, PASS_SCENE, PASS_TAA, PASS_BLOOM_DOWN, PASS_BLOOM_UP,
+                PASS_TONEMAP, PASS_COUNT };
+
+    struct PushConstants
+    {
+        glm::mat4 model;
+        uint32_t texture;
+        uint32_t heightmap;     // Material::Terrain only
+        float heightSpacing;
+        int32_t baked;          // floor and terrain: DrawItem::lightmapChart; cars: their light probe slot, or -1
+        glm::vec4 prevModel[3];  // last frame's model, its top three rows (a mat3x4 at offset 80); 128 bytes in all
+    };
+
+    // post passes: x, y the source's texel size, z bloom threshold (< 0: none) or bloom
+    // strength, w exposure; the TAA resolve: x, y the jitter in texture coordinates, z the
+    // history weight; SSAO: the view's rect in pixels; its blur: x, y the axis, z the radius
+    struct PostPush
+    {
+        glm::vec4 params;
+    };
+
+    struct FrameData
+    {
+        VkCommandPool pool;
+        VkCommandBuffer primary;
+        std::vector<VkCommandPool> workerPools;     // one per recording thread
+        std::vector<VkCommandBuffer> workerCmds;    // secondary, one per recording thread
+        VkFence fence;
+        VkSemaphore imageAvailable, renderDone;
+        VkBuffer ubo;                               // MAX_VIEWS slices of uboStride bytes
+        VkDeviceMemory uboMemory;
+        void* uboMapped;
+        VkBuffer lightProbes;                       // MAX_LIGHT_PROBE_ITEMS LightProbeSH, by draw item index
+        VkDeviceMemory lightProbeMemory;
+        void* lightProbeMapped;
+        VkDescriptorSet frameSet;
+        std::vector<Buffer> retired;                // destroyed mesh buffers, freed after this slot's fence
+        VkQueryPool queries;
+        bool passWritten[PASS_COUNT];
+    };
+
+    GLFWwindow* window;
+    unsigned int workerCount;
+
+    VkInstance instance = VK_NULL_HANDLE;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    VkPhysicalDevice gpu = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    uint32_t queueFamily = 0;
+
+    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+    std::vector<VkImage> swapImages;
+    uint32_t swapIndex = 0;
+    VkExtent2D extent;
+    VkExtent2D sceneExtent;     // extent times the TAA render scale
+    bool needsResize = false;
+
+    Image colorTarget = {}, depthTarget = {}, velocityTarget = {};
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+    VkSampler repeatSampler = VK_NULL_HANDLE, clampSampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout textureSetLayout = VK_NULL_HANDLE, frameSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet textureSet = VK_NULL_HANDLE;
+    uint32_t textureCount = 0;
+    int whiteTextureIndex = -1;
+    std::map<unsigned int, float> heightSpacing;    // createHeightmap() textures
+
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    Pipeline floorPipeline, carPipeline, terrainPipeline, skyboxPipeline;
+
+    VkCommandPool uploadPool = VK_NULL_HANDLE;
+    FrameData frames[FRAMES_IN_FLIGHT];
+    unsigned int frameIndex = 0;
+    VkDeviceSize uboStride = 0;                     // FrameUniforms rounded up to the offset alignment
+    glm::vec4 viewRects[MAX_VIEWS];
+    ViewTarget viewTargets[MAX_VIEWS];
+    int viewFaces[MAX_VIEWS];
+    unsigned int viewCount = 0;
+    float timestampPeriod = 1.0f;                   // ns per tick
+    double gpuPassMs[PASS_COUNT] = { -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0 };
+
+    // reflection probe: cube with mips, one framebuffer per face (sharing one depth image)
+    ReflectionSettings reflections;
+    uint32_t probeSize = 0, probeMips = 1;
+    Image probeImage = {}, probeDepth = {}, probeVelocity = {};
+    VkImageView probeFaceViews[6] = {};
+    VkFramebuffer probeFramebuffers[6] = {};
+    bool probeValid = false;
+
+    // planar reflection target (setPlanarReflections), 1/resolutionDivisor of the scene's
+    PlanarReflectionSettings planar;
+    Image planarColor = {}, planarDepth = {}, planarVelocity = {};
+    VkFramebuffer planarFramebuffer = VK_NULL_HANDLE;
+    VkExtent2D planarExtent = {};
+    bool planarReady = false;   // this frame renders it, so its screen views may sample it
+
+    // post-processing (setPostProcess): bloom levels from 1/bloomDivisor of the target down,
+    // then the tonemap into ldrTarget. The render passes only differ in load op and layouts,
+    // so each level's framebuffer serves both bloom passes
+    PostProcessSettings post;
+    VkRenderPass bloomDownPass = VK_NULL_HANDLE, bloomUpPass = VK_NULL_HANDLE, tonemapPass = VK_NULL_HANDLE;
+    VkDescriptorSetLayout postSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout postPipelineLayout = VK_NULL_HANDLE;
+    VkDescriptorPool postPool = VK_NULL_HANDLE;
+    VkDescriptorSet bloomDownSets[MAX_BLOOM_LEVELS] = {}, bloomUpSets[MAX_BLOOM_LEVELS] = {};
+    VkDescriptorSet bloomFirstSets[2] = {}, tonemapSets[2] = {};   // read the scene, or history image 0 / 1
+    Pipeline bloomDownPipeline, bloomUpPipeline, tonemapPipeline;
+    Image bloomImages[MAX_BLOOM_LEVELS] = {};
+    VkFramebuffer bloomFramebuffers[MAX_BLOOM_LEVELS] = {};
+    VkExtent2D bloomExtents[MAX_BLOOM_LEVELS] = {};
+    uint32_t bloomCount = 0;
+    Image ldrTarget = {};
+    VkFramebuffer ldrFramebuffer = VK_NULL_HANDLE;
+    bool postReady = false;     // the post targets exist (post.hdr)
+
+    // temporal anti-aliasing (setTemporalAA): the resolve writes historyImages[historyIndex]
+    // and reads the other one, last frame's
+    TemporalAASettings taa;
+    VkRenderPass taaPass = VK_NULL_HANDLE;
+    VkDescriptorSet taaSets[2] = {};   // writing history image 0 / 1
+    Pipeline taaPipeline;
+    Image historyImages[2] = {};
+    VkFramebuffer historyFramebuffers[2] = {};
+    uint32_t historyIndex = 0;
+    bool historyReady = false;  // the history images exist (TAA active)
+    bool historyValid = false;  // the other history image holds last frame
+    glm::vec2 taaJitter = glm::vec2(0.0f);  // this frame's, in texture coordinates
+
+    bool taaActive() const { return post.hdr && taa.enabled; }
+
+    // ambient occlusion (setAmbientOcclusion), half the scene's extent: the screen views'
+    // depth, and the occlusion in aoImages[0] (the blur's first axis goes through [1])
+    AmbientOcclusionSettings ao;
+    VkRenderPass aoDepthPass = VK_NULL_HANDLE, ssaoPass = VK_NULL_HANDLE;
+    VkPipelineLayout ssaoPipelineLayout = VK_NULL_HANDLE;   // the post sets, then the frame's uniforms
+    Pipeline aoDepthPipeline, aoTerrainDepthPipeline, ssaoPipeline, ssaoBlurPipeline;
+    VkDescriptorSet ssaoSet = VK_NULL_HANDLE, ssaoBlurSets[2] = {};    // the blur reading aoImages[0] / [1]
+    Image aoDepth = {}, aoImages[2] = {};
+    VkFramebuffer aoDepthFramebuffer = VK_NULL_HANDLE, aoFramebuffers[2] = {};
+    VkExtent2D aoExtent = {};
+    bool aoReady = false;       // the targets exist (quality is not Off)
+
+    // environment lighting (setEnvironmentLighting); iblMips == 0 until set
+    Image iblSpecular = {}, iblLut = {};
+    uint32_t iblMips = 0;
+    glm::vec3 iblSH[9] = {};
+
+    // baked lighting (setLightmap); lightmapChartCount == 0 until set
+    Image lightmapImage = {};
+    unsigned int lightmapChartCount = 0;
+    glm::vec4 lightmapTable[3 * MAX_LIGHTMAP_CHARTS] = {};
+
+    std::vector<Buffer> buffers;
+    std::vector<Image> images;
+    std::vector<MeshEntry> meshes;
+    std::vector<unsigned int> freeMeshes;           // destroyed createMesh() slots
+    VkBuffer skyboxVertices = VK_NULL_HANDLE;
+    bool hasSkybox = false;
+
+    glm::vec3 clearColor;
+    RendererStats lastStats;
+
+    // ---- recording ----
+
+    // records items [begin, end) for every view; per-view draws and CPU time go to draws[] and ms[]
+    void recordChunk(VkCommandBuffer cmd, const std::vector<DrawItem>& items, size_t begin, size_t end, bool withSkybox,
+                     unsigned int* draws, double* ms)
+    {
+        FrameData& fd = frames[frameIndex];
+        VkCommandBufferInheritanceInfo inherit = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+        inherit.renderPass = renderPass;
+        inherit.subpass = 0;
+        inherit.framebuffer = framebuffer;
+        VkCommandBufferBeginInfo bi = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        bi.pInheritanceInfo = &inherit;
+        VK_CHECK(vkBeginCommandBuffer(cmd, &bi));
+
+        VkPipeline bound = VK_NULL_HANDLE;
+        for (unsigned int v = 0; v < viewCount; v++)
+        {
+            if (viewTargets[v] != ViewTarget::Screen) continue;
+            auto t0 = std::chrono::high_resolution_clock::now();
+            // the rect's y runs up from the bottom, Vulkan's viewport y down from the top
+            const glm::vec4& r = viewRects[v];
+            VkRect2D scissor;
+            scissor.offset = { (int32_t)(r.x * sceneExtent.width), (int32_t)((1.0f - r.y - r.w) * sceneExtent.height) };
+            scissor.extent = { (uint32_t)(r.z * sceneExtent.width), (uint32_t)(r.w * sceneExtent.height) };
+            VkViewport viewport = { (float)scissor.offset.x, (float)scissor.offset.y,
+                                    (float)scissor.extent.width, (float)scissor.extent.height, 0.0f, 1.0f };
+            vkCmdSetViewport(cmd, 0, 1, &viewport);
+            vkCmdSetScissor(cmd, 0, 1, &scissor);
+            VkDescriptorSet sets[2] = { textureSet, fd.frameSet };
+            uint32_t offset = (uint32_t)(v * uboStride);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, sets, 1, &offset);
+
+            unsigned int viewDraws = recordItems(cmd, items, begin, end, v, withSkybox, bound);
+            draws[v] = viewDraws;
+            ms[v] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+        }
+
+        VK_CHECK(vkEndCommandBuffer(cmd));
+    }
+
+    // the items of view v in [begin, end), then the skybox; view's viewport and uniforms are bound.
+    // depthOnly draws them with the ambient occlusion depth pipelines instead
+    unsigned int recordItems(VkCommandBuffer cmd, const std::vector<DrawItem>& items, size_t begin, size_t end, unsigned int v,
+                             bool withSkybox, VkPipeline& bound, bool depthOnly = false)
+    {
+        unsigned int draws = 0;
+        for (size_t i = begin; i < end; i++)
+        {
+            const DrawItem& item = items[i];
+            if (!(item.viewMask & (1u << v))) continue;
+            VkPipeline p = depthOnly ? (item.material == Material::Terrain ? aoTerrainDepthPipeline.pipeline : aoDepthPipeline.pipeline)
+                         : item.material == Material::Floor ? floorPipeline.pipeline
+                         : item.material == Material::Terrain ? terrainPipeline.pipeline : carPipeline.pipeline;
+            if (p != bound) { vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, p); bound = p; }
+            glm::mat4 prevRows = glm::transpose(item.prevModel[3][3] == 0.0f ? item.model : item.prevModel);
+            float spacing = 1.0f;
+            int32_t baked = item.material == Material::Car ? (item.hasLightProbe && i < MAX_LIGHT_PROBE_ITEMS ? (int32_t)i : -1)
+                                                           : item.lightmapChart;
+            if (item.heightmap)
+            {
+                auto found = heightSpacing.find(item.heightmap);
+                if (found != heightSpacing.end()) spacing = found->second;
+            }
+
+            for (const MeshPart& part : meshes[item.mesh].parts)
+            {
+                PushConstants pc = { item.model, part.texture ? part.texture : item.texture, item.heightmap, spacing, baked,
+                                     { prevRows[0], prevRows[1], prevRows[2] } };
+                vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pc), &pc);
+                VkDeviceSize offset = 0;
+                vkCmdBindVertexBuffers(cmd, 0, 1, &part.vertices, &offset);
+                vkCmdBindIndexBuffer(cmd, part.indices, 0, VK_INDEX_TYPE_UINT32);
+                vkCmdDrawIndexed(cmd, part.indexCount, 1, 0, 0, 0);
+                draws++;
+            }
+        }
+
+        if (withSkybox)
+        {
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, skyboxPipeline.pipeline);
+            bound = skyboxPipeline.pipeline;
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(cmd, 0, 1, &skyboxVertices, &offset);
+            vkCmdDraw(cmd, 36, 1, 0, 0);
+            draws++;
+        }
+        return draws;
+    }
+
+    // one probe face: its own render pass instance over that layer of the cube
+    unsigned int recordProbeFace(VkCommandBuffer cmd, const std::vector<DrawItem>& items, unsigned int v)
+    {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        FrameData& fd = frames[frameIndex];
+        VkClearValue clears[3];
+        clears[0].color = { { clearColor.r, clearColor.g, clearColor.b, 1.0f } };
+        clears[1].depthStencil = { 0.0f, 0 };
+        clears[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+        VkRenderPassBeginInfo rp = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+        rp.renderPass = renderPass;    // same formats and layouts as the scene target
+        rp.framebuffer = probeFramebuffers[viewFaces[v]];
+        rp.renderArea.extent = { probeSize, probeSize };
+        rp.clearValueCount = 3;
+        rp.pClearValues = clears;
+        vkCmdBeginRenderPass(cmd, &rp, VK_SUBPASS_CONTENTS_INLINE);
+
+        VkViewport viewport = { 0.0f, 0.0f, (float)probeSize, (float)probeSize, 0.0f, 1.0f };
+        VkRect2D scissor = { { 0, 0 }, { probeSize, probeSize } };
+        vkCmdSetViewport(cmd, 0, 1, &viewport);
+        vkCmdSetScissor(cmd, 0, 1, &scissor);
+        VkDescriptorSet sets[2] = { textureSet, fd.frameSet };
+        uint32_t offset = (uint32_t)(v * uboStride);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, sets, 1, &offset);
+        VkPipeline bound = VK_NULL_HANDLE;
+        unsigned int draws = recordItems(cmd, items, 0, items.size(), v, hasSkybox, bound);
+        vkCmdEndRenderPass(cmd);
+
+        lastStats.viewDrawCalls[v] = draws;
+        lastStats.viewCpuMs[v] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+        return draws;
+    }
+
+    // the render pass leaves mip 0 of the face in TRANSFER_SRC_OPTIMAL; blit it down the
+    // chain and hand the whole face back to the shaders
+    void recordProbeMips(VkCommandBuffer cmd, uint32_t face)
+    {
+        if (probeMips > 1)
+            imageBarrier(cmd, probeImage.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 1, probeMips - 1, 1, face);
+        int32_t size = (int32_t)probeSize;
+        for (uint32_t level = 1; level < probeMips; level++)
+        {
+            if (level > 1)
+                imageBarrier(cmd, probeImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                             VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, level - 1, 1, 1, face);
+            VkImageBlit blit = {};
+            blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, face, 1 };
+            blit.srcOffsets[1] = { size, size, 1 };
+            size = std::max(1, size / 2);
+            blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, face, 1 };
+            blit.dstOffsets[1] = { size, size, 1 };
+            vkCmdBlitImage(cmd, probeImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, probeImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           1, &blit, VK_FILTER_LINEAR);
+        }
+        imageBarrier(cmd, probeImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, probeMips - 1, 1, face);
+        imageBarrier(cmd, probeImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, probeMips - 1, 1, 1, face);
+    }
+
+    // all planar reflection views in one render pass instance, each in its view's rect of
+    // the reduced target, which is then handed to the floor shader
+    unsigned int recordPlanarReflection(VkCommandBuffer cmd, const std::vector<DrawItem>& items)
+    {
+        FrameData& fd = frames[frameIndex];
+        // last frame's floor may still be sampling the target about to be cleared
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                             0, 0, nullptr, 0, nullptr, 0, nullptr);
+        VkClearValue clears[3];
+        clears[0].color = { { clearColor.r, clearColor.g, clearColor.b, 1.0f } };
+        clears[1].depthStencil = { 0.0f, 0 };
+        clears[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+        VkRenderPassBeginInfo rp = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+        rp.renderPass = renderPass;
+        rp.framebuffer = planarFramebuffer;
+        rp.renderArea.extent = planarExtent;
+        rp.clearValueCount = 3;
+        rp.pClearValues = clears;
+        vkCmdBeginRenderPass(cmd, &rp, VK_SUBPASS_CONTENTS_INLINE);
+
+        unsigned int draws = 0;
+        VkPipeline bound = VK_NULL_HANDLE;
+        for (unsigned int v = 0; v < viewCount; v++)
+        {
+            if (viewTargets[v] != ViewTarget::PlanarReflection) continue;
+            auto t0 = std::chrono::high_resolution_clock::now();
+            const glm::vec4& r = viewRects[v];
+            VkRect2D scissor;
+            scissor.offset = { (int32_t)(r.x * planarExtent.width), (int32_t)((1.0f - r.y - r.w) * planarExtent.height) };
+            scissor.extent = { std::max(1u, (uint32_t)(r.z * planarExtent.width)), std::max(1u, (uint32_t)(r.w * planarExtent.height)) };
+            VkViewport viewport = { (float)scissor.offset.x, (float)scissor.offset.y,
+                                    (float)scissor.extent.width, (float)scissor.extent.height, 0.0f, 1.0f };
+            vkCmdSetViewport(cmd, 0, 1, &viewport);
+            vkCmdSetScissor(cmd, 0, 1, &scissor);
+            VkDescriptorSet sets[2] = { textureSet, fd.frameSet };
+            uint32_t offset = (uint32_t)(v * uboStride);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, sets, 1, &offset);
+            lastStats.viewDrawCalls[v] = recordItems(cmd, items, 0, items.size(), v, hasSkybox, bound);
+            lastStats.viewCpuMs[v] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+            draws += lastStats.viewDrawCalls[v];
+        }
+        vkCmdEndRenderPass(cmd);
+
+        imageBarrier(cmd, planarColor.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        return draws;
+    }
+
+    // the screen views' depth into aoDepth, each view's occlusion from it, then the blur
+    // into aoImages[0]; returns the depth pass's draw calls
+    unsigned int recordAmbientOcclusion(VkCommandBuffer cmd, const std::vector<DrawItem>& items)
+    {
+        FrameData& fd = frames[frameIndex];
+        auto t0 = std::chrono::high_resolution_clock::now();
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, fd.queries, 2 * PASS_AO_DEPTH);
+        VkClearValue clear;
+        clear.depthStencil = { 0.0f, 0 };
+        VkRenderPassBeginInfo rp = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+        rp.renderPass = aoDepthPass;
+        rp.framebuffer = aoDepthFramebuffer;
+        rp.renderArea.extent = aoExtent;
+        rp.clearValueCount = 1;
+        rp.pClearValues = &clear;
+        vkCmdBeginRenderPass(cmd, &rp, VK_SUBPASS_CONTENTS_INLINE);
+
+        // the views' rects in the half-size targets, y down
+        VkRect2D rects[MAX_VIEWS] = {};
+        unsigned int draws = 0;
+        VkPipeline bound = VK_NULL_HANDLE;
+        for (unsigned int v = 0; v < viewCount; v++)
+        {
+            if (viewTargets[v] != ViewTarget::Screen) continue;
+            const glm::vec4& r = viewRects[v];
+            rects[v].offset = { (int32_t)(r.x * aoExtent.width), (int32_t)((1.0f - r.y - r.w) * aoExtent.height) };
+            rects[v].extent = { std::max(1u, (uint32_t)(r.z * aoExtent.width)), std::max(1u, (uint32_t)(r.w * aoExtent.height)) };
+            VkViewport viewport = { (float)rects[v].offset.x, (float)rects[v].offset.y,
+                                    (float)rects[v].extent.width, (float)rects[v].extent.height, 0.0f, 1.0f };
+            vkCmdSetViewport(cmd, 0, 1, &viewport);
+            vkCmdSetScissor(cmd, 0, 1, &rects[v]);
+            VkDescriptorSet sets[2] = { textureSet, fd.frameSet };
+            uint32_t offset = (uint32_t)(v * uboStride);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, sets, 1, &offset);
+            draws += recordItems(cmd, items, 0, items.size(), v, false, bound, true);
+        }
+        vkCmdEndRenderPass(cmd);
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, fd.queries, 2 * PASS_AO_DEPTH + 1);
+        fd.passWritten[PASS_AO_DEPTH] = true;
+        auto t1 = std::chrono::high_resolution_clock::now();
+        addPass("ao-depth", std::chrono::duration<double, std::milli>(t1 - t0).count(), PASS_AO_DEPTH);
+
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, fd.queries, 2 * PASS_SSAO);
+        rp = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+        rp.renderPass = ssaoPass;
+        rp.framebuffer = aoFramebuffers[0];
+        rp.renderArea.extent = aoExtent;
+        vkCmdBeginRenderPass(cmd, &rp, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, ssaoPipeline.pipeline);
+        for (unsigned int v = 0; v < viewCount; v++)
+        {
+            if (viewTargets[v] != ViewTarget::Screen) continue;
+            VkViewport viewport = { (float)rects[v].offset.x, (float)rects[v].offset.y,
+                                    (float)rects[v].extent.width, (float)rects[v].extent.height, 0.0f, 1.0f };
+            vkCmdSetViewport(cmd, 0, 1, &viewport);
+            vkCmdSetScissor(cmd, 0, 1, &rects[v]);
+            VkDescriptorSet sets[2] = { ssaoSet, fd.frameSet };
+            uint32_t offset = (uint32_t)(v * uboStride);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, ssaoPipelineLayout, 0, 2, sets, 1, &offset);
+            PostPush push = { glm::vec4(viewport.x, viewport.y, viewport.width, viewport.height) };
+            vkCmdPushConstants(cmd, ssaoPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), &push);
+            vkCmdDraw(cmd, 3, 1, 0, 0);
+        }
+        vkCmdEndRenderPass(cmd);
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, fd.queries, 2 * PASS_SSAO + 1);
+        fd.passWritten[PASS_SSAO] = true;
+        auto t2 = std::chrono::high_resolution_clock::now();
+        addPass("ssao", std::chrono::duration<double, std::milli>(t2 - t1).count(), PASS_SSAO);
+
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, fd.queries, 2 * PASS_SSAO_BLUR);
+        float radius = (float)aoBlurRadius(ao.quality);
+        recordPostPass(cmd, ssaoPass, aoFramebuffers[1], aoExtent, ssaoBlurPipeline.pipeline, ssaoBlurSets[0], glm::vec4(1.0f, 0.0f, radius, 0.0f));
+        recordPostPass(cmd, ssaoPass, aoFramebuffers[0], aoExtent, ssaoBlurPipeline.pipeline, ssaoBlurSets[1], glm::vec4(0.0f, 1.0f, radius, 0.0f));
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, fd.queries, 2 * PASS_SSAO_BLUR + 1);
+        fd.passWritten[PASS_SSAO_BLUR] = true;
+        addPass("ssao-blur", std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t2).count(),
+                PASS_SSAO_BLUR);
+        return draws;
+    }
+
+    // the TAA resolve, bloom down and back up the chain, then the tonemap into ldrTarget;
+    // CPU ms per stage go to ms[]
+    void recordPost(VkCommandBuffer cmd, double* ms)
+    {
+        FrameData& fd = frames[frameIndex];
+        // the scene pass left its target ready for the blit; the post passes sample it instead
+        imageBarrier(cmd, colorTarget.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+        auto t0 = std::chrono::high_resolution_clock::now();
+        uint32_t resolved = 0;      // which of the paired sets bloom and the tonemap use
+        if (historyReady)
+        {
+            historyIndex ^= 1;
+            resolved = historyIndex;
+            vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, fd.queries, 2 * PASS_TAA);
+            float feedback = historyValid ? std::min(std::max(taa.feedback, 0.0f), 0.98f) : 0.0f;
+            glm::vec4 params(taaJitter.x, taaJitter.y, feedback, 0.0f);
+            recordPostPass(cmd, taaPass, historyFramebuffers[historyIndex], extent, taaPipeline.pipeline, taaSets[historyIndex], params);
+            vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, fd.queries, 2 * PASS_TAA + 1);
+            fd.passWritten[PASS_TAA] = true;
+            historyValid = true;
+            auto t1 = std::chrono::high_resolution_clock::now();
+            ms[0] = std::chrono::duration<double, std::milli>(t1 - t0).count();
+            t0 = t1;
+        }
+
+        if (bloomCount)
+        {
+            vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, fd.queries, 2 * PASS_BLOOM_DOWN);
+            for (uint32_t i = 0; i < bloomCount; i++)
+            {
+                VkExtent2D source = i == 0 ? extent : bloomExtents[i - 1];
+                glm::vec4 params(1.0f / source.width, 1.0f / source.height, i == 0 ? post.bloomThreshold : -1.0f, 0.0f);
+                recordPostPass(cmd, bloomDownPass, bloomFramebuffers[i], bloomExtents[i], bloomDownPipeline.pipeline,
+                               i == 0 ? bloomFirstSets[resolved] : bloomDownSets[i], params);
+            }
+            vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, fd.queries, 2 * PASS_BLOOM_DOWN + 1);
+            fd.passWritten[PASS_BLOOM_DOWN] = true;
+            auto t1 = std::chrono::high_resolution_clock::now();
+            ms[1] = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+            vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, fd.queries, 2 * PASS_BLOOM_UP);
+            for (int i = (int)bloomCount - 2; i >= 0; i--)
+            {
+                glm::vec4 params(1.0f / bloomExtents[i + 1].width, 1.0f / bloomExtents[i + 1].height, 0.0f, 0.0f);
+                recordPostPass(cmd, bloomUpPass, bloomFramebuffers[i], bloomExtents[i], bloomUpPipeline.pipeline, bloomUpSets[i], params);
+            }
+            vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, fd.queries, 2 * PASS_BLOOM_UP + 1);
+            fd.passWritten[PASS_BLOOM_UP] = true;
+            t0 = std::chrono::high_resolution_clock::now();
+            ms[2] = std::chrono::duration<double, std::milli>(t0 - t1).count();
+        }
+
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, fd.queries, 2 * PASS_TONEMAP);
+        glm::vec4 params(0.0f, 0.0f, bloomCount ? post.bloomStrength / bloomCount : 0.0f, post.exposure);
+        recordPostPass(cmd, tonemapPass, ldrFramebuffer, extent, tonemapPipeline.pipeline, tonemapSets[resolved], params);
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, fd.queries, 2 * PASS_TONEMAP + 1);
+        fd.passWritten[PASS_TONEMAP] = true;
+        ms[3] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+    }
+
+    // one fullscreen triangle into the whole of `framebuffer`
+    void recordPostPass(VkCommandBuffer cmd, VkRenderPass pass, VkFramebuffer framebuffer, VkExtent2D size,
+                        VkPipeline pipeline, VkDescriptorSet set, const glm::vec4& params)
+    {
+        VkRenderPassBeginInfo rp = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+        rp.renderPass = pass;
+        rp.framebuffer = framebuffer;
+        rp.renderArea.extent = size;
+        vkCmdBeginRenderPass(cmd, &rp, VK_SUBPASS_CONTENTS_INLINE);
+        VkViewport viewport = { 0.0f, 0.0f, (float)size.width, (float)size.height, 0.0f, 1.0f };
+        VkRect2D scissor = { { 0, 0 }, size };
+        vkCmdSetViewport(cmd, 0, 1, &viewport);
+        vkCmdSetScissor(cmd, 0, 1, &scissor);
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, postPipelineLayout, 0, 1, &set, 0, nullptr);
+        PostPush push = { params };
+        vkCmdPushConstants(cmd, postPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), &push);
+        vkCmdDraw(cmd, 3, 1, 0, 0);
+        vkCmdEndRenderPass(cmd);
+    }
+
+    // ---- timing ----
+
+    void addPass(const char* name, double cpuMs, Pass pass)
+    {
+        if (lastStats.passCount >= MAX_PASSES) return;
+        PassTiming& p = lastStats.passes[lastStats.passCount++];
+        p.name = name;
+        p.cpuMs = cpuMs;
+        p.gpuMs = gpuPassMs[pass];
+    }
+
+    // the slot's fence has just been waited on, so its queries are complete
+    void readTimestamps(FrameData& fd)
+    {
+        for (unsigned int p = 0; p < PASS_COUNT; p++)
+        {
+            if (!fd.passWritten[p]) continue;
+            uint64_t ticks[2];
+            if (vkGetQueryPoolResults(device, fd.queries, 2 * p, 2, sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+                gpuPassMs[p] = (ticks[1] - ticks[0]) * timestampPeriod * 1e-6;
+            fd.passWritten[p] = false;
+        }
+    }
+
+    static void imageBarrier(VkCommandBuffer cmd, VkImage image, VkImageLayout from, VkImageLayout to,
+                             VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+                             VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
+                             uint32_t baseMip = 0, uint32_t mips = 1, uint32_t layers = 1, uint32_t baseLayer = 0)
+    {
+        VkImageMemoryBarrier b = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+        b.oldLayout = from;
+        b.newLayout = to;
+        b.srcAccessMask = srcAccess;
+        b.dstAccessMask = dstAccess;
+        b.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        b.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        b.image = image;
+        b.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseMip, mips, baseLayer, layers };
+        vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &b);
+    }
+
+    // ---- setup ----
+
+    void createInstance()
+    {
+        VkApplicationInfo app = { VK_STRUCTURE_TYPE_APPLICATION_INFO };
+        app.pApplicationName = "Car + Skybox + Textured Floor";
+        app.apiVersion = VK_API_VERSION_1_2;
+
+        std::vector<const char*> extensions;
+        if (window)
+        {
+            uint32_t count = 0;
+            const char** required = glfwGetRequiredInstanceExtensions(&count);
+            extensions.assign(required, required + count);
+        }
+
+        VkInstanceCreateInfo ci = { VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO };
+        ci.pApplicationInfo = &app;
+        ci.enabledExtensionCount = (uint32_t)extensions.size();
+        ci.ppEnabledExtensionNames = extensions.data();
+        VK_CHECK(vkCreateInstance(&ci, nullptr, &instance));
+    }
+
+    void pickDevice()
+    {
+        uint32_t count = 0;
+        vkEnumeratePhysicalDevices(instance, &count, nullptr);
+        std::vector<VkPhysicalDevice> devices(count);
+        vkEnumeratePhysicalDevices(instance, &count, devices.data());
+
+        // prefer a discrete GPU, but accept anything with graphics (lavapipe is a CPU device)
+        int bestScore = -1;
+        for (VkPhysicalDevice d : devices)
+        {
+            uint32_t qCount = 0;
+            vkGetPhysicalDeviceQueueFamilyProperties(d, &qCount, nullptr);
+            std::vector<VkQueueFamilyProperties> families(qCount);
+            vkGetPhysicalDeviceQueueFamilyProperties(d, &qCount, families.data());
+            for (uint32_t q = 0; q < qCount; q++)
+            {
+                if (!(families[q].queueFlags & VK_QUEUE_GRAPHICS_BIT)) continue;
+                VkBool32 present = VK_TRUE;
+                if (surface) vkGetPhysicalDeviceSurfaceSupportKHR(d, q, surface, &present);
+                if (!present) continue;
+
+                VkPhysicalDeviceProperties props;
+                vkGetPhysicalDeviceProperties(d, &props);
+                int score = props.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU ? 2 :
+                            props.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU ? 1 : 0;
+                if (score > bestScore) { bestScore = score; gpu = d; queueFamily = q; }
+                break;
+            }
+        }
+        if (!gpu) { std::cerr << "No Vulkan device with graphics support\n"; std::abort(); }
+
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(gpu, &props);
+        std::cout << "Vulkan device: " << props.deviceName << std::endl;
+        timestampPeriod = props.limits.timestampPeriod;
+        VkDeviceSize align = std::max<VkDeviceSize>(1, props.limits.minUniformBufferOffsetAlignment);
+        uboStride = (sizeof(FrameUniforms) + align - 1) / align * align;
+    }
+
+    void createDevice()
+    {
+        float priority = 1.0f;
+        VkDeviceQueueCreateInfo qci = { VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO };
+        qci.queueFamilyIndex = queueFamily;
+        qci.queueCount = 1;
+        qci.pQueuePriorities = &priority;
+
+        VkPhysicalDeviceVulkan12Features features12 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+        features12.descriptorIndexing = VK_TRUE;
+        features12.runtimeDescriptorArray = VK_TRUE;
+        features12.descriptorBindingPartiallyBound = VK_TRUE;
+        features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+
+        const char* swapchainExt = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+        VkDeviceCreateInfo ci = { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
+        ci.pNext = &features12;
+        ci.queueCreateInfoCount = 1;
+        ci.pQueueCreateInfos = &qci;
+        ci.enabledExtensionCount = surface ? 1 : 0;
+        ci.ppEnabledExtensionNames = &swapchainExt;
+        VK_CHECK(vkCreateDevice(gpu, &ci, nullptr, &device));
+        vkGetDeviceQueue(device, queueFamily, 0, &queue);
+
+        VkCommandPoolCreateInfo pci = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+        pci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        pci.queueFamilyIndex = queueFamily;
+        VK_CHECK(vkCreateCommandPool(device, &pci, nullptr, &uploadPool));
+    }
+
+    void createSamplers()
+    {
+        VkSamplerCreateInfo si = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+        si.magFilter = VK_FILTER_LINEAR;
+        si.minFilter = VK_FILTER_LINEAR;
+        si.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        si.addressModeU = si.addressModeV = si.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        si.maxLod = VK_LOD_CLAMP_NONE;
+        VK_CHECK(vkCreateSampler(device, &si, nullptr, &repeatSampler));
+        si.addressModeU = si.addressModeV = si.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        VK_CHECK(vkCreateSampler(device, &si, nullptr, &clampSampler));
+    }
+
+    void createDescriptors()
+    {
+        // set 0: bindless texture array + skybox + reflection probe + prefiltered skybox + BRDF table
+        // + planar reflection + ambient occlusion and its depth + lightmap, updated after bind so
+        // loads never stall recording
+        VkDescriptorSetLayoutBinding texBindings[9] = {};
+        texBindings[0].binding = 0;
+        texBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        texBindings[0].descriptorCount = MAX_TEXTURES;
+        texBindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;   // the terrain reads heights per vertex
+        texBindings[1].binding = 1;
+        texBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        texBindings[1].descriptorCount = 1;
+        texBindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        for (uint32_t b = 2; b < 9; b++)    // reflection probe, prefiltered skybox, BRDF table, planar reflection, occlusion, its depth, lightmap
+        {
+            texBindings[b] = texBindings[1];
+            texBindings[b].binding = b;
+        }
+
+        VkDescriptorBindingFlags bindingFlags[9];
+        for (VkDescriptorBindingFlags& f : bindingFlags)
+            f = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+        VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO };
+        flagsInfo.bindingCount = 9;
+        flagsInfo.pBindingFlags = bindingFlags;
+
+        VkDescriptorSetLayoutCreateInfo lci = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+        lci.pNext = &flagsInfo;
+        lci.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        lci.bindingCount = 9;
+        lci.pBindings = texBindings;
+        VK_CHECK(vkCreateDescriptorSetLayout(device, &lci, nullptr, &textureSetLayout));
+
+        // set 1: per-frame, per-view uniforms, and the frame's light probes
+        VkDescriptorSetLayoutBinding frameBindings[2] = {};
+        frameBindings[0].binding = 0;
+        frameBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;   // offset selects the view
+        frameBindings[0].descriptorCount = 1;
+        frameBindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+        frameBindings[1].binding = 1;
+        frameBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        frameBindings[1].descriptorCount = 1;
+        frameBindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        VkDescriptorSetLayoutCreateInfo fci = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+        fci.bindingCount = 2;
+        fci.pBindings = frameBindings;
+        VK_CHECK(vkCreateDescriptorSetLayout(device, &fci, nullptr, &frameSetLayout));
+
+        VkDescriptorPoolSize sizes[3] = {
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_TEXTURES + 8 },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, FRAMES_IN_FLIGHT },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, FRAMES_IN_FLIGHT }
+        };
+        VkDescriptorPoolCreateInfo pci = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+        pci.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        pci.maxSets = 1 + FRAMES_IN_FLIGHT;
+        pci.poolSizeCount = 3;
+        pci.pPoolSizes = sizes;
+        VK_CHECK(vkCreateDescriptorPool(device, &pci, nullptr, &descriptorPool));
+
+        VkDescriptorSetAllocateInfo ai = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+        ai.descriptorPool = descriptorPool;
+        ai.descriptorSetCount = 1;
+        ai.pSetLayouts = &textureSetLayout;
+        VK_CHECK(vkAllocateDescriptorSets(device, &ai, &textureSet));
+
+        VkPushConstantRange push = { VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants) };
+        VkDescriptorSetLayout layouts[2] = { textureSetLayout, frameSetLayout };
+        VkPipelineLayoutCreateInfo pl = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+        pl.setLayoutCount = 2;
+        pl.pSetLayouts = layouts;
+        pl.pushConstantRangeCount = 1;
+        pl.pPushConstantRanges = &push;
+        VK_CHECK(vkCreatePipelineLayout(device, &pl, nullptr, &pipelineLayout));
+    }
+
+    void createFrames()
+    {
+        for (FrameData& f : frames)
+        {
+            VkCommandPoolCreateInfo pci = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+            pci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            pci.queueFamilyIndex = queueFamily;
+            VK_CHECK(vkCreateCommandPool(device, &pci, nullptr, &f.pool));
+
+            VkCommandBufferAllocateInfo ai = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+            ai.commandPool = f.pool;
+            ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            ai.commandBufferCount = 1;
+            VK_CHECK(vkAllocateCommandBuffers(device, &ai, &f.primary));
+
+            // command pools are externally synchronized, so every recording thread gets its own
+            f.workerPools.resize(workerCount);
+            f.workerCmds.resize(workerCount);
+            for (unsigned int w = 0; w < workerCount; w++)
+            {
+                VK_CHECK(vkCreateCommandPool(device, &pci, nullptr, &f.workerPools[w]));
+                ai.commandPool = f.workerPools[w];
+                ai.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+                VK_CHECK(vkAllocateCommandBuffers(device, &ai, &f.workerCmds[w]));
+            }
+
+            VkFenceCreateInfo fi = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+            fi.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+            VK_CHECK(vkCreateFence(device, &fi, nullptr, &f.fence));
+            VkSemaphoreCreateInfo si = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+            VK_CHECK(vkCreateSemaphore(device, &si, nullptr, &f.imageAvailable));
+            VK_CHECK(vkCreateSemaphore(device, &si, nullptr, &f.renderDone));
+
+            createBuffer(uboStride * MAX_VIEWS, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, f.ubo, f.uboMemory);
+            VK_CHECK(vkMapMemory(device, f.uboMemory, 0, uboStride * MAX_VIEWS, 0, &f.uboMapped));
+            createBuffer(sizeof(LightProbeSH) * MAX_LIGHT_PROBE_ITEMS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, f.lightProbes, f.lightProbeMemory);
+            VK_CHECK(vkMapMemory(device, f.lightProbeMemory, 0, sizeof(LightProbeSH) * MAX_LIGHT_PROBE_ITEMS, 0, &f.lightProbeMapped));
+
+            VkQueryPoolCreateInfo qi = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+            qi.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            qi.queryCount = 2 * PASS_COUNT;
+            VK_CHECK(vkCreateQueryPool(device, &qi, nullptr, &f.queries));
+            for (bool& written : f.passWritten) written = false;
+
+            VkDescriptorSetAllocateInfo dai = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+            dai.descriptorPool = descriptorPool;
+            dai.descriptorSetCount = 1;
+            dai.pSetLayouts = &frameSetLayout;
+            VK_CHECK(vkAllocateDescriptorSets(device, &dai, &f.frameSet));
+
+            VkDescriptorBufferInfo bi[2] = { { f.ubo, 0, sizeof(FrameUniforms) },
+                                             { f.lightProbes, 0, sizeof(LightProbeSH) * MAX_LIGHT_PROBE_ITEMS } };
+            VkWriteDescriptorSet writes[2] = { { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET }, { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET } };
+            for (uint32_t b = 0; b < 2; b++)
+            {
+                writes[b].dstSet = f.frameSet;
+                writes[b].dstBinding = b;
+                writes[b].descriptorCount = 1;
+                writes[b].descriptorType = b == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[b].pBufferInfo = &bi[b];
+            }
+            vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+        }
+    }
+
+    void createSwapchain()
+    {
+        VkSurfaceCapabilitiesKHR caps;
+        VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(gpu, surface, &caps));
+        if (caps.currentExtent.width != UINT32_MAX) extent = caps.currentExtent;
+
+        uint32_t count = 0;
+        vkGetPhysicalDeviceSurfaceFormatsKHR(gpu, surface, &count, nullptr);
+        std::vector<VkSurfaceFormatKHR> formats(count);
+        vkGetPhysicalDeviceSurfaceFormatsKHR(gpu, surface, &count, formats.data());
+        VkSurfaceFormatKHR format = formats[0];
+        for (const VkSurfaceFormatKHR& f : formats)
+            if (f.format == VK_FORMAT_B8G8R8A8_UNORM) format = f;
+
+        VkSwapchainCreateInfoKHR ci = { VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR };
+        ci.surface = surface;
+        ci.minImageCount = std::max(caps.minImageCount, 2u);
+        if (caps.maxImageCount) ci.minImageCount = std::min(ci.minImageCount, caps.maxImageCount);
+        ci.imageFormat = format.format;
+        ci.imageColorSpace = format.colorSpace;
+        ci.imageExtent = extent;
+        ci.imageArrayLayers = 1;
+        ci.imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;   // filled by a blit, never rendered to directly
+        ci.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ci.preTransform = caps.currentTransform;
+        ci.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+        ci.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+        ci.clipped = VK_TRUE;
+        VK_CHECK(vkCreateSwapchainKHR(device, &ci, nullptr, &swapchain));
+
+        vkGetSwapchainImagesKHR(device, swapchain, &count, nullptr);
+        swapImages.resize(count);
+        vkGetSwapchainImagesKHR(device, swapchain, &count, swapImages.data());
+    }
+
+    void destroySwapchain()
+    {
+        if (swapchain) vkDestroySwapchainKHR(device, swapchain, nullptr);
+        swapchain = VK_NULL_HANDLE;
+        swapImages.clear();
+    }
+
+    // the window's size, or its TAA render scale fraction
+    void updateSceneExtent()
+    {
+        float scale = taaActive() ? std::min(std::max(taa.renderScale, 0.5f), 1.0f) : 1.0f;
+        sceneExtent = { std::max(1u, (uint32_t)(extent.width * scale + 0.5f)), std::max(1u, (uint32_t)(extent.height * scale + 0.5f)) };
+    }
+
+    void createRenderTarget()
+    {
+        colorTarget = createImage(sceneExtent.width, sceneExtent.height, 1, 1, SCENE_FORMAT,
+                                  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                                  VK_IMAGE_ASPECT_COLOR_BIT);
+        depthTarget = createImage(sceneExtent.width, sceneExtent.height, 1, 1, VK_FORMAT_D32_SFLOAT,
+                                  VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+        velocityTarget = createImage(sceneExtent.width, sceneExtent.height, 1, 1, VELOCITY_FORMAT,
+                                     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+        if (!renderPass)
+        {
+            VkAttachmentDescription attachments[3] = {};
+            attachments[0].format = SCENE_FORMAT;
+            attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+            attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            attachments[1] = attachments[0];
+            attachments[1].format = VK_FORMAT_D32_SFLOAT;
+            attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            // motion vectors go straight to the TAA resolve
+            attachments[2] = attachments[0];
+            attachments[2].format = VELOCITY_FORMAT;
+            attachments[2].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+            VkAttachmentReference colorRefs[2] = { { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+                                                   { 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL } };
+            VkAttachmentReference depthRef = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+            VkSubpassDescription subpass = {};
+            subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+            subpass.colorAttachmentCount = 2;
+            subpass.pColorAttachments = colorRefs;
+            subpass.pDepthStencilAttachment = &depthRef;
+
+            // previous frame's blit or post passes must finish reading colour before we clear
+            // it again, and the end-of-pass transitions must be visible to this frame's blit
+            // and the resolve's read of the motion vectors
+            VkSubpassDependency deps[2] = {};
+            deps[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+            deps[0].dstSubpass = 0;
+            deps[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            deps[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+            deps[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            deps[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            deps[1].srcSubpass = 0;
+            deps[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+            deps[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            deps[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            deps[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            deps[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+            VkRenderPassCreateInfo rp = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
+            rp.attachmentCount = 3;
+            rp.pAttachments = attachments;
+            rp.subpassCount = 1;
+            rp.pSubpasses = &subpass;
+            rp.dependencyCount = 2;
+            rp.pDependencies = deps;
+            VK_CHECK(vkCreateRenderPass(device, &rp, nullptr, &renderPass));
+        }
+
+        VkImageView views[3] = { colorTarget.view, depthTarget.view, velocityTarget.view };
+        VkFramebufferCreateInfo fb = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+        fb.renderPass = renderPass;
+        fb.attachmentCount = 3;
+        fb.pAttachments = views;
+        fb.width = sceneExtent.width;
+        fb.height = sceneExtent.height;
+        fb.layers = 1;
+        VK_CHECK(vkCreateFramebuffer(device, &fb, nullptr, &framebuffer));
+    }
+
+    void createProbe(uint32_t size)
+    {
+        probeSize = size;
+        probeMips = 1;
+        while ((size >> probeMips) > 0) probeMips++;
+        probeValid = false;
+        probeImage = createImage(size, size, probeMips, 6, SCENE_FORMAT,
+                                 VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+                                 VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+        // start black and shader-readable, like any uploaded cube
+        std::vector<uint16_t> black((size_t)size * size * 4 * 6, 0);   // half floats
+        uploadImage(probeImage, black.data(), black.size() * sizeof(uint16_t), size, size, probeMips, 6);
+        probeDepth = createImage(size, size, 1, 1, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+        // the render pass writes motion vectors; nothing reads the probe's
+        probeVelocity = createImage(size, size, 1, 1, VELOCITY_FORMAT,
+                                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+        for (uint32_t face = 0; face < 6; face++)
+        {
+            VkImageViewCreateInfo vi = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+            vi.image = probeImage.image;
+            vi.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            vi.format = SCENE_FORMAT;
+            vi.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, face, 1 };
+            VK_CHECK(vkCreateImageView(device, &vi, nullptr, &probeFaceViews[face]));
+
+            VkImageView attachments[3] = { probeFaceViews[face], probeDepth.view, probeVelocity.view };
+            VkFramebufferCreateInfo fb = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+            fb.renderPass = renderPass;
+            fb.attachmentCount = 3;
+            fb.pAttachments = attachments;
+            fb.width = size;
+            fb.height = size;
+            fb.layers = 1;
+            VK_CHECK(vkCreateFramebuffer(device, &fb, nullptr, &probeFramebuffers[face]));
+        }
+
+        VkDescriptorImageInfo info = { clampSampler, probeImage.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        VkWriteDescriptorSet write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        write.dstSet = textureSet;
+        write.dstBinding = 2;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &info;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    }
+
+    // 1/resolutionDivisor of the scene target, drawn with the scene's render pass
+    void createPlanarTarget()
+    {
+        if (planar.resolutionDivisor <= 0) return;
+        uint32_t d = (uint32_t)planar.resolutionDivisor;
+        planarExtent = { std::max(1u, sceneExtent.width / d), std::max(1u, sceneExtent.height / d) };
+        planarColor = createImage(planarExtent.width, planarExtent.height, 1, 1, SCENE_FORMAT,
+                                  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                  VK_IMAGE_ASPECT_COLOR_BIT);
+        // start black and shader-readable, like the probe
+        std::vector<uint16_t> black((size_t)planarExtent.width * planarExtent.height * 4, 0);
+        uploadImage(planarColor, black.data(), black.size() * sizeof(uint16_t), planarExtent.width, planarExtent.height, 1, 1);
+        planarDepth = createImage(planarExtent.width, planarExtent.height, 1, 1, VK_FORMAT_D32_SFLOAT,
+                                  VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+        planarVelocity = createImage(planarExtent.width, planarExtent.height, 1, 1, VELOCITY_FORMAT,
+                                     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+        VkImageView attachments[3] = { planarColor.view, planarDepth.view, planarVelocity.view };
+        VkFramebufferCreateInfo fb = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+        fb.renderPass = renderPass;
+        fb.attachmentCount = 3;
+        fb.pAttachments = attachments;
+        fb.width = planarExtent.width;
+        fb.height = planarExtent.height;
+        fb.layers = 1;
+        VK_CHECK(vkCreateFramebuffer(device, &fb, nullptr, &planarFramebuffer));
+
+        VkDescriptorImageInfo info = { clampSampler, planarColor.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        VkWriteDescriptorSet write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        write.dstSet = textureSet;
+        write.dstBinding = 5;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &info;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    }
+
+    VkFramebuffer createColorFramebuffer(VkRenderPass pass, VkImageView view, VkExtent2D size)
+    {
+        VkFramebufferCreateInfo fb = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+        fb.renderPass = pass;
+        fb.attachmentCount = 1;
+        fb.pAttachments = &view;
+        fb.width = size.width;
+        fb.height = size.height;
+        fb.layers = 1;
+        VkFramebuffer framebuffer;
+        VK_CHECK(vkCreateFramebuffer(device, &fb, nullptr, &framebuffer));
+        return framebuffer;
+    }
+
+    // the tonemap's output, the TAA history and the bloom levels, and the post descriptor
+    // sets over them
+    void createPostTargets()
+    {
+        if (!post.hdr) return;
+        ldrTarget = createImage(extent.width, extent.height, 1, 1, VK_FORMAT_R8G8B8A8_UNORM,
+                                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+        ldrFramebuffer = createColorFramebuffer(tonemapPass, ldrTarget.view, extent);
+
+        if (taaActive())
+        {
+            // start black and shader-readable: the first resolve binds one before either is written
+            std::vector<uint16_t> black((size_t)extent.width * extent.height * 4, 0);
+            for (uint32_t h = 0; h < 2; h++)
+            {
+                historyImages[h] = createImage(extent.width, extent.height, 1, 1, SCENE_FORMAT,
+                                               VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                               VK_IMAGE_ASPECT_COLOR_BIT);
+                uploadImage(historyImages[h], black.data(), black.size() * sizeof(uint16_t), extent.width, extent.height, 1, 1);
+                historyFramebuffers[h] = createColorFramebuffer(taaPass, historyImages[h].view, extent);
+            }
+            historyReady = true;
+            historyValid = false;
+        }
+
+        bloomCount = 0;
+        if (post.bloomDivisor > 0)
+        {
+            uint32_t w = extent.width / (uint32_t)post.bloomDivisor, h = extent.height / (uint32_t)post.bloomDivisor;
+            for (; (int)bloomCount < std::min(post.bloomLevels, MAX_BLOOM_LEVELS) && w >= 2 && h >= 2; bloomCount++)
+            {
+                bloomExtents[bloomCount] = { w, h };
+                bloomImages[bloomCount] = createImage(w, h, 1, 1, SCENE_FORMAT,
+                                                      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+                bloomFramebuffers[bloomCount] = createColorFramebuffer(bloomDownPass, bloomImages[bloomCount].view, bloomExtents[bloomCount]);
+                w /= 2;
+                h /= 2;
+            }
+        }
+
+        // down: the level above (the resolved frame first); up: the level below; tonemap:
+        // the resolved frame and the first level (the frame again without bloom, never read
+        // then); the resolve: the scene, the other history image and the motion vectors
+        VkDescriptorImageInfo infos[2 * MAX_BLOOM_LEVELS + 12];
+        VkWriteDescriptorSet writes[2 * MAX_BLOOM_LEVELS + 12];
+        uint32_t count = 0;
+        auto write = [&](VkDescriptorSet set, uint32_t binding, VkImageView view) {
+            infos[count] = { clampSampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+            writes[count] = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+            writes[count].dstSet = set;
+            writes[count].dstBinding = binding;
+            writes[count].descriptorCount = 1;
+            writes[count].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[count].pImageInfo = &infos[count];
+            count++;
+        };
+        for (uint32_t i = 1; i < bloomCount; i++) write(bloomDownSets[i], 0, bloomImages[i - 1].view);
+        for (uint32_t i = 0; i + 1 < bloomCount; i++) write(bloomUpSets[i], 0, bloomImages[i + 1].view);
+        for (uint32_t h = 0; h < 2; h++)
+        {
+            VkImageView resolved = historyReady ? historyImages[h].view : colorTarget.view;
+            if (bloomCount) write(bloomFirstSets[h], 0, resolved);
+            write(tonemapSets[h], 0, resolved);
+            write(tonemapSets[h], 1, bloomCount ? bloomImages[0].view : resolved);
+            if (!historyReady) continue;
+            write(taaSets[h], 0, colorTarget.view);
+            write(taaSets[h], 1, historyImages[h ^ 1].view);
+            write(taaSets[h], 2, velocityTarget.view);
+        }
+        vkUpdateDescriptorSets(device, count, writes, 0, nullptr);
+        postReady = true;
+    }
+
+    void destroyPostTargets()
+    {
+        if (!postReady) return;
+        vkDestroyFramebuffer(device, ldrFramebuffer, nullptr);
+        for (uint32_t i = 0; i < bloomCount; i++) vkDestroyFramebuffer(device, bloomFramebuffers[i], nullptr);
+        std::vector<Image*> targets = { &ldrTarget };
+        for (uint32_t i = 0; i < bloomCount; i++) targets.push_back(&bloomImages[i]);
+        if (historyReady)
+            for (uint32_t h = 0; h < 2; h++)
+            {
+                vkDestroyFramebuffer(device, historyFramebuffers[h], nullptr);
+                targets.push_back(&historyImages[h]);
+            }
+        for (Image* i : targets)
+        {
+            vkDestroyImageView(device, i->view, nullptr);
+            vkDestroyImage(device, i->image, nullptr);
+            vkFreeMemory(device, i->memory, nullptr);
+        }
+        bloomCount = 0;
+        postReady = false;
+        historyReady = historyValid = false;
+    }
+
+    // half the scene's extent; the sets over them are rewritten each time (the device is idle)
+    void createOcclusionTargets()
+    {
+        if (ao.quality == AOQuality::Off) return;
+        aoExtent = { std::max(1u, sceneExtent.width / 2), std::max(1u, sceneExtent.height / 2) };
+        aoDepth = createImage(aoExtent.width, aoExtent.height, 1, 1, VK_FORMAT_D32_SFLOAT,
+                              VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+        aoDepthFramebuffer = createColorFramebuffer(aoDepthPass, aoDepth.view, aoExtent);   // its one attachment is depth
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            aoImages[i] = createImage(aoExtent.width, aoExtent.height, 1, 1, VK_FORMAT_R8_UNORM,
+                                      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+            aoFramebuffers[i] = createColorFramebuffer(ssaoPass, aoImages[i].view, aoExtent);
+        }
+
+        VkDescriptorImageInfo infos[7];
+        VkWriteDescriptorSet writes[7];
+        uint32_t count = 0;
+        auto write = [&](VkDescriptorSet set, uint32_t binding, VkImageView view) {
+            infos[count] = { clampSampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+            writes[count] = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+            writes[count].dstSet = set;
+            writes[count].dstBinding = binding;
+            writes[count].descriptorCount = 1;
+            writes[count].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[count].pImageInfo = &infos[count];
+            count++;
+        };
+        write(ssaoSet, 0, aoDepth.view);
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            write(ssaoBlurSets[i], 0, aoImages[i].view);
+            write(ssaoBlurSets[i], 1, aoDepth.view);
+        }
+        write(textureSet, 6, aoImages[0].view);
+        write(textureSet, 7, aoDepth.view);
+        vkUpdateDescriptorSets(device, count, writes, 0, nullptr);
+        aoReady = true;
+    }
+
+    void destroyOcclusionTargets()
+    {
+        if (!aoReady) return;
+        vkDestroyFramebuffer(device, aoDepthFramebuffer, nullptr);
+        for (VkFramebuffer fb : aoFramebuffers) vkDestroyFramebuffer(device, fb, nullptr);
+        for (Image* i : { &aoDepth, &aoImages[0], &aoImages[1] })
+        {
+            vkDestroyImageView(device, i->view, nullptr);
+            vkDestroyImage(device, i->image, nullptr);
+            vkFreeMemory(device, i->memory, nullptr);
+        }
+        aoReady = false;
+    }
+
+    void destroyPlanarTarget()
+    {
+        if (!planarFramebuffer) return;
+        vkDestroyFramebuffer(device, planarFramebuffer, nullptr);
+        planarFramebuffer = VK_NULL_HANDLE;
+        for (Image* i : { &planarColor, &planarDepth, &planarVelocity })
+        {
+            vkDestroyImageView(device, i->view, nullptr);
+            vkDestroyImage(device, i->image, nullptr);
+            vkFreeMemory(device, i->memory, nullptr);
+        }
+    }
+
+    void destroyEnvironmentLighting()
+    {
+        if (!iblMips) return;
+        for (Image* i : { &iblSpecular, &iblLut })
+        {
+            vkDestroyImageView(device, i->view, nullptr);
+            vkDestroyImage(device, i->image, nullptr);
+            vkFreeMemory(device, i->memory, nullptr);
+        }
+        iblMips = 0;
+    }
+
+    void destroyLightmap()
+    {
+        if (!lightmapChartCount) return;
+        vkDestroyImageView(device, lightmapImage.view, nullptr);
+        vkDestroyImage(device, lightmapImage.image, nullptr);
+        vkFreeMemory(device, lightmapImage.memory, nullptr);
+        lightmapImage = {};
+        lightmapChartCount = 0;
+    }
+
+    void destroyProbe()
+    {
+        for (uint32_t face = 0; face < 6; face++)
+        {
+            vkDestroyFramebuffer(device, probeFramebuffers[face], nullptr);
+            vkDestroyImageView(device, probeFaceViews[face], nullptr);
+        }
+        for (Image* i : { &probeImage, &probeDepth, &probeVelocity })
+        {
+            vkDestroyImageView(device, i->view, nullptr);
+            vkDestroyImage(device, i->image, nullptr);
+            vkFreeMemory(device, i->memory, nullptr);
+        }
+        probeSize = 0;
+        probeValid = false;
+    }
+
+    void destroyRenderTarget()
+    {
+        vkDestroyFramebuffer(device, framebuffer, nullptr);
+        for (Image* i : { &colorTarget, &depthTarget, &velocityTarget })
+        {
+            vkDestroyImageView(device, i->view, nullptr);
+            vkDestroyImage(device, i->image, nullptr);
+            vkFreeMemory(device, i->memory, nullptr);
+        }
+        if (renderPass) vkDestroyRenderPass(device, renderPass, nullptr);
+        renderPass = VK_NULL_HANDLE;
+    }
+
+    void recreateTargets()
+    {
+        vkDeviceWaitIdle(device);
+        vkDestroyFramebuffer(device, framebuffer, nullptr);
+        for (Image* i : { &colorTarget, &depthTarget, &velocityTarget })
+        {
+            vkDestroyImageView(device, i->view, nullptr);
+            vkDestroyImage(device, i->image, nullptr);
+            vkFreeMemory(device, i->memory, nullptr);
+        }
+        destroyPlanarTarget();
+        destroyPostTargets();
+        destroyOcclusionTargets();
+        if (surface) { destroySwapchain(); createSwapchain(); }
+        updateSceneExtent();
+        createRenderTarget();   // render pass is format-only and survives resizes
+        createPlanarTarget();
+        createPostTargets();
+        createOcclusionTargets();
+        needsResize = false;
+    }
+
+    VkShaderModule loadShader(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) { std::cerr << "Failed to open SPIR-V " << path << "\n"; std::abort(); }
+        std::vector<char> code((size_t)file.tellg());
+        file.seekg(0);
+        file.read(code.data(), code.size());
+
+        VkShaderModuleCreateInfo ci = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+        ci.codeSize = code.size();
+        ci.pCode = reinterpret_cast<const uint32_t*>(code.data());
+        VkShaderModule module;
+        VK_CHECK(vkCreateShaderModule(device, &ci, nullptr, &module));
+        return module;
+    }
+
+    void createPipelines()
+    {
+        std::vector<char> cacheData;
+        std::ifstream in("vk_pipeline_cache.bin", std::ios::binary | std::ios::ate);
+        if (in)
+        {
+            cacheData.resize((size_t)in.tellg());
+            in.seekg(0);
+            if (!in.read(cacheData.data(), cacheData.size())) cacheData.clear();
+        }
+        // the driver validates the header and ignores data from another device or driver version
+        VkPipelineCacheCreateInfo cci = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+        cci.initialDataSize = cacheData.size();
+        cci.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+        VK_CHECK(vkCreatePipelineCache(device, &cci, nullptr, &pipelineCache));
+
+        floorPipeline.pipeline = createPipeline("floor.vk.vs.spv", "floor.vk.fs.spv", false);
+        carPipeline.pipeline = createPipeline("1.model_loading.vk.vs.spv", "1.model_loading.vk.fs.spv", false);
+        terrainPipeline.pipeline = createPipeline("terrain.vk.vs.spv", "floor.vk.fs.spv", false);
+        skyboxPipeline.pipeline = createPipeline("6.2.skybox.vk.vs.spv", "6.2.skybox.vk.fs.spv", true);
+        // depth only for the ambient occlusion; the cars only need their positions, as the floor's
+        aoDepthPass = createDepthRenderPass();
+        aoDepthPipeline.pipeline = createPipeline("floor.vk.vs.spv", nullptr, false);
+        aoTerrainDepthPipeline.pipeline = createPipeline("terrain.vk.vs.spv", nullptr, false);
+        createPostPipelines();
+    }
+
+    // the ambient occlusion's depth: cleared, written, then sampled by its passes and the scene
+    VkRenderPass createDepthRenderPass()
+    {
+        VkAttachmentDescription attachment = {};
+        attachment.format = VK_FORMAT_D32_SFLOAT;
+        attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkAttachmentReference depthRef = { 0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+        VkSubpassDescription subpass = {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.pDepthStencilAttachment = &depthRef;
+
+        // last frame's scene may still be reading it
+        VkSubpassDependency deps[2] = {};
+        deps[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        deps[0].dstSubpass = 0;
+        deps[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        deps[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        deps[0].srcAccessMask = 0;
+        deps[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        deps[1].srcSubpass = 0;
+        deps[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        deps[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        deps[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        deps[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        deps[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        VkRenderPassCreateInfo rp = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
+        rp.attachmentCount = 1;
+        rp.pAttachments = &attachment;
+        rp.subpassCount = 1;
+        rp.pSubpasses = &subpass;
+        rp.dependencyCount = 2;
+        rp.pDependencies = deps;
+        VkRenderPass pass;
+        VK_CHECK(vkCreateRenderPass(device, &rp, nullptr, &pass));
+        return pass;
+    }
+
+    // colour-only pass of the post chain: ordered after whatever last wrote or read its
+    // attachment, and before the shaders or the blit that read the result
+    VkRenderPass createPostRenderPass(VkFormat format, VkAttachmentLoadOp load, VkImageLayout initial, VkImageLayout final)
+    {
+        VkAttachmentDescription attachment = {};
+        attachment.format = format;
+        attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        attachment.loadOp = load;
+        attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = initial;
+        attachment.finalLayout = final;
+
+        VkAttachmentReference colorRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+        VkSubpassDescription subpass = {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorRef;
+
+        VkSubpassDependency deps[2] = {};
+        deps[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        deps[0].dstSubpass = 0;
+        deps[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+        deps[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        deps[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        deps[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        deps[1].srcSubpass = 0;
+        deps[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        deps[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        deps[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+        deps[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        deps[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+
+        VkRenderPassCreateInfo rp = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
+        rp.attachmentCount = 1;
+        rp.pAttachments = &attachment;
+        rp.subpassCount = 1;
+        rp.pSubpasses = &subpass;
+        rp.dependencyCount = 2;
+        rp.pDependencies = deps;
+        VkRenderPass pass;
+        VK_CHECK(vkCreateRenderPass(device, &rp, nullptr, &pass));
+        return pass;
+    }
+
+    void createPostPipelines()
+    {
+        taaPass = createPostRenderPass(SCENE_FORMAT, VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                                       VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        // bloom levels share the scene's format: RGBA16F is a blendable colour attachment
+        // everywhere, unlike the packed B10G11R11 the GL backend uses
+        bloomDownPass = createPostRenderPass(SCENE_FORMAT, VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                                             VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        bloomUpPass = createPostRenderPass(SCENE_FORMAT, VK_ATTACHMENT_LOAD_OP_LOAD,
+                                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        tonemapPass = createPostRenderPass(VK_FORMAT_R8G8B8A8_UNORM, VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                                           VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        ssaoPass = createPostRenderPass(VK_FORMAT_R8_UNORM, VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        VkDescriptorSetLayoutBinding bindings[3] = {};
+        for (uint32_t b = 0; b < 3; b++)
+        {
+            bindings[b].binding = b;
+            bindings[b].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            bindings[b].descriptorCount = 1;
+            bindings[b].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo lci = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+        lci.bindingCount = 3;
+        lci.pBindings = bindings;
+        VK_CHECK(vkCreateDescriptorSetLayout(device, &lci, nullptr, &postSetLayout));
+
+        VkPushConstantRange push = { VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PostPush) };
+        VkPipelineLayoutCreateInfo pl = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+        pl.setLayoutCount = 1;
+        pl.pSetLayouts = &postSetLayout;
+        pl.pushConstantRangeCount = 1;
+        pl.pPushConstantRanges = &push;
+        VK_CHECK(vkCreatePipelineLayout(device, &pl, nullptr, &postPipelineLayout));
+        VkDescriptorSetLayout ssaoLayouts[2] = { postSetLayout, frameSetLayout };
+        pl.setLayoutCount = 2;
+        pl.pSetLayouts = ssaoLayouts;
+        VK_CHECK(vkCreatePipelineLayout(device, &pl, nullptr, &ssaoPipelineLayout));
+
+        // one set per bloom pass, and pairs (one per history image) for the passes that read
+        // the resolved frame and for the resolve itself, then the ambient occlusion's three,
+        // rewritten when the targets are recreated (the device is idle then)
+        const uint32_t setCount = 2 * MAX_BLOOM_LEVELS + 9;
+        VkDescriptorPoolSize size = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3 * setCount };
+        VkDescriptorPoolCreateInfo pci = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+        pci.maxSets = setCount;
+        pci.poolSizeCount = 1;
+        pci.pPoolSizes = &size;
+        VK_CHECK(vkCreateDescriptorPool(device, &pci, nullptr, &postPool));
+        std::vector<VkDescriptorSetLayout> layouts(setCount, postSetLayout);
+        std::vector<VkDescriptorSet> sets(setCount);
+        VkDescriptorSetAllocateInfo ai = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+        ai.descriptorPool = postPool;
+        ai.descriptorSetCount = setCount;
+        ai.pSetLayouts = layouts.data();
+        VK_CHECK(vkAllocateDescriptorSets(device, &ai, sets.data()));
+        for (int i = 0; i < MAX_BLOOM_LEVELS; i++)
+        {
+            bloomDownSets[i] = sets[2 * i];
+            bloomUpSets[i] = sets[2 * i + 1];
+        }
+        for (uint32_t h = 0; h < 2; h++)
+        {
+            bloomFirstSets[h] = sets[2 * MAX_BLOOM_LEVELS + h];
+            tonemapSets[h] = sets[2 * MAX_BLOOM_LEVELS + 2 + h];
+            taaSets[h] = sets[2 * MAX_BLOOM_LEVELS + 4 + h];
+            ssaoBlurSets[h] = sets[2 * MAX_BLOOM_LEVELS + 6 + h];
+        }
+        ssaoSet = sets[2 * MAX_BLOOM_LEVELS + 8];
+
+        taaPipeline.pipeline = createPostPipeline("taa.vk.fs.spv", taaPass, false);
+        bloomDownPipeline.pipeline = createPostPipeline("bloom_downsample.vk.fs.spv", bloomDownPass, false);
+        bloomUpPipeline.pipeline = createPostPipeline("bloom_upsample.vk.fs.spv", bloomUpPass, true);
+        tonemapPipeline.pipeline = createPostPipeline("tonemap.vk.fs.spv", tonemapPass, false);
+        ssaoPipeline.pipeline = createPostPipeline("ssao.vk.fs.spv", ssaoPass, false, ssaoPipelineLayout);
+        ssaoBlurPipeline.pipeline = createPostPipeline("ssao_blur.vk.fs.spv", ssaoPass, false);
+    }
+
+    // fullscreen triangle (post.vk.vs, no vertex input), no depth; `additive` blends ONE + ONE.
+    // layout defaults to postPipelineLayout
+    VkPipeline createPostPipeline(const char* fs, VkRenderPass pass, bool additive, VkPipelineLayout layout = VK_NULL_HANDLE)
+    {
+        VkShaderModule vsModule = loadShader("post.vk.vs.spv"), fsModule = loadShader(fs);
+        VkPipelineShaderStageCreateInfo stages[2] = {};
+        stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        stages[0].module = vsModule;
+        stages[0].pName = "main";
+        stages[1] = stages[0];
+        stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        stages[1].module = fsModule;
+
+        VkPipelineVertexInputStateCreateInfo vi = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+        VkPipelineInputAssemblyStateCreateInfo ia = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+        ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        VkPipelineViewportStateCreateInfo vp = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+        vp.viewportCount = 1;
+        vp.scissorCount = 1;
+        VkPipelineRasterizationStateCreateInfo rs = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+        rs.polygonMode = VK_POLYGON_MODE_FILL;
+        rs.cullMode = VK_CULL_MODE_NONE;
+        rs.lineWidth = 1.0f;
+        VkPipelineMultisampleStateCreateInfo ms = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+        ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        VkPipelineColorBlendAttachmentState blend = {};
+        blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        if (additive)
+        {
+            blend.blendEnable = VK_TRUE;
+            blend.srcColorBlendFactor = blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            blend.srcAlphaBlendFactor = blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            blend.colorBlendOp = blend.alphaBlendOp = VK_BLEND_OP_ADD;
+        }
+        VkPipelineColorBlendStateCreateInfo cb = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+        cb.attachmentCount = 1;
+        cb.pAttachments = &blend;
+        VkDynamicState dynamics[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+        VkPipelineDynamicStateCreateInfo dyn = { VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+        dyn.dynamicStateCount = 2;
+        dyn.pDynamicStates = dynamics;
+
+        VkGraphicsPipelineCreateInfo ci = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+        ci.stageCount = 2;
+        ci.pStages = stages;
+        ci.pVertexInputState = &vi;
+        ci.pInputAssemblyState = &ia;
+        ci.pViewportState = &vp;
+        ci.pRasterizationState = &rs;
+        ci.pMultisampleState = &ms;
+        ci.pColorBlendState = &cb;
+        ci.pDynamicState = &dyn;
+        ci.layout = layout ? layout : postPipelineLayout;
+        ci.renderPass = pass;
+        VkPipeline pipeline;
+        VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &ci, nullptr, &pipeline));
+
+        vkDestroyShaderModule(device, vsModule, nullptr);
+        vkDestroyShaderModule(device, fsModule, nullptr);
+        return pipeline;
+    }
+
+    // fs == nullptr: depth only, for aoDepthPass
+    VkPipeline createPipeline(const char* vs, const char* fs, bool skybox)
+    {
+        VkShaderModule vsModule = loadShader(vs), fsModule = fs ? loadShader(fs) : VK_NULL_HANDLE;
+        VkPipelineShaderStageCreateInfo stages[2] = {};
+        stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        stages[0].module = vsModule;
+        stages[0].pName = "main";
+        stages[1] = stages[0];
+        stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        stages[1].module = fsModule;
+
+        VkVertexInputBindingDescription binding = { 0, (uint32_t)((skybox ? 3 : 8) * sizeof(float)), VK_VERTEX_INPUT_RATE_VERTEX };
+        VkVertexInputAttributeDescription attrs[3] = {
+            { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 },
+            { 1, 0, VK_FORMAT_R32G32B32_SFLOAT, 3 * sizeof(float) },
+            { 2, 0, VK_FORMAT_R32G32_SFLOAT, 6 * sizeof(float) }
+        };
+        VkPipelineVertexInputStateCreateInfo vi = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+        vi.vertexBindingDescriptionCount = 1;
+        vi.pVertexBindingDescriptions = &binding;
+        vi.vertexAttributeDescriptionCount = skybox ? 1 : 3;
+        vi.pVertexAttributeDescriptions = attrs;
+
+        VkPipelineInputAssemblyStateCreateInfo ia = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+        ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        VkPipelineViewportStateCreateInfo vp = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+        vp.viewportCount = 1;
+        vp.scissorCount = 1;
+        VkPipelineRasterizationStateCreateInfo rs = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+        rs.polygonMode = VK_POLYGON_MODE_FILL;
+        rs.cullMode = VK_CULL_MODE_NONE;
+        rs.lineWidth = 1.0f;
+        VkPipelineMultisampleStateCreateInfo ms = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+        ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        VkPipelineDepthStencilStateCreateInfo ds = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+        ds.depthTestEnable = VK_TRUE;
+        ds.depthWriteEnable = skybox ? VK_FALSE : VK_TRUE;
+        ds.depthCompareOp = skybox ? VK_COMPARE_OP_GREATER_OR_EQUAL : VK_COMPARE_OP_GREATER;
+        VkPipelineColorBlendAttachmentState blend[2] = {};     // colour, motion vectors
+        blend[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        blend[1].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT;
+        VkPipelineColorBlendStateCreateInfo cb = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+        cb.attachmentCount = fs ? 2 : 0;
+        cb.pAttachments = blend;
+        VkDynamicState dynamics[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+        VkPipelineDynamicStateCreateInfo dyn = { VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+        dyn.dynamicStateCount = 2;
+        dyn.pDynamicStates = dynamics;
+
+        VkGraphicsPipelineCreateInfo ci = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+        ci.stageCount = fs ? 2 : 1;
+        ci.pStages = stages;
+        ci.pVertexInputState = &vi;
+        ci.pInputAssemblyState = &ia;
+        ci.pViewportState = &vp;
+        ci.pRasterizationState = &rs;
+        ci.pMultisampleState = &ms;
+        ci.pDepthStencilState = &ds;
+        ci.pColorBlendState = &cb;
+        ci.pDynamicState = &dyn;
+        ci.layout = pipelineLayout;
+        ci.renderPass = fs ? renderPass : aoDepthPass;
+        VkPipeline pipeline;
+        VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &ci, nullptr, &pipeline));
+
+        vkDestroyShaderModule(device, vsModule, nullptr);
+        if (fsModule) vkDestroyShaderModule(device, fsModule, nullptr);
+        return pipeline;
+    }
+
+    void savePipelineCache()
+    {
+        size_t size = 0;
+        if (vkGetPipelineCacheData(device, pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0) return;
+        std::vector<uint8_t> data(size);
+        if (vkGetPipelineCacheData(device, pipelineCache, &size, data.data()) != VK_SUCCESS) return;
+        data.resize(size);
+        // replaced atomically: the driver only validates the header, so a torn file from a
+        // crash or two instances exiting at once must never be read back
+        std::string error;
+        if (!writeFileAtomically("vk_pipeline_cache.bin", data, &error))
+            std::cerr << "Pipeline cache not saved: " << error << "\n";
+    }
+
+    void createSkyboxMesh()
+    {
+        static const float v[] = {
+            -1, 1,-1, -1,-1,-1,  1,-1,-1,  1,-1,-1,  1, 1,-1, -1, 1,-1,
+            -1,-1, 1, -1,-1,-1, -1, 1,-1, -1, 1,-1, -1, 1, 1, -1,-1, 1,
+             1,-1,-1,  1,-1, 1,  1, 1, 1,  1, 1, 1,  1, 1,-1,  1,-1,-1,
+            -1,-1, 1, -1, 1, 1,  1, 1, 1,  1, 1, 1,  1,-1, 1, -1,-1, 1,
+            -1, 1,-1,  1, 1,-1,  1, 1, 1,  1, 1, 1, -1, 1, 1, -1, 1,-1,
+            -1,-1,-1, -1,-1, 1,  1,-1,-1,  1,-1,-1, -1,-1, 1,  1,-1, 1
+        };
+        skyboxVertices = createStaticBuffer(v, sizeof(v), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    }
+
+    // ---- resources ----
+
+    uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags props)
+    {
+        VkPhysicalDeviceMemoryProperties mem;
+        vkGetPhysicalDeviceMemoryProperties(gpu, &mem);
+        for (uint32_t i = 0; i < mem.memoryTypeCount; i++)
+            if ((typeBits & (1u << i)) && (mem.memoryTypes[i].propertyFlags & props) == props) return i;
+        std::cerr << "No suitable Vulkan memory type\n";
+        std::abort();
+    }
+
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags props, VkBuffer& buffer, VkDeviceMemory& memory)
+    {
+        VkBufferCreateInfo bi = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+        bi.size = size;
+        bi.usage = usage;
+        bi.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        VK_CHECK(vkCreateBuffer(device, &bi, nullptr, &buffer));
+        VkMemoryRequirements req;
+        vkGetBufferMemoryRequirements(device, buffer, &req);
+        VkMemoryAllocateInfo ai = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+        ai.allocationSize = req.size;
+        ai.memoryTypeIndex = findMemoryType(req.memoryTypeBits, props);
+        VK_CHECK(vkAllocateMemory(device, &ai, nullptr, &memory));
+        VK_CHECK(vkBindBufferMemory(device, buffer, memory, 0));
+    }
+
+    // static geometry goes through a staging copy into device-local memory
+    VkBuffer createStaticBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage)
+    {
+        Buffer staging, target;
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     staging.buffer, staging.memory);
+        void* mapped;
+        VK_CHECK(vkMapMemory(device, staging.memory, 0, size, 0, &mapped));
+        memcpy(mapped, data, (size_t)size);
+        vkUnmapMemory(device, staging.memory);
+        createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, target.buffer, target.memory);
+
+        VkCommandBuffer cmd = beginUpload();
+        VkBufferCopy copy = { 0, 0, size };
+        vkCmdCopyBuffer(cmd, staging.buffer, target.buffer, 1, &copy);
+        VkBufferMemoryBarrier b = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+        b.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        b.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        b.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        b.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        b.buffer = target.buffer;
+        b.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &b, 0, nullptr);
+        endUpload(cmd);
+
+        vkDestroyBuffer(device, staging.buffer, nullptr);
+        vkFreeMemory(device, staging.memory, nullptr);
+        buffers.push_back(target);
+        return target.buffer;
+    }
+
+    MeshPart uploadPart(const float* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, uint32_t texture)
+    {
+        MeshPart part;
+        part.vertices = createStaticBuffer(vertices, vertexCount * 8 * sizeof(float), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+        part.indices = createStaticBuffer(indices, indexCount * sizeof(unsigned int), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+        part.indexCount = (uint32_t)indexCount;
+        part.texture = texture;
+        return part;
+    }
+
+    Image createImage(uint32_t w, uint32_t h, uint32_t mips, uint32_t layers, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect)
+    {
+        Image img;
+        VkImageCreateInfo ci = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+        ci.flags = layers == 6 ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+        ci.imageType = VK_IMAGE_TYPE_2D;
+        ci.format = format;
+        ci.extent = { w, h, 1 };
+        ci.mipLevels = mips;
+        ci.arrayLayers = layers;
+        ci.samples = VK_SAMPLE_COUNT_1_BIT;
+        ci.tiling = VK_IMAGE_TILING_OPTIMAL;
+        ci.usage = usage;
+        ci.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VK_CHECK(vkCreateImage(device, &ci, nullptr, &img.image));
+
+        VkMemoryRequirements req;
+        vkGetImageMemoryRequirements(device, img.image, &req);
+        VkMemoryAllocateInfo ai = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+        ai.allocationSize = req.size;
+        ai.memoryTypeIndex = findMemoryType(req.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VK_CHECK(vkAllocateMemory(device, &ai, nullptr, &img.memory));
+        VK_CHECK(vkBindImageMemory(device, img.image, img.memory, 0));
+
+        VkImageViewCreateInfo vi = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+        vi.image = img.image;
+        vi.viewType = layers == 6 ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D;
+        vi.format = format;
+        vi.subresourceRange = { aspect, 0, mips, 0, layers };
+        VK_CHECK(vkCreateImageView(device, &vi, nullptr, &img.view));
+        return img;
+    }
+
+    // copies tightly packed layers into mip 0, builds the mip chain with blits
+    // and leaves the whole image in SHADER_READ_ONLY_OPTIMAL
+    void uploadImage(const Image& img, const void* pixels, size_t size, uint32_t w, uint32_t h, uint32_t mips, uint32_t layers)
+    {
+        Buffer staging;
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     staging.buffer, staging.memory);
+        void* mapped;
+        VK_CHECK(vkMapMemory(device, staging.memory, 0, size, 0, &mapped));
+        memcpy(mapped, pixels, size);
+        vkUnmapMemory(device, staging.memory);
+
+        VkCommandBuffer cmd = beginUpload();
+        imageBarrier(cmd, img.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                     0, mips, layers);
+        VkBufferImageCopy copy = {};
+        copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, layers };
+        copy.imageExtent = { w, h, 1 };
+        vkCmdCopyBufferToImage(cmd, staging.buffer, img.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+        int32_t mw = (int32_t)w, mh = (int32_t)h;
+        for (uint32_t level = 1; level < mips; level++)
+        {
+            imageBarrier(cmd, img.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                         VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, level - 1, 1, layers);
+            VkImageBlit blit = {};
+            blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, layers };
+            blit.srcOffsets[1] = { mw, mh, 1 };
+            mw = std::max(1, mw / 2);
+            mh = std::max(1, mh / 2);
+            blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, layers };
+            blit.dstOffsets[1] = { mw, mh, 1 };
+            vkCmdBlitImage(cmd, img.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, img.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           1, &blit, VK_FILTER_LINEAR);
+            imageBarrier(cmd, img.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                         VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, level - 1, 1, layers);
+        }
+        imageBarrier(cmd, img.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, mips - 1, 1, layers);
+        endUpload(cmd);
+
+        vkDestroyBuffer(device, staging.buffer, nullptr);
+        vkFreeMemory(device, staging.memory, nullptr);
+    }
+
+    // every mip given, tightly packed one after the other (all layers of a mip together),
+    // each half the size of the one before; leaves the image in SHADER_READ_ONLY_OPTIMAL
+    void uploadMipLevels(const Image& img, const void* pixels, uint32_t size, uint32_t mips, uint32_t layers, uint32_t texelBytes)
+    {
+        std::vector<VkBufferImageCopy> copies(mips);
+        VkDeviceSize offset = 0;
+        for (uint32_t level = 0; level < mips; level++)
+        {
+            uint32_t s = std::max(1u, size >> level);
+            copies[level] = {};
+            copies[level].bufferOffset = offset;
+            copies[level].imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, layers };
+            copies[level].imageExtent = { s, s, 1 };
+            offset += (VkDeviceSize)s * s * layers * texelBytes;
+        }
+
+        Buffer staging;
+        createBuffer(offset, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     staging.buffer, staging.memory);
+        void* mapped;
+        VK_CHECK(vkMapMemory(device, staging.memory, 0, offset, 0, &mapped));
+        memcpy(mapped, pixels, (size_t)offset);
+        vkUnmapMemory(device, staging.memory);
+
+        VkCommandBuffer cmd = beginUpload();
+        imageBarrier(cmd, img.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                     0, mips, layers);
+        vkCmdCopyBufferToImage(cmd, staging.buffer, img.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mips, copies.data());
+        imageBarrier(cmd, img.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, mips, layers);
+        endUpload(cmd);
+
+        vkDestroyBuffer(device, staging.buffer, nullptr);
+        vkFreeMemory(device, staging.memory, nullptr);
+    }
+
+    unsigned int registerTexture(const Image& img)
+    {
+        if (textureCount + 1 >= MAX_TEXTURES) { std::cout << "Vulkan texture array full\n"; return 0; }
+        images.push_back(img);
+        // index 0 stays unused so that 0 keeps meaning "no texture" in DrawItem
+        uint32_t index = ++textureCount;
+
+        VkDescriptorImageInfo info = { repeatSampler, img.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        VkWriteDescriptorSet write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        write.dstSet = textureSet;
+        write.dstBinding = 0;
+        write.dstArrayElement = index;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &info;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+        return index;
+    }
+
+    unsigned int loadTextureFile(const std::string& path, bool flip)
+    {
+        stbi_set_flip_vertically_on_load(flip);
+        int w, h, n;
+        unsigned char* data = stbi_load(path.c_str(), &w, &h, &n, 4);
+        if (!data)
+        {
+            std::cout << "Failed to load texture at path: " << path << std::endl;
+            return whiteTexture();
+        }
+        uint32_t mips = 1;
+        while ((std::max(w, h) >> mips) > 0) mips++;
+        Image img = createImage((uint32_t)w, (uint32_t)h, mips, 1, VK_FORMAT_R8G8B8A8_UNORM,
+                                VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                VK_IMAGE_ASPECT_COLOR_BIT);
+        uploadImage(img, data, (size_t)w * h * 4, (uint32_t)w, (uint32_t)h, mips, 1);
+        stbi_image_free(data);
+        return registerTexture(img);
+    }
+
+    unsigned int whiteTexture()
+    {
+        if (whiteTextureIndex < 0)
+        {
+            const uint32_t white = 0xffffffffu;
+            Image img = createImage(1, 1, 1, 1, VK_FORMAT_R8G8B8A8_UNORM,
+                                    VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+            uploadImage(img, &white, 4, 1, 1, 1, 1);
+            whiteTextureIndex = (int)registerTexture(img);
+        }
+        return (unsigned int)whiteTextureIndex;
+    }
+
+    VkCommandBuffer beginUpload()
+    {
+        VkCommandBufferAllocateInfo ai = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+        ai.commandPool = uploadPool;
+        ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        ai.commandBufferCount = 1;
+        VkCommandBuffer cmd;
+        VK_CHECK(vkAllocateCommandBuffers(device, &ai, &cmd));
+        VkCommandBufferBeginInfo bi = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK(vkBeginCommandBuffer(cmd, &bi));
+        return cmd;
+    }
+
+    // uploads happen at load time, so a blocking wait keeps the staging lifetime trivial
+    void endUpload(VkCommandBuffer cmd)
+    {
+        VK_CHECK(vkEndCommandBuffer(cmd));
+        VkSubmitInfo si = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        si.commandBufferCount = 1;
+        si.pCommandBuffers = &cmd;
+        VK_CHECK(vkQueueSubmit(queue, 1, &si, VK_NULL_HANDLE));
+        VK_CHECK(vkQueueWaitIdle(queue));
+        vkFreeCommandBuffers(device, uploadPool, 1, &cmd);
+    }
+};
+
+#endif
@@ -0,0 +1,783 @@
+#ifndef ROADS_H
+#define ROADS_H
+
+// Road network: Hermite spline segments between nodes, meshed procedurally into road
+// surface, kerbs and barriers that drape over the ground.
+//
+// The world is cut into square chunks. Each segment is sampled at sampleSpacing along
+// its curve and every interval belongs to the chunk that contains its midpoint, so a
+// chunk's geometry depends only on the segments that pass through it. Chunks are built
+// as jobs on the job system from a snapshot of those segments; the main thread uploads
+// finished chunks a few per frame, nearest first (like world_stream.h).
+//
+// Every chunk build is cached on disk (cacheDir/<x>_<z>.bin) under a key hashed from
+// everything it was made from: the generator version, the road profile, the ground
+// settings and the chunk's segments. A matching file is read back instead of meshing;
+// any change makes the key differ and the chunk is rebuilt and the file replaced.
+//
+// Barriers are static colliders: each chunk owns a small BVH of barrier boxes (one per
+// interval and side), so editing a node or a segment rebuilds only the chunks its old
+// and new curves touch, and the rest of the network (and its colliders) stays as it is.
+// Collision queries wait for any chunk they touch that is still building, so what the
+// physics sees never depends on build timing (deterministic replays stay exact).
+//
+// Barrier boxes are axis-aligned (the BVH's primitive); intervals are short so a
+// diagonal barrier's box stays close to the barrier. A box belongs to the chunk of its
+// interval's midpoint but reaches reach() sideways and half the interval along the road,
+// so queries look into the chunks within reach() plus the longest interval of any
+// segment (Hermite steps are not equal in length, so that is measured, not
+// sampleSpacing). Kerbs and barriers stop short of junctions so side roads can be
+// entered; at a junction the main road's surface sits a little above the branch's.
+
+#include <glm/glm.hpp>
+
+#include "bvh.h"
+#include "deterministic.h"
+#include "file_io.h"
+#include "heightfield.h"
+#include "jobs.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct RoadProfile
+{
+    float width = 8.0f;             // road surface, kerb to kerb
+    float kerbWidth = 0.4f;
+    float kerbHeight = 0.15f;
+    float barrierOffset = 1.5f;     // verge between kerb and barrier
+    float barrierHeight = 1.0f;
+    float barrierThickness = 0.3f;
+    float sampleSpacing = 2.0f;     // interval length along the centreline
+    float lift = 0.06f;             // surface above the ground
+};
+
+struct RoadConfig
+{
+    float chunkSize = 64.0f;
+    std::string cacheDir = "road_cache";    // empty: no disk cache
+    unsigned int maxUploadsPerFrame = 4;
+    RoadProfile profile;
+};
+
+struct RoadStats
+{
+    size_t chunks = 0, building = 0, colliders = 0;
+    uint64_t built = 0, cacheHits = 0, cacheWrites = 0, uploads = 0;
+    double buildMs = 0.0;           // total worker time spent meshing (cache misses)
+    double loadMs = 0.0;            // total worker time spent reading cache files
+};
+
+class RoadNetwork
+{
+public:
+    static const uint32_t GENERATOR_VERSION = 1;    // bump when meshing changes: invalidates cached chunks
+
+    struct Segment
+    {
+        uint32_t from, to;
+        glm::vec3 tangentFrom, tangentTo;   // Hermite tangents (y ignored)
+        uint32_t rank;                      // 0: main road, higher: branches (drawn under at junctions)
+    };
+
+    // ground == nullptr: level at y = 0. renderer may be null (benchmarks)
+    RoadNetwork(Renderer* renderer, const Heightfield* ground, const RoadConfig& config = RoadConfig())
+        : renderer(renderer), ground(ground), config(config) {}
+
+    ~RoadNetwork()
+    {
+        jobSystem().wait(inFlight);
+        for (auto& kv : chunks) releaseMeshes(*kv.second);
+    }
+
+    RoadNetwork(const RoadNetwork&) = delete;
+    RoadNetwork& operator=(const RoadNetwork&) = delete;
+
+    // ---- editing (main thread); changes take effect through the chunks they touch ----
+
+    uint32_t addNode(const glm::vec3& position)
+    {
+        nodes.push_back(glm::vec3(position.x, 0.0f, position.z));
+        degree.push_back(0);
+        return (uint32_t)nodes.size() - 1;
+    }
+
+    uint32_t addSegment(uint32_t from, uint32_t to, const glm::vec3& tangentFrom, const glm::vec3& tangentTo, uint32_t rank = 0)
+    {
+        segments.push_back({ from, to, tangentFrom, tangentTo, rank });
+        segmentChunks.emplace_back();
+        segmentLongest.push_back(0.0f);
+        degree[from]++;
+        degree[to]++;
+        uint32_t s = (uint32_t)segments.size() - 1;
+        // a new junction changes where kerbs stop on the segments already there
+        remesh(segmentsAt(from, to));
+        return s;
+    }
+
+    void moveNode(uint32_t node, const glm::vec3& position)
+    {
+        nodes[node] = glm::vec3(position.x, 0.0f, position.z);
+        remesh(segmentsAt(node, node));
+    }
+
+    void setTangents(uint32_t segment, const glm::vec3& tangentFrom, const glm::vec3& tangentTo)
+    {
+        segments[segment].tangentFrom = tangentFrom;
+        segments[segment].tangentTo = tangentTo;
+        remesh({ segment });
+    }
+
+    // ---- per frame ----
+
+    // uploads finished chunks, nearest to `focus` first
+    void update(const glm::vec3& focus)
+    {
+        flush();
+        if (jobSystem().threadCount() == 1)
+            for (unsigned int k = 0; k < config.maxUploadsPerFrame && jobSystem().runPending(); k++) {}
+
+        std::vector<Chunk*> built;
+        for (auto& kv : chunks)
+            if (kv.second->state.load(std::memory_order_acquire) == Built) built.push_back(kv.second.get());
+        auto distance = [&](const Chunk* c) { return glm::length(glm::vec3(c->center.x - focus.x, 0.0f, c->center.z - focus.z)); };
+        std::sort(built.begin(), built.end(), [&](Chunk* a, Chunk* b) { return distance(a) < distance(b); });
+        for (size_t k = 0; k < built.size() && k < config.maxUploadsPerFrame; k++) upload(*built[k]);
+    }
+
+    void draw(std::vector<DrawItem>& list, unsigned int texture) const
+    {
+        for (const auto& kv : chunks)
+        {
+            const Chunk& c = *kv.second;
+            unsigned int mesh = c.mesh != NO_MESH ? c.mesh : c.staleMesh;   // keep showing the old build until the new one is up
+            if (mesh != NO_MESH) list.push_back({ mesh, Material::Floor, glm::mat4(1.0f), texture });
+        }
+    }
+
+    // blocks until every chunk is built (benchmarks, tools)
+    void finish()
+    {
+        flush();
+        jobSystem().wait(inFlight);
+    }
+
+    // ---- collision: barrier colliders of the chunks the query touches ----
+
+    // same contract as StaticBVH::sweep (hit.prim indexes the hit chunk's own colliders)
+    bool sweep(const glm::vec3& center, const glm::vec3& halfExtents, const glm::vec3& delta, BVHRayHit& hit)
+    {
+        glm::vec3 lo = glm::min(center, center + delta) - halfExtents, hi = glm::max(center, center + delta) + halfExtents;
+        bool any = false;
+        forChunksOverlapping(lo, hi, [&](Chunk& c) {
+            BVHRayHit h;
+            if (c.colliders.sweep(center, halfExtents, delta, h) && (!any || h.t < hit.t)) { hit = h; any = true; }
+        });
+        return any;
+    }
+
+    // same contract as StaticBVH::sphereCast
+    bool sphereCast(const glm::vec3& origin, const glm::vec3& dir, float maxT, float radius, BVHRayHit& hit)
+    {
+        glm::vec3 end = origin + dir * maxT;
+        bool any = false;
+        forChunksOverlapping(glm::min(origin, end) - glm::vec3(radius), glm::max(origin, end) + glm::vec3(radius), [&](Chunk& c) {
+            BVHRayHit h;
+            if (c.colliders.sphereCast(origin, dir, any ? hit.t : maxT, radius, h)) { hit = h; any = true; }
+        });
+        return any;
+    }
+
+    void overlap(const glm::vec3& qmin, const glm::vec3& qmax, std::vector<BVHBox>& boxes)
+    {
+        boxes.clear();
+        forChunksOverlapping(qmin, qmax, [&](Chunk& c) {
+            c.colliders.visitOverlap(qmin, qmax, [&](unsigned int p) { boxes.push_back(c.colliders.primitive(p)); return true; });
+        });
+    }
+
+    // ---- queries ----
+
+    size_t nodeCount() const { return nodes.size(); }
+    size_t segmentCount() const { return segments.size(); }
+    const glm::vec3& node(uint32_t i) const { return nodes[i]; }
+    const Segment& segment(uint32_t i) const { return segments[i]; }
+    const RoadConfig& settings() const { return config; }
+
+    // centreline point at parameter t in [0, 1], on the ground
+    glm::vec3 pointOn(uint32_t segment, float t) const
+    {
+        glm::vec3 p = curveOf(segment).point(t);
+        p.y = groundHeight(p.x, p.z);
+        return p;
+    }
+
+    const RoadStats& stats()
+    {
+        counters.chunks = chunks.size();
+        counters.built = builtCount;
+        counters.cacheHits = hitCount;
+        counters.cacheWrites = writeCount;
+        counters.buildMs = buildMicros * 1e-3;
+        counters.loadMs = loadMicros * 1e-3;
+        counters.building = counters.colliders = 0;
+        for (auto& kv : chunks)
+        {
+            if (kv.second->state.load(std::memory_order_acquire) == Building) counters.building++;
+            else counters.colliders += kv.second->colliders.primitiveCount();
+        }
+        return counters;
+    }
+
+    void printStats(std::ostream& out)
+    {
+        const RoadStats& s = stats();
+        out << "roads: " << nodes.size() << " nodes, " << segments.size() << " segments in " << s.chunks << " chunks ("
+            << s.building << " building), " << s.colliders << " barrier colliders\n"
+            << "  " << s.built << " chunk builds: " << s.cacheHits << " from cache (" << s.loadMs << " ms), "
+            << s.built - s.cacheHits << " meshed (" << s.buildMs << " ms), " << s.cacheWrites << " cache writes\n";
+    }
+
+private:
+    static const unsigned int NO_MESH = ~0u;
+    static constexpr const char* CACHE_MAGIC = "RDC1";
+    enum State { Building, Built, Uploaded };
+
+    // a segment as the mesher sees it: everything a chunk build reads, copied so edits
+    // can't race with builds in flight
+    struct Curve
+    {
+        glm::vec3 p0, p1, t0, t1;
+        float lift;
+        float clear0, clear1;       // no kerbs or barriers this far from each end (junctions)
+        uint32_t intervals;
+        float length;
+
+        glm::vec3 point(float t) const
+        {
+            float t2 = t * t, t3 = t2 * t;
+            return p0 * (2 * t3 - 3 * t2 + 1) + t0 * (t3 - 2 * t2 + t) + p1 * (-2 * t3 + 3 * t2) + t1 * (t3 - t2);
+        }
+        glm::vec3 tangent(float t) const
+        {
+            float t2 = t * t;
+            return p0 * (6 * t2 - 6 * t) + t0 * (3 * t2 - 4 * t + 1) + p1 * (-6 * t2 + 6 * t) + t1 * (3 * t2 - 2 * t);
+        }
+    };
+
+    struct ChunkCoord { int x, z; };
+
+    struct Chunk
+    {
+        ChunkCoord coord;
+        glm::vec3 center;
+        std::atomic<int> state{ Building };
+        std::vector<Curve> curves;
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+        std::vector<BVHBox> boxes;
+        StaticBVH colliders;
+        unsigned int mesh = NO_MESH, staleMesh = NO_MESH;
+    };
+
+    Renderer* renderer;
+    const Heightfield* ground;
+    RoadConfig config;
+    std::vector<glm::vec3> nodes;
+    std::vector<uint32_t> degree;
+    std::vector<Segment> segments;
+    std::vector<std::vector<uint64_t>> segmentChunks;   // chunks each segment's intervals fall in
+    std::vector<float> segmentLongest;                  // each segment's longest interval in xz
+    float longestInterval = 0.0f;                       // of all segments; widens collision queries
+    std::unordered_map<uint64_t, std::shared_ptr<Chunk>> chunks;
+    std::vector<uint64_t> dirty;                        // chunks to rebuild at the next flush()
+    JobCounter inFlight;
+    RoadStats counters;
+    std::atomic<uint64_t> builtCount{ 0 }, hitCount{ 0 }, writeCount{ 0 };
+    std::atomic<int64_t> buildMicros{ 0 }, loadMicros{ 0 };
+
+    static uint64_t key(ChunkCoord c) { return ((uint64_t)(uint32_t)c.x << 32) | (uint32_t)c.z; }
+    static ChunkCoord coordOf(uint64_t k) { return { (int)(uint32_t)(k >> 32), (int)(uint32_t)k }; }
+
+    ChunkCoord chunkAt(const glm::vec3& p) const
+    {
+        return { (int)std::floor(p.x / config.chunkSize), (int)std::floor(p.z / config.chunkSize) };
+    }
+
+    float groundHeight(float x, float z) const { return ground ? ground->height(x, z) : 0.0f; }
+
+    // how far barriers reach sideways from the centreline (chunk bounds grow by this)
+    float reach() const
+    {
+        const RoadProfile& p = config.profile;
+        return 0.5f * p.width + p.kerbWidth + p.barrierOffset + p.barrierThickness;
+    }
+
+    std::vector<uint32_t> segmentsAt(uint32_t a, uint32_t b) const
+    {
+        std::vector<uint32_t> out;
+        for (uint32_t s = 0; s < segments.size(); s++)
+            if (segments[s].from == a || segments[s].to == a || segments[s].from == b || segments[s].to == b) out.push_back(s);
+        return out;
+    }
+
+    Curve curveOf(uint32_t s) const
+    {
+        const Segment& seg = segments[s];
+        Curve c;
+        c.p0 = nodes[seg.from];
+        c.p1 = nodes[seg.to];
+        c.t0 = glm::vec3(seg.tangentFrom.x, 0.0f, seg.tangentFrom.z);
+        c.t1 = glm::vec3(seg.tangentTo.x, 0.0f, seg.tangentTo.z);
+        c.lift = config.profile.lift - 0.02f * (float)seg.rank;
+        float junction = config.profile.width * 0.5f + reach();
+        c.clear0 = degree[seg.from] > 2 ? junction : 0.0f;
+        c.clear1 = degree[seg.to] > 2 ? junction : 0.0f;
+        c.length = 0.0f;
+        glm::vec3 prev = c.p0;
+        for (int k = 1; k <= 32; k++)
+        {
+            glm::vec3 p = c.point(k / 32.0f);
+            c.length += glm::length(p - prev);
+            prev = p;
+        }
+        c.intervals = std::max(1u, (uint32_t)std::ceil(c.length / config.profile.sampleSpacing));
+        return c;
+    }
+
+    // the longest chord of the curve's intervals in xz
+    static float longestOf(const Curve& c)
+    {
+        float longest = 0.0f;
+        glm::vec3 prev = c.point(0.0f);
+        for (uint32_t i = 1; i <= c.intervals; i++)
+        {
+            glm::vec3 p = c.point((float)i / c.intervals);
+            longest = std::max(longest, glm::length(glm::vec3(p.x - prev.x, 0.0f, p.z - prev.z)));
+            prev = p;
+        }
+        return longest;
+    }
+
+    std::vector<uint64_t> chunksOf(const Curve& c) const
+    {
+        std::vector<uint64_t> out;
+        for (uint32_t i = 0; i < c.intervals; i++)
+        {
+            uint64_t k = key(chunkAt(c.point((i + 0.5f) / c.intervals)));
+            if (std::find(out.begin(), out.end(), k) == out.end()) out.push_back(k);
+        }
+        return out;
+    }
+
+    // re-derives the chunks of these segments and marks every chunk that gained or lost
+    // one of them; all other chunks are left alone
+    void remesh(const std::vector<uint32_t>& changed)
+    {
+        for (uint32_t s : changed)
+        {
+            dirty.insert(dirty.end(), segmentChunks[s].begin(), segmentChunks[s].end());
+            Curve curve = curveOf(s);
+            segmentChunks[s] = chunksOf(curve);
+            segmentLongest[s] = longestOf(curve);
+            dirty.insert(dirty.end(), segmentChunks[s].begin(), segmentChunks[s].end());
+        }
+        longestInterval = segmentLongest.empty() ? 0.0f : *std::max_element(segmentLongest.begin(), segmentLongest.end());
+    }
+
+    // edits only mark chunks; the builds start here, once per chunk however many edits touched it
+    void flush()
+    {
+        std::sort(dirty.begin(), dirty.end());
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+        for (uint64_t k : dirty) request(k);
+        dirty.clear();
+    }
+
+    void request(uint64_t k)
+    {
+        std::shared_ptr<Chunk> chunk(new Chunk());
+        chunk->coord = coordOf(k);
+        chunk->center = glm::vec3((chunk->coord.x + 0.5f) * config.chunkSize, 0.0f, (chunk->coord.z + 0.5f) * config.chunkSize);
+        for (uint32_t s = 0; s < segments.size(); s++)
+            if (std::find(segmentChunks[s].begin(), segmentChunks[s].end(), k) != segmentChunks[s].end())
+                chunk->curves.push_back(curveOf(s));
+
+        auto old = chunks.find(k);
+        if (old != chunks.end())
+        {
+            // the replaced build keeps drawing until this one is uploaded
+            Chunk& prev = *old->second;
+            chunk->staleMesh = prev.mesh != NO_MESH ? prev.mesh : prev.staleMesh;
+            prev.mesh = prev.staleMesh = NO_MESH;
+            chunks.erase(old);
+        }
+        if (chunk->curves.empty())
+        {
+            if (chunk->staleMesh != NO_MESH && renderer) renderer->destroyMesh(chunk->staleMesh);
+            return;
+        }
+        chunks[k] = chunk;
+        jobSystem().run([this, chunk]() {
+            if (!loadCached(*chunk)) { build(*chunk); saveCached(*chunk); }
+            chunk->colliders.build(chunk->boxes, 1);
+            builtCount++;
+            chunk->state.store(Built, std::memory_order_release);
+        }, &inFlight);
+    }
+
+    template <typename Visit>
+    void forChunksOverlapping(const glm::vec3& lo, const glm::vec3& hi, Visit visit)
+    {
+        flush();
+        // a chunk's boxes reach past its square by reach() and up to half an interval
+        float r = reach() + longestInterval;
+        ChunkCoord a = chunkAt(lo - glm::vec3(r)), b = chunkAt(hi + glm::vec3(r));
+        for (int z = a.z; z <= b.z; z++)
+            for (int x = a.x; x <= b.x; x++)
+            {
+                auto it = chunks.find(key({ x, z }));
+                if (it == chunks.end()) continue;
+                Chunk& c = *it->second;
+                while (c.state.load(std::memory_order_acquire) == Building)
+                    if (!jobSystem().runPending()) std::this_thread::yield();
+                visit(c);
+            }
+    }
+
+    void upload(Chunk& c)
+    {
+        if (renderer)
+        {
+            if (c.staleMesh != NO_MESH) renderer->destroyMesh(c.staleMesh);
+            c.mesh = renderer->createMesh(c.vertices.data(), c.vertices.size() / 8, c.indices.data(), c.indices.size());
+        }
+        c.staleMesh = NO_MESH;
+        c.state.store(Uploaded, std::memory_order_release);
+        counters.uploads++;
+    }
+
+    void releaseMeshes(Chunk& c)
+    {
+        if (!renderer) return;
+        if (c.mesh != NO_MESH) renderer->destroyMesh(c.mesh);
+        if (c.staleMesh != NO_MESH) renderer->destroyMesh(c.staleMesh);
+        c.mesh = c.staleMesh = NO_MESH;
+    }
+
+    // ---- meshing (worker threads) ----
+
+    void build(Chunk& c)
+    {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        const RoadProfile& p = config.profile;
+        std::vector<float> px, pz, offset;   // vertex positions before draping, height above ground
+        std::vector<float> attrs;            // normal + uv per vertex
+
+        // corners: start of the interval, end, then back across; u runs across, v along
+        auto quad = [&](const glm::vec3 corner[4], const float up[4], const glm::vec3& normal, float u0, float u1, float v0, float v1) {
+            unsigned int base = (unsigned int)px.size();
+            float us[4] = { u0, u0, u1, u1 }, vs[4] = { v0, v1, v1, v0 };
+            for (int k = 0; k < 4; k++)
+            {
+                px.push_back(corner[k].x);
+                pz.push_back(corner[k].z);
+                offset.push_back(up[k]);
+                float a[5] = { normal.x, normal.y, normal.z, us[k], vs[k] };
+                attrs.insert(attrs.end(), a, a + 5);
+            }
+            unsigned int tri[6] = { base, base + 1, base + 2, base + 2, base + 3, base };
+            c.indices.insert(c.indices.end(), tri, tri + 6);
+        };
+
+        const float half = 0.5f * p.width, kerbOut = half + p.kerbWidth;
+        const float barrierIn = kerbOut + p.barrierOffset, barrierOut = barrierIn + p.barrierThickness;
+        const float sink = 0.3f;   // barriers start below the ground so slopes show no gap
+        std::vector<std::pair<glm::vec3, glm::vec3>> barrierFeet;   // (inner, outer) corner pairs for colliders
+        for (const Curve& curve : c.curves)
+        {
+            for (uint32_t i = 0; i < curve.intervals; i++)
+            {
+                float s0 = (float)i / curve.intervals, s1 = (float)(i + 1) / curve.intervals;
+                glm::vec3 a = curve.point(s0), b = curve.point(s1);
+                ChunkCoord owner = chunkAt((a + b) * 0.5f);
+                if (owner.x != c.coord.x || owner.z != c.coord.z) continue;
+
+                glm::vec3 ta = curve.tangent(s0), tb = curve.tangent(s1);
+                glm::vec3 ra = glm::normalize(glm::vec3(ta.z, 0.0f, -ta.x)), rb = glm::normalize(glm::vec3(tb.z, 0.0f, -tb.x));
+                float v0 = s0 * curve.length / p.width, v1 = s1 * curve.length / p.width;
+                float along = (s0 + s1) * 0.5f * curve.length;
+                bool sides = along > curve.clear0 && curve.length - along > curve.clear1;
+
+                // surface
+                {
+                    glm::vec3 q[4] = { a - ra * half, b - rb * half, b + rb * half, a + ra * half };
+                    float up[4] = { curve.lift, curve.lift, curve.lift, curve.lift };
+                    quad(q, up, glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, 1.0f, v0, v1);
+                }
+                if (!sides) continue;
+
+                for (float side : { -1.0f, 1.0f })
+                {
+                    glm::vec3 sa = ra * side, sb = rb * side;
+                    // kerb: inner face and top
+                    {
+                        glm::vec3 q[4] = { a + sa * half, b + sb * half, b + sb * half, a + sa * half };
+                        float up[4] = { curve.lift, curve.lift, p.kerbHeight, p.kerbHeight };
+                        quad(q, up, -sa, 0.0f, 0.05f, v0, v1);
+                        glm::vec3 t[4] = { a + sa * half, b + sb * half, b + sb * kerbOut, a + sa * kerbOut };
+                        float top[4] = { p.kerbHeight, p.kerbHeight, p.kerbHeight, p.kerbHeight };
+                        quad(t, top, glm::vec3(0.0f, 1.0f, 0.0f), 0.05f, 0.1f, v0, v1);
+                    }
+                    // barrier: inner face, outer face, top
+                    {
+                        glm::vec3 qi[4] = { a + sa * barrierIn, b + sb * barrierIn, b + sb * barrierIn, a + sa * barrierIn };
+                        float face[4] = { -sink, -sink, p.barrierHeight, p.barrierHeight };
+                        quad(qi, face, -sa, 0.0f, 0.2f, v0, v1);
+                        glm::vec3 qo[4] = { a + sa * barrierOut, b + sb * barrierOut, b + sb * barrierOut, a + sa * barrierOut };
+                        quad(qo, face, sa, 0.0f, 0.2f, v0, v1);
+                        glm::vec3 qt[4] = { a + sa * barrierIn, b + sb * barrierIn, b + sb * barrierOut, a + sa * barrierOut };
+                        float top[4] = { p.barrierHeight, p.barrierHeight, p.barrierHeight, p.barrierHeight };
+                        quad(qt, top, glm::vec3(0.0f, 1.0f, 0.0f), 0.2f, 0.25f, v0, v1);
+                    }
+                    barrierFeet.push_back({ a + sa * barrierIn, a + sa * barrierOut });
+                    barrierFeet.push_back({ b + sb * barrierIn, b + sb * barrierOut });
+                }
+            }
+        }
+
+        // drape: one batched ground query for every vertex
+        std::vector<float> height(px.size(), 0.0f);
+        if (ground && !px.empty()) ground->query({ px.data(), pz.data(), height.data() }, px.size());
+        c.vertices.resize(px.size() * 8);
+        for (size_t v = 0; v < px.size(); v++)
+        {
+            float* out = &c.vertices[v * 8];
+            out[0] = px[v];
+            out[1] = height[v] + offset[v];
+            out[2] = pz[v];
+            std::copy(&attrs[v * 5], &attrs[v * 5] + 5, out + 3);
+        }
+
+        // one box per barrier interval: its four foot corners, from below the ground to the top
+        for (size_t k = 0; k + 1 < barrierFeet.size(); k += 2)
+        {
+            glm::vec3 corners[4] = { barrierFeet[k].first, barrierFeet[k].second, barrierFeet[k + 1].first, barrierFeet[k + 1].second };
+            BVHBox box = { glm::vec3(1e30f), glm::vec3(-1e30f) };
+            for (const glm::vec3& q : corners)
+            {
+                float h = groundHeight(q.x, q.z);
+                box.min = glm::min(box.min, glm::vec3(q.x, h - sink, q.z));
+                box.max = glm::max(box.max, glm::vec3(q.x, h + p.barrierHeight, q.z));
+            }
+            c.boxes.push_back(box);
+        }
+        buildMicros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - t0).count();
+    }
+
+    // ---- disk cache (worker threads) ----
+
+    uint64_t cacheKey(const Chunk& c) const
+    {
+        StateHash h;
+        h.add(GENERATOR_VERSION);
+        h.add((uint32_t)c.coord.x);
+        h.add((uint32_t)c.coord.z);
+        h.add(config.chunkSize);
+        const RoadProfile& p = config.profile;
+        for (float f : { p.width, p.kerbWidth, p.kerbHeight, p.barrierOffset, p.barrierHeight, p.barrierThickness, p.sampleSpacing, p.lift }) h.add(f);
+        if (ground)
+        {
+            const HeightfieldConfig& g = ground->settings();
+            h.add((uint32_t)g.sizeLog2);
+            h.add(g.seed);
+            for (float f : { g.spacing, g.amplitude, g.flatRadius, g.flatBlend }) h.add(f);
+        }
+        for (const Curve& curve : c.curves)
+        {
+            for (const glm::vec3* v : { &curve.p0, &curve.p1, &curve.t0, &curve.t1 }) h.add(*v);
+            for (float f : { curve.lift, curve.clear0, curve.clear1, curve.length }) h.add(f);
+            h.add(curve.intervals);
+        }
+        return h.value;
+    }
+
+    std::string cachePath(const Chunk& c) const
+    {
+        return config.cacheDir + "/" + std::to_string(c.coord.x) + "_" + std::to_string(c.coord.z) + ".bin";
+    }
+
+    bool loadCached(Chunk& c)
+    {
+        if (config.cacheDir.empty()) return false;
+        auto t0 = std::chrono::high_resolution_clock::now();
+        std::ifstream in(cachePath(c), std::ios::binary);
+        char magic[4];
+        uint64_t fileKey = 0;
+        uint32_t sizes[3] = {};
+        if (!in.read(magic, 4) || std::memcmp(magic, CACHE_MAGIC, 4) != 0) return false;
+        if (!in.read((char*)&fileKey, sizeof(fileKey)) || fileKey != cacheKey(c)) return false;
+        if (!in.read((char*)sizes, sizeof(sizes))) return false;
+        // the sizes must account for exactly the rest of the file before anything is allocated
+        std::streamoff header = in.tellg();
+        in.seekg(0, std::ios::end);
+        std::streamoff rest = in.tellg() - header;
+        in.seekg(header);
+        uint64_t expected = (uint64_t)sizes[0] * sizeof(float) + (uint64_t)sizes[1] * sizeof(unsigned int) + (uint64_t)sizes[2] * sizeof(BVHBox);
+        if (!in || rest < 0 || expected != (uint64_t)rest) return false;
+        c.vertices.resize(sizes[0]);
+        c.indices.resize(sizes[1]);
+        c.boxes.resize(sizes[2]);
+        in.read((char*)c.vertices.data(), (std::streamsize)(c.vertices.size() * sizeof(float)));
+        in.read((char*)c.indices.data(), (std::streamsize)(c.indices.size() * sizeof(unsigned int)));
+        in.read((char*)c.boxes.data(), (std::streamsize)(c.boxes.size() * sizeof(BVHBox)));
+        if (!in)
+        {
+            c.vertices.clear();
+            c.indices.clear();
+            c.boxes.clear();
+            return false;
+        }
+        hitCount++;
+        loadMicros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - t0).count();
+        return true;
+    }
+
+    // replaced atomically (file_io.h); a chunk can be rebuilt while an older build of it is
+    // still writing, and each write has its own temporary file
+    void saveCached(const Chunk& c)
+    {
+        if (config.cacheDir.empty()) return;
+        std::error_code ec;
+        std::filesystem::create_directories(config.cacheDir, ec);
+        uint64_t k = cacheKey(c);
+        uint32_t sizes[3] = { (uint32_t)c.vertices.size(), (uint32_t)c.indices.size(), (uint32_t)c.boxes.size() };
+        std::vector<uint8_t> bytes;
+        bytes.reserve(4 + sizeof(k) + sizeof(sizes) + c.vertices.size() * sizeof(float) + c.indices.size() * sizeof(unsigned int) + c.boxes.size() * sizeof(BVHBox));
+        appendBytes(bytes, CACHE_MAGIC, 4);
+        appendBytes(bytes, &k, sizeof(k));
+        appendBytes(bytes, sizes, sizeof(sizes));
+        appendBytes(bytes, c.vertices.data(), c.vertices.size() * sizeof(float));
+        appendBytes(bytes, c.indices.data(), c.indices.size() * sizeof(unsigned int));
+        appendBytes(bytes, c.boxes.data(), c.boxes.size() * sizeof(BVHBox));
+        if (writeFileAtomically(cachePath(c), bytes)) writeCount++;
+    }
+};
+
+// ---- procedural layout ----
+// A closed main road around the arena with a wobbling radius, and branches that leave
+// from every other ring node and wander outwards. Node tangents are Catmull-Rom, so the
+// road is smooth through every node. Only integer hashing and table trig are used, so
+// the layout is the same on every machine.
+inline void generateRoads(RoadNetwork& roads, uint32_t seed, float ringRadius = 72.0f)
+{
+    uint32_t state = seed * 0x9e3779b9u + 0x7f4a7c15u;
+    auto random = [&state]() {   // xorshift32 -> [0, 1)
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (float)(state >> 8) * (1.0f / 16777216.0f);
+    };
+
+    const int RING_NODES = 12, BRANCH_NODES = 5;
+    const float BRANCH_STEP = 70.0f;
+    std::vector<glm::vec3> ring(RING_NODES);
+    for (int i = 0; i < RING_NODES; i++)
+    {
+        float a = 6.2831853f * i / RING_NODES;
+        float r = ringRadius * (0.92f + 0.16f * random());
+        ring[i] = glm::vec3(tableCos(a) * r, 0.0f, tableSin(a) * r);
+    }
+    std::vector<uint32_t> ringNode(RING_NODES);
+    for (int i = 0; i < RING_NODES; i++) ringNode[i] = roads.addNode(ring[i]);
+    auto ringTangent = [&](int i) { return (ring[(i + 1) % RING_NODES] - ring[(i + RING_NODES - 1) % RING_NODES]) * 0.5f; };
+    for (int i = 0; i < RING_NODES; i++)
+        roads.addSegment(ringNode[i], ringNode[(i + 1) % RING_NODES], ringTangent(i), ringTangent((i + 1) % RING_NODES));
+
+    for (int i = 0; i < RING_NODES; i += 2)
+    {
+        std::vector<glm::vec3> path = { ring[i] };
+        float heading = tableAtan2(ring[i].z, ring[i].x);
+        for (int k = 0; k < BRANCH_NODES; k++)
+        {
+            heading += (random() - 0.5f) * 0.8f;
+            path.push_back(path.back() + glm::vec3(tableCos(heading), 0.0f, tableSin(heading)) * BRANCH_STEP);
+        }
+        std::vector<uint32_t> ids = { ringNode[i] };
+        for (size_t k = 1; k < path.size(); k++) ids.push_back(roads.addNode(path[k]));
+        auto tangent = [&](size_t k) {
+            if (k == 0) return glm::normalize(path[1] - path[0]) * BRANCH_STEP;   // leave the ring straight out
+            if (k + 1 == path.size()) return path[k] - path[k - 1];
+            return (path[k + 1] - path[k - 1]) * 0.5f;
+        };
+        for (size_t k = 0; k + 1 < path.size(); k++) roads.addSegment(ids[k], ids[k + 1], tangent(k), tangent(k + 1), 1);
+    }
+}
+
+// ---- benchmark: building the network cold, from the cache, and after one edit ----
+inline void runRoadsBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    Heightfield field;
+    RoadConfig config;
+    config.cacheDir = "road_cache_bench";
+    std::error_code ec;
+    std::filesystem::remove_all(config.cacheDir, ec);
+
+    std::cout << "roads (" << jobSystem().threadCount() << " job threads)\n";
+    std::cout << std::setw(14) << "pass" << std::setw(10) << "chunks" << std::setw(10) << "rebuilt" << std::setw(12) << "from cache"
+              << std::setw(12) << "colliders" << std::setw(12) << "wall ms" << "\n";
+    auto report = [&](const char* name, RoadNetwork& roads, uint64_t builtBefore, uint64_t hitsBefore, double ms) {
+        const RoadStats& s = roads.stats();
+        std::cout << std::setw(14) << name << std::setw(10) << s.chunks << std::setw(10) << s.built - builtBefore
+                  << std::setw(12) << s.cacheHits - hitsBefore << std::setw(12) << s.colliders << std::setw(12) << ms << "\n";
+    };
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        auto t0 = Clock::now();
+        RoadNetwork roads(nullptr, &field, config);
+        generateRoads(roads, 1);
+        roads.finish();
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        report(pass ? "from cache" : "cold", roads, 0, 0, ms);
+
+        if (pass == 1)
+        {
+            // nudge one branch node: only the chunks around its two segments rebuild
+            uint64_t built = roads.stats().built, hits = roads.stats().cacheHits;
+            t0 = Clock::now();
+            roads.moveNode(13, roads.node(13) + glm::vec3(6.0f, 0.0f, -4.0f));
+            roads.finish();
+            report("edit 1 node", roads, built, hits, std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+
+            BVHRayHit hit;
+            std::vector<BVHBox> boxes;
+            glm::vec3 probe = roads.pointOn(0, 0.5f) + glm::vec3(0.0f, 0.5f, 0.0f);
+            const int sweeps = 100000;
+            int hits2 = 0;
+            t0 = Clock::now();
+            for (int k = 0; k < sweeps; k++)
+                hits2 += roads.sweep(probe, glm::vec3(0.8f, 0.5f, 1.5f), glm::vec3(tableCos(k * 0.01f), 0.0f, tableSin(k * 0.01f)) * 10.0f, hit);
+            double us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count() / sweeps;
+            std::cout << "  barrier sweep from the road centre: " << us << " us per query, " << hits2 << "/" << sweeps << " hit\n";
+        }
+    }
+    std::filesystem::remove_all(config.cacheDir, ec);
+}
+
+#endif
@@ -0,0 +1,56 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D depth;        // the screen views at half resolution, reversed-Z: near / distance
+uniform vec4 viewport;          // this view's rect in the target, in pixels: x, y, width, height
+uniform vec4 projectionInfo;    // projection[0][0], [1][1], [2][0], [2][1] (the jitter)
+uniform float near;
+uniform float radius;           // world units
+uniform float intensity;
+uniform int samples;
+
+// view-space position of target pixel p
+vec3 viewPosition(ivec2 p)
+{
+    float d = texelFetch(depth, p, 0).r;
+    vec2 ndc = (vec2(p) + 0.5 - viewport.xy) / viewport.zw * 2.0 - 1.0;
+    float distance = near / max(d, 1e-7);
+    return vec3((ndc + projectionInfo.zw) / projectionInfo.xy * distance, -distance);
+}
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    if (texelFetch(depth, p, 0).r <= 0.0) { FragColor = vec4(1.0); return; }   // sky
+    ivec2 lo = ivec2(viewport.xy), hi = ivec2(viewport.xy + viewport.zw) - 1;
+    vec3 c = viewPosition(p);
+
+    // the normal from the neighbours, each axis towards the side nearer in depth so that
+    // silhouettes do not bend it
+    vec3 l = viewPosition(max(p - ivec2(1, 0), lo)), r = viewPosition(min(p + ivec2(1, 0), hi));
+    vec3 b = viewPosition(max(p - ivec2(0, 1), lo)), t = viewPosition(min(p + ivec2(0, 1), hi));
+    vec3 dx = abs(r.z - c.z) < abs(c.z - l.z) ? r - c : c - l;
+    vec3 dy = abs(t.z - c.z) < abs(c.z - b.z) ? t - c : c - b;
+    vec3 n = normalize(cross(dx, dy));
+    if (dot(n, c) > 0.0) n = -n;    // towards the camera
+
+    // a spiral of samples over the disc the radius covers on screen, turned per pixel
+    // (the blur evens the pattern out); each one occludes by how far it rises above the
+    // surface's tangent plane, fading out towards the radius
+    float pixels = min(radius * abs(projectionInfo.y) * 0.5 * viewport.w / -c.z, 64.0);
+    float turn = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715)))) * 6.2831853;
+    float occlusion = 0.0;
+    for (int i = 0; i < samples; i++)
+    {
+        float a = (float(i) + 0.5) / float(samples);
+        float angle = a * 7.0 * 6.2831853 + turn;
+        ivec2 q = clamp(p + ivec2(vec2(cos(angle), sin(angle)) * a * pixels), lo, hi);
+        vec3 v = viewPosition(q) - c;
+        float vv = dot(v, v);
+        float falloff = max(1.0 - vv / (radius * radius), 0.0);
+        occlusion += falloff * max(dot(n, v) * inversesqrt(vv + 1e-6) - 0.1, 0.0);
+    }
+    FragColor = vec4(clamp(1.0 - intensity * occlusion / float(samples) * 1.5, 0.0, 1.0));
+}
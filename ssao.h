@@ -0,0 +1,131 @@
+#ifndef SSAO_H
+#define SSAO_H
+
+// Screen-space ambient occlusion (AmbientOcclusionSettings in renderer.h) and its timings
+// per quality preset.
+//
+// The ambient light - the SH irradiance, or the floor's flat 0.3 - reaches every point
+// the same, so the cars sit on the floor instead of in it and the terrain's folds read
+// flat. The backends darken it where nearby geometry hides part of the sky, measured in
+// screen space from depth alone, in three passes timed on the GPU:
+//
+//  - "ao-depth": the screen views' depth again, at half the scene target's size, with
+//    position-only shaders. Drawing it separately keeps the scene pass as it was and
+//    makes the occlusion passes a quarter of the pixels
+//  - "ssao": per pixel, the view-space position from that depth, a normal from the
+//    neighbours (towards the nearer neighbour on each axis, so silhouettes do not bend
+//    it), and a spiral of samples around it turned per pixel; each sample occludes by how
+//    far it rises above the tangent plane, fading out at the radius
+//  - "ssao-blur": a separable Gaussian, horizontal then vertical, that leaves out taps at
+//    another depth so the car's occlusion stays off the background behind it
+//
+// The floor, terrain and car shaders read the result at full resolution through a
+// depth-aware upsample of the four nearest half-resolution texels, weighted towards the
+// ones at the fragment's own depth; it scales their diffuse ambient only, never the
+// direct light or the reflections. Probe faces and planar reflection views go without.
+//
+// The presets trade samples and blur taps: Low 4 samples and 1 tap either side, Medium 8
+// and 2, High 16 and 4. AmbientOcclusionProfile collects the passes' cost at each preset
+// used; with a sweep it cycles Low, Medium, High every sweepFrames frames so one run
+// measures all three on the same scene.
+
+#include "renderer.h"
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+
+class AmbientOcclusionProfile
+{
+public:
+    static const int PRESETS = 4;       // AOQuality values
+    static const int STAGES = 3;        // ao-depth, ssao, ssao-blur
+    static const unsigned int SETTLE_FRAMES = 4;    // GPU timings lag the change by the frames in flight
+
+    // sweepFrames == 0 keeps the requested preset
+    explicit AmbientOcclusionProfile(const AmbientOcclusionSettings& settings, unsigned int sweepFrames = 0)
+        : current(settings), sweepFrames(sweepFrames)
+    {
+        if (sweepFrames && current.quality == AOQuality::Off) current.quality = AOQuality::Low;
+    }
+
+    const AmbientOcclusionSettings& settings() const { return current; }
+
+    // collects this frame's timings; true when settings() changed and should go to the renderer
+    bool update(const RendererStats& stats)
+    {
+        if (current.quality == AOQuality::Off) return false;
+        int preset = (int)current.quality;
+        if (settle > 0) settle--;
+        else
+        {
+            bool timed = false;
+            for (int stage = 0; stage < STAGES; stage++)
+            {
+                const PassTiming* pass = stats.pass(stageNames()[stage]);
+                if (!pass) continue;
+                cpuMs[preset][stage] += pass->cpuMs;
+                if (pass->gpuMs >= 0.0) { gpuMs[preset][stage] += pass->gpuMs; timed = true; }
+            }
+            const PassTiming* scene = stats.pass("scene");
+            if (timed && scene && scene->gpuMs >= 0.0)
+            {
+                sceneGpuMs[preset] += scene->gpuMs;
+                gpuFrames[preset]++;
+            }
+            frames[preset]++;
+        }
+        if (!sweepFrames || ++presetFrames < sweepFrames) return false;
+
+        presetFrames = 0;
+        settle = SETTLE_FRAMES;
+        current.quality = current.quality == AOQuality::Low ? AOQuality::Medium
+                        : current.quality == AOQuality::Medium ? AOQuality::High : AOQuality::Low;
+        return true;
+    }
+
+    void printStats(std::ostream& out) const
+    {
+        static const char* presetNames[PRESETS] = { "off", "low", "medium", "high" };
+        bool any = false;
+        for (int p = 1; p < PRESETS; p++) any = any || frames[p];
+        if (!any) return;
+        out << "ssao: radius " << current.radius << ", intensity " << current.intensity << (sweepFrames ? ", swept" : "") << "\n";
+        for (int p = 1; p < PRESETS; p++)
+        {
+            if (!frames[p]) continue;
+            out << "  " << std::left << std::setw(8) << presetNames[p] << std::right << std::setw(6) << frames[p] << " frames"
+                << std::fixed << std::setprecision(3);
+            double cpuTotal = 0.0;
+            for (int stage = 0; stage < STAGES; stage++) cpuTotal += cpuMs[p][stage];
+            out << "  cpu " << cpuTotal / frames[p];
+            if (gpuFrames[p])
+            {
+                double gpuTotal = 0.0;
+                for (int stage = 0; stage < STAGES; stage++)
+                {
+                    out << "  " << stageNames()[stage] << " " << gpuMs[p][stage] / gpuFrames[p];
+                    gpuTotal += gpuMs[p][stage];
+                }
+                out << "  gpu " << gpuTotal / gpuFrames[p] << "  scene " << sceneGpuMs[p] / gpuFrames[p];
+            }
+            out << " ms\n" << std::defaultfloat << std::setprecision(6);
+        }
+    }
+
+private:
+    static const char* const* stageNames()
+    {
+        static const char* names[STAGES] = { "ao-depth", "ssao", "ssao-blur" };
+        return names;
+    }
+
+    AmbientOcclusionSettings current;
+    unsigned int sweepFrames;
+    unsigned int presetFrames = 0, settle = 0;
+    uint64_t frames[PRESETS] = {}, gpuFrames[PRESETS] = {};
+    double cpuMs[PRESETS][STAGES] = {}, gpuMs[PRESETS][STAGES] = {};
+    double sceneGpuMs[PRESETS] = {};
+};
+
+#endif
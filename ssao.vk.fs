@@ -0,0 +1,76 @@
+#version 450
+layout (location = 0) out vec4 FragColor;
+
+layout (location = 0) in vec2 TexCoord;
+
+layout (set = 0, binding = 0) uniform sampler2D depth;     // the screen views at half resolution, reversed-Z: near / distance
+
+layout (set = 1, binding = 0) uniform Frame
+{
+    mat4 view;
+    mat4 projection;    // y flipped: the matrix inverted below flips it back
+    mat4 skyView;
+    mat4 viewProjection;
+    mat4 prevViewProjection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 environment;
+    vec4 ibl;
+    vec4 sh[9];
+    vec4 planar;
+    vec4 target;
+    vec4 occlusion;     // x: 1 = this view samples it, y: radius in world units, z: intensity, w: samples
+} frame;
+
+layout (push_constant) uniform Push
+{
+    vec4 params;    // this view's rect in the target, in pixels from the top left: x, y, width, height
+} push;
+
+// view-space position of target pixel p
+vec3 viewPosition(ivec2 p)
+{
+    float d = texelFetch(depth, p, 0).r;
+    vec2 ndc = (vec2(p) + 0.5 - push.params.xy) / push.params.zw * 2.0 - 1.0;
+    float distance = frame.projection[3][2] / max(d, 1e-7);
+    vec2 scale = vec2(frame.projection[0][0], frame.projection[1][1]);
+    vec2 offset = vec2(frame.projection[2][0], frame.projection[2][1]);
+    return vec3((ndc + offset) / scale * distance, -distance);
+}
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    if (texelFetch(depth, p, 0).r <= 0.0) { FragColor = vec4(1.0); return; }   // sky
+    ivec2 lo = ivec2(push.params.xy), hi = ivec2(push.params.xy + push.params.zw) - 1;
+    vec3 c = viewPosition(p);
+
+    // the normal from the neighbours, each axis towards the side nearer in depth so that
+    // silhouettes do not bend it
+    vec3 l = viewPosition(max(p - ivec2(1, 0), lo)), r = viewPosition(min(p + ivec2(1, 0), hi));
+    vec3 b = viewPosition(max(p - ivec2(0, 1), lo)), t = viewPosition(min(p + ivec2(0, 1), hi));
+    vec3 dx = abs(r.z - c.z) < abs(c.z - l.z) ? r - c : c - l;
+    vec3 dy = abs(t.z - c.z) < abs(c.z - b.z) ? t - c : c - b;
+    vec3 n = normalize(cross(dx, dy));
+    if (dot(n, c) > 0.0) n = -n;    // towards the camera
+
+    // a spiral of samples over the disc the radius covers on screen, turned per pixel
+    // (the blur evens the pattern out); each one occludes by how far it rises above the
+    // surface's tangent plane, fading out towards the radius
+    float radius = frame.occlusion.y;
+    int samples = int(frame.occlusion.w);
+    float pixels = min(radius * abs(frame.projection[1][1]) * 0.5 * push.params.w / -c.z, 64.0);
+    float turn = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715)))) * 6.2831853;
+    float occlusion = 0.0;
+    for (int i = 0; i < samples; i++)
+    {
+        float a = (float(i) + 0.5) / float(samples);
+        float angle = a * 7.0 * 6.2831853 + turn;
+        ivec2 q = clamp(p + ivec2(vec2(cos(angle), sin(angle)) * a * pixels), lo, hi);
+        vec3 v = viewPosition(q) - c;
+        float vv = dot(v, v);
+        float falloff = max(1.0 - vv / (radius * radius), 0.0);
+        occlusion += falloff * max(dot(n, v) * inversesqrt(vv + 1e-6) - 0.1, 0.0);
+    }
+    FragColor = vec4(clamp(1.0 - frame.occlusion.z * occlusion / float(samples) * 1.5, 0.0, 1.0));
+}
@@ -0,0 +1,30 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D occlusion;
+uniform sampler2D depth;        // what the occlusion was computed from
+uniform vec2 direction;         // one texel along the blur: (1, 0), then (0, 1)
+uniform int radius;             // taps either side
+
+// one axis of a Gaussian that leaves out taps at another depth, so that the car's
+// occlusion does not spill onto the background behind it
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 last = textureSize(occlusion, 0) - 1;
+    float d = texelFetch(depth, p, 0).r;
+    float sum = texelFetch(occlusion, p, 0).r, total = 1.0;
+    for (int i = -radius; i <= radius; i++)
+    {
+        if (i == 0 || d <= 0.0) continue;
+        ivec2 q = clamp(p + ivec2(direction) * i, ivec2(0), last);
+        // reversed-Z depth is near / distance, so this is the relative distance difference
+        float difference = abs(texelFetch(depth, q, 0).r - d) / d;
+        float w = exp(-float(i * i) / float(radius * radius + 1)) * max(1.0 - 16.0 * difference, 0.0);
+        sum += w * texelFetch(occlusion, q, 0).r;
+        total += w;
+    }
+    FragColor = vec4(sum / total);
+}
@@ -0,0 +1,120 @@
+#ifndef TAA_H
+#define TAA_H
+
+// Temporal anti-aliasing (TemporalAASettings in renderer.h), the camera side.
+//
+// The tiled floor shimmers at grazing angles because every pixel takes one sample of
+// a texture far finer than itself, at the same spot every frame. TAA moves that spot:
+// each frame the screen views' projections are shifted by a different sub-pixel
+// offset (the Halton (2, 3) sequence, 8 frames long, evenly spread over the pixel), and
+// the backend's resolve pass averages the results over time, per pixel, at the cost of
+// one fullscreen pass instead of MSAA's multiple samples of every pixel.
+//
+// What moved between frames is followed with motion vectors: the scene shaders write
+// each fragment's screen motion, from last frame's view-projection (set here per view)
+// and last frame's model matrix (DrawItem::prevModel, set by the caller for the cars),
+// and the resolve reads last frame's result there. History that no longer matches -
+// disocclusions, shading changes - is clamped to the range of the current pixel's
+// 3x3 neighbourhood before it is blended in, which is what keeps moving cars from
+// leaving trails.
+//
+// The same machinery upsamples: with renderScale < 1 the scene renders at that
+// fraction of the window and the jitter, a sub-pixel of the smaller target, lands on
+// different output pixels each frame, so the resolve reconstructs the full size from
+// several frames' samples. The scene is the expensive pass; at 0.75 it shades 56% of
+// the pixels and the resolve costs the same as before. The backend times the resolve
+// as "taa"; record() collects it next to "scene".
+
+#include <glm/glm.hpp>
+
+#include "renderer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// radical inverse of index in base: 0.5, 0.25, 0.75, ... for base 2
+inline float halton(uint32_t index, uint32_t base)
+{
+    float f = 1.0f, r = 0.0f;
+    for (; index > 0; index /= base)
+    {
+        f /= (float)base;
+        r += f * (float)(index % base);
+    }
+    return r;
+}
+
+class TemporalAA
+{
+public:
+    static const uint32_t SEQUENCE = 8;    // jitter positions before the pattern repeats
+
+    explicit TemporalAA(const TemporalAASettings& settings = TemporalAASettings())
+        : settings(settings) {}
+
+    bool enabled() const { return settings.enabled; }
+
+    // jitters the screen views by this frame's offset, in pixels of a target
+    // targetWidth x targetHeight (the window's size times renderScale), and gives each
+    // the unjittered view-projection it had last frame; views are matched by index
+    void apply(FrameParams& frame, int targetWidth, int targetHeight)
+    {
+        if (!settings.enabled || targetWidth <= 0 || targetHeight <= 0) return;
+        frameIndex++;
+        // pixel offset in [-0.5, 0.5); index 0 of the sequence is the centre, skip it
+        uint32_t i = frameIndex % SEQUENCE + 1;
+        glm::vec2 pixel(halton(i, 2) - 0.5f, halton(i, 3) - 0.5f);
+
+        size_t screen = 0;
+        for (ViewParams& view : frame.views)
+        {
+            if (view.target != ViewTarget::Screen || screen >= MAX_SCREEN_VIEWS) continue;
+            glm::mat4 viewProjection = view.projection * view.view;
+            view.prevViewProjection = screen < previous.size() ? previous[screen] : viewProjection;
+            if (screen < previous.size()) previous[screen] = viewProjection;
+            else previous.push_back(viewProjection);
+            screen++;
+
+            // one pixel is 2 / (pixels across the view) in NDC
+            view.jitter = pixel * 2.0f / glm::vec2(std::max(1.0f, view.rect.z * targetWidth), std::max(1.0f, view.rect.w * targetHeight));
+            view.projection = jitteredProjection(view.projection, view.jitter);
+        }
+        previous.resize(screen);
+    }
+
+    void record(const RendererStats& stats)
+    {
+        const PassTiming* taa = stats.pass("taa");
+        const PassTiming* scene = stats.pass("scene");
+        if (!taa || !scene) return;
+        frames++;
+        cpuMs += taa->cpuMs;
+        if (taa->gpuMs >= 0.0 && scene->gpuMs >= 0.0)
+        {
+            gpuMs += taa->gpuMs;
+            sceneGpuMs += scene->gpuMs;
+            gpuFrames++;
+        }
+    }
+
+    void printStats(std::ostream& out) const
+    {
+        if (!frames) return;
+        out << "taa: render scale " << settings.renderScale << " (" << 100.0 * settings.renderScale * settings.renderScale
+            << "% of the window's pixels shaded), resolve " << cpuMs / frames << " ms CPU";
+        if (gpuFrames)
+            out << ", " << gpuMs / gpuFrames << " ms GPU, scene " << sceneGpuMs / gpuFrames << " ms GPU";
+        out << " per frame over " << frames << " frames\n";
+    }
+
+private:
+    TemporalAASettings settings;
+    uint32_t frameIndex = 0;
+    std::vector<glm::mat4> previous;    // unjittered projection * view per screen view
+    uint64_t frames = 0, gpuFrames = 0;
+    double cpuMs = 0.0, gpuMs = 0.0, sceneGpuMs = 0.0;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#version 450
+layout (location = 0) out vec4 FragColor;
+
+layout (location = 0) in vec2 TexCoord;
+
+layout (set = 0, binding = 0) uniform sampler2D current;   // this frame, HDR, jittered, at the render resolution
+layout (set = 0, binding = 1) uniform sampler2D history;   // last frame's result, at the output resolution
+layout (set = 0, binding = 2) uniform sampler2D velocity;  // motion since last frame in texture coordinates
+
+layout (push_constant) uniform Push
+{
+    vec4 params;    // xy: this frame's jitter in texture coordinates, z: history weight (0: no history)
+} push;
+
+// blend weight that keeps single very bright samples from flickering (Karis)
+float weight(vec3 c)
+{
+    return 1.0 / (1.0 + max(c.r, max(c.g, c.b)));
+}
+
+void main()
+{
+    // the jittered frame shows what belongs at TexCoord at TexCoord + jitter
+    vec2 uv = TexCoord + push.params.xy;
+    ivec2 size = textureSize(current, 0);
+    ivec2 p = clamp(ivec2(uv * vec2(size)), ivec2(0), size - 1);
+    vec3 color = texture(current, uv).rgb;
+
+    // the range of the 3x3 neighbourhood: history outside it is stale
+    vec3 lo = color, hi = color;
+    for (int y = -1; y <= 1; y++)
+        for (int x = -1; x <= 1; x++)
+        {
+            vec3 c = texelFetch(current, clamp(p + ivec2(x, y), ivec2(0), size - 1), 0).rgb;
+            lo = min(lo, c);
+            hi = max(hi, c);
+        }
+
+    vec2 previous = TexCoord - texelFetch(velocity, p, 0).rg;
+    bool onScreen = all(greaterThanEqual(previous, vec2(0.0))) && all(lessThanEqual(previous, vec2(1.0)));
+
+    float feedback = push.params.z;
+    vec3 past = color;
+    float wh = 0.0;
+    if (onScreen && feedback > 0.0)
+    {
+        past = clamp(texture(history, previous).rgb, lo, hi);
+        wh = feedback * weight(past);
+    }
+    float wc = (1.0 - feedback) * weight(color);
+    FragColor = vec4((color * wc + past * wh) / (wc + wh), 1.0);
+}
@@ -0,0 +1,152 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+// Heightfield terrain drawn with geometry clipmaps.
+//
+// The ground around the camera is a stack of square grids that share one centre: level 0
+// is a full grid of cells x cells quads one sample apart, and every level above it is
+// the same footprint at twice the spacing with the middle quarter cut out, which is
+// exactly where the level below sits. So the vertex count is constant wherever the
+// camera goes and only two meshes exist (the full grid and the ring); the model matrix
+// places and scales them per level and the vertex shader (terrain.vs) reads the heights
+// from the heightmap texture, with the same bilinear lookup the physics uses.
+//
+// The centre snaps to the coarsest level's spacing, so every vertex of every level stays
+// on that level's lattice (no swimming) and each ring's hole lines up with the level
+// inside it without trim strips; the price is that the finest level recentres in coarse
+// steps, which its extent absorbs. Where a ring meets the coarser one, its odd edge
+// vertices take the coarser edge's interpolated height, so the seams have no cracks.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "heightfield.h"
+#include "renderer.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+struct ClipmapConfig
+{
+    int levels = 5;     // level L has spacing 2^L samples; 5 levels reach 512 samples out
+    int cells = 64;     // quads per side of each level (a multiple of 4)
+};
+
+class TerrainClipmap
+{
+public:
+    TerrainClipmap(Renderer* renderer, const Heightfield& field, const ClipmapConfig& config = ClipmapConfig())
+        : renderer(renderer), config(config), spacing(field.spacing())
+    {
+        heightmap = renderer->createHeightmap(field.samples().data(), field.size(), field.spacing());
+        fullMesh = build(false, fullVertices, fullIndices);
+        ringMesh = build(true, ringVertices, ringIndices);
+    }
+
+    ~TerrainClipmap()
+    {
+        renderer->destroyMesh(fullMesh);
+        renderer->destroyMesh(ringMesh);
+    }
+
+    TerrainClipmap(const TerrainClipmap&) = delete;
+    TerrainClipmap& operator=(const TerrainClipmap&) = delete;
+
+    // one draw per level, centred under the viewer
+    void draw(std::vector<DrawItem>& list, const glm::vec3& viewPos, unsigned int texture, uint32_t viewMask = ~0u) const
+    {
+        glm::vec3 centre = snappedCentre(viewPos);
+        for (int level = 0; level < config.levels; level++)
+        {
+            float scale = spacing * (float)(1 << level);
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), centre);
+            model = glm::scale(model, glm::vec3(scale, 1.0f, scale));
+            DrawItem item = { level == 0 ? fullMesh : ringMesh, Material::Terrain, model, texture };
+            item.heightmap = heightmap;
+            item.viewMask = viewMask;
+            list.push_back(item);
+        }
+    }
+
+    // split-screen: one set of levels per distinct centre, so views whose centres snap
+    // to the same place (usually all of them, the snap is coarse) share the draws
+    void draw(std::vector<DrawItem>& list, const std::vector<ViewParams>& views, unsigned int texture) const
+    {
+        uint32_t done = 0;
+        for (size_t v = 0; v < views.size() && v < MAX_VIEWS; v++)
+        {
+            if (done & (1u << v)) continue;
+            glm::vec3 centre = snappedCentre(views[v].viewPos);
+            uint32_t mask = 0;
+            for (size_t w = v; w < views.size() && w < MAX_VIEWS; w++)
+                if (snappedCentre(views[w].viewPos) == centre) mask |= 1u << w;
+            done |= mask;
+            draw(list, views[v].viewPos, texture, mask);
+        }
+    }
+
+    size_t vertexCount() const { return fullVertices + (size_t)(config.levels - 1) * ringVertices; }
+    size_t triangleCount() const { return (fullIndices + (size_t)(config.levels - 1) * ringIndices) / 3; }
+    float extent() const { return spacing * (float)(config.cells / 2 << (config.levels - 1)); }
+
+    void printStats(std::ostream& out) const
+    {
+        out << "terrain: " << config.levels << " clipmap levels, " << vertexCount() << " vertices, "
+            << triangleCount() << " triangles per frame, reaching " << extent() << " units\n";
+    }
+
+private:
+    Renderer* renderer;
+    ClipmapConfig config;
+    float spacing;
+    unsigned int heightmap = 0, fullMesh = 0, ringMesh = 0;
+    size_t fullVertices = 0, fullIndices = 0, ringVertices = 0, ringIndices = 0;
+
+    glm::vec3 snappedCentre(const glm::vec3& viewPos) const
+    {
+        float snap = spacing * (float)(1 << (config.levels - 1));
+        return glm::vec3(std::floor(viewPos.x / snap) * snap, 0.0f, std::floor(viewPos.z / snap) * snap);
+    }
+
+    // grid in cell units centred on the origin; the ring skips the middle quarter. The
+    // normal attribute carries the edge direction of odd outer-edge vertices (terrain.vs)
+    unsigned int build(bool ring, size_t& vertexCountOut, size_t& indexCountOut)
+    {
+        const int n = config.cells, half = n / 2, hole = n / 4;
+        auto inHole = [&](int cx, int cz) { return ring && cx >= half - hole && cx < half + hole && cz >= half - hole && cz < half + hole; };
+
+        std::vector<int> index((size_t)(n + 1) * (n + 1), -1);
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+        auto vertex = [&](int x, int z) -> unsigned int {
+            int& slot = index[(size_t)z * (n + 1) + x];
+            if (slot < 0)
+            {
+                slot = (int)(vertices.size() / 8);
+                float ex = 0.0f, ez = 0.0f;
+                if ((z == 0 || z == n) && (x & 1)) ex = 1.0f;
+                if ((x == 0 || x == n) && (z & 1)) ez = 1.0f;
+                float v[8] = { (float)(x - half), 0.0f, (float)(z - half), ex, 0.0f, ez, 0.0f, 0.0f };
+                vertices.insert(vertices.end(), v, v + 8);
+            }
+            return (unsigned int)slot;
+        };
+
+        for (int z = 0; z < n; z++)
+            for (int x = 0; x < n; x++)
+            {
+                if (inHole(x, z)) continue;
+                unsigned int a = vertex(x, z), b = vertex(x + 1, z), c = vertex(x + 1, z + 1), d = vertex(x, z + 1);
+                unsigned int quad[6] = { a, d, c, c, b, a };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        vertexCountOut = vertices.size() / 8;
+        indexCountOut = indices.size();
+        return renderer->createMesh(vertices.data(), vertexCountOut, indices.data(), indices.size());
+    }
+};
+
+#endif
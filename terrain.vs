@@ -0,0 +1,62 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;    // clipmap rings: edge direction of vertices that match the coarser ring, else 0
+layout (location = 2) in vec2 aTexCoord;
+
+out vec2 TexCoord;
+out vec3 FragPos;
+out vec3 Normal;
+out vec4 CurrClip;   // motion vectors (taa.h): this frame's and last frame's clip position, unjittered
+out vec4 PrevClip;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat4 viewProjection;       // unjittered projection * view
+uniform mat4 prevViewProjection;   // last frame's
+uniform sampler2D heightmap;    // R32F, repeats
+uniform float heightSpacing;    // world units between samples
+
+// same lookup as heightfield.h: bilinear between the four surrounding samples
+float sampleAt(ivec2 i)
+{
+    ivec2 size = textureSize(heightmap, 0);
+    return texelFetch(heightmap, i & (size - 1), 0).r;
+}
+
+float heightAt(vec2 p)
+{
+    vec2 g = p / heightSpacing;
+    vec2 f = floor(g);
+    vec2 t = g - f;
+    ivec2 i = ivec2(f);
+    float h00 = sampleAt(i), h10 = sampleAt(i + ivec2(1, 0));
+    float h01 = sampleAt(i + ivec2(0, 1)), h11 = sampleAt(i + ivec2(1, 1));
+    float a = h00 + (h10 - h00) * t.x;
+    float b = h01 + (h11 - h01) * t.x;
+    return a + (b - a) * t.y;
+}
+
+void main()
+{
+    vec3 world = vec3(model * vec4(aPos, 1.0));
+    vec3 edge = mat3(model) * aNormal;
+
+    // odd vertices on a ring's outer edge take the height the coarser ring interpolates there
+    float h = heightAt(world.xz);
+    if (dot(edge, edge) > 0.0)
+        h = 0.5 * (heightAt(world.xz - edge.xz) + heightAt(world.xz + edge.xz));
+    world.y = h;
+
+    float s = heightSpacing;
+    float sx = (heightAt(world.xz + vec2(s, 0.0)) - heightAt(world.xz - vec2(s, 0.0))) / (2.0 * s);
+    float sz = (heightAt(world.xz + vec2(0.0, s)) - heightAt(world.xz - vec2(0.0, s))) / (2.0 * s);
+
+    FragPos = world;
+    Normal = normalize(vec3(-sx, 1.0, -sz));
+    TexCoord = vec2(world.x, -world.z) * 0.5;    // the floor's texture mapping (WorldStreamConfig::uvPerUnit)
+    gl_Position = projection * view * vec4(world, 1.0);
+    // the rings follow the camera but the surface stays put: only the camera moved it
+    CurrClip = viewProjection * vec4(world, 1.0);
+    PrevClip = prevViewProjection * vec4(world, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D scene;        // HDR
+uniform sampler2D bloom;        // the first bloom level, every level summed into it
+uniform float bloomStrength;    // per level summed; 0: no bloom
+uniform float exposure;
+
+// ACES filmic curve, Narkowicz's fit
+vec3 aces(vec3 x)
+{
+    return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+void main()
+{
+    vec3 color = texture(scene, TexCoord).rgb;
+    if (bloomStrength > 0.0) color += texture(bloom, TexCoord).rgb * bloomStrength;
+    FragColor = vec4(aces(color * exposure), 1.0);
+}
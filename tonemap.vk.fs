@@ -0,0 +1,25 @@
+#version 450
+layout (location = 0) out vec4 FragColor;
+
+layout (location = 0) in vec2 TexCoord;
+
+layout (set = 0, binding = 0) uniform sampler2D scene;     // HDR
+layout (set = 0, binding = 1) uniform sampler2D bloom;     // the first bloom level, every level summed into it
+
+layout (push_constant) uniform Push
+{
+    vec4 params;    // z: bloom strength per level summed (0: no bloom), w: exposure
+} push;
+
+// ACES filmic curve, Narkowicz's fit
+vec3 aces(vec3 x)
+{
+    return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+void main()
+{
+    vec3 color = texture(scene, TexCoord).rgb;
+    if (push.params.z > 0.0) color += texture(bloom, TexCoord).rgb * push.params.z;
+    FragColor = vec4(aces(color * push.params.w), 1.0);
+}
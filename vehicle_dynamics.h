@@ -0,0 +1,380 @@
+#ifndef VEHICLE_DYNAMICS_H
+#define VEHICLE_DYNAMICS_H
+
+// Vehicle dynamics: a bicycle model (one front and one rear axle) stepped over SoA
+// arrays, many cars per call.
+//
+// Per substep the model
+//   - moves the axle loads with the longitudinal acceleration (load transfer),
+//   - computes front/rear slip angles from each axle's velocity in its wheel frame,
+//   - turns them into lateral forces with a saturating tire curve
+//         Fy = -mu Fz * x / sqrt(1 + x^2),  x = C * slip / (mu Fz)
+//     (linear with cornering stiffness C at small slip, levels off at the friction
+//     limit; the driven rear axle loses lateral grip along the friction circle),
+//   - integrates vx, vy and yaw rate in the body frame, then the pose.
+// On a slope the weight component along the heading pulls the car downhill; the
+// caller supplies the slope (traffic.h and main query the heightfield for it).
+// Below a few m/s the dynamic model is blended into the kinematic one, which is
+// well-behaved at standstill. Steps longer than MAX_SUBSTEP are split.
+//
+// The kernel (vehicle_dynamics_kernels.inl) reuses the SIMD wrappers and runtime
+// instruction-set selection of collision_simd.h. stepVehicleReference is the plain
+// double-precision scalar version with library trig; the benchmark checks the
+// kernels against it.
+//
+// Yaw follows the player's convention: degrees, forward = (sin yaw, 0, cos yaw);
+// vy is along side = (cos yaw, 0, -sin yaw), the direction positive yaw turns towards.
+
+#include <glm/glm.hpp>
+
+#include "collision_simd.h"
+#include "deterministic.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+struct VehicleParams
+{
+    float mass = 1200.0f;             // kg
+    float inertia = 1600.0f;          // yaw moment of inertia, kg m^2
+    float cgToFront = 1.0f;           // centre of mass to front axle, m
+    float cgToRear = 1.2f;            // centre of mass to rear axle, m
+    float cgHeight = 0.5f;            // for load transfer
+    float corneringFront = 60000.0f;  // N per rad of slip
+    float corneringRear = 70000.0f;
+    float friction = 1.1f;            // tire/road mu
+    float maxSteer = 0.55f;           // front wheel angle at full input, rad
+    float driveForce = 9000.0f;       // at full throttle, N (rear-wheel drive)
+    float brakeForce = 14000.0f;
+    float maxSpeed = 12.0f;           // drive fades out here, m/s
+    float reverseFraction = 0.5f;     // reverse top speed relative to maxSpeed
+    float coastDecel = 1.5f;          // rolling resistance, m/s^2
+    float drag = 0.8f;                // aerodynamic, N per (m/s)^2
+};
+
+static const float GRAVITY = 9.81f;
+static const float KINEMATIC_BELOW = 1.5f;   // m/s: purely kinematic model
+static const float DYNAMIC_ABOVE = 4.0f;     // m/s: purely dynamic model
+static const float DRIVE_FADE = 0.25f;       // drive fades out over the last quarter of top speed
+static const float MAX_SUBSTEP = 1.0f / 120.0f;
+
+struct VehicleBatch
+{
+    float *posX, *posZ, *yaw;      // ground position, yaw in degrees
+    float *headX, *headZ;          // (sin yaw, cos yaw), kept alongside yaw so the kernel needs no trig
+    float *vx, *vy, *yawRate;      // body-frame velocity (forward, side), rad/s
+    float *accel;                  // last longitudinal acceleration, for load transfer
+    const float *throttle, *steer; // inputs, -1..1 (negative throttle brakes, then reverses)
+    const float *slope;            // ground rise per unit of travel along the heading (0: level)
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")   // strict: see deterministic.h
+#endif
+namespace vehicle_scalar
+{
+    typedef collision_scalar::Simd Simd;
+#include "vehicle_dynamics_kernels.inl"
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+#ifdef COLLISION_SIMD_X86
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#pragma GCC optimize("fp-contract=off")   // strict: see deterministic.h
+#endif
+namespace vehicle_sse2
+{
+    typedef collision_sse2::Simd Simd;
+#include "vehicle_dynamics_kernels.inl"
+}
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+namespace vehicle_avx2
+{
+    typedef collision_avx2::Simd Simd;
+#include "vehicle_dynamics_kernels.inl"
+}
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#endif
+namespace vehicle_avx512
+{
+    typedef collision_avx512::Simd Simd;
+#include "vehicle_dynamics_kernels.inl"
+}
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif // COLLISION_SIMD_X86
+
+// advances vehicles [begin, end) by dt using the instruction set from physicsSimdLevel()
+inline void stepVehicles(const VehicleParams& params, const VehicleBatch& v, size_t begin, size_t end, float dt)
+{
+    int substeps = std::max(1, (int)std::ceil(dt / MAX_SUBSTEP - 1e-3f));
+    float h = dt / substeps;
+    size_t done = begin;
+#ifdef COLLISION_SIMD_X86
+    switch (physicsSimdLevel())
+    {
+    case SimdLevel::AVX512: done = vehicle_avx512::bicycleKernel(params, v, begin, end, h, substeps); break;
+    case SimdLevel::AVX2: done = vehicle_avx2::bicycleKernel(params, v, begin, end, h, substeps); break;
+    case SimdLevel::SSE2: done = vehicle_sse2::bicycleKernel(params, v, begin, end, h, substeps); break;
+    default: break;
+    }
+#endif
+    vehicle_scalar::bicycleKernel(params, v, done, end, h, substeps);
+}
+
+// ---- SoA storage ----
+
+struct VehicleArrays
+{
+    std::vector<float> posX, posZ, yaw, headX, headZ;
+    std::vector<float> vx, vy, yawRate, accel;
+    std::vector<float> throttle, steer, slope;
+
+    size_t add(const glm::vec3& position, float yawDegrees, float speed = 0.0f)
+    {
+        posX.push_back(position.x);
+        posZ.push_back(position.z);
+        yaw.push_back(yawDegrees);
+        headX.push_back(tableSin(glm::radians(yawDegrees)));
+        headZ.push_back(tableCos(glm::radians(yawDegrees)));
+        vx.push_back(speed);
+        for (std::vector<float>* f : { &vy, &yawRate, &accel, &throttle, &steer, &slope }) f->push_back(0.0f);
+        return posX.size() - 1;
+    }
+
+    size_t size() const { return posX.size(); }
+
+    VehicleBatch batch()
+    {
+        return { posX.data(), posZ.data(), yaw.data(), headX.data(), headZ.data(),
+                 vx.data(), vy.data(), yawRate.data(), accel.data(), throttle.data(), steer.data(), slope.data() };
+    }
+
+    void step(const VehicleParams& params, float dt) { stepVehicles(params, batch(), 0, size(), dt); }
+
+    glm::vec3 position(size_t i) const { return glm::vec3(posX[i], 0.0f, posZ[i]); }
+    glm::vec3 forward(size_t i) const { return glm::vec3(headX[i], 0.0f, headZ[i]); }
+    glm::vec3 side(size_t i) const { return glm::vec3(headZ[i], 0.0f, -headX[i]); }
+    glm::vec3 velocity(size_t i) const { return forward(i) * vx[i] + side(i) * vy[i]; }
+
+    // overwrite the pose (e.g. after collision response), keeping yaw and heading in sync
+    void setPose(size_t i, const glm::vec3& position, float yawDegrees)
+    {
+        posX[i] = position.x;
+        posZ[i] = position.z;
+        yaw[i] = yawDegrees;
+        headX[i] = tableSin(glm::radians(yawDegrees));
+        headZ[i] = tableCos(glm::radians(yawDegrees));
+    }
+
+    void setVelocity(size_t i, const glm::vec3& velocity)
+    {
+        vx[i] = glm::dot(velocity, forward(i));
+        vy[i] = glm::dot(velocity, side(i));
+    }
+
+    // slope along the heading from the ground normal under the car
+    void setGround(size_t i, const glm::vec3& normal)
+    {
+        slope[i] = -(normal.x * headX[i] + normal.z * headZ[i]) / std::max(normal.y, 0.1f);
+    }
+
+    void hash(StateHash& h) const
+    {
+        for (const std::vector<float>* f : { &posX, &posZ, &yaw, &headX, &headZ, &vx, &vy, &yawRate, &accel }) h.add(*f);
+    }
+};
+
+// ---- scalar reference ----
+
+struct VehicleState
+{
+    double posX = 0.0, posZ = 0.0, yaw = 0.0;   // yaw in radians
+    double vx = 0.0, vy = 0.0, yawRate = 0.0, accel = 0.0;
+};
+
+inline void stepVehicleReference(const VehicleParams& p, VehicleState& s, float throttle, float steer, float dt, float slope = 0.0f)
+{
+    int substeps = std::max(1, (int)std::ceil(dt / MAX_SUBSTEP - 1e-3f));
+    double h = (double)dt / substeps;
+    double L = p.cgToFront + p.cgToRear;
+    double delta = std::max(-1.0f, std::min(1.0f, steer)) * p.maxSteer;
+
+    double inputForce;
+    double topReverse = p.maxSpeed * p.reverseFraction;
+    if (throttle > 0.0f) inputForce = throttle * p.driveForce * std::max(0.0, std::min(1.0, (p.maxSpeed - s.vx) / (DRIVE_FADE * p.maxSpeed)));
+    else if (s.vx > 0.5) inputForce = throttle * p.brakeForce;
+    else inputForce = throttle * p.driveForce * std::max(0.0, std::min(1.0, (topReverse + s.vx) / (DRIVE_FADE * topReverse)));
+
+    auto tire = [](double slip, double k, double grip) {
+        double x = k * slip / grip;
+        return -grip * x / std::sqrt(1.0 + x * x);
+    };
+
+    for (int step = 0; step < substeps; step++)
+    {
+        double minLoad = 0.1 * p.mass * GRAVITY / 2.0;
+        double fzf = std::max(minLoad, (p.mass * GRAVITY * p.cgToRear - p.mass * p.cgHeight * s.accel) / L);
+        double fzr = std::max(minLoad, (p.mass * GRAVITY * p.cgToFront + p.mass * p.cgHeight * s.accel) / L);
+
+        double fx = inputForce - p.mass * p.coastDecel * std::max(-1.0, std::min(1.0, s.vx * 2.0)) - p.drag * s.vx * std::fabs(s.vx);
+        double fxLimit = p.friction * (fzf + fzr);
+        fx = std::max(-fxLimit, std::min(fxLimit, fx));
+        fx -= p.mass * GRAVITY * slope / std::sqrt(1.0 + (double)slope * slope);
+
+        double frontLat = s.vy + p.cgToFront * s.yawRate;
+        double wheelLat = frontLat * std::cos(delta) - s.vx * std::sin(delta);
+        double wheelLong = s.vx * std::cos(delta) + frontLat * std::sin(delta);
+        double slipFront = std::atan(wheelLat / std::max(std::fabs(wheelLong), 0.5));
+        double slipRear = std::atan((s.vy - p.cgToRear * s.yawRate) / std::max(std::fabs(s.vx), 0.5));
+
+        double gripFront = p.friction * fzf, gripRear = p.friction * fzr;
+        double fxRear = std::min(std::fabs(fx), gripRear * 0.95);
+        gripRear = std::sqrt(gripRear * gripRear - fxRear * fxRear);
+        double fyf = tire(slipFront, p.corneringFront, gripFront);
+        double fyr = tire(slipRear, p.corneringRear, gripRear);
+
+        s.accel = (fx - fyf * std::sin(delta)) / p.mass;
+        double dvx = s.accel + s.vy * s.yawRate;
+        double dvy = (fyf * std::cos(delta) + fyr) / p.mass - s.vx * s.yawRate;
+        double dr = (p.cgToFront * fyf * std::cos(delta) - p.cgToRear * fyr) / p.inertia;
+        s.vx += dvx * h;
+        s.vy += dvy * h;
+        s.yawRate += dr * h;
+
+        double w = std::max(0.0, std::min(1.0, (std::fabs(s.vx) - KINEMATIC_BELOW) / (DYNAMIC_ABOVE - KINEMATIC_BELOW)));
+        double rKin = s.vx * std::tan(delta) / L;
+        s.yawRate = rKin + w * (s.yawRate - rKin);
+        s.vy = rKin * p.cgToRear + w * (s.vy - rKin * p.cgToRear);
+
+        s.yaw += s.yawRate * h;
+        double sy = std::sin(s.yaw), cy = std::cos(s.yaw);
+        s.posX += (sy * s.vx + cy * s.vy) * h;
+        s.posZ += (cy * s.vx - sy * s.vy) * h;
+    }
+}
+
+// ---- benchmark: vehicle steps per second per instruction set, checked against the reference ----
+// Every car accelerates while weaving with its own steering frequency, then brakes hard
+// halfway through; the first REFERENCE_CARS are replayed with stepVehicleReference.
+// Equal state hashes mean bit-identical results: the strict scalar and SSE2 kernels
+// always agree, the wider ones may differ where the compiler fused multiply-adds.
+inline void runVehicleBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const size_t n = 1 << 16;
+    const size_t REFERENCE_CARS = 2048;
+    const int ticks = 300;
+    const float dt = 1.0f / 60.0f;
+    VehicleParams params;
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> amplitude(n), frequency(n), phase(n), gas(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        amplitude[i] = 0.2f + 0.8f * unit(rng);
+        frequency[i] = 0.3f + 1.5f * unit(rng);
+        phase[i] = 6.2831853f * unit(rng);
+        gas[i] = 0.3f + 0.7f * unit(rng);
+    }
+    auto inputs = [&](VehicleArrays& cars, int tick) {
+        float t = tick * dt;
+        for (size_t i = 0; i < n; i++)
+        {
+            cars.throttle[i] = t < ticks * dt * 0.5f ? gas[i] : -gas[i];
+            cars.steer[i] = amplitude[i] * std::sin(frequency[i] * t + phase[i]);
+        }
+    };
+
+    std::vector<VehicleState> reference(REFERENCE_CARS);
+    {
+        VehicleArrays cars;
+        for (size_t i = 0; i < n; i++) cars.add(glm::vec3(0.0f), 0.0f);
+        for (int tick = 0; tick < ticks; tick++)
+        {
+            inputs(cars, tick);
+            for (size_t i = 0; i < REFERENCE_CARS; i++) stepVehicleReference(params, reference[i], cars.throttle[i], cars.steer[i], dt);
+        }
+    }
+
+    SimdLevel best = detectSimdLevel();
+    std::cout << "vehicle dynamics: " << n << " cars x " << ticks << " ticks, best available " << simdLevelName(best) << "\n";
+    std::cout << std::setw(10) << "isa" << std::setw(14) << "Msteps/s" << std::setw(14) << "ns/car"
+              << std::setw(16) << "max pos err" << std::setw(16) << "mean pos err" << std::setw(14) << "max vel err" << std::setw(20) << "state hash" << "\n";
+    for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512 })
+    {
+        if (level > best) continue;
+        setSimdLevel(level);
+        VehicleArrays cars;
+        for (size_t i = 0; i < n; i++) cars.add(glm::vec3(0.0f), 0.0f);
+
+        double secs = 0.0;
+        for (int tick = 0; tick < ticks; tick++)
+        {
+            inputs(cars, tick);
+            auto t0 = Clock::now();
+            cars.step(params, dt);
+            secs += std::chrono::duration<double>(Clock::now() - t0).count();
+        }
+
+        double maxPos = 0.0, sumPos = 0.0, maxVel = 0.0;
+        for (size_t i = 0; i < REFERENCE_CARS; i++)
+        {
+            const VehicleState& s = reference[i];
+            double pos = std::hypot(cars.posX[i] - s.posX, cars.posZ[i] - s.posZ);
+            double vel = std::hypot(cars.vx[i] - s.vx, cars.vy[i] - s.vy);
+            maxPos = std::max(maxPos, pos);
+            sumPos += pos;
+            maxVel = std::max(maxVel, vel);
+        }
+        StateHash hash;
+        cars.hash(hash);
+        double steps = (double)n * ticks;
+        std::cout << std::setw(10) << simdLevelName(level) << std::setw(14) << steps / secs / 1e6 << std::setw(14) << secs / steps * 1e9
+                  << std::setw(16) << maxPos << std::setw(16) << sumPos / REFERENCE_CARS << std::setw(14) << maxVel
+                  << std::setw(20) << std::hex << hash.value << std::dec << "\n";
+    }
+    setSimdLevel(best);
+}
+
+#endif
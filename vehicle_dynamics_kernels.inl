@@ -0,0 +1,167 @@
+// Batched bicycle-model step, written once against the SIMD wrapper from collision_simd.h.
+// vehicle_dynamics.h includes this file once per instruction set, inside a namespace
+// that typedefs `Simd` and under the matching target pragma. The kernel handles whole
+// W-wide blocks starting at `begin` and returns where it stopped; the caller finishes
+// the tail with the scalar variant.
+//
+// Trig is replaced by polynomials that are accurate over the ranges the model uses:
+// slip angles go through a full-range atan, steering and per-substep yaw increments
+// are small angles (|x| < 1 rad) and use truncated Taylor series.
+
+inline Simd::V vmin(Simd::V a, Simd::V b) { return Simd::select(Simd::lt(a, b), a, b); }
+inline Simd::V vmax(Simd::V a, Simd::V b) { return Simd::select(Simd::gt(a, b), a, b); }
+inline Simd::V vclamp(Simd::V x, Simd::V lo, Simd::V hi) { return vmin(vmax(x, lo), hi); }
+
+// |error| < 2e-5 rad; |x| > 1 is folded through atan(x) = pi/2 - atan(1/x)
+inline Simd::V vatan(Simd::V x)
+{
+    typedef Simd::V V;
+    const V one = Simd::set1(1.0f), zero = Simd::set1(0.0f);
+    V ax = Simd::abs(x);
+    Simd::M big = Simd::gt(ax, one);
+    V t = Simd::select(big, Simd::div(one, vmax(ax, Simd::set1(1e-30f))), ax);
+    V t2 = Simd::mul(t, t);
+    V p = Simd::set1(-0.01172120f);
+    p = Simd::add(Simd::mul(p, t2), Simd::set1(0.05265332f));
+    p = Simd::add(Simd::mul(p, t2), Simd::set1(-0.11643287f));
+    p = Simd::add(Simd::mul(p, t2), Simd::set1(0.19354346f));
+    p = Simd::add(Simd::mul(p, t2), Simd::set1(-0.33262347f));
+    p = Simd::add(Simd::mul(p, t2), Simd::set1(0.99997726f));
+    p = Simd::mul(p, t);
+    p = Simd::select(big, Simd::sub(Simd::set1(1.57079633f), p), p);
+    return Simd::select(Simd::lt(x, zero), Simd::sub(zero, p), p);
+}
+
+// sin/cos for |x| < 1 rad (error < 3e-6 at 1 rad, < 1e-7 below 0.6)
+inline void vsincos(Simd::V x, Simd::V& s, Simd::V& c)
+{
+    typedef Simd::V V;
+    const V one = Simd::set1(1.0f);
+    V x2 = Simd::mul(x, x);
+    s = Simd::sub(one, Simd::mul(x2, Simd::set1(1.0f / 42.0f)));
+    s = Simd::sub(one, Simd::mul(Simd::mul(x2, Simd::set1(1.0f / 20.0f)), s));
+    s = Simd::mul(x, Simd::sub(one, Simd::mul(Simd::mul(x2, Simd::set1(1.0f / 6.0f)), s)));
+    c = Simd::sub(one, Simd::mul(x2, Simd::set1(1.0f / 56.0f)));
+    c = Simd::sub(one, Simd::mul(Simd::mul(x2, Simd::set1(1.0f / 30.0f)), c));
+    c = Simd::sub(one, Simd::mul(Simd::mul(x2, Simd::set1(1.0f / 12.0f)), c));
+    c = Simd::sub(one, Simd::mul(Simd::mul(x2, Simd::set1(0.5f)), c));
+}
+
+// saturating tire: linear with cornering stiffness k at small slip, levels off at the
+// friction limit `grip` (= mu * Fz); the force opposes the slip
+inline Simd::V vtire(Simd::V slip, Simd::V k, Simd::V grip)
+{
+    Simd::V x = Simd::div(Simd::mul(k, slip), grip);
+    Simd::V shape = Simd::div(x, Simd::sqrt(Simd::add(Simd::set1(1.0f), Simd::mul(x, x))));
+    return Simd::sub(Simd::set1(0.0f), Simd::mul(grip, shape));
+}
+
+inline size_t bicycleKernel(const VehicleParams& p, const VehicleBatch& v, size_t begin, size_t end, float h, int substeps)
+{
+    typedef Simd::V V;
+    const V zero = Simd::set1(0.0f), one = Simd::set1(1.0f), minusOne = Simd::set1(-1.0f);
+    const float wheelbase = p.cgToFront + p.cgToRear;
+    const V dt = Simd::set1(h), invMass = Simd::set1(1.0f / p.mass), invInertia = Simd::set1(1.0f / p.inertia);
+    const V a = Simd::set1(p.cgToFront), b = Simd::set1(p.cgToRear), invL = Simd::set1(1.0f / wheelbase);
+    const V loadFront = Simd::set1(p.mass * GRAVITY * p.cgToRear / wheelbase), loadRear = Simd::set1(p.mass * GRAVITY * p.cgToFront / wheelbase);
+    const V transfer = Simd::set1(p.mass * p.cgHeight / wheelbase), minLoad = Simd::set1(0.1f * p.mass * GRAVITY / 2.0f);
+    const V mu = Simd::set1(p.friction), kf = Simd::set1(p.corneringFront), kr = Simd::set1(p.corneringRear);
+    const V maxSteer = Simd::set1(p.maxSteer), drive = Simd::set1(p.driveForce), brake = Simd::set1(p.brakeForce);
+    const V top = Simd::set1(p.maxSpeed), topReverse = Simd::set1(p.maxSpeed * p.reverseFraction);
+    const V invFade = Simd::set1(1.0f / (DRIVE_FADE * p.maxSpeed)), invFadeReverse = Simd::set1(1.0f / (DRIVE_FADE * p.maxSpeed * p.reverseFraction));
+    const V rolling = Simd::set1(p.mass * p.coastDecel), drag = Simd::set1(p.drag);
+    const V minSlipSpeed = Simd::set1(0.5f), kinLo = Simd::set1(KINEMATIC_BELOW), invBlend = Simd::set1(1.0f / (DYNAMIC_ABOVE - KINEMATIC_BELOW));
+    const V toDegrees = Simd::set1(57.2957795f), half = Simd::set1(0.5f), weight = Simd::set1(p.mass * GRAVITY);
+
+    size_t i = begin;
+    for (; i + Simd::W <= end; i += Simd::W)
+    {
+        V px = Simd::load(v.posX + i), pz = Simd::load(v.posZ + i), yaw = Simd::load(v.yaw + i);
+        V hx = Simd::load(v.headX + i), hz = Simd::load(v.headZ + i);
+        V vx = Simd::load(v.vx + i), vy = Simd::load(v.vy + i), r = Simd::load(v.yawRate + i), ax = Simd::load(v.accel + i);
+        V throttle = Simd::load(v.throttle + i);
+        V delta = Simd::mul(vclamp(Simd::load(v.steer + i), minusOne, one), maxSteer);
+        V sd, cd;
+        vsincos(delta, sd, cd);
+        V tanDelta = Simd::div(sd, cd);
+
+        // drive fades out just below top speed (forward and reverse); pressing against the
+        // direction of travel brakes
+        V forwardDrive = Simd::mul(Simd::mul(throttle, drive), vclamp(Simd::mul(Simd::sub(top, vx), invFade), zero, one));
+        V reverseDrive = Simd::mul(Simd::mul(throttle, drive), vclamp(Simd::mul(Simd::add(topReverse, vx), invFadeReverse), zero, one));
+        V braking = Simd::mul(throttle, brake);
+        V inputForce = Simd::select(Simd::gt(throttle, zero), forwardDrive, Simd::select(Simd::gt(vx, half), braking, reverseDrive));
+
+        // weight along the slope (sin of its angle); the tires don't limit it
+        V slope = Simd::load(v.slope + i);
+        V downhill = Simd::div(Simd::mul(weight, slope), Simd::sqrt(Simd::add(one, Simd::mul(slope, slope))));
+
+        for (int s = 0; s < substeps; s++)
+        {
+            // longitudinal load transfer from last step's acceleration
+            V fzf = vmax(Simd::sub(loadFront, Simd::mul(transfer, ax)), minLoad);
+            V fzr = vmax(Simd::add(loadRear, Simd::mul(transfer, ax)), minLoad);
+
+            V fx = Simd::sub(inputForce, Simd::mul(rolling, vclamp(Simd::mul(vx, Simd::set1(2.0f)), minusOne, one)));
+            fx = Simd::sub(fx, Simd::mul(drag, Simd::mul(vx, Simd::abs(vx))));
+            V fxLimit = Simd::mul(mu, Simd::add(fzf, fzr));
+            fx = Simd::sub(vclamp(fx, Simd::sub(zero, fxLimit), fxLimit), downhill);
+
+            // slip angles from the velocity of each axle in its wheel frame
+            V frontLat = Simd::add(vy, Simd::mul(a, r));
+            V wheelLat = Simd::sub(Simd::mul(frontLat, cd), Simd::mul(vx, sd));
+            V wheelLong = Simd::add(Simd::mul(vx, cd), Simd::mul(frontLat, sd));
+            V slipFront = vatan(Simd::div(wheelLat, vmax(Simd::abs(wheelLong), minSlipSpeed)));
+            V slipRear = vatan(Simd::div(Simd::sub(vy, Simd::mul(b, r)), vmax(Simd::abs(vx), minSlipSpeed)));
+
+            // the rear carries the drive, so its lateral grip shrinks with the friction circle
+            V gripFront = Simd::mul(mu, fzf);
+            V gripRear = Simd::mul(mu, fzr);
+            V fxRear = vmin(Simd::abs(fx), Simd::mul(gripRear, Simd::set1(0.95f)));
+            gripRear = Simd::sqrt(Simd::sub(Simd::mul(gripRear, gripRear), Simd::mul(fxRear, fxRear)));
+            V fyf = vtire(slipFront, kf, gripFront);
+            V fyr = vtire(slipRear, kr, gripRear);
+
+            // body-frame equations of motion
+            V fyfLat = Simd::mul(fyf, cd);
+            ax = Simd::mul(Simd::sub(fx, Simd::mul(fyf, sd)), invMass);
+            V dvx = Simd::add(ax, Simd::mul(vy, r));
+            V dvy = Simd::sub(Simd::mul(Simd::add(fyfLat, fyr), invMass), Simd::mul(vx, r));
+            V dr = Simd::mul(Simd::sub(Simd::mul(a, fyfLat), Simd::mul(b, fyr)), invInertia);
+            vx = Simd::add(vx, Simd::mul(dvx, dt));
+            vy = Simd::add(vy, Simd::mul(dvy, dt));
+            r = Simd::add(r, Simd::mul(dr, dt));
+
+            // at parking speeds the tire model is singular; blend into the kinematic model
+            V w = vclamp(Simd::mul(Simd::sub(Simd::abs(vx), kinLo), invBlend), zero, one);
+            V rKin = Simd::mul(Simd::mul(vx, tanDelta), invL);
+            r = Simd::add(rKin, Simd::mul(w, Simd::sub(r, rKin)));
+            V vyKin = Simd::mul(rKin, b);
+            vy = Simd::add(vyKin, Simd::mul(w, Simd::sub(vy, vyKin)));
+
+            // integrate pose: forward = (sin yaw, cos yaw), side = (cos yaw, -sin yaw)
+            V dyaw = Simd::mul(r, dt);
+            V sy, cy;
+            vsincos(dyaw, sy, cy);
+            V nhx = Simd::add(Simd::mul(hx, cy), Simd::mul(hz, sy));
+            hz = Simd::sub(Simd::mul(hz, cy), Simd::mul(hx, sy));
+            hx = nhx;
+            yaw = Simd::add(yaw, Simd::mul(dyaw, toDegrees));
+            px = Simd::add(px, Simd::mul(Simd::add(Simd::mul(hx, vx), Simd::mul(hz, vy)), dt));
+            pz = Simd::add(pz, Simd::mul(Simd::sub(Simd::mul(hz, vx), Simd::mul(hx, vy)), dt));
+        }
+
+        // keep the heading unit length
+        V invLen = Simd::div(one, Simd::sqrt(Simd::add(Simd::mul(hx, hx), Simd::mul(hz, hz))));
+        Simd::store(v.posX + i, px);
+        Simd::store(v.posZ + i, pz);
+        Simd::store(v.yaw + i, yaw);
+        Simd::store(v.headX + i, Simd::mul(hx, invLen));
+        Simd::store(v.headZ + i, Simd::mul(hz, invLen));
+        Simd::store(v.vx + i, vx);
+        Simd::store(v.vy + i, vy);
+        Simd::store(v.yawRate + i, r);
+        Simd::store(v.accel + i, ax);
+    }
+    return i;
+}
@@ -0,0 +1,316 @@
+#ifndef WORLD_STREAM_H
+#define WORLD_STREAM_H
+
+// Open world streamed in square chunks around the car.
+//
+// Every frame update() works out which chunks should be resident: those within
+// loadRadius of the car, plus those within loadRadius of where the car will be
+// prefetchSeconds from now (so driving fast pulls the world in ahead of it). Missing
+// chunks are requested nearest-first; a request builds the chunk's CPU data as a job
+// on the job system, and the main thread uploads finished chunks (at most
+// maxUploadsPerFrame, nearest first, so a burst of arrivals cannot hitch a frame).
+// Chunks beyond evictRadius of both the car and its prediction are released; the gap
+// between the two radii keeps chunks from thrashing at the boundary.
+//
+// Resident and in-flight chunks count against budgetBytes (CPU copy + GPU buffers).
+// When a new request would exceed it, the farthest chunk that is not wanted is evicted
+// first; if every resident chunk is wanted, the request waits, so the budget also caps
+// the effective radius.
+//
+// Chunks are ground tiles in world coordinates: a grid of cellsPerChunk^2 quads with
+// the floor's UV density, continuous across chunk borders.
+
+#include <glm/glm.hpp>
+
+#include "jobs.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+struct WorldStreamConfig
+{
+    float chunkSize = 32.0f;            // world units per chunk side
+    int cellsPerChunk = 16;             // ground quads per chunk side
+    float uvPerUnit = 0.5f;             // texture repeats per world unit
+    float loadRadius = 96.0f;           // request chunks whose centre is this close
+    float evictRadius = 128.0f;         // release chunks beyond this
+    float prefetchSeconds = 2.0f;       // look-ahead along the car's velocity
+    size_t budgetBytes = 4u << 20;      // resident + in-flight chunk memory
+    unsigned int maxUploadsPerFrame = 4;
+};
+
+struct WorldStreamStats
+{
+    size_t resident = 0, loading = 0;   // chunks uploaded / requested but not uploaded
+    size_t residentBytes = 0;
+    uint64_t loads = 0, evictions = 0, deferredByBudget = 0;
+    double lastLatencyMs = 0.0, avgLatencyMs = 0.0, maxLatencyMs = 0.0;   // request -> uploaded
+};
+
+class WorldStreamer
+{
+public:
+    // renderer may be null (benchmarks): chunks are built but never uploaded
+    explicit WorldStreamer(Renderer* renderer, const WorldStreamConfig& config = WorldStreamConfig())
+        : renderer(renderer), config(config) {}
+
+    ~WorldStreamer()
+    {
+        jobSystem().wait(inFlight);
+        for (auto& kv : chunks)
+            if (kv.second->mesh != NO_MESH && renderer) renderer->destroyMesh(kv.second->mesh);
+    }
+
+    void update(const glm::vec3& position, const glm::vec3& velocity)
+    {
+        glm::vec3 ahead = position + velocity * config.prefetchSeconds;
+        auto distance = [&](const glm::vec3& c) {
+            return std::min(glm::length(glm::vec3(c.x - position.x, 0.0f, c.z - position.z)),
+                            glm::length(glm::vec3(c.x - ahead.x, 0.0f, c.z - ahead.z)));
+        };
+
+        // single core: no workers, so lend this thread to the queued builds
+        if (jobSystem().threadCount() == 1)
+            for (unsigned int k = 0; k < config.maxUploadsPerFrame && jobSystem().runPending(); k++) {}
+
+        // upload finished builds, nearest first
+        std::vector<Chunk*> built;
+        for (auto& kv : chunks)
+            if (kv.second->state.load(std::memory_order_acquire) == Built) built.push_back(kv.second.get());
+        std::sort(built.begin(), built.end(), [&](Chunk* a, Chunk* b) { return distance(a->center) < distance(b->center); });
+        for (size_t k = 0; k < built.size() && k < config.maxUploadsPerFrame; k++) upload(*built[k], Clock::now());
+
+        // release what is far from both the car and its prediction
+        for (auto it = chunks.begin(); it != chunks.end();)
+        {
+            if (it->second->state.load(std::memory_order_acquire) != Loading && distance(it->second->center) > config.evictRadius)
+                it = release(it);
+            else
+                ++it;
+        }
+
+        // request missing chunks around the car and around its prediction, nearest first
+        std::vector<std::pair<float, ChunkCoord>> wanted;
+        collectWanted(position, distance, wanted);
+        collectWanted(ahead, distance, wanted);
+        std::sort(wanted.begin(), wanted.end(), [](const std::pair<float, ChunkCoord>& a, const std::pair<float, ChunkCoord>& b) { return a.first < b.first; });
+        size_t bytesPerChunk = chunkBytes();
+        for (const auto& w : wanted)
+        {
+            if (chunks.count(key(w.second))) continue;
+            if (usedBytes + bytesPerChunk > config.budgetBytes && !evictFarthestUnwanted(distance, w.first, bytesPerChunk))
+            {
+                counters.deferredByBudget++;
+                break;
+            }
+            request(w.second, Clock::now());
+        }
+
+        counters.resident = counters.loading = 0;
+        for (auto& kv : chunks)
+        {
+            if (kv.second->mesh != NO_MESH || (!renderer && kv.second->state.load(std::memory_order_acquire) == Uploaded)) counters.resident++;
+            else counters.loading++;
+        }
+        counters.residentBytes = usedBytes;
+    }
+
+    // ground tiles to draw this frame
+    void draw(std::vector<DrawItem>& list, unsigned int texture) const
+    {
+        for (const auto& kv : chunks)
+            if (kv.second->mesh != NO_MESH)
+                list.push_back({ kv.second->mesh, Material::Floor, glm::mat4(1.0f), texture });
+    }
+
+    const WorldStreamStats& stats() const { return counters; }
+    const WorldStreamConfig& settings() const { return config; }
+
+    void printStats(std::ostream& out) const
+    {
+        out << "world stream: " << counters.resident << " resident chunks (" << counters.residentBytes / 1024 << " KB of "
+            << config.budgetBytes / 1024 << " KB), " << counters.loading << " loading, " << counters.loads << " loads, "
+            << counters.evictions << " evictions, " << counters.deferredByBudget << " deferred by budget\n"
+            << "  load latency: avg " << counters.avgLatencyMs << " ms, max " << counters.maxLatencyMs << " ms\n";
+    }
+
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+    static const unsigned int NO_MESH = ~0u;
+    enum State { Loading, Built, Uploaded };
+
+    struct ChunkCoord { int x, z; };
+
+    struct Chunk
+    {
+        ChunkCoord coord;
+        glm::vec3 center;
+        std::atomic<int> state{ Loading };
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+        unsigned int mesh = NO_MESH;
+        Clock::time_point requested;
+    };
+
+    typedef std::unordered_map<uint64_t, std::unique_ptr<Chunk>> ChunkMap;
+
+    Renderer* renderer;
+    WorldStreamConfig config;
+    ChunkMap chunks;
+    JobCounter inFlight;
+    size_t usedBytes = 0;
+    WorldStreamStats counters;
+
+    static uint64_t key(ChunkCoord c) { return ((uint64_t)(uint32_t)c.x << 32) | (uint32_t)c.z; }
+
+    glm::vec3 centerOf(ChunkCoord c) const
+    {
+        return glm::vec3((c.x + 0.5f) * config.chunkSize, 0.0f, (c.z + 0.5f) * config.chunkSize);
+    }
+
+    // geometry is held twice: the CPU copy and the GPU buffers
+    size_t chunkBytes() const
+    {
+        size_t verts = (size_t)(config.cellsPerChunk + 1) * (config.cellsPerChunk + 1);
+        size_t tris = (size_t)config.cellsPerChunk * config.cellsPerChunk * 2;
+        return 2 * (verts * 8 * sizeof(float) + tris * 3 * sizeof(unsigned int));
+    }
+
+    template <typename Distance>
+    void collectWanted(const glm::vec3& around, Distance distance, std::vector<std::pair<float, ChunkCoord>>& wanted) const
+    {
+        int r = (int)std::ceil(config.loadRadius / config.chunkSize);
+        int cx = (int)std::floor(around.x / config.chunkSize), cz = (int)std::floor(around.z / config.chunkSize);
+        for (int z = cz - r; z <= cz + r; z++)
+            for (int x = cx - r; x <= cx + r; x++)
+            {
+                glm::vec3 c = centerOf({ x, z });
+                if (glm::length(glm::vec3(c.x - around.x, 0.0f, c.z - around.z)) <= config.loadRadius)
+                    wanted.push_back({ distance(c), { x, z } });
+            }
+    }
+
+    void request(ChunkCoord coord, Clock::time_point now)
+    {
+        std::unique_ptr<Chunk> chunk(new Chunk());
+        chunk->coord = coord;
+        chunk->center = centerOf(coord);
+        chunk->requested = now;
+        Chunk* c = chunk.get();
+        chunks[key(coord)] = std::move(chunk);
+        usedBytes += chunkBytes();
+        jobSystem().run([this, c]() {
+            build(*c);
+            c->state.store(Built, std::memory_order_release);
+        }, &inFlight);
+    }
+
+    // CPU side: ground grid in world space
+    void build(Chunk& c) const
+    {
+        int n = config.cellsPerChunk;
+        float step = config.chunkSize / n;
+        glm::vec3 origin((float)c.coord.x * config.chunkSize, 0.0f, (float)c.coord.z * config.chunkSize);
+        c.vertices.reserve((size_t)(n + 1) * (n + 1) * 8);
+        for (int z = 0; z <= n; z++)
+            for (int x = 0; x <= n; x++)
+            {
+                glm::vec3 p = origin + glm::vec3(x * step, 0.0f, z * step);
+                float v[8] = { p.x, p.y, p.z, 0.0f, 1.0f, 0.0f, p.x * config.uvPerUnit, -p.z * config.uvPerUnit };
+                c.vertices.insert(c.vertices.end(), v, v + 8);
+            }
+        c.indices.reserve((size_t)n * n * 6);
+        for (int z = 0; z < n; z++)
+            for (int x = 0; x < n; x++)
+            {
+                unsigned int i0 = z * (n + 1) + x, i1 = i0 + 1, i2 = i0 + (n + 1), i3 = i2 + 1;
+                unsigned int quad[6] = { i0, i2, i3, i3, i1, i0 };
+                c.indices.insert(c.indices.end(), quad, quad + 6);
+            }
+    }
+
+    void upload(Chunk& c, Clock::time_point now)
+    {
+        if (renderer)
+            c.mesh = renderer->createMesh(c.vertices.data(), c.vertices.size() / 8, c.indices.data(), c.indices.size());
+        c.state.store(Uploaded, std::memory_order_release);
+        double ms = std::chrono::duration<double, std::milli>(now - c.requested).count();
+        counters.loads++;
+        counters.lastLatencyMs = ms;
+        counters.avgLatencyMs += (ms - counters.avgLatencyMs) / (double)counters.loads;
+        counters.maxLatencyMs = std::max(counters.maxLatencyMs, ms);
+    }
+
+    ChunkMap::iterator release(ChunkMap::iterator it)
+    {
+        if (it->second->mesh != NO_MESH && renderer) renderer->destroyMesh(it->second->mesh);
+        usedBytes -= chunkBytes();
+        counters.evictions++;
+        return chunks.erase(it);
+    }
+
+    // frees room for a chunk at distance `need` by evicting one that is farther away
+    template <typename Distance>
+    bool evictFarthestUnwanted(Distance distance, float need, size_t bytes)
+    {
+        while (usedBytes + bytes > config.budgetBytes)
+        {
+            ChunkMap::iterator farthest = chunks.end();
+            float best = need;
+            for (auto it = chunks.begin(); it != chunks.end(); ++it)
+            {
+                if (it->second->state.load(std::memory_order_acquire) == Loading) continue;
+                float d = distance(it->second->center);
+                if (d > best) { best = d; farthest = it; }
+            }
+            if (farthest == chunks.end()) return false;
+            release(farthest);
+        }
+        return true;
+    }
+};
+
+// ---- benchmark: drive straight through the world at several speeds ----
+// No renderer, so latency is request -> built on a worker -> taken by the main thread.
+inline void runWorldStreamBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const float dt = 1.0f / 60.0f;
+    const int frames = 1200;
+
+    std::cout << "world stream (" << jobSystem().threadCount() << " job threads), " << frames << " frames at 60 Hz\n";
+    std::cout << std::setw(10) << "speed" << std::setw(12) << "budget KB" << std::setw(10) << "resident" << std::setw(10) << "loads"
+              << std::setw(10) << "evicted" << std::setw(10) << "deferred" << std::setw(14) << "avg lat ms" << std::setw(14) << "max lat ms"
+              << std::setw(14) << "update ms" << "\n";
+    for (float speed : { 12.0f, 50.0f, 200.0f })
+        for (size_t budget : { (size_t)1 << 20, (size_t)4 << 20 })
+        {
+            WorldStreamConfig config;
+            config.budgetBytes = budget;
+            WorldStreamer world(nullptr, config);
+            glm::vec3 pos(0.0f), vel(speed * 0.6f, 0.0f, speed * 0.8f);
+            double updateMs = 0.0;
+            for (int f = 0; f < frames; f++)
+            {
+                auto t0 = Clock::now();
+                world.update(pos, vel);
+                updateMs += std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+                pos += vel * dt;
+            }
+            const WorldStreamStats& s = world.stats();
+            std::cout << std::setw(10) << speed << std::setw(12) << budget / 1024 << std::setw(10) << s.resident << std::setw(10) << s.loads
+                      << std::setw(10) << s.evictions << std::setw(10) << s.deferredByBudget << std::setw(14) << s.avgLatencyMs << std::setw(14) << s.maxLatencyMs
+                      << std::setw(14) << updateMs / frames << "\n";
+        }
+}
+
+#endif